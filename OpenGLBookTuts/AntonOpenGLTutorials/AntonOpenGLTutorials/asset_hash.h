@@ -0,0 +1,27 @@
+#pragma once
+/******************************************************************************\
+| The one content hash in the tree: 64-bit FNV-1a. Asset pack entries, shader  |
+| sources and cache keys (shader_library, texture_cache) are all hashed with   |
+| it. The seed carries on from an earlier hash, so several pieces can be       |
+| hashed as if they were one buffer, or a value folded into a key.             |
+| Inline so the tools get it without linking anything else.                    |
+\******************************************************************************/
+#ifndef _ASSET_HASH_H_
+#define _ASSET_HASH_H_
+
+#include <stddef.h>
+
+#define ASSET_HASH_SEED 14695981039346656037ull
+
+inline unsigned long long asset_hash(const void *data, size_t size,
+	unsigned long long seed = ASSET_HASH_SEED) {
+	const unsigned char *bytes = (const unsigned char *)data;
+	unsigned long long h = seed;
+	for (size_t i = 0; i < size; i++) {
+		h ^= bytes[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+#endif
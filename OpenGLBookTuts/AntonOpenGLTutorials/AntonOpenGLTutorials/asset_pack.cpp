@@ -0,0 +1,201 @@
+#include "asset_pack.h"
+#include "stb_image.h"
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void clear_pack(asset_pack_t *pack) {
+	pack->base = NULL;
+	pack->size = 0;
+	pack->header = NULL;
+	pack->entries = NULL;
+#ifdef _WIN32
+	pack->file = INVALID_HANDLE_VALUE;
+	pack->mapping = NULL;
+#else
+	pack->fd = -1;
+#endif
+}
+
+// the whole pages covering [data, data + size)
+void page_range(const asset_pack_t *pack, const asset_entry_t *entry, void **start,
+	size_t *length) {
+	size_t begin = (size_t)entry->offset & ~(size_t)(ASSET_PACK_ALIGNMENT - 1);
+	size_t end = (size_t)(entry->offset + entry->stored_size);
+	*start = (void *)(pack->base + begin);
+	*length = end - begin;
+}
+
+bool map_file(asset_pack_t *pack, const char *path) {
+#ifdef _WIN32
+	pack->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (pack->file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(pack->file, &size) || size.QuadPart == 0) {
+		return false;
+	}
+	pack->size = (size_t)size.QuadPart;
+	pack->mapping = CreateFileMappingA(pack->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!pack->mapping) {
+		return false;
+	}
+	pack->base = (const unsigned char *)MapViewOfFile(pack->mapping, FILE_MAP_READ, 0, 0, 0);
+	return pack->base != NULL;
+#else
+	pack->fd = open(path, O_RDONLY);
+	if (pack->fd < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(pack->fd, &info) != 0 || info.st_size == 0) {
+		return false;
+	}
+	pack->size = (size_t)info.st_size;
+	void *base = mmap(NULL, pack->size, PROT_READ, MAP_PRIVATE, pack->fd, 0);
+	if (base == MAP_FAILED) {
+		return false;
+	}
+	pack->base = (const unsigned char *)base;
+	// the header and TOC get read first, the entries in whatever order the game
+	// wants them, so no readahead across the whole file
+	madvise(base, pack->size, MADV_RANDOM);
+	return true;
+#endif
+}
+
+} // namespace
+
+bool asset_pack_open(asset_pack_t *pack, const char *path) {
+	clear_pack(pack);
+	if (!map_file(pack, path)) {
+		asset_pack_close(pack);
+		return false;
+	}
+
+	const asset_pack_header_t *header = (const asset_pack_header_t *)pack->base;
+	if (pack->size < sizeof(*header) || memcmp(header->magic, "APAK", 4) != 0 ||
+		header->version != ASSET_PACK_VERSION || header->file_size != pack->size) {
+		fprintf(stderr, "ERROR: %s is not a version %i asset pack\n", path, ASSET_PACK_VERSION);
+		asset_pack_close(pack);
+		return false;
+	}
+	const asset_entry_t *entries = (const asset_entry_t *)(header + 1);
+	if ((pack->size - sizeof(*header)) / sizeof(asset_entry_t) < header->entry_count) {
+		fprintf(stderr, "ERROR: %s: table of contents runs past the end\n", path);
+		asset_pack_close(pack);
+		return false;
+	}
+	for (unsigned int i = 0; i < header->entry_count; i++) {
+		const asset_entry_t &entry = entries[i];
+		if (entry.name[ASSET_NAME_LENGTH - 1] != '\0' || entry.offset > pack->size ||
+			entry.stored_size > pack->size - entry.offset ||
+			(i > 0 && strcmp(entries[i - 1].name, entry.name) >= 0)) {
+			fprintf(stderr, "ERROR: %s: entry %u is malformed\n", path, i);
+			asset_pack_close(pack);
+			return false;
+		}
+	}
+	pack->header = header;
+	pack->entries = entries;
+	return true;
+}
+
+void asset_pack_close(asset_pack_t *pack) {
+#ifdef _WIN32
+	if (pack->base) {
+		UnmapViewOfFile(pack->base);
+	}
+	if (pack->mapping) {
+		CloseHandle(pack->mapping);
+	}
+	if (pack->file != INVALID_HANDLE_VALUE) {
+		CloseHandle(pack->file);
+	}
+#else
+	if (pack->base) {
+		munmap((void *)pack->base, pack->size);
+	}
+	if (pack->fd >= 0) {
+		close(pack->fd);
+	}
+#endif
+	clear_pack(pack);
+}
+
+const asset_entry_t *asset_pack_find(const asset_pack_t *pack, const char *name) {
+	if (!pack->header) {
+		return NULL;
+	}
+	size_t low = 0;
+	size_t high = pack->header->entry_count;
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		int order = strcmp(pack->entries[middle].name, name);
+		if (order == 0) {
+			return &pack->entries[middle];
+		}
+		if (order < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return NULL;
+}
+
+void asset_pack_prefetch(const asset_pack_t *pack, const asset_entry_t *entry) {
+	void *start;
+	size_t length;
+	page_range(pack, entry, &start, &length);
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+	WIN32_MEMORY_RANGE_ENTRY range = {start, length};
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+	madvise(start, length, MADV_WILLNEED);
+#endif
+}
+
+const unsigned char *asset_pack_read(const asset_pack_t *pack, const asset_entry_t *entry,
+	std::vector<unsigned char> &scratch, size_t *size) {
+	const unsigned char *data = pack->base + entry->offset;
+#ifndef _WIN32
+	void *start;
+	size_t length;
+	page_range(pack, entry, &start, &length);
+	madvise(start, length, MADV_SEQUENTIAL);
+#endif
+	*size = (size_t)entry->size;
+	if (!(entry->flags & ASSET_DEFLATE)) {
+		return data;
+	}
+	scratch.resize((size_t)entry->size);
+	int inflated = stbi_zlib_decode_noheader_buffer((char *)scratch.data(), (int)scratch.size(),
+		(const char *)data, (int)entry->stored_size);
+	if (inflated < 0 || (unsigned long long)inflated != entry->size) {
+		fprintf(stderr, "ERROR: asset %s doesn't inflate to %llu bytes\n", entry->name,
+			entry->size);
+		return NULL;
+	}
+	return scratch.data();
+}
+
+bool asset_pack_verify(const asset_pack_t *pack, const asset_entry_t *entry) {
+	std::vector<unsigned char> scratch;
+	size_t size;
+	const unsigned char *data = asset_pack_read(pack, entry, scratch, &size);
+	return data && asset_hash(data, size) == entry->hash;
+}
@@ -0,0 +1,79 @@
+#pragma once
+/******************************************************************************\
+| Read-only asset pack: every asset in one file, mapped into memory once.      |
+| Layout:                                                                      |
+|   asset_pack_header_t                                                        |
+|   asset_entry_t[entry_count], sorted by name so lookups can binary search    |
+|   entry data, each starting on an ASSET_PACK_ALIGNMENT (page) boundary       |
+| An entry is either stored as is (PNG and JPEG are compressed already) or     |
+| raw deflate (ASSET_DEFLATE) when that saved enough to be worth it, and       |
+| carries the FNV-1a hash of its uncompressed bytes.                           |
+| The mapping is opened with a random access hint, asset_pack_prefetch asks    |
+| the OS to start paging an entry in ahead of time and asset_pack_read marks   |
+| the entry sequential before handing it out, so readahead works for the big   |
+| images without pulling in the rest of the pack.                              |
+| Packs are built with tools/asset_packer. No OpenGL in here.                  |
+\******************************************************************************/
+#ifndef _ASSET_PACK_H_
+#define _ASSET_PACK_H_
+
+#include "asset_hash.h"
+#include <stddef.h>
+#include <vector>
+
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGNMENT 4096
+#define ASSET_NAME_LENGTH 80
+
+// asset_entry_t::flags
+#define ASSET_DEFLATE 1
+
+struct asset_pack_header_t {
+	char magic[4]; // "APAK"
+	unsigned int version;
+	unsigned int entry_count;
+	unsigned int alignment;
+	unsigned long long file_size;
+	unsigned long long reserved[5];
+};
+
+struct asset_entry_t {
+	char name[ASSET_NAME_LENGTH]; // nul terminated
+	unsigned long long offset; // from the start of the pack
+	unsigned long long stored_size;
+	unsigned long long size; // uncompressed
+	unsigned long long hash; // of the uncompressed bytes
+	unsigned int flags;
+	unsigned int reserved[3];
+};
+
+struct asset_pack_t {
+	const unsigned char *base;
+	size_t size;
+	const asset_pack_header_t *header;
+	const asset_entry_t *entries;
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#else
+	int fd;
+#endif
+};
+
+// maps 'path' and checks the header and table of contents. false (with the
+// reason printed) if it's missing or malformed, 'pack' is then left closed
+bool asset_pack_open(asset_pack_t *pack, const char *path);
+void asset_pack_close(asset_pack_t *pack);
+// NULL if the pack has no entry called 'name'
+const asset_entry_t *asset_pack_find(const asset_pack_t *pack, const char *name);
+// starts paging the entry in without waiting for it
+void asset_pack_prefetch(const asset_pack_t *pack, const asset_entry_t *entry);
+// the uncompressed contents of 'entry', 'size' bytes long. stored entries
+// point straight into the mapping, deflated ones are inflated into 'scratch'.
+// NULL if inflating failed or the result doesn't have the size in the TOC
+const unsigned char *asset_pack_read(const asset_pack_t *pack, const asset_entry_t *entry,
+	std::vector<unsigned char> &scratch, size_t *size);
+// reads the entry and compares it against its content hash
+bool asset_pack_verify(const asset_pack_t *pack, const asset_entry_t *entry);
+
+#endif
@@ -0,0 +1,338 @@
+// generated by tools/shader_permutations from shaders.manifest, do not edit.
+// regenerate after changing a shader, include or the manifest:
+//   shader_permutations shaders.manifest --embed=embedded_shaders.h
+// (run from this directory)
+#pragma once
+#ifndef _EMBEDDED_SHADERS_H_
+#define _EMBEDDED_SHADERS_H_
+
+struct embedded_shader_t {
+	const char *file;
+	const char *permutation; // normalised key, see shader_preprocessor.h
+	unsigned long long hash; // hash_string(source)
+	const char *source; // preprocessed
+};
+
+static constexpr int embedded_shader_count = 10;
+
+static constexpr embedded_shader_t embedded_shaders[] = {
+	{ "skybox_shader.vert", "", 0x49e1b2df7254a381ull,
+		"#version 410\n"
+		"// 0: skybox_shader.vert\n"
+		"#line 1 0\n"
+		"\n"
+		"\n"
+		"//no vertex buffer: one triangle that covers the whole screen is made from gl_VertexID\n"
+		"//(0 -> (-1,-1), 1 -> (3,-1), 2 -> (-1,3))\n"
+		"uniform mat4 inv_proj_view;\n"
+		"out vec3 texcoords;\n"
+		"\n"
+		"void main() {\n"
+		"  vec2 ndc = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;\n"
+		"  //unproject a point on the far plane to get the view direction through this pixel\n"
+		"  vec4 world = inv_proj_view * vec4(ndc, 1.0, 1.0);\n"
+		"  texcoords = world.xyz / world.w;\n"
+		"  //z = w puts the triangle exactly on the far plane (depth 1.0)\n"
+		"  gl_Position = vec4(ndc, 1.0, 1.0);\n"
+		"}\n"
+	},
+	{ "skybox_shader.frag", "", 0x2b1c85effec560cfull,
+		"#version 410\n"
+		"// 0: skybox_shader.frag\n"
+		"#line 1 0\n"
+		"\n"
+		"\n"
+		"in vec3 texcoords;\n"
+		"uniform samplerCube cube_texture;\n"
+		"out vec4 frag_colour;\n"
+		"\n"
+		"void main() {\n"
+		"  frag_colour = texture(cube_texture, texcoords);\n"
+		"}\n"
+	},
+	{ "test.vert", "FLAT_COLOUR=vec4(1.0,0.0,0.0,1.0)", 0xee9a16792e1415e5ull,
+		"#version 410\n"
+		"#define FLAT_COLOUR vec4(1.0,0.0,0.0,1.0)\n"
+		"// 0: test.vert\n"
+		"#line 1 0\n"
+		"\n"
+		"\tin vec3 vp;\n"
+		"\tvoid main()\n"
+		"\t{\n"
+		"\t\tgl_Position = vec4(vp[0], vp[1], vp[2], 1.0);\n"
+		"\t};\n"
+	},
+	{ "mesh.frag", "FLAT_COLOUR=vec4(1.0,0.0,0.0,1.0)", 0xf0cedaca52aec023ull,
+		"#version 410\n"
+		"#define FLAT_COLOUR vec4(1.0,0.0,0.0,1.0)\n"
+		"// 0: mesh.frag\n"
+		"#line 1 0\n"
+		"\n"
+		"//fragment shader for everything but the skybox, see shaders.manifest\n"
+		"//permutations: TEXTURED, VERTEX_COLOUR, FLAT_COLOUR=<vec4> for anything else\n"
+		"\n"
+		"#ifndef FLAT_COLOUR\n"
+		"#define FLAT_COLOUR vec4(0.5, 0.5, 0.5, 1.0)\n"
+		"#endif\n"
+		"\n"
+		"#ifdef TEXTURED\n"
+		"in vec2 texture_coordinates;\n"
+		"uniform sampler2D basic_texture;\n"
+		"#endif\n"
+		"#ifdef VERTEX_COLOUR\n"
+		"in vec3 colour;\n"
+		"#endif\n"
+		"out vec4 frag_colour;\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"#if defined(TEXTURED)\n"
+		"\tfrag_colour = texture(basic_texture, texture_coordinates);\n"
+		"#elif defined(VERTEX_COLOUR)\n"
+		"\tfrag_colour = vec4(colour, 1.0);\n"
+		"#else\n"
+		"\tfrag_colour = FLAT_COLOUR;\n"
+		"#endif\n"
+		"}\n"
+	},
+	{ "mesh.vert", "VERTEX_COLOUR", 0xdfde105756d890f7ull,
+		"#version 410\n"
+		"#define VERTEX_COLOUR\n"
+		"// 0: mesh.vert\n"
+		"// 1: transform.glsl\n"
+		"#line 1 0\n"
+		"\n"
+		"//vertex shader for the ship, asteroid and vertex coloured entity, see shaders.manifest\n"
+		"//permutations: TEXTURED, VERTEX_COLOUR\n"
+		"\n"
+		"#if defined(TEXTURED) && defined(VERTEX_COLOUR)\n"
+		"#error TEXTURED and VERTEX_COLOUR both use attribute location 1\n"
+		"#endif\n"
+		"\n"
+		"#line 1 1\n"
+		"//model-view-projection transform shared by the mesh shaders\n"
+		"\n"
+		"uniform mat4 matrix;\n"
+		"uniform mat4 view, proj;\n"
+		"\n"
+		"vec4 transform_position(vec3 position)\n"
+		"{\n"
+		"\treturn proj * view * matrix * vec4(position, 1.0);\n"
+		"}\n"
+		"#line 10 0\n"
+		"\n"
+		"layout(location = 0) in vec3 vertex_position;\n"
+		"#ifdef TEXTURED\n"
+		"layout(location = 1) in vec2 vt;\n"
+		"out vec2 texture_coordinates;\n"
+		"#endif\n"
+		"#ifdef VERTEX_COLOUR\n"
+		"layout(location = 1) in vec3 vertex_colour;\n"
+		"out vec3 colour;\n"
+		"#endif\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"#ifdef TEXTURED\n"
+		"\ttexture_coordinates = vt;\n"
+		"#endif\n"
+		"#ifdef VERTEX_COLOUR\n"
+		"\tcolour = vertex_colour;\n"
+		"#endif\n"
+		"\tgl_Position = transform_position(vertex_position);\n"
+		"}\n"
+	},
+	{ "mesh.frag", "VERTEX_COLOUR", 0x18df0e42b27718b5ull,
+		"#version 410\n"
+		"#define VERTEX_COLOUR\n"
+		"// 0: mesh.frag\n"
+		"#line 1 0\n"
+		"\n"
+		"//fragment shader for everything but the skybox, see shaders.manifest\n"
+		"//permutations: TEXTURED, VERTEX_COLOUR, FLAT_COLOUR=<vec4> for anything else\n"
+		"\n"
+		"#ifndef FLAT_COLOUR\n"
+		"#define FLAT_COLOUR vec4(0.5, 0.5, 0.5, 1.0)\n"
+		"#endif\n"
+		"\n"
+		"#ifdef TEXTURED\n"
+		"in vec2 texture_coordinates;\n"
+		"uniform sampler2D basic_texture;\n"
+		"#endif\n"
+		"#ifdef VERTEX_COLOUR\n"
+		"in vec3 colour;\n"
+		"#endif\n"
+		"out vec4 frag_colour;\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"#if defined(TEXTURED)\n"
+		"\tfrag_colour = texture(basic_texture, texture_coordinates);\n"
+		"#elif defined(VERTEX_COLOUR)\n"
+		"\tfrag_colour = vec4(colour, 1.0);\n"
+		"#else\n"
+		"\tfrag_colour = FLAT_COLOUR;\n"
+		"#endif\n"
+		"}\n"
+	},
+	{ "mesh.vert", "TEXTURED", 0x896b748ce9ca21dbull,
+		"#version 410\n"
+		"#define TEXTURED\n"
+		"// 0: mesh.vert\n"
+		"// 1: transform.glsl\n"
+		"#line 1 0\n"
+		"\n"
+		"//vertex shader for the ship, asteroid and vertex coloured entity, see shaders.manifest\n"
+		"//permutations: TEXTURED, VERTEX_COLOUR\n"
+		"\n"
+		"#if defined(TEXTURED) && defined(VERTEX_COLOUR)\n"
+		"#error TEXTURED and VERTEX_COLOUR both use attribute location 1\n"
+		"#endif\n"
+		"\n"
+		"#line 1 1\n"
+		"//model-view-projection transform shared by the mesh shaders\n"
+		"\n"
+		"uniform mat4 matrix;\n"
+		"uniform mat4 view, proj;\n"
+		"\n"
+		"vec4 transform_position(vec3 position)\n"
+		"{\n"
+		"\treturn proj * view * matrix * vec4(position, 1.0);\n"
+		"}\n"
+		"#line 10 0\n"
+		"\n"
+		"layout(location = 0) in vec3 vertex_position;\n"
+		"#ifdef TEXTURED\n"
+		"layout(location = 1) in vec2 vt;\n"
+		"out vec2 texture_coordinates;\n"
+		"#endif\n"
+		"#ifdef VERTEX_COLOUR\n"
+		"layout(location = 1) in vec3 vertex_colour;\n"
+		"out vec3 colour;\n"
+		"#endif\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"#ifdef TEXTURED\n"
+		"\ttexture_coordinates = vt;\n"
+		"#endif\n"
+		"#ifdef VERTEX_COLOUR\n"
+		"\tcolour = vertex_colour;\n"
+		"#endif\n"
+		"\tgl_Position = transform_position(vertex_position);\n"
+		"}\n"
+	},
+	{ "mesh.frag", "TEXTURED", 0xbfbda84b4acf7f99ull,
+		"#version 410\n"
+		"#define TEXTURED\n"
+		"// 0: mesh.frag\n"
+		"#line 1 0\n"
+		"\n"
+		"//fragment shader for everything but the skybox, see shaders.manifest\n"
+		"//permutations: TEXTURED, VERTEX_COLOUR, FLAT_COLOUR=<vec4> for anything else\n"
+		"\n"
+		"#ifndef FLAT_COLOUR\n"
+		"#define FLAT_COLOUR vec4(0.5, 0.5, 0.5, 1.0)\n"
+		"#endif\n"
+		"\n"
+		"#ifdef TEXTURED\n"
+		"in vec2 texture_coordinates;\n"
+		"uniform sampler2D basic_texture;\n"
+		"#endif\n"
+		"#ifdef VERTEX_COLOUR\n"
+		"in vec3 colour;\n"
+		"#endif\n"
+		"out vec4 frag_colour;\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"#if defined(TEXTURED)\n"
+		"\tfrag_colour = texture(basic_texture, texture_coordinates);\n"
+		"#elif defined(VERTEX_COLOUR)\n"
+		"\tfrag_colour = vec4(colour, 1.0);\n"
+		"#else\n"
+		"\tfrag_colour = FLAT_COLOUR;\n"
+		"#endif\n"
+		"}\n"
+	},
+	{ "mesh.vert", "", 0x610da36f30784b0aull,
+		"#version 410\n"
+		"// 0: mesh.vert\n"
+		"// 1: transform.glsl\n"
+		"#line 1 0\n"
+		"\n"
+		"//vertex shader for the ship, asteroid and vertex coloured entity, see shaders.manifest\n"
+		"//permutations: TEXTURED, VERTEX_COLOUR\n"
+		"\n"
+		"#if defined(TEXTURED) && defined(VERTEX_COLOUR)\n"
+		"#error TEXTURED and VERTEX_COLOUR both use attribute location 1\n"
+		"#endif\n"
+		"\n"
+		"#line 1 1\n"
+		"//model-view-projection transform shared by the mesh shaders\n"
+		"\n"
+		"uniform mat4 matrix;\n"
+		"uniform mat4 view, proj;\n"
+		"\n"
+		"vec4 transform_position(vec3 position)\n"
+		"{\n"
+		"\treturn proj * view * matrix * vec4(position, 1.0);\n"
+		"}\n"
+		"#line 10 0\n"
+		"\n"
+		"layout(location = 0) in vec3 vertex_position;\n"
+		"#ifdef TEXTURED\n"
+		"layout(location = 1) in vec2 vt;\n"
+		"out vec2 texture_coordinates;\n"
+		"#endif\n"
+		"#ifdef VERTEX_COLOUR\n"
+		"layout(location = 1) in vec3 vertex_colour;\n"
+		"out vec3 colour;\n"
+		"#endif\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"#ifdef TEXTURED\n"
+		"\ttexture_coordinates = vt;\n"
+		"#endif\n"
+		"#ifdef VERTEX_COLOUR\n"
+		"\tcolour = vertex_colour;\n"
+		"#endif\n"
+		"\tgl_Position = transform_position(vertex_position);\n"
+		"}\n"
+	},
+	{ "mesh.frag", "", 0x8897f2f203946d9eull,
+		"#version 410\n"
+		"// 0: mesh.frag\n"
+		"#line 1 0\n"
+		"\n"
+		"//fragment shader for everything but the skybox, see shaders.manifest\n"
+		"//permutations: TEXTURED, VERTEX_COLOUR, FLAT_COLOUR=<vec4> for anything else\n"
+		"\n"
+		"#ifndef FLAT_COLOUR\n"
+		"#define FLAT_COLOUR vec4(0.5, 0.5, 0.5, 1.0)\n"
+		"#endif\n"
+		"\n"
+		"#ifdef TEXTURED\n"
+		"in vec2 texture_coordinates;\n"
+		"uniform sampler2D basic_texture;\n"
+		"#endif\n"
+		"#ifdef VERTEX_COLOUR\n"
+		"in vec3 colour;\n"
+		"#endif\n"
+		"out vec4 frag_colour;\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"#if defined(TEXTURED)\n"
+		"\tfrag_colour = texture(basic_texture, texture_coordinates);\n"
+		"#elif defined(VERTEX_COLOUR)\n"
+		"\tfrag_colour = vec4(colour, 1.0);\n"
+		"#else\n"
+		"\tfrag_colour = FLAT_COLOUR;\n"
+		"#endif\n"
+		"}\n"
+	},
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "file_system.h"
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+bool make_directory(const char *path) {
+#ifdef _WIN32
+	_mkdir(path);
+#else
+	mkdir(path, 0755);
+#endif
+	struct stat info;
+	return stat(path, &info) == 0 && (info.st_mode & S_IFDIR);
+}
+
+std::string executable_directory() {
+	char path[4096];
+#ifdef _WIN32
+	DWORD length = GetModuleFileNameA(NULL, path, sizeof(path));
+	if (length == 0 || length >= sizeof(path)) {
+		return std::string();
+	}
+#else
+	ssize_t length = readlink("/proc/self/exe", path, sizeof(path));
+	if (length <= 0 || length >= (ssize_t)sizeof(path)) {
+		return std::string();
+	}
+#endif
+	std::string directory(path, (size_t)length);
+	size_t slash = directory.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : directory.substr(0, slash + 1);
+}
+
+bool file_stamp(const char *path, unsigned long long *size, long long *write_time) {
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info)) {
+		return false;
+	}
+	*size = ((unsigned long long)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	*write_time = ((long long)info.ftLastWriteTime.dwHighDateTime << 32) |
+		info.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat info;
+	if (stat(path, &info) != 0) {
+		return false;
+	}
+	*size = (unsigned long long)info.st_size;
+#ifdef __APPLE__
+	*write_time = (long long)info.st_mtimespec.tv_sec * 1000000000ll + info.st_mtimespec.tv_nsec;
+#else
+	*write_time = (long long)info.st_mtim.tv_sec * 1000000000ll + info.st_mtim.tv_nsec;
+#endif
+#endif
+	return true;
+}
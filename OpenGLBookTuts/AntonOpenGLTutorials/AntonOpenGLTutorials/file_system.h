@@ -0,0 +1,23 @@
+#pragma once
+/******************************************************************************\
+| The few file system calls that differ between Windows and everything else,   |
+| shared by the game, its caches and the tools: making a directory, finding    |
+| the directory the executable is in (so caches don't land wherever the game   |
+| was started from) and a file's size and last write time, at the finest       |
+| resolution the OS gives, for telling whether it changed without reading it.  |
+| No OpenGL in here.                                                           |
+\******************************************************************************/
+#ifndef _FILE_SYSTEM_H_
+#define _FILE_SYSTEM_H_
+
+#include <string>
+
+// creates 'path' if it's missing (not its parents). true if it's a directory afterwards
+bool make_directory(const char *path);
+// the running executable's directory with a trailing separator, "" if it can't be found
+std::string executable_directory();
+// false if 'path' isn't there. whole seconds would miss two saves within the same one,
+// so 'write_time' is in whatever finer unit the OS has (compare it, don't interpret it)
+bool file_stamp(const char *path, unsigned long long *size, long long *write_time);
+
+#endif
@@ -0,0 +1,123 @@
+#include "file_watcher.h"
+#include "file_system.h"
+#include "steady_time.h"
+#include <algorithm>
+#include <stdio.h>
+#ifdef __linux__
+#include <errno.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// modification time at the finest resolution the OS gives, -1 if missing
+long long file_mtime(const std::string &path) {
+	unsigned long long size = 0;
+	long long write_time = 0;
+	return file_stamp(path.c_str(), &size, &write_time) ? write_time : -1;
+}
+
+void add_changed(std::vector<std::string> &changed, const std::string &path) {
+	if (std::find(changed.begin(), changed.end(), path) == changed.end()) {
+		changed.push_back(path);
+	}
+}
+
+} // namespace
+
+void file_watcher_init(file_watcher_t *watcher) {
+	watcher->files.clear();
+	watcher->next_poll = 0.0;
+	watcher->inotify_fd = -1;
+#ifdef __linux__
+	watcher->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watcher->inotify_fd < 0) {
+		fprintf(stderr, "WARNING: inotify unavailable, polling file times instead\n");
+	}
+#endif
+}
+
+bool file_watcher_add(file_watcher_t *watcher, const char *path) {
+	for (size_t i = 0; i < watcher->files.size(); i++) {
+		if (watcher->files[i].path == path) {
+			return true;
+		}
+	}
+	watched_file_t file;
+	file.path = path;
+	size_t slash = file.path.find_last_of("/\\");
+	file.directory = slash == std::string::npos ? "." : file.path.substr(0, slash);
+	file.name = slash == std::string::npos ? file.path : file.path.substr(slash + 1);
+	file.mtime = file_mtime(file.path);
+	file.watch = -1;
+	if (file.mtime < 0) {
+		fprintf(stderr, "WARNING: can't watch %s, it doesn't exist\n", path);
+		return false;
+	}
+#ifdef __linux__
+	if (watcher->inotify_fd >= 0) {
+		// watching the same directory twice gives back the same descriptor
+		file.watch = inotify_add_watch(watcher->inotify_fd, file.directory.c_str(),
+			IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (file.watch < 0) {
+			fprintf(stderr, "WARNING: inotify_add_watch failed for %s\n", file.directory.c_str());
+		}
+	}
+#endif
+	watcher->files.push_back(file);
+	return true;
+}
+
+int file_watcher_poll(file_watcher_t *watcher, std::vector<std::string> &changed) {
+	changed.clear();
+#ifdef __linux__
+	if (watcher->inotify_fd >= 0) {
+		alignas(struct inotify_event) char buffer[4096];
+		for (;;) {
+			ssize_t length = read(watcher->inotify_fd, buffer, sizeof(buffer));
+			if (length <= 0) {
+				break; // EAGAIN: nothing more queued
+			}
+			for (char *p = buffer; p < buffer + length;) {
+				const struct inotify_event *event = (const struct inotify_event *)p;
+				if (event->len > 0) {
+					for (size_t i = 0; i < watcher->files.size(); i++) {
+						const watched_file_t &file = watcher->files[i];
+						if (file.watch == event->wd && file.name == event->name) {
+							add_changed(changed, file.path);
+						}
+					}
+				}
+				p += sizeof(struct inotify_event) + event->len;
+			}
+		}
+		return (int)changed.size();
+	}
+#endif
+	double now = now_seconds();
+	if (now < watcher->next_poll) {
+		return 0;
+	}
+	watcher->next_poll = now + FILE_WATCHER_POLL_INTERVAL;
+	for (size_t i = 0; i < watcher->files.size(); i++) {
+		watched_file_t &file = watcher->files[i];
+		long long mtime = file_mtime(file.path);
+		// a missing file is usually an editor halfway through saving, wait for it
+		if (mtime >= 0 && mtime != file.mtime) {
+			file.mtime = mtime;
+			add_changed(changed, file.path);
+		}
+	}
+	return (int)changed.size();
+}
+
+void file_watcher_shutdown(file_watcher_t *watcher) {
+#ifdef __linux__
+	if (watcher->inotify_fd >= 0) {
+		close(watcher->inotify_fd);
+	}
+#endif
+	watcher->inotify_fd = -1;
+	watcher->files.clear();
+}
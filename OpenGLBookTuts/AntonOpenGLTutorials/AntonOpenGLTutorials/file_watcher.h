@@ -0,0 +1,41 @@
+#pragma once
+/******************************************************************************\
+| Reports files that have been written since the last poll.                    |
+| On Linux the directories holding the watched files get an inotify watch;     |
+| editors that save by writing a temp file and renaming it over the original   |
+| still show up as a change (IN_MOVED_TO). Everywhere else the files' last     |
+| write times are compared, at most every FILE_WATCHER_POLL_INTERVAL.          |
+| No OpenGL in here.                                                           |
+\******************************************************************************/
+#ifndef _FILE_WATCHER_H_
+#define _FILE_WATCHER_H_
+
+#include <string>
+#include <vector>
+
+// seconds between write time sweeps where inotify isn't available
+#define FILE_WATCHER_POLL_INTERVAL 0.25
+
+struct watched_file_t {
+	std::string path; // as passed to file_watcher_add, this is what gets reported
+	std::string directory;
+	std::string name;
+	long long mtime;
+	int watch; // inotify watch descriptor of its directory
+};
+
+struct file_watcher_t {
+	std::vector<watched_file_t> files;
+	int inotify_fd; // -1 when polling write times
+	double next_poll;
+};
+
+void file_watcher_init(file_watcher_t *watcher);
+// starts watching 'path', false if it couldn't be watched
+bool file_watcher_add(file_watcher_t *watcher, const char *path);
+// fills 'changed' with every watched path written since the last call,
+// each at most once, and returns how many. never blocks
+int file_watcher_poll(file_watcher_t *watcher, std::vector<std::string> &changed);
+void file_watcher_shutdown(file_watcher_t *watcher);
+
+#endif
@@ -0,0 +1,174 @@
+#include "frame_pacing.h"
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+frame_pacing_config_t frame_pacing_default_config() {
+	frame_pacing_config_t config;
+	config.present_mode = PRESENT_VSYNC_ON;
+	config.fps_cap = 0.0;
+	config.just_in_time = false;
+	return config;
+}
+
+bool frame_pacing_parse_arg(frame_pacing_config_t *config, const char *arg) {
+	if (strcmp(arg, "--vsync=on") == 0) {
+		config->present_mode = PRESENT_VSYNC_ON;
+	} else if (strcmp(arg, "--vsync=off") == 0) {
+		config->present_mode = PRESENT_VSYNC_OFF;
+	} else if (strcmp(arg, "--vsync=adaptive") == 0) {
+		config->present_mode = PRESENT_VSYNC_ADAPTIVE;
+	} else if (strncmp(arg, "--fps-cap=", 10) == 0) {
+		config->fps_cap = atof(arg + 10);
+		if (config->fps_cap < 0.0) {
+			config->fps_cap = 0.0;
+		}
+	} else if (strcmp(arg, "--jit") == 0) {
+		config->just_in_time = true;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+void frame_pacer_init(frame_pacer_t *pacer, const frame_pacing_config_t &config,
+	int refresh_rate) {
+	memset(pacer, 0, sizeof(*pacer));
+	pacer->config = config;
+	pacer->refresh_rate = refresh_rate > 0 ? refresh_rate : 60;
+	// OS sleeps commonly overshoot by up to a millisecond, start from there
+	pacer->sleep_overshoot = 0.001;
+
+	int interval = 0;
+	const char *mode_name = "off";
+	if (config.present_mode == PRESENT_VSYNC_ON) {
+		interval = 1;
+		mode_name = "on";
+	} else if (config.present_mode == PRESENT_VSYNC_ADAPTIVE) {
+		if (glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+			glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+			interval = -1;
+			mode_name = "adaptive";
+		} else {
+			fprintf(stderr, "WARNING: adaptive vsync not supported, using vsync on\n");
+			interval = 1;
+			mode_name = "on";
+		}
+	}
+	glfwSwapInterval(interval);
+
+	if (config.fps_cap > 0.0) {
+		pacer->period = 1.0 / config.fps_cap;
+	} else if (interval != 0) {
+		// vsync paces swapping frames, this paces the ones that don't swap
+		pacer->period = 1.0 / pacer->refresh_rate;
+	}
+	if (config.just_in_time && pacer->period <= 0.0) {
+		fprintf(stderr, "WARNING: just-in-time frames need vsync or an fps cap, disabled\n");
+		pacer->config.just_in_time = false;
+	}
+
+#ifdef _WIN32
+	// default scheduler granularity is ~15.6ms, far too coarse to sleep with
+	timeBeginPeriod(1);
+#endif
+	printf("frame pacing: vsync %s, fps cap %.1f, just-in-time %s\n", mode_name,
+		config.fps_cap, pacer->config.just_in_time ? "on" : "off");
+	pacer->next_deadline = glfwGetTime() + pacer->period;
+}
+
+void frame_pacer_shutdown(frame_pacer_t *pacer) {
+#ifdef _WIN32
+	timeEndPeriod(1);
+#endif
+	if (pacer->latency_count > 0) {
+		printf("input-to-swap latency: avg %.2f ms, max %.2f ms over %i frames\n",
+			pacer->latency_total / pacer->latency_count * 1000.0,
+			pacer->latency_max * 1000.0, pacer->latency_count);
+	}
+}
+
+void frame_pacer_wait_until(frame_pacer_t *pacer, double target) {
+	// sleep in 1ms steps while there's clearly time, keeping track of how much
+	// the OS oversleeps so the spin at the end starts early enough
+	double now = glfwGetTime();
+	while (target - now > pacer->sleep_overshoot + 0.001) {
+		double before = now;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		now = glfwGetTime();
+		double overshoot = (now - before) - 0.001;
+		if (overshoot > pacer->sleep_overshoot) {
+			pacer->sleep_overshoot = overshoot;
+		} else {
+			// slowly forget one-off long sleeps
+			pacer->sleep_overshoot = pacer->sleep_overshoot * 0.99 + overshoot * 0.01;
+		}
+	}
+	while (now < target) {
+		now = glfwGetTime();
+	}
+}
+
+void frame_pacer_begin_frame(frame_pacer_t *pacer) {
+	if (pacer->config.just_in_time) {
+		// start just early enough for the slowest recent frame to make the deadline
+		double safety = 0.001;
+		frame_pacer_wait_until(pacer, pacer->next_deadline - pacer->predicted_work - safety);
+	}
+	pacer->frame_start = glfwGetTime();
+	pacer->input_time = pacer->frame_start;
+	pacer->submit_time = 0.0;
+}
+
+void frame_pacer_mark_input(frame_pacer_t *pacer) {
+	pacer->input_time = glfwGetTime();
+}
+
+void frame_pacer_mark_submit(frame_pacer_t *pacer) {
+	pacer->submit_time = glfwGetTime();
+}
+
+void frame_pacer_end_frame(frame_pacer_t *pacer, bool swapped) {
+	double now = glfwGetTime();
+	if (swapped) {
+		double latency = now - pacer->input_time;
+		pacer->latency_last = latency;
+		pacer->latency_total += latency;
+		if (latency > pacer->latency_max) {
+			pacer->latency_max = latency;
+		}
+		pacer->latency_count++;
+
+		// track the worst recent frame, decaying so one hitch doesn't stick
+		double work = (pacer->submit_time > 0.0 ? pacer->submit_time : now) - pacer->frame_start;
+		pacer->predicted_work = work > pacer->predicted_work ? work
+			: pacer->predicted_work * 0.95 + work * 0.05;
+	}
+
+	if (pacer->period <= 0.0) {
+		return;
+	}
+	bool vsync = pacer->config.present_mode != PRESENT_VSYNC_OFF;
+	if (swapped && vsync && pacer->config.fps_cap <= 0.0) {
+		// the swap already waited for vblank, line the next deadline up with it
+		pacer->next_deadline = now + pacer->period;
+		return;
+	}
+	if (!pacer->config.just_in_time || !swapped) {
+		frame_pacer_wait_until(pacer, pacer->next_deadline);
+	}
+	pacer->next_deadline += pacer->period;
+	// fell more than a frame behind: don't try to catch up with a burst of frames
+	now = glfwGetTime();
+	if (pacer->next_deadline < now) {
+		pacer->next_deadline = now + pacer->period;
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+/******************************************************************************\
+| Frame pacing: swap interval selection, a frame rate cap and input latency.   |
+| The cap waits with a hybrid of OS sleeps (coarse, cheap) and a final spin    |
+| (precise). In just-in-time mode the wait moves to the start of the frame,    |
+| so input is sampled as late as possible before the frame has to be ready,    |
+| instead of a whole frame early. How early is predicted from the time up to   |
+| the glfwSwapBuffers call (frame_pacer_mark_submit), not its return, which    |
+| with vsync includes the wait for vblank. Latency is measured from the input  |
+| sample to the return of glfwSwapBuffers.                                     |
+|                                                                              |
+| configured per deployment from the command line:                             |
+|   --vsync=on|off|adaptive   --fps-cap=<frames per second>   --jit            |
+\******************************************************************************/
+#ifndef _FRAME_PACING_H_
+#define _FRAME_PACING_H_
+
+enum present_mode_t {
+	PRESENT_VSYNC_OFF,
+	PRESENT_VSYNC_ON,
+	// vsync, but late frames tear instead of waiting for the next vblank.
+	// falls back to PRESENT_VSYNC_ON without the swap_control_tear extension
+	PRESENT_VSYNC_ADAPTIVE
+};
+
+struct frame_pacing_config_t {
+	present_mode_t present_mode;
+	double fps_cap; // 0 for no cap
+	bool just_in_time;
+};
+
+struct frame_pacer_t {
+	frame_pacing_config_t config;
+	double refresh_rate;
+	double period; // seconds per frame, 0 when nothing limits the frame rate
+	double next_deadline;
+	double frame_start;
+	double input_time;
+	// when the frame was handed to glfwSwapBuffers, 0 until then
+	double submit_time;
+	// slowest recent begin-to-submit time, how early a just-in-time frame starts.
+	// not to the swap's return: with vsync that includes the wait for vblank
+	double predicted_work;
+	// how much longer than asked OS sleeps tend to take, the rest is spun
+	double sleep_overshoot;
+	// input-sample-to-swap latency, in seconds
+	double latency_last;
+	double latency_total;
+	double latency_max;
+	int latency_count;
+};
+
+// defaults: vsync on, no cap, no just-in-time start
+frame_pacing_config_t frame_pacing_default_config();
+// applies one command line option, false if it isn't a frame pacing one
+bool frame_pacing_parse_arg(frame_pacing_config_t *config, const char *arg);
+
+// sets the swap interval on the current context. 'refresh_rate' (Hz) is used
+// to pace just-in-time frames and frames that don't swap
+void frame_pacer_init(frame_pacer_t *pacer, const frame_pacing_config_t &config,
+	int refresh_rate);
+// call before sampling input; waits first in just-in-time mode
+void frame_pacer_begin_frame(frame_pacer_t *pacer);
+// call right after polling/reading input
+void frame_pacer_mark_input(frame_pacer_t *pacer);
+// call just before glfwSwapBuffers
+void frame_pacer_mark_submit(frame_pacer_t *pacer);
+// call after glfwSwapBuffers ('swapped' true) or at the end of a frame that
+// didn't swap; records latency and waits out the rest of the frame if capped
+void frame_pacer_end_frame(frame_pacer_t *pacer, bool swapped);
+void frame_pacer_shutdown(frame_pacer_t *pacer);
+
+// sleeps, then spins, until glfwGetTime() reaches 'target'
+void frame_pacer_wait_until(frame_pacer_t *pacer, double target);
+
+#endif
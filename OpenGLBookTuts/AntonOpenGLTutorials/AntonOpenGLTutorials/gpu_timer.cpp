@@ -0,0 +1,61 @@
+#include "gpu_timer.h"
+#include "profiler.h"
+#include <string.h>
+
+void gpu_timer_init(gpu_timer_t *timer) {
+	memset(timer, 0, sizeof(*timer));
+	timer->available = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+	if (!timer->available) {
+		fprintf(stderr, "WARNING: no timer queries, GPU passes won't be timed\n");
+		return;
+	}
+	glGenQueries(2 * GPU_TIMER_MAX_PASSES, &timer->queries[0][0]);
+}
+
+void gpu_timer_begin_frame(gpu_timer_t *timer) {
+	if (!timer->available) {
+		return;
+	}
+	timer->current = 1 - timer->current;
+	int set = timer->current;
+	for (int i = 0; i < timer->pass_count[set]; i++) {
+		GLuint ready = GL_FALSE;
+		glGetQueryObjectuiv(timer->queries[set][i], GL_QUERY_RESULT_AVAILABLE, &ready);
+		// a GPU more than a frame behind just loses that sample instead of blocking us
+		if (!ready) {
+			continue;
+		}
+		GLuint64 elapsed_ns = 0;
+		glGetQueryObjectui64v(timer->queries[set][i], GL_QUERY_RESULT, &elapsed_ns);
+		profiler_record_gpu(timer->names[set][i], timer->submit_ticks[set][i], elapsed_ns);
+	}
+	timer->pass_count[set] = 0;
+}
+
+void gpu_timer_begin(gpu_timer_t *timer, const char *name) {
+	int set = timer->current;
+	if (!timer->available || timer->in_pass || timer->pass_count[set] >= GPU_TIMER_MAX_PASSES) {
+		return;
+	}
+	int pass = timer->pass_count[set];
+	timer->names[set][pass] = name;
+	timer->submit_ticks[set][pass] = profiler_ticks();
+	glBeginQuery(GL_TIME_ELAPSED, timer->queries[set][pass]);
+	timer->in_pass = true;
+}
+
+void gpu_timer_end(gpu_timer_t *timer) {
+	if (!timer->in_pass) {
+		return;
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+	timer->pass_count[timer->current]++;
+	timer->in_pass = false;
+}
+
+void gpu_timer_destroy(gpu_timer_t *timer) {
+	if (timer->available) {
+		glDeleteQueries(2 * GPU_TIMER_MAX_PASSES, &timer->queries[0][0]);
+	}
+	timer->available = false;
+}
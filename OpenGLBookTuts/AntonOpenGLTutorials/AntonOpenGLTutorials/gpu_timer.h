@@ -0,0 +1,33 @@
+#pragma once
+/******************************************************************************\
+| GPU pass timing with GL_TIME_ELAPSED queries.                                |
+| Each frame uses one of two sets of query objects; when a set comes round    |
+| again (two frames later) its results are read back, so reading never stalls |
+| on work the GPU hasn't finished. Results go to the profiler as GPU zones.   |
+| Passes can't nest, GL only allows one GL_TIME_ELAPSED query at a time.      |
+\******************************************************************************/
+#ifndef _GPU_TIMER_H_
+#define _GPU_TIMER_H_
+
+#include <GL/glew.h>
+
+#define GPU_TIMER_MAX_PASSES 16
+
+struct gpu_timer_t {
+	GLuint queries[2][GPU_TIMER_MAX_PASSES];
+	const char *names[2][GPU_TIMER_MAX_PASSES];
+	unsigned long long submit_ticks[2][GPU_TIMER_MAX_PASSES];
+	int pass_count[2];
+	int current; // query set written this frame
+	bool in_pass;
+	bool available; // false if the context has no timer queries
+};
+
+void gpu_timer_init(gpu_timer_t *timer);
+// reads back the set issued two frames ago and makes it current
+void gpu_timer_begin_frame(gpu_timer_t *timer);
+void gpu_timer_begin(gpu_timer_t *timer, const char *name);
+void gpu_timer_end(gpu_timer_t *timer);
+void gpu_timer_destroy(gpu_timer_t *timer);
+
+#endif
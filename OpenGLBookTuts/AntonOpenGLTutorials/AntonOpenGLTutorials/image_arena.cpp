@@ -0,0 +1,217 @@
+#include "image_arena.h"
+#include <algorithm>
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+// in front of every allocation, so image_free knows where it came from. 16
+// bytes keeps what follows as aligned as malloc's
+struct header_t {
+	size_t size;
+	unsigned int kind;
+	unsigned int unused;
+};
+
+const unsigned int FROM_HEAP = 0x48454150;
+const unsigned int FROM_ARENA = 0x4152454e;
+const size_t HEADER_BYTES = sizeof(header_t);
+const size_t MIN_BLOCK_BYTES = 1024 * 1024;
+
+struct block_t {
+	unsigned char *memory;
+	size_t size;
+	size_t used;
+};
+
+struct arena_t {
+	std::vector<block_t> blocks; // allocations come from the last one
+	int depth; // image_arena_begin calls not yet ended
+	header_t *last; // the newest allocation, the one that can grow in place
+	size_t sealed; // used in the blocks before the last
+	size_t high_water; // the most in use at once during this image
+
+	arena_t() : depth(0), last(NULL), sealed(0), high_water(0) {}
+	~arena_t() {
+		for (size_t i = 0; i < blocks.size(); i++) {
+			free(blocks[i].memory);
+		}
+	}
+};
+
+thread_local arena_t arena;
+
+std::atomic<unsigned long long> arena_allocations(0);
+std::atomic<unsigned long long> heap_allocations(0);
+std::atomic<unsigned long long> grown_in_place(0);
+std::atomic<size_t> peak_bytes(0);
+
+size_t padded(size_t size) {
+	return HEADER_BYTES + ((size + 15) & ~(size_t)15);
+}
+
+header_t *header_of(void *p) {
+	return (header_t *)((unsigned char *)p - HEADER_BYTES);
+}
+
+void *heap_alloc(size_t size) {
+	header_t *header = (header_t *)malloc(HEADER_BYTES + size);
+	if (!header) {
+		return NULL;
+	}
+	header->size = size;
+	header->kind = FROM_HEAP;
+	heap_allocations.fetch_add(1, std::memory_order_relaxed);
+	return header + 1;
+}
+
+bool add_block(arena_t &a, size_t size) {
+	block_t block;
+	block.memory = (unsigned char *)malloc(size);
+	if (!block.memory) {
+		return false;
+	}
+	block.size = size;
+	block.used = 0;
+	if (!a.blocks.empty()) {
+		a.sealed += a.blocks.back().used;
+	}
+	a.blocks.push_back(block);
+	heap_allocations.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void *arena_alloc(arena_t &a, size_t size) {
+	size_t need = padded(size);
+	if (a.blocks.empty() || a.blocks.back().size - a.blocks.back().used < need) {
+		size_t grow = a.blocks.empty() ? MIN_BLOCK_BYTES : a.blocks.back().size * 2;
+		if (!add_block(a, std::max(need, grow))) {
+			return NULL;
+		}
+	}
+	block_t &block = a.blocks.back();
+	header_t *header = (header_t *)(block.memory + block.used);
+	header->size = size;
+	header->kind = FROM_ARENA;
+	block.used += need;
+	a.high_water = std::max(a.high_water, a.sealed + block.used);
+	a.last = header;
+	arena_allocations.fetch_add(1, std::memory_order_relaxed);
+	return header + 1;
+}
+
+// where the newest allocation starts in the current block, if 'header' is it
+bool is_last(const arena_t &a, const header_t *header, size_t *start) {
+	if (header != a.last || a.blocks.empty()) {
+		return false;
+	}
+	*start = (size_t)((const unsigned char *)header - a.blocks.back().memory);
+	return true;
+}
+
+} // namespace
+
+void *image_malloc(size_t size) {
+	return arena.depth > 0 ? arena_alloc(arena, size) : heap_alloc(size);
+}
+
+void *image_realloc(void *p, size_t size) {
+	if (!p) {
+		return image_malloc(size);
+	}
+	header_t *header = header_of(p);
+	if (header->kind == FROM_HEAP) {
+		header_t *moved = (header_t *)realloc(header, HEADER_BYTES + size);
+		if (!moved) {
+			return NULL;
+		}
+		moved->size = size;
+		heap_allocations.fetch_add(1, std::memory_order_relaxed);
+		return moved + 1;
+	}
+	size_t start = 0;
+	if (is_last(arena, header, &start) && start + padded(size) <= arena.blocks.back().size) {
+		arena.blocks.back().used = start + padded(size);
+		arena.high_water = std::max(arena.high_water, arena.sealed + arena.blocks.back().used);
+		header->size = size;
+		grown_in_place.fetch_add(1, std::memory_order_relaxed);
+		return p;
+	}
+	void *moved = image_malloc(size);
+	if (!moved) {
+		return NULL;
+	}
+	memcpy(moved, p, std::min(header->size, size));
+	image_free(p);
+	return moved;
+}
+
+void image_free(void *p) {
+	if (!p) {
+		return;
+	}
+	header_t *header = header_of(p);
+	if (header->kind == FROM_HEAP) {
+		free(header);
+		return;
+	}
+	// the rest goes with the arena, only the newest allocation can be handed back now
+	size_t start = 0;
+	if (is_last(arena, header, &start)) {
+		arena.blocks.back().used = start;
+		arena.last = NULL;
+	}
+}
+
+void image_arena_begin() {
+	arena.depth++;
+}
+
+void image_arena_end() {
+	arena_t &a = arena;
+	if (a.depth == 0 || --a.depth > 0) {
+		return;
+	}
+	size_t peak = peak_bytes.load(std::memory_order_relaxed);
+	while (a.high_water > peak && !peak_bytes.compare_exchange_weak(peak, a.high_water)) {
+	}
+	// one block that holds all of this image at once, so the next one like it
+	// needs no more
+	size_t keep = std::min(a.high_water, (size_t)IMAGE_ARENA_KEEP_BYTES);
+	if (a.blocks.size() > 1 || (!a.blocks.empty() && a.blocks.back().size > IMAGE_ARENA_KEEP_BYTES)) {
+		for (size_t i = 0; i < a.blocks.size(); i++) {
+			free(a.blocks[i].memory);
+		}
+		a.blocks.clear();
+		add_block(a, std::max(keep, MIN_BLOCK_BYTES));
+	}
+	if (!a.blocks.empty()) {
+		a.blocks.back().used = 0;
+	}
+	a.last = NULL;
+	a.sealed = a.high_water = 0;
+}
+
+void image_arena_trim() {
+	arena_t &a = arena;
+	if (a.depth > 0) {
+		return;
+	}
+	for (size_t i = 0; i < a.blocks.size(); i++) {
+		free(a.blocks[i].memory);
+	}
+	a.blocks.clear();
+	a.last = NULL;
+	a.sealed = a.high_water = 0;
+}
+
+image_arena_stats_t image_arena_stats() {
+	image_arena_stats_t stats;
+	stats.arena_allocations = arena_allocations.load();
+	stats.heap_allocations = heap_allocations.load();
+	stats.grown_in_place = grown_in_place.load();
+	stats.peak_bytes = peak_bytes.load();
+	return stats;
+}
@@ -0,0 +1,50 @@
+#pragma once
+/******************************************************************************\
+| A thread-local arena for image decoding, and the allocator stb_image is      |
+| built with (STBI_MALLOC, STBI_REALLOC and STBI_FREE, see main.cpp).          |
+| Between image_arena_begin and image_arena_end everything stb_image allocates |
+| on that thread (the zlib buffers, the jpeg component planes, the image it    |
+| returns) comes from the thread's arena: a pointer bump, and the last         |
+| allocation grows in place, which is what inflate's doubling output buffer    |
+| does. image_arena_end drops it all at once. The arena keeps its memory (up   |
+| to IMAGE_ARENA_KEEP_BYTES, in one block) for the thread's next image, so a   |
+| worker that has decoded one texture decodes the next without touching the    |
+| heap, and image_arena_trim gives it back once the images stop coming.        |
+| Outside begin/end the same calls go to malloc, and image_free tells          |
+| the two apart, so pixels from either are freed the same way.                 |
+| The caller copies what it keeps out before image_arena_end, converted the    |
+| way it wants it (image_batch.h writes it straight into upload memory).       |
+| No OpenGL in here.                                                           |
+\******************************************************************************/
+#ifndef _IMAGE_ARENA_H_
+#define _IMAGE_ARENA_H_
+
+#include <stddef.h>
+
+// the most a thread's arena holds on to between images
+#define IMAGE_ARENA_KEEP_BYTES (64 * 1024 * 1024)
+
+void *image_malloc(size_t size);
+void *image_realloc(void *p, size_t size);
+void image_free(void *p);
+
+// this thread's image_malloc takes from its arena until the matching
+// image_arena_end, which frees everything allocated since. they nest
+void image_arena_begin();
+void image_arena_end();
+// hands the memory this thread's arena kept back to the heap, unless it's
+// between begin and end. the decode workers call it when they run out of
+// images (thread_pool_init's 'idle'), so loading doesn't hold on to it
+void image_arena_trim();
+
+struct image_arena_stats_t {
+	unsigned long long arena_allocations; // served by a pointer bump
+	unsigned long long heap_allocations; // malloc calls, arena blocks included
+	unsigned long long grown_in_place; // reallocs that didn't move
+	size_t peak_bytes; // the most one arena had in use during one image
+};
+
+// totals over every thread since startup
+image_arena_stats_t image_arena_stats();
+
+#endif
@@ -0,0 +1,226 @@
+#include "image_batch.h"
+#include "image_arena.h"
+#include "image_ops.h"
+#include "profiler.h"
+#include "steady_time.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// where the pixels of a 'bytes' image go: the caller's memory if they fit
+unsigned char *destination(batch_image_t &image, size_t bytes) {
+	return image.dest && bytes <= image.dest_bytes ? image.dest : (unsigned char *)malloc(bytes);
+}
+
+// the image and its mips out of the cache entry for 'key', NULL on a miss
+unsigned char *read_cached(texture_cache_t *cache, unsigned long long key, batch_image_t &image,
+	int *x, int *y, int *n, int *channels, std::vector<mip_level_t> &mips) {
+	PROFILE_ZONE("read cached image");
+	texture_cache_entry_t entry;
+	if (!texture_cache_find(cache, key, &entry)) {
+		return NULL;
+	}
+	unsigned char *pixels = destination(image, entry.levels[0].bytes);
+	if (pixels) {
+		memcpy(pixels, entry.levels[0].pixels, entry.levels[0].bytes);
+		mips.resize(entry.levels.size() - 1);
+		for (size_t i = 1; i < entry.levels.size(); i++) {
+			mips[i - 1].width = entry.levels[i].width;
+			mips[i - 1].height = entry.levels[i].height;
+			mips[i - 1].pixels.assign(entry.levels[i].pixels, entry.levels[i].pixels + entry.levels[i].bytes);
+		}
+		*x = entry.x;
+		*y = entry.y;
+		*n = entry.n;
+		*channels = entry.channels;
+	}
+	texture_cache_close_entry(&entry);
+	return pixels;
+}
+
+void write_cached(texture_cache_t *cache, unsigned long long key, const unsigned char *pixels,
+	int x, int y, int n, int channels, const std::vector<mip_level_t> &mips) {
+	PROFILE_ZONE("write cached image");
+	std::vector<texture_cache_level_t> levels(mips.size() + 1);
+	levels[0].width = x;
+	levels[0].height = y;
+	levels[0].pixels = pixels;
+	levels[0].bytes = (size_t)x * y * channels;
+	for (size_t i = 0; i < mips.size(); i++) {
+		levels[i + 1].width = mips[i].width;
+		levels[i + 1].height = mips[i].height;
+		levels[i + 1].pixels = mips[i].pixels.data();
+		levels[i + 1].bytes = mips[i].pixels.size();
+	}
+	texture_cache_store(cache, key, x, y, n, channels, levels);
+}
+
+// decodes, converts and flips the image in the arena, makes the mips from
+// that and copies the result out. with a cache it's stored under 'key' too
+unsigned char *decode_image(image_batch_t *batch, batch_image_t &image, texture_cache_t *cache,
+	unsigned long long key, int *out_x, int *out_y, int *out_n, int *out_channels,
+	std::vector<mip_level_t> &mips) {
+	int x = 0, y = 0, n = 0;
+	image_arena_begin();
+	// asking stb_image for other channels costs a per-pixel switch, image_ops converts faster
+	unsigned char *decoded = batch->decode(image.name.c_str(), &x, &y, &n, 0);
+	int channels = image.force_channels ? image.force_channels : n;
+	size_t count = (size_t)x * y;
+	// converted and flipped in the arena, the mips are made from that
+	unsigned char *converted = decoded;
+	if (decoded && channels != n) {
+		converted = (unsigned char *)image_malloc(count * channels);
+		if (converted) {
+			image_convert_into(decoded, n, converted, channels, x, y, image.flip, false);
+		}
+	} else if (decoded && image.flip) {
+		image_flip_rows(decoded, x, y, channels);
+	}
+	unsigned char *pixels = NULL;
+	if (converted) {
+		if (channels == 3 || channels == 4) {
+			PROFILE_ZONE("generate mips");
+			generate_mips(converted, x, y, channels, image.mip_filter, true, mips);
+		}
+		bool swap_rb = image.bgra && channels == 4;
+		if (swap_rb) {
+			for (size_t i = 0; i < mips.size(); i++) {
+				image_swizzle_rb(mips[i].pixels.data(), (size_t)mips[i].width * mips[i].height);
+			}
+		}
+		// the cache is written from the arena, not the destination: that may be
+		// upload memory, which is slow to read back
+		if (cache && swap_rb) {
+			image_swizzle_rb(converted, count);
+			swap_rb = false;
+		}
+		// the one copy out of the arena
+		size_t bytes = count * channels;
+		pixels = destination(image, bytes);
+		if (pixels) {
+			image_convert_into(converted, channels, pixels, channels, x, y, false, swap_rb);
+			if (cache) {
+				write_cached(cache, key, converted, x, y, n, channels, mips);
+			}
+		}
+	}
+	if (converted != decoded) {
+		image_free(converted);
+	}
+	image_free(decoded);
+	image_arena_end();
+	*out_x = x;
+	*out_y = y;
+	*out_n = n;
+	*out_channels = channels;
+	return pixels;
+}
+
+void decode_job(image_batch_t *batch, size_t index) {
+	PROFILE_ZONE("decode image");
+	double start = now_ms();
+	// nothing else touches this image until 'done' is set, so no lock while decoding
+	batch_image_t &image = batch->images[index];
+	int x = 0, y = 0, n = 0, channels = 0;
+	std::vector<mip_level_t> mips;
+	unsigned long long key = 0;
+	bool use_cache = batch->cache && batch->hash && batch->hash(image.name.c_str(), &key);
+	unsigned char *pixels = NULL;
+	if (use_cache) {
+		key = texture_cache_key(key, image.force_channels, image.flip, image.bgra, image.mip_filter);
+		pixels = read_cached(batch->cache, key, image, &x, &y, &n, &channels, mips);
+	}
+	bool cached = pixels != NULL;
+	if (!cached) {
+		pixels = decode_image(batch, image, use_cache ? batch->cache : NULL, key, &x, &y, &n,
+			&channels, mips);
+	}
+	{
+		std::lock_guard<std::mutex> lock(batch->mutex);
+		image.pixels = pixels;
+		image.x = x;
+		image.y = y;
+		image.n = n;
+		image.channels = channels;
+		image.mips.swap(mips);
+		image.cached = cached;
+		image.decode_ms = now_ms() - start;
+		image.done = true;
+	}
+	batch->finished.notify_all();
+}
+
+} // namespace
+
+void image_batch_init(image_batch_t *batch, image_decode_function_t decode) {
+	batch->images.clear();
+	batch->decode = decode;
+	batch->cache = NULL;
+	batch->hash = NULL;
+}
+
+size_t image_batch_add(image_batch_t *batch, const char *name, int force_channels, bool flip,
+	bool bgra, mip_filter_t mip_filter) {
+	batch_image_t image;
+	image.name = name;
+	image.force_channels = force_channels;
+	image.flip = flip;
+	image.bgra = bgra;
+	image.mip_filter = mip_filter;
+	image.dest = NULL;
+	image.dest_bytes = 0;
+	image.pixels = NULL;
+	image.x = image.y = image.n = image.channels = 0;
+	image.done = false;
+	image.cached = false;
+	image.decode_ms = 0.0;
+	batch->images.push_back(image);
+	return batch->images.size() - 1;
+}
+
+void image_batch_set_destination(image_batch_t *batch, size_t index, unsigned char *dest,
+	size_t bytes) {
+	batch->images[index].dest = dest;
+	batch->images[index].dest_bytes = bytes;
+}
+
+void image_batch_set_cache(image_batch_t *batch, texture_cache_t *cache, image_hash_function_t hash) {
+	batch->cache = cache;
+	batch->hash = hash;
+}
+
+void image_batch_start(image_batch_t *batch, thread_pool_t *pool) {
+	for (size_t i = 0; i < batch->images.size(); i++) {
+		thread_pool_submit(pool, [batch, i] { decode_job(batch, i); });
+	}
+}
+
+bool image_batch_ready(image_batch_t *batch, size_t index) {
+	std::lock_guard<std::mutex> lock(batch->mutex);
+	return batch->images[index].done;
+}
+
+const batch_image_t *image_batch_wait(image_batch_t *batch, size_t index) {
+	PROFILE_ZONE("wait for image");
+	std::unique_lock<std::mutex> lock(batch->mutex);
+	batch->finished.wait(lock, [batch, index] { return batch->images[index].done; });
+	return &batch->images[index];
+}
+
+void image_batch_release(image_batch_t *batch, size_t index) {
+	std::lock_guard<std::mutex> lock(batch->mutex);
+	if (batch->images[index].pixels != batch->images[index].dest) {
+		free(batch->images[index].pixels);
+	}
+	batch->images[index].pixels = NULL;
+	std::vector<mip_level_t>().swap(batch->images[index].mips);
+}
+
+void image_batch_free(image_batch_t *batch) {
+	for (size_t i = 0; i < batch->images.size(); i++) {
+		image_batch_wait(batch, i);
+		image_batch_release(batch, i);
+	}
+	batch->images.clear();
+}
@@ -0,0 +1,87 @@
+#pragma once
+/******************************************************************************\
+| A set of images decoded together on a thread_pool_t, one job per image.      |
+| The context thread waits for (or polls) them one at a time in the order      |
+| they were added, so it can upload each as soon as it's ready while the rest  |
+| are still decoding: six cube-map faces cost about one face's decode on 6+    |
+| cores.                                                                       |
+| The decode itself is a callback with stbi_load's signature, so images can    |
+| come out of the asset pack or loose files. It runs inside an image arena     |
+| (image_arena.h) and what it returns is freed with image_free, so stb_image   |
+| built with those hooks decodes without the heap. Images are always decoded   |
+| with their own channel count; the conversion and the flip are done in the    |
+| arena, the mips made from that, and then the pixels are copied out once,     |
+| R/B swapped on the way, to memory the caller gave the image (a mapped pixel  |
+| buffer) or else a malloc'd buffer.                                           |
+| With a texture cache (texture_cache.h) each image is first looked up by its  |
+| content hash and settings; a hit is copied out of the mapped entry with no   |
+| decoding at all, a miss is decoded and then stored for the next launch.      |
+| No OpenGL in here.                                                           |
+\******************************************************************************/
+#ifndef _IMAGE_BATCH_H_
+#define _IMAGE_BATCH_H_
+
+#include "mip_generator.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// returns pixels from image_malloc (stbi_load with image_arena.h's hooks), NULL on failure
+typedef unsigned char *(*image_decode_function_t)(const char *name, int *x, int *y, int *n,
+	int force_channels);
+// the content hash of the image's file (asset_hash of its bytes), false if it can't be read
+typedef bool (*image_hash_function_t)(const char *name, unsigned long long *hash);
+
+struct batch_image_t {
+	std::string name;
+	int force_channels; // 0 keeps the image's own
+	bool flip; // rows bottom-up, the way glTexImage2D wants them
+	bool bgra; // 4 channel images (and their mips) stored B, G, R, A
+	mip_filter_t mip_filter; // 3 and 4 channel images only
+	unsigned char *dest; // caller's memory for the pixels, NULL to malloc them
+	size_t dest_bytes; // too small for the image and they're malloc'd anyway
+	unsigned char *pixels; // NULL if decoding failed. 'dest' or malloc'd
+	int x, y, n; // 'n' is the channel count in the file, 'pixels' has 'channels'
+	int channels;
+	std::vector<mip_level_t> mips; // levels 1 and below
+	bool done;
+	bool cached; // copied out of the texture cache, not decoded
+	double decode_ms;
+};
+
+struct image_batch_t {
+	std::vector<batch_image_t> images;
+	image_decode_function_t decode;
+	texture_cache_t *cache; // NULL for none
+	image_hash_function_t hash;
+	std::mutex mutex;
+	std::condition_variable finished;
+};
+
+void image_batch_init(image_batch_t *batch, image_decode_function_t decode);
+// returns the image's index. only before image_batch_start. the worker
+// generates the mip chain too unless 'mip_filter' is MIP_FILTER_NONE
+size_t image_batch_add(image_batch_t *batch, const char *name, int force_channels, bool flip,
+	bool bgra, mip_filter_t mip_filter);
+// the pixels of image 'index' go to 'dest' (not freed by the batch) if they
+// fit in 'bytes'. only before image_batch_start
+void image_batch_set_destination(image_batch_t *batch, size_t index, unsigned char *dest,
+	size_t bytes);
+// looks images up in 'cache' (keyed with 'hash') before decoding them and
+// stores what had to be decoded. only before image_batch_start
+void image_batch_set_cache(image_batch_t *batch, texture_cache_t *cache, image_hash_function_t hash);
+// queues a decode job for every image
+void image_batch_start(image_batch_t *batch, thread_pool_t *pool);
+// true once image 'index' is decoded, never blocks
+bool image_batch_ready(image_batch_t *batch, size_t index);
+// blocks until image 'index' is decoded. check 'pixels' for failure
+const batch_image_t *image_batch_wait(image_batch_t *batch, size_t index);
+// frees the pixels and mips of one image once it's uploaded
+void image_batch_release(image_batch_t *batch, size_t index);
+// waits for any jobs still running and frees all the pixels
+void image_batch_free(image_batch_t *batch);
+
+#endif
@@ -0,0 +1,533 @@
+#include "image_ops.h"
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define IMAGE_OPS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC compiles any intrinsic without a switch, the CPU check is what keeps them safe
+#define SSE2_FUNCTION
+#define AVX2_FUNCTION
+#else
+#include <cpuid.h>
+#define SSE2_FUNCTION __attribute__((target("sse2")))
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#else
+#define IMAGE_OPS_X86 0
+#endif
+
+namespace {
+
+const int linear_to_srgb_size = 16384;
+
+struct srgb_tables_t {
+	float to_linear[256];
+	// 3 spare bytes so a 32-bit gather at the last index stays inside
+	unsigned char to_srgb[linear_to_srgb_size + 3];
+	srgb_tables_t() {
+		for (int i = 0; i < 256; i++) {
+			float c = i / 255.0f;
+			to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < linear_to_srgb_size; i++) {
+			float v = i / (float)(linear_to_srgb_size - 1);
+			float c = v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+			to_srgb[i] = (unsigned char)(c * 255.0f + 0.5f);
+		}
+		memset(to_srgb + linear_to_srgb_size, 0, 3);
+	}
+};
+
+const srgb_tables_t &srgb_tables() {
+	static const srgb_tables_t tables; // built once, thread-safe since C++11
+	return tables;
+}
+
+image_simd_t detect_simd() {
+#if IMAGE_OPS_X86
+	unsigned int regs[4] = {0, 0, 0, 0}; // eax, ebx, ecx, edx
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	unsigned int max_leaf = (unsigned int)info[0];
+	__cpuid(info, 1);
+	memcpy(regs, info, sizeof(regs));
+#else
+	unsigned int max_leaf = __get_cpuid_max(0, NULL);
+	__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+	if (!(regs[3] & (1u << 26))) {
+		return IMAGE_SIMD_SCALAR;
+	}
+	bool osxsave = (regs[2] & (1u << 27)) != 0;
+	bool avx = (regs[2] & (1u << 28)) != 0;
+	if (!osxsave || !avx || max_leaf < 7) {
+		return IMAGE_SIMD_SSE2;
+	}
+	// the OS has to save the YMM registers on a context switch too
+#ifdef _MSC_VER
+	unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+	memcpy(regs, info, sizeof(regs));
+#else
+	unsigned int xcr0_low = 0, xcr0_high = 0;
+	__asm__ volatile("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+	unsigned long long xcr0 = ((unsigned long long)xcr0_high << 32) | xcr0_low;
+	__cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	if ((xcr0 & 6) != 6 || !(regs[1] & (1u << 5))) {
+		return IMAGE_SIMD_SSE2;
+	}
+	return IMAGE_SIMD_AVX2;
+#else
+	return IMAGE_SIMD_SCALAR;
+#endif
+}
+
+image_simd_t detected_simd() {
+	static const image_simd_t simd = detect_simd();
+	return simd;
+}
+
+std::atomic<int> simd_limit(IMAGE_SIMD_AVX2);
+
+// scalar kernels, also the tails of the SIMD ones
+
+void swap_bytes_scalar(unsigned char *a, unsigned char *b, size_t bytes) {
+	for (size_t i = 0; i < bytes; i++) {
+		unsigned char t = a[i];
+		a[i] = b[i];
+		b[i] = t;
+	}
+}
+
+// backwards, so 'rgba' can be 'rgb'
+void rgb_to_rgba_scalar(const unsigned char *rgb, unsigned char *rgba, size_t count,
+	unsigned char alpha) {
+	for (size_t i = count; i-- > 0;) {
+		unsigned char r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+		rgba[i * 4] = r;
+		rgba[i * 4 + 1] = g;
+		rgba[i * 4 + 2] = b;
+		rgba[i * 4 + 3] = alpha;
+	}
+}
+
+void rgba_to_rgb_scalar(const unsigned char *rgba, unsigned char *rgb, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		unsigned char r = rgba[i * 4], g = rgba[i * 4 + 1], b = rgba[i * 4 + 2];
+		rgb[i * 3] = r;
+		rgb[i * 3 + 1] = g;
+		rgb[i * 3 + 2] = b;
+	}
+}
+
+void swizzle_rb_scalar(unsigned char *pixels, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		std::swap(pixels[i * 4], pixels[i * 4 + 2]);
+	}
+}
+
+// c * a / 255 rounded to nearest, exactly, without a divide
+inline unsigned int mul_div_255(unsigned int c, unsigned int a) {
+	unsigned int t = c * a + 128;
+	return (t + (t >> 8)) >> 8;
+}
+
+void premultiply_scalar(unsigned char *pixels, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		unsigned char *p = pixels + i * 4;
+		for (int c = 0; c < 3; c++) {
+			p[c] = (unsigned char)mul_div_255(p[c], p[3]);
+		}
+	}
+}
+
+void srgb_to_linear_scalar(const unsigned char *src, float *dst, size_t count) {
+	const srgb_tables_t &tables = srgb_tables();
+	for (size_t i = 0; i < count * 4; i++) {
+		dst[i] = (i & 3) == 3 ? src[i] / 255.0f : tables.to_linear[src[i]];
+	}
+}
+
+void linear_to_srgb_scalar(const float *src, unsigned char *dst, size_t count) {
+	const srgb_tables_t &tables = srgb_tables();
+	for (size_t i = 0; i < count * 4; i++) {
+		float v = std::min(std::max(src[i], 0.0f), 1.0f);
+		if ((i & 3) == 3) {
+			dst[i] = (unsigned char)(v * 255.0f + 0.5f);
+		} else {
+			dst[i] = tables.to_srgb[(int)(v * (linear_to_srgb_size - 1) + 0.5f)];
+		}
+	}
+}
+
+#if IMAGE_OPS_X86
+
+SSE2_FUNCTION void swap_bytes_sse2(unsigned char *a, unsigned char *b, size_t bytes) {
+	size_t i = 0;
+	for (; i + 16 <= bytes; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		_mm_storeu_si128((__m128i *)(a + i), y);
+		_mm_storeu_si128((__m128i *)(b + i), x);
+	}
+	swap_bytes_scalar(a + i, b + i, bytes - i);
+}
+
+SSE2_FUNCTION void swizzle_rb_sse2(unsigned char *pixels, size_t count) {
+	const __m128i keep = _mm_set1_epi32((int)0xFF00FF00);
+	const __m128i low = _mm_set1_epi32(0xFF);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(pixels + i * 4));
+		__m128i r = _mm_slli_epi32(_mm_and_si128(v, low), 16);
+		__m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), low);
+		v = _mm_or_si128(_mm_and_si128(v, keep), _mm_or_si128(r, b));
+		_mm_storeu_si128((__m128i *)(pixels + i * 4), v);
+	}
+	swizzle_rb_scalar(pixels + i * 4, count - i);
+}
+
+// two pixels widened to 16 bits a channel
+SSE2_FUNCTION inline __m128i premultiply_16_sse2(__m128i x) {
+	const __m128i alpha_lanes = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+	const __m128i alpha_one = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+	__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xFF), 0xFF);
+	__m128i m = _mm_or_si128(_mm_andnot_si128(alpha_lanes, a), alpha_one);
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(x, m), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+SSE2_FUNCTION void premultiply_sse2(unsigned char *pixels, size_t count) {
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(pixels + i * 4));
+		__m128i lo = premultiply_16_sse2(_mm_unpacklo_epi8(v, zero));
+		__m128i hi = premultiply_16_sse2(_mm_unpackhi_epi8(v, zero));
+		_mm_storeu_si128((__m128i *)(pixels + i * 4), _mm_packus_epi16(lo, hi));
+	}
+	premultiply_scalar(pixels + i * 4, count - i);
+}
+
+AVX2_FUNCTION void swap_bytes_avx2(unsigned char *a, unsigned char *b, size_t bytes) {
+	size_t i = 0;
+	for (; i + 32 <= bytes; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+		_mm256_storeu_si256((__m256i *)(a + i), y);
+		_mm256_storeu_si256((__m256i *)(b + i), x);
+	}
+	swap_bytes_scalar(a + i, b + i, bytes - i);
+}
+
+// 8 pixels a step, each 128-bit lane expanding 4 of them. the second load
+// reads 4 bytes past the step's input, so the last 2 or more pixels are left
+// to the scalar loop. steps go backwards so 'rgba' can be 'rgb': a step only
+// writes at or after where the next one down reads
+AVX2_FUNCTION void rgb_to_rgba_avx2(const unsigned char *rgb, unsigned char *rgba, size_t count,
+	unsigned char alpha) {
+	const __m256i spread = _mm256_setr_epi8(0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128,
+		9, 10, 11, -128, 0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128);
+	const __m256i opaque = _mm256_set1_epi32((int)((unsigned int)alpha << 24));
+	size_t steps = count >= 2 ? (count - 2) / 8 : 0;
+	rgb_to_rgba_scalar(rgb + steps * 24, rgba + steps * 32, count - steps * 8, alpha);
+	for (size_t step = steps; step-- > 0;) {
+		__m128i lo = _mm_loadu_si128((const __m128i *)(rgb + step * 24));
+		__m128i hi = _mm_loadu_si128((const __m128i *)(rgb + step * 24 + 12));
+		__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		v = _mm256_or_si256(_mm256_shuffle_epi8(v, spread), opaque);
+		_mm256_storeu_si256((__m256i *)(rgba + step * 32), v);
+	}
+}
+
+// the reverse, forwards. the second store writes 4 bytes past the step's
+// output, which the next step overwrites, so the last pixels are scalar here too
+AVX2_FUNCTION void rgba_to_rgb_avx2(const unsigned char *rgba, unsigned char *rgb, size_t count) {
+	const __m256i gather = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+		-128, -128, -128, -128, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -128, -128, -128, -128);
+	size_t steps = count >= 2 ? (count - 2) / 8 : 0;
+	for (size_t step = 0; step < steps; step++) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(rgba + step * 32));
+		v = _mm256_shuffle_epi8(v, gather);
+		_mm_storeu_si128((__m128i *)(rgb + step * 24), _mm256_castsi256_si128(v));
+		_mm_storeu_si128((__m128i *)(rgb + step * 24 + 12), _mm256_extracti128_si256(v, 1));
+	}
+	rgba_to_rgb_scalar(rgba + steps * 32, rgb + steps * 24, count - steps * 8);
+}
+
+AVX2_FUNCTION void swizzle_rb_avx2(unsigned char *pixels, size_t count) {
+	const __m256i keep = _mm256_set1_epi32((int)0xFF00FF00);
+	const __m256i low = _mm256_set1_epi32(0xFF);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(pixels + i * 4));
+		__m256i r = _mm256_slli_epi32(_mm256_and_si256(v, low), 16);
+		__m256i b = _mm256_and_si256(_mm256_srli_epi32(v, 16), low);
+		v = _mm256_or_si256(_mm256_and_si256(v, keep), _mm256_or_si256(r, b));
+		_mm256_storeu_si256((__m256i *)(pixels + i * 4), v);
+	}
+	swizzle_rb_scalar(pixels + i * 4, count - i);
+}
+
+AVX2_FUNCTION inline __m256i premultiply_16_avx2(__m256i x) {
+	const __m256i alpha_lanes = _mm256_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1,
+		0, 0, 0, -1);
+	const __m256i alpha_one = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255,
+		0, 0, 0, 255);
+	__m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, 0xFF), 0xFF);
+	__m256i m = _mm256_or_si256(_mm256_andnot_si256(alpha_lanes, a), alpha_one);
+	__m256i t = _mm256_add_epi16(_mm256_mullo_epi16(x, m), _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+AVX2_FUNCTION void premultiply_avx2(unsigned char *pixels, size_t count) {
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		// unpack and pack both work within 128-bit lanes, so the pixels come back in order
+		__m256i v = _mm256_loadu_si256((const __m256i *)(pixels + i * 4));
+		__m256i lo = premultiply_16_avx2(_mm256_unpacklo_epi8(v, zero));
+		__m256i hi = premultiply_16_avx2(_mm256_unpackhi_epi8(v, zero));
+		_mm256_storeu_si256((__m256i *)(pixels + i * 4), _mm256_packus_epi16(lo, hi));
+	}
+	premultiply_scalar(pixels + i * 4, count - i);
+}
+
+// two pixels a step, the table lookups gathered
+AVX2_FUNCTION void srgb_to_linear_avx2(const unsigned char *src, float *dst, size_t count) {
+	const srgb_tables_t &tables = srgb_tables();
+	const __m256 byte_max = _mm256_set1_ps(255.0f);
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		__m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i * 4)));
+		__m256 colour = _mm256_i32gather_ps(tables.to_linear, bytes, 4);
+		// divided, not multiplied by 1/255, to match the scalar kernel to the bit
+		__m256 alpha = _mm256_div_ps(_mm256_cvtepi32_ps(bytes), byte_max);
+		_mm256_storeu_ps(dst + i * 4, _mm256_blend_ps(colour, alpha, 0x88));
+	}
+	srgb_to_linear_scalar(src + i * 4, dst + i * 4, count - i);
+}
+
+AVX2_FUNCTION void linear_to_srgb_avx2(const float *src, unsigned char *dst, size_t count) {
+	const srgb_tables_t &tables = srgb_tables();
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 table_scale = _mm256_set1_ps((float)(linear_to_srgb_size - 1));
+	const __m256 byte_scale = _mm256_set1_ps(255.0f);
+	const __m256i low_byte = _mm256_set1_epi32(0xFF);
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		__m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i * 4), zero), one);
+		__m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, table_scale), half));
+		// 32-bit gathers of a byte table, the byte wanted is the low one
+		__m256i colour = _mm256_and_si256(low_byte,
+			_mm256_i32gather_epi32((const int *)tables.to_srgb, index, 1));
+		__m256i alpha = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, byte_scale), half));
+		__m256i words = _mm256_blend_epi32(colour, alpha, 0x88);
+		words = _mm256_packus_epi32(words, words);
+		words = _mm256_packus_epi16(words, words);
+		int first = _mm_cvtsi128_si32(_mm256_castsi256_si128(words));
+		int second = _mm_cvtsi128_si32(_mm256_extracti128_si256(words, 1));
+		memcpy(dst + i * 4, &first, 4);
+		memcpy(dst + i * 4 + 4, &second, 4);
+	}
+	linear_to_srgb_scalar(src + i * 4, dst + i * 4, count - i);
+}
+
+#endif
+
+// 'from' channels to 'to' channels one pixel at a time, backwards when growing
+// so it can work in place ('dst' may be 'src')
+void convert_channels_scalar(const unsigned char *src, unsigned char *dst, size_t count, int from,
+	int to) {
+	for (size_t n = 0; n < count; n++) {
+		size_t i = to > from ? count - 1 - n : n;
+		const unsigned char *p = src + i * from;
+		unsigned char r, g, b, a = 255;
+		if (from < 3) {
+			r = g = b = p[0];
+			if (from == 2) {
+				a = p[1];
+			}
+		} else {
+			r = p[0];
+			g = p[1];
+			b = p[2];
+			if (from == 4) {
+				a = p[3];
+			}
+		}
+		unsigned char *q = dst + i * to;
+		if (to < 3) {
+			q[0] = (unsigned char)((r * 77 + g * 150 + b * 29) >> 8); // stb_image's weights
+			if (to == 2) {
+				q[1] = a;
+			}
+		} else {
+			q[0] = r;
+			q[1] = g;
+			q[2] = b;
+			if (to == 4) {
+				q[3] = a;
+			}
+		}
+	}
+}
+
+} // namespace
+
+image_simd_t image_simd() {
+	return (image_simd_t)std::min((int)detected_simd(), simd_limit.load(std::memory_order_relaxed));
+}
+
+const char *image_simd_name(image_simd_t simd) {
+	switch (simd) {
+	case IMAGE_SIMD_SSE2: return "SSE2";
+	case IMAGE_SIMD_AVX2: return "AVX2";
+	default: return "scalar";
+	}
+}
+
+void image_set_simd(image_simd_t simd) {
+	simd_limit.store((int)simd, std::memory_order_relaxed);
+}
+
+void image_flip_rows(unsigned char *pixels, int w, int h, int channels) {
+	void (*swap)(unsigned char *, unsigned char *, size_t) = swap_bytes_scalar;
+#if IMAGE_OPS_X86
+	image_simd_t simd = image_simd();
+	if (simd == IMAGE_SIMD_AVX2) {
+		swap = swap_bytes_avx2;
+	} else if (simd == IMAGE_SIMD_SSE2) {
+		swap = swap_bytes_sse2;
+	}
+#endif
+	size_t row_bytes = (size_t)w * channels;
+	for (int top = 0, bottom = h - 1; top < bottom; top++, bottom--) {
+		swap(pixels + top * row_bytes, pixels + bottom * row_bytes, row_bytes);
+	}
+}
+
+void image_rgb_to_rgba(const unsigned char *rgb, unsigned char *rgba, size_t count,
+	unsigned char alpha) {
+#if IMAGE_OPS_X86
+	if (image_simd() == IMAGE_SIMD_AVX2) {
+		rgb_to_rgba_avx2(rgb, rgba, count, alpha);
+		return;
+	}
+#endif
+	rgb_to_rgba_scalar(rgb, rgba, count, alpha);
+}
+
+void image_rgba_to_rgb(const unsigned char *rgba, unsigned char *rgb, size_t count) {
+#if IMAGE_OPS_X86
+	if (image_simd() == IMAGE_SIMD_AVX2) {
+		rgba_to_rgb_avx2(rgba, rgb, count);
+		return;
+	}
+#endif
+	rgba_to_rgb_scalar(rgba, rgb, count);
+}
+
+void image_swizzle_rb(unsigned char *pixels, size_t count) {
+	switch (image_simd()) {
+#if IMAGE_OPS_X86
+	case IMAGE_SIMD_AVX2: swizzle_rb_avx2(pixels, count); break;
+	case IMAGE_SIMD_SSE2: swizzle_rb_sse2(pixels, count); break;
+#endif
+	default: swizzle_rb_scalar(pixels, count); break;
+	}
+}
+
+void image_premultiply_alpha(unsigned char *pixels, size_t count) {
+	switch (image_simd()) {
+#if IMAGE_OPS_X86
+	case IMAGE_SIMD_AVX2: premultiply_avx2(pixels, count); break;
+	case IMAGE_SIMD_SSE2: premultiply_sse2(pixels, count); break;
+#endif
+	default: premultiply_scalar(pixels, count); break;
+	}
+}
+
+void image_srgb_to_linear(const unsigned char *src, float *dst, size_t count) {
+#if IMAGE_OPS_X86
+	if (image_simd() == IMAGE_SIMD_AVX2) {
+		srgb_to_linear_avx2(src, dst, count);
+		return;
+	}
+#endif
+	srgb_to_linear_scalar(src, dst, count);
+}
+
+void image_linear_to_srgb(const float *src, unsigned char *dst, size_t count) {
+#if IMAGE_OPS_X86
+	if (image_simd() == IMAGE_SIMD_AVX2) {
+		linear_to_srgb_avx2(src, dst, count);
+		return;
+	}
+#endif
+	linear_to_srgb_scalar(src, dst, count);
+}
+
+unsigned char *image_convert_channels(unsigned char *pixels, size_t count, int from, int to) {
+	if (from == to || count == 0) {
+		return pixels;
+	}
+	if (to > from) {
+		unsigned char *grown = (unsigned char *)realloc(pixels, count * to);
+		if (!grown) {
+			free(pixels);
+			return NULL;
+		}
+		pixels = grown;
+	}
+	if (from == 3 && to == 4) {
+		image_rgb_to_rgba(pixels, pixels, count, 255);
+	} else if (from == 4 && to == 3) {
+		image_rgba_to_rgb(pixels, pixels, count);
+	} else {
+		convert_channels_scalar(pixels, pixels, count, from, to);
+	}
+	return pixels;
+}
+
+void image_convert_into(const unsigned char *src, int from, unsigned char *dst, int to, int w,
+	int h, bool flip, bool swap_rb) {
+	// a chunk of a row at a time through the cache, then out in one sequential write
+	const size_t chunk_pixels = 2048;
+	unsigned char chunk[chunk_pixels * 4];
+	size_t src_row = (size_t)w * from, dst_row = (size_t)w * to;
+	swap_rb = swap_rb && to == 4;
+	for (int y = 0; y < h; y++) {
+		const unsigned char *in = src + (size_t)(flip ? h - 1 - y : y) * src_row;
+		unsigned char *out = dst + (size_t)y * dst_row;
+		if (from == to && !swap_rb) {
+			memcpy(out, in, dst_row);
+			continue;
+		}
+		for (size_t x = 0; x < (size_t)w; x += chunk_pixels) {
+			size_t count = std::min(chunk_pixels, (size_t)w - x);
+			if (from == to) {
+				memcpy(chunk, in + x * from, count * to);
+			} else if (from == 3 && to == 4) {
+				image_rgb_to_rgba(in + x * from, chunk, count, 255);
+			} else if (from == 4 && to == 3) {
+				image_rgba_to_rgb(in + x * from, chunk, count);
+			} else {
+				convert_channels_scalar(in + x * from, chunk, count, from, to);
+			}
+			if (swap_rb) {
+				image_swizzle_rb(chunk, count);
+			}
+			memcpy(out + x * to, chunk, count * to);
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+/******************************************************************************\
+| Per-pixel work on decoded 8-bit images: row flips, RGB <-> RGBA, the R/B     |
+| swap for BGRA uploads, premultiplied alpha and sRGB <-> linear float.        |
+| Each operation has a scalar, an SSE2 and an AVX2 kernel, picked once at      |
+| startup from what the CPU (and the OS, for the AVX registers) supports, so   |
+| one build runs everywhere. SSE2 has no byte shuffle, so 3 <-> 4 channel      |
+| conversions use the scalar kernel unless there's AVX2, and the sRGB table    |
+| lookups only get faster with AVX2's gathers.                                 |
+| Everything that can work in place does: flips, the R/B swap, premultiply,    |
+| and both channel conversions as long as the buffer is big enough for the     |
+| larger of the two layouts. image_convert_into does a conversion, the flip    |
+| and the R/B swap on the way to another buffer instead. No OpenGL in here.    |
+\******************************************************************************/
+#ifndef _IMAGE_OPS_H_
+#define _IMAGE_OPS_H_
+
+#include <stddef.h>
+
+enum image_simd_t {
+	IMAGE_SIMD_SCALAR,
+	IMAGE_SIMD_SSE2,
+	IMAGE_SIMD_AVX2
+};
+
+// the kernels in use, the best the machine has unless image_set_simd lowered it
+image_simd_t image_simd();
+const char *image_simd_name(image_simd_t simd);
+// uses 'simd' or the best the machine has, whichever is lower. for comparing
+// kernels, set it before any worker starts on images
+void image_set_simd(image_simd_t simd);
+
+// swaps row 0 with row h-1 and so on
+void image_flip_rows(unsigned char *pixels, int w, int h, int channels);
+// 'rgba' may be 'rgb' when the buffer holds count * 4 bytes
+void image_rgb_to_rgba(const unsigned char *rgb, unsigned char *rgba, size_t count,
+	unsigned char alpha);
+// 'rgb' may be 'rgba'
+void image_rgba_to_rgb(const unsigned char *rgba, unsigned char *rgb, size_t count);
+// RGBA <-> BGRA, in place
+void image_swizzle_rb(unsigned char *pixels, size_t count);
+// colour times alpha / 255 (rounded) for RGBA pixels, in place
+void image_premultiply_alpha(unsigned char *pixels, size_t count);
+// RGBA bytes to floats in 0..1, colour through the sRGB curve, alpha linear
+void image_srgb_to_linear(const unsigned char *src, float *dst, size_t count);
+// and back, clamping to 0..1 first
+void image_linear_to_srgb(const float *src, unsigned char *dst, size_t count);
+
+// 'pixels' (malloc'd, as stbi_load returns them) with 'from' channels
+// converted to 'to' channels (1 to 4, alpha opaque when added), growing it
+// with realloc if needed. returns the buffer to use from then on, or NULL
+// with 'pixels' freed if it couldn't be grown
+unsigned char *image_convert_channels(unsigned char *pixels, size_t count, int from, int to);
+// 'src' (w x h, 'from' channels) copied to 'dst' as 'to' channels, rows in
+// reverse order if 'flip' and R/B swapped if 'swap_rb' (4 channels only), all
+// in one pass. 'dst' is only ever written, front to back, so it can be mapped
+// upload memory. they must not overlap
+void image_convert_into(const unsigned char *src, int from, unsigned char *dst, int to, int w,
+	int h, bool flip, bool swap_rb);
+
+#endif
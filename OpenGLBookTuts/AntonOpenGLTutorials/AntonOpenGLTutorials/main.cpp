@@ -1,4 +1,13 @@
+//plain fopen/ctime are fine here, keep msvc from treating them as errors under /sdl
+#define _CRT_SECURE_NO_WARNINGS
 #define STB_IMAGE_IMPLEMENTATION
+#define STBI_FAST_PNG
+#define STBI_FAST_JPEG
+//stb_image allocates from the decoding thread's image arena, see image_arena.h
+#include "image_arena.h"
+#define STBI_MALLOC(size) image_malloc(size)
+#define STBI_REALLOC(p, size) image_realloc(p, size)
+#define STBI_FREE(p) image_free(p)
 #include "stb_image.h"
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -9,12 +18,30 @@
 #include <istream>
 #include <string>
 #include <sstream>
+#include <string.h>
 #include <time.h>
 #include <stdarg.h>
 #include "maths_funcs.h"
+#include "mesh_utils.h"
+#include "profiler.h"
+#include "gpu_timer.h"
+#include "frame_pacing.h"
+#include "shader_library.h"
+#include "file_watcher.h"
+#include "asset_pack.h"
+#include "thread_pool.h"
+#include "texture_streamer.h"
+#include "texture_cache.h"
+#include "texture_atlas.h"
+#include "image_ops.h"
+#include "procedural_sky.h"
+#include "file_system.h"
 #define GL_LOG_FILE "gl.log"
 #define _USE_MATH_DEFINES
+#include <algorithm>
 #include <cmath>
+#include <map>
+#include <mutex>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -43,6 +70,8 @@ void initEnemy(enemy_t& enemy)
 }
 
 int gamestate = GAMEPLAY;
+//B swaps the bkg1 skybox for bkg3 and back, bkg3 is only loaded the first time
+bool use_second_skybox = false;
 float clearColors[3][3] = { {1.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0} };
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
@@ -53,24 +82,43 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 		gamestate %= 3;
 		glClearColor(clearColors[gamestate][0], clearColors[gamestate][1], clearColors[gamestate][2], 1.0f);
 	}
+	if (key == GLFW_KEY_B && action == GLFW_PRESS)
+	{
+		use_second_skybox = !use_second_skybox;
+	}
 }
 
-static std::string ParseShader(std::string filepath)
+//start a new log file with the current date and time
+bool restart_gl_log()
 {
-	std::ifstream stream(filepath);
-	if (!stream)
+	FILE* file = fopen(GL_LOG_FILE, "w");
+	if (!file)
 	{
-		fprintf(stderr, "Unable to open shader file");
-		exit(0);
+		fprintf(stderr, "ERROR: could not open GL_LOG_FILE log file %s for writing\n", GL_LOG_FILE);
+		return false;
 	}
-	std::string line;
-	std::string result;
-	while (getline(stream, line))
+	time_t now = time(NULL);
+	char* date = ctime(&now);
+	fprintf(file, "GL_LOG_FILE log. local time %s\n", date);
+	fclose(file);
+	return true;
+}
+
+//append a printf style message to the log file
+bool gl_log(const char* message, ...)
+{
+	va_list argptr;
+	FILE* file = fopen(GL_LOG_FILE, "a");
+	if (!file)
 	{
-		result += line;
-		result += "\n";
+		fprintf(stderr, "ERROR: could not open GL_LOG_FILE %s file for appending\n", GL_LOG_FILE);
+		return false;
 	}
-	return result;
+	va_start(argptr, message);
+	vfprintf(file, message, argptr);
+	va_end(argptr);
+	fclose(file);
+	return true;
 }
 
 mat4 createCameraViewMatrix()
@@ -78,65 +126,562 @@ mat4 createCameraViewMatrix()
 	return mat4();
 }
 
-bool load_cube_map_side(
-	GLuint texture, GLenum side_target, const char* file_name) {
-	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+#define RELPATH "../../external resources/skybox/"
+//built from RELPATH by tools/asset_packer, when it's missing the loose files are read instead
+#define ASSET_PACK_PATH "../../external resources/assets.pak"
+
+asset_pack_t asset_pack;
+bool asset_pack_loaded = false;
+//nebula skybox faces spread their rows over these, set once the pool is up
+thread_pool_t* sky_workers = NULL;
 
-	int x, y, n;
-	int force_channels = 4;
-	unsigned char*  image_data = stbi_load(
-		file_name, &x, &y, &n, force_channels);
-	if (!image_data) {
-		fprintf(stderr, "ERROR: could not load %s\n", file_name);
+//the file 'name' under RELPATH, for when there's no pack or it doesn't have that file
+bool read_loose_file(const char* name, std::vector<unsigned char>& bytes)
+{
+	std::string path = std::string(RELPATH) + name;
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
 		return false;
 	}
-	// non-power-of-2 dimensions check
-	if ((x & (x - 1)) != 0 || (y & (y - 1)) != 0) {
-		fprintf(stderr,
-			"WARNING: image %s is not power-of-2 dimensions\n",
-			file_name);
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	bytes.resize(size > 0 ? (size_t)size : 0);
+	bool ok = size >= 0 && fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	fclose(file);
+	return ok;
+}
+
+//decodes the image 'name' out of the asset pack, straight from the mapping for stored entries,
+//or from the loose file under RELPATH if there's no pack or it doesn't have that image
+unsigned char* load_image(const char* name, int* x, int* y, int* n, int force_channels)
+{
+	//a nebula face isn't a file, it's made here from the seed in its name
+	unsigned seed = 0;
+	int face_size = 0, face = 0;
+	if (procedural_sky_parse_name(name, &seed, &face_size, &face))
+	{
+		unsigned char* pixels = (unsigned char*)image_malloc((size_t)face_size * face_size * 3);
+		if (!pixels)
+		{
+			return NULL;
+		}
+		procedural_sky_face(sky_workers, seed, face_size, face, pixels);
+		*x = face_size;
+		*y = face_size;
+		*n = 3;
+		if (force_channels && force_channels != 3)
+		{
+			unsigned char* converted = (unsigned char*)image_malloc((size_t)face_size * face_size * force_channels);
+			if (converted)
+			{
+				image_convert_into(pixels, 3, converted, force_channels, face_size, face_size, false, false);
+			}
+			image_free(pixels);
+			return converted;
+		}
+		return pixels;
 	}
+	if (asset_pack_loaded)
+	{
+		const asset_entry_t* entry = asset_pack_find(&asset_pack, name);
+		if (entry)
+		{
+			std::vector<unsigned char> scratch;
+			size_t size = 0;
+			const unsigned char* data = asset_pack_read(&asset_pack, entry, scratch, &size);
+			if (data)
+			{
+				return stbi_load_from_memory(data, (int)size, x, y, n, force_channels);
+			}
+		}
+	}
+	//read whole so stb_image can split jpeg restart intervals over the workers, it can't from a FILE*.
+	//into image_malloc memory, on a worker that's the arena the decode uses too
+	std::string path = std::string(RELPATH) + name;
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	unsigned char* bytes = size > 0 ? (unsigned char*)image_malloc((size_t)size) : NULL;
+	bool ok = bytes && fread(bytes, 1, (size_t)size, file) == (size_t)size;
+	fclose(file);
+	unsigned char* pixels = ok ? stbi_load_from_memory(bytes, (int)size, x, y, n, force_channels) : NULL;
+	image_free(bytes);
+	return pixels;
+}
 
-	// copy image data into 'target' side of cube map
-	glTexImage2D(
-		side_target,
-		0,
-		GL_RGBA,
-		x,
-		y,
-		0,
-		GL_RGBA,
-		GL_UNSIGNED_BYTE,
-		image_data);
-	free(image_data);
+//stb_image's hook for decoding jpeg restart intervals at once, 'user' is the worker pool
+void jpeg_parallel_for(void* user, int count, void (*task)(void* arg, int index), void* arg)
+{
+	thread_pool_parallel_for_nested((thread_pool_t*)user, (size_t)count, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			task(arg, (int)i);
+		}
+	});
+}
+
+//starts paging in the images startup is about to decode, so the reads overlap window and context creation
+void prefetch_images(const char* const* names, int count)
+{
+	for (int i = 0; asset_pack_loaded && i < count; i++)
+	{
+		const asset_entry_t* entry = asset_pack_find(&asset_pack, names[i]);
+		if (entry)
+		{
+			asset_pack_prefetch(&asset_pack, entry);
+		}
+	}
+}
+
+//the raw bytes of an asset, for files that aren't images stb_image decodes (the baked .ktx textures)
+bool read_asset(const char* name, std::vector<unsigned char>& bytes)
+{
+	if (asset_pack_loaded)
+	{
+		const asset_entry_t* entry = asset_pack_find(&asset_pack, name);
+		if (entry)
+		{
+			size_t size = 0;
+			const unsigned char* data = asset_pack_read(&asset_pack, entry, bytes, &size);
+			if (data && data != bytes.data())
+			{
+				bytes.assign(data, data + size);
+			}
+			return data != NULL;
+		}
+	}
+	return read_loose_file(name, bytes);
+}
+
+//a loose file's content hash, with the size and write time it had when it was hashed
+struct loose_hash_t
+{
+	unsigned long long size;
+	long long write_time;
+	unsigned long long hash;
+};
+//by name, so an unchanged loose file is only read and hashed once. the decode workers all use it
+std::map<std::string, loose_hash_t> loose_hashes;
+std::mutex loose_hashes_mutex;
+//kept next to the texture cache's entries between launches, empty when there's no cache
+std::string loose_hashes_file;
+bool loose_hashes_changed = false;
+
+//reads the hashes an earlier launch saved in the texture cache directory 'dir', so a warm launch without the
+//asset pack only stats the loose images. a line is "<hash> <size> <write time> <name>"
+void load_loose_hashes(const char* dir)
+{
+	loose_hashes_file = std::string(dir) + "/loose_hashes.txt";
+	FILE* file = fopen(loose_hashes_file.c_str(), "r");
+	if (!file)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(loose_hashes_mutex);
+	char line[1024];
+	while (fgets(line, sizeof(line), file))
+	{
+		loose_hash_t stamp = { 0, 0, 0 };
+		int name_start = 0;
+		if (sscanf(line, "%llx %llu %lld %n", &stamp.hash, &stamp.size, &stamp.write_time, &name_start) != 3 || name_start == 0)
+		{
+			continue;
+		}
+		std::string name = line + name_start;
+		while (!name.empty() && (name.back() == '\n' || name.back() == '\r'))
+		{
+			name.pop_back();
+		}
+		if (!name.empty())
+		{
+			loose_hashes[name] = stamp;
+		}
+	}
+	fclose(file);
+}
+
+//writes loose_hashes back if this run hashed anything, leaving out images that are gone. written to a temp
+//file and renamed into place, like the cache's entries
+void save_loose_hashes()
+{
+	std::lock_guard<std::mutex> lock(loose_hashes_mutex);
+	if (loose_hashes_file.empty() || !loose_hashes_changed)
+	{
+		return;
+	}
+	std::string temp_file = loose_hashes_file + ".tmp";
+	FILE* file = fopen(temp_file.c_str(), "w");
+	if (!file)
+	{
+		fprintf(stderr, "WARNING: could not write %s\n", temp_file.c_str());
+		return;
+	}
+	for (std::map<std::string, loose_hash_t>::const_iterator it = loose_hashes.begin(); it != loose_hashes.end(); ++it)
+	{
+		unsigned long long size = 0;
+		long long write_time = 0;
+		if (file_stamp((std::string(RELPATH) + it->first).c_str(), &size, &write_time))
+		{
+			fprintf(file, "%016llx %llu %lld %s\n", it->second.hash, it->second.size, it->second.write_time, it->first.c_str());
+		}
+	}
+	bool written = !ferror(file);
+	written = fclose(file) == 0 && written;
+	remove(loose_hashes_file.c_str());
+	if (!written || rename(temp_file.c_str(), loose_hashes_file.c_str()) != 0)
+	{
+		fprintf(stderr, "WARNING: could not write %s\n", loose_hashes_file.c_str());
+		remove(temp_file.c_str());
+		return;
+	}
+	loose_hashes_changed = false;
+}
+
+//content hash of an image for the texture cache: the pack already has it, loose files are read and hashed
+//(the same hash, so a loose file and its packed copy share cache entries), again only when their size or
+//write time changed, on this launch or since the one that saved loose_hashes
+bool hash_image(const char* name, unsigned long long* hash)
+{
+	//nebula faces aren't cached, making one again is quicker than reading it back
+	unsigned seed = 0;
+	int face_size = 0, face = 0;
+	if (procedural_sky_parse_name(name, &seed, &face_size, &face))
+	{
+		return false;
+	}
+	if (asset_pack_loaded)
+	{
+		const asset_entry_t* entry = asset_pack_find(&asset_pack, name);
+		if (entry)
+		{
+			*hash = entry->hash;
+			return true;
+		}
+	}
+	loose_hash_t stamp = { 0, 0, 0 };
+	if (!file_stamp((std::string(RELPATH) + name).c_str(), &stamp.size, &stamp.write_time))
+	{
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(loose_hashes_mutex);
+		std::map<std::string, loose_hash_t>::iterator known = loose_hashes.find(name);
+		if (known != loose_hashes.end() && known->second.size == stamp.size && known->second.write_time == stamp.write_time)
+		{
+			*hash = known->second.hash;
+			return true;
+		}
+	}
+	std::vector<unsigned char> bytes;
+	if (!read_loose_file(name, bytes))
+	{
+		return false;
+	}
+	stamp.hash = asset_hash(bytes.data(), bytes.size());
+	{
+		std::lock_guard<std::mutex> lock(loose_hashes_mutex);
+		loose_hashes[name] = stamp;
+		loose_hashes_changed = true;
+	}
+	*hash = stamp.hash;
 	return true;
 }
 
-void create_cube_map(
-	const char* front,
-	const char* back,
-	const char* top,
-	const char* bottom,
-	const char* left,
-	const char* right,
-	GLuint* skybox) {
-	// generate a cube-map texture to hold all the sides
-	glActiveTexture(GL_TEXTURE0);
-	glGenTextures(1, skybox);
-
-	// load each image and copy into a side of the cube-map texture
-	load_cube_map_side(*skybox, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, front);
-	load_cube_map_side(*skybox, GL_TEXTURE_CUBE_MAP_POSITIVE_Z, back);
-	load_cube_map_side(*skybox, GL_TEXTURE_CUBE_MAP_POSITIVE_Y, top);
-	load_cube_map_side(*skybox, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, bottom);
-	load_cube_map_side(*skybox, GL_TEXTURE_CUBE_MAP_NEGATIVE_X, left);
-	load_cube_map_side(*skybox, GL_TEXTURE_CUBE_MAP_POSITIVE_X, right);
-	// format cube map texture
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+//the entry for 'image' in the atlas manifest 'name', NULL if there's no manifest, it isn't a flipped 2D
+//atlas (what the ship's texture coordinates need) or it doesn't have the image
+const atlas_entry_t* load_atlas_entry(const char* name, const char* image, atlas_t* atlas)
+{
+	std::vector<unsigned char> text;
+	if (!read_asset(name, text) || !atlas_parse_manifest((const char*)text.data(), text.size(), atlas, name))
+	{
+		return NULL;
+	}
+	const atlas_entry_t* entry = atlas_find(atlas, image);
+	if (!entry || atlas->array || !atlas->bottom_up)
+	{
+		gl_log("%s has no %s or wasn't baked as a --flip atlas, not using it\n", name, image);
+		return NULL;
+	}
+	gl_log("%s from %s in %s\n", image, atlas->texture.c_str(), name);
+	return entry;
+}
+
+//image size and channels from the header alone, the streamer sizes texture storage with it before decoding
+bool probe_image(const char* name, int* x, int* y, int* n)
+{
+	unsigned seed = 0;
+	int face_size = 0, face = 0;
+	if (procedural_sky_parse_name(name, &seed, &face_size, &face))
+	{
+		*x = face_size;
+		*y = face_size;
+		*n = 3;
+		return true;
+	}
+	if (asset_pack_loaded)
+	{
+		const asset_entry_t* entry = asset_pack_find(&asset_pack, name);
+		if (entry && !(entry->flags & ASSET_DEFLATE))
+		{
+			return stbi_info_from_memory(asset_pack.base + entry->offset, (int)entry->size, x, y, n) != 0;
+		}
+		if (entry)
+		{
+			std::vector<unsigned char> scratch;
+			size_t size = 0;
+			const unsigned char* data = asset_pack_read(&asset_pack, entry, scratch, &size);
+			return data && stbi_info_from_memory(data, (int)size, x, y, n) != 0;
+		}
+	}
+	std::string path = std::string(RELPATH) + name;
+	return stbi_info(path.c_str(), x, y, n) != 0;
+}
+
+//whether the asset pack or RELPATH has 'name', without reading it
+bool asset_exists(const char* name)
+{
+	if (asset_pack_loaded && asset_pack_find(&asset_pack, name))
+	{
+		return true;
+	}
+	std::string path = std::string(RELPATH) + name;
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file)
+	{
+		fclose(file);
+	}
+	return file != NULL;
+}
+
+//the vertical field of view the projection is built with, skybox tiers are picked for it too
+const float camera_fov = 67.0f * ONE_DEG_IN_RAD;
+
+//face sizes tools/texture_baker --tiers bakes skyboxes at (bkg1_back6_1024.ktx next to bkg1_back6.png)
+const int skybox_tiers[] = { 512, 1024, 2048, 4096 };
+
+//bkg1_back6.png at tier 1024 is bkg1_back6_1024.ktx
+std::string skybox_tier_name(const char* face, int tier)
+{
+	std::string name = face;
+	size_t dot = name.find_last_of('.');
+	return name.substr(0, dot) + "_" + std::to_string(tier) + ".ktx";
+}
+
+//how many texels across a cube face needs for about one a pixel: a face spans 90 degrees of view
+float skybox_face_pixels(int framebuffer_height)
+{
+	return framebuffer_height / tan(camera_fov * 0.5f);
+}
+
+//the smallest tier at least 'face_pixels' across that all six faces are baked at, 0 (the full-size images)
+//if there's none
+int pick_skybox_tier(const char* const faces[6], float face_pixels)
+{
+	for (int tier : skybox_tiers)
+	{
+		bool baked = tier >= face_pixels;
+		for (int i = 0; baked && i < 6; i++)
+		{
+			baked = asset_exists(skybox_tier_name(faces[i], tier).c_str());
+		}
+		if (baked)
+		{
+			return tier;
+		}
+	}
+	return 0;
+}
+
+//nebulas are made at whatever size is asked for, so the smallest tier with a texel a pixel, up to the
+//largest face procedural_sky makes
+int pick_nebula_tier(float face_pixels)
+{
+	for (int tier : skybox_tiers)
+	{
+		if (tier >= face_pixels || tier >= PROCEDURAL_SKY_MAX_SIZE)
+		{
+			return std::min(tier, PROCEDURAL_SKY_MAX_SIZE);
+		}
+	}
+	return PROCEDURAL_SKY_MAX_SIZE;
+}
+
+//a skybox and the tier it's loaded at. a different tier streams in as 'next' while the old one is still
+//drawn, and replaces it once it has every level it wants
+//a nebula set has no images, its tiers are face sizes procedural_sky makes it at, and a new seed streams
+//in as 'next' the same way
+struct skybox_set_t
+{
+	const char* const* faces; //the full-size images, NULL for a nebula
+	unsigned seed; //the nebula wanted
+	int framebuffer_height; //the tier was picked for
+	int tier;
+	unsigned texture_seed;
+	streamed_texture_t* texture; //NULL until first loaded
+	int next_tier;
+	unsigned next_seed;
+	streamed_texture_t* next;
+};
+
+streamed_texture_t* request_skybox_tier(texture_streamer_t* streamer, const skybox_set_t* set, int tier,
+	const unsigned char placeholder[4])
+{
+	const char* const* faces = set->faces;
+	std::string names[6];
+	const char* tier_faces[6];
+	if (!faces)
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			names[i] = procedural_sky_face_name(set->seed, tier, i);
+			tier_faces[i] = names[i].c_str();
+		}
+		gl_log("skybox: nebula %u at %ix%i\n", set->seed, tier, tier);
+		return texture_streamer_request_cube(streamer, tier_faces, GL_TEXTURE0, placeholder);
+	}
+	if (tier == 0)
+	{
+		gl_log("skybox %s: full-size images\n", faces[0]);
+		return texture_streamer_request_cube(streamer, faces, GL_TEXTURE0, placeholder);
+	}
+	for (int i = 0; i < 6; i++)
+	{
+		names[i] = skybox_tier_name(faces[i], tier);
+		tier_faces[i] = names[i].c_str();
+	}
+	gl_log("skybox %s: %ix%i tier\n", faces[0], tier, tier);
+	return texture_streamer_request_cube(streamer, tier_faces, GL_TEXTURE0, placeholder);
+}
+
+//starts loading the tier (and for a nebula, the seed) for a framebuffer 'framebuffer_height' high, unless
+//it's the one shown or already on its way
+void retier_skybox(texture_streamer_t* streamer, skybox_set_t* set, int framebuffer_height, const unsigned char placeholder[4])
+{
+	set->framebuffer_height = framebuffer_height;
+	float face_pixels = skybox_face_pixels(framebuffer_height);
+	int tier = set->faces ? pick_skybox_tier(set->faces, face_pixels) : pick_nebula_tier(face_pixels);
+	if (set->next && (set->next_tier != tier || set->next_seed != set->seed))
+	{
+		texture_streamer_release(streamer, set->next);
+		set->next = NULL;
+	}
+	if (set->next || (set->texture && set->tier == tier && set->texture_seed == set->seed))
+	{
+		return;
+	}
+	streamed_texture_t* texture = request_skybox_tier(streamer, set, tier, placeholder);
+	if (!set->texture)
+	{
+		set->texture = texture;
+		set->tier = tier;
+		set->texture_seed = set->seed;
+	}
+	else
+	{
+		set->next = texture;
+		set->next_tier = tier;
+		set->next_seed = set->seed;
+	}
+}
+
+//the cube map to draw this frame. swaps in the new tier once it's complete, and goes back to the full-size
+//images if a baked tier can't be loaded (a driver without BC1, say). a nebula has nothing to go back to
+streamed_texture_t* skybox_texture(texture_streamer_t* streamer, skybox_set_t* set, const unsigned char placeholder[4])
+{
+	if (set->next && set->next->failed)
+	{
+		texture_streamer_release(streamer, set->next);
+		set->next = NULL;
+		if (set->faces && set->tier != 0)
+		{
+			set->next = request_skybox_tier(streamer, set, 0, placeholder);
+			set->next_tier = 0;
+		}
+	}
+	if (set->next && streamed_texture_complete(set->next))
+	{
+		texture_streamer_release(streamer, set->texture);
+		set->texture = set->next;
+		set->tier = set->next_tier;
+		set->texture_seed = set->next_seed;
+		set->next = NULL;
+	}
+	if (set->texture->failed && set->faces && set->tier != 0 && !set->next)
+	{
+		texture_streamer_release(streamer, set->texture);
+		set->texture = request_skybox_tier(streamer, set, 0, placeholder);
+		set->tier = 0;
+	}
+	return set->texture;
+}
+
+//uploads a quantised mesh as one interleaved vbo plus an index buffer, both recorded in the returned vao
+//attribute 0 is the position (normalised shorts or half floats), attribute 1 the unorm16 texture coordinates
+//positions come out in [-1,1], draw it with set_model_matrix so they get mapped back to model space
+GLuint create_quantised_mesh_vao(const quantised_mesh_t& mesh)
+{
+	GLuint vao = 0;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	GLuint vbo = 0;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(unsigned short), mesh.vertices.data(), GL_STATIC_DRAW);
+
+	//the element buffer binding is part of the vao state, so it has to be bound while the vao is
+	GLuint ibo = 0;
+	glGenBuffers(1, &ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned short), mesh.indices.data(), GL_STATIC_DRAW);
+
+	if (mesh.position_format == POSITION_FORMAT_HALF)
+	{
+		glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, mesh.stride_bytes, NULL);
+	}
+	else
+	{
+		glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, mesh.stride_bytes, NULL);
+	}
+	glEnableVertexAttribArray(0);
+	if (mesh.has_texcoords)
+	{
+		glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, mesh.stride_bytes, (const GLvoid*)(4 * sizeof(unsigned short)));
+		glEnableVertexAttribArray(1);
+	}
+
+	glBindVertexArray(0);
+	return vao;
+}
+
+//uploads model * dequantise as the model matrix, which undoes the bounding box normalisation of quantised positions
+void set_model_matrix(int location, const float* model, const float* dequantise)
+{
+	mat4 model_mat, dequantise_mat;
+	memcpy(model_mat.m, model, sizeof(model_mat.m));
+	memcpy(dequantise_mat.m, dequantise, sizeof(dequantise_mat.m));
+	mat4 result = model_mat * dequantise_mat;
+	glUniformMatrix4fv(location, 1, GL_FALSE, result.m);
+}
+
+//the skybox vertex shader turns screen positions back into view directions, it needs the inverse of proj * view
+//without the camera translation so the sky stays infinitely far away
+void set_skybox_inverse_view_proj(int location, mat4 proj, const mat4& view)
+{
+	mat4 rotation = view;
+	rotation.m[12] = 0.0f;
+	rotation.m[13] = 0.0f;
+	rotation.m[14] = 0.0f;
+	mat4 inv_proj_view = inverse(proj * rotation);
+	glUniformMatrix4fv(location, 1, GL_FALSE, inv_proj_view.m);
 }
 
 //code taken from https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-sphere-intersection
@@ -172,13 +717,90 @@ bool solveQuadratic(const float &a, const float &b, const float &c, float &x0, f
 	return true;
 }
 
-#define RELPATH "../../external resources/skybox/"
+//the megabytes of a --texture-budget=MB or --texture-cache=MB option, 'text' being what follows the '='.
+//anything but a whole number, 0 or more, is reported and leaves 'mb' at its default
+void parse_megabytes(const char* option, const char* text, size_t* mb)
+{
+	char* end = NULL;
+	long value = strtol(text, &end, 10);
+	if (end == text || *end != '\0' || value < 0)
+	{
+		fprintf(stderr, "WARNING: %s isn't a number of megabytes, keeping %u\n", option, (unsigned)*mb);
+		return;
+	}
+	*mb = (size_t)value;
+}
 
-int main()
+int main(int argc, char** argv)
 {
+	profiler_init();
+	profiler_set_thread_name("main");
+	restart_gl_log();
+
+	//every command line option, read in one pass
+	//--texture-budget=MB caps the video memory textures use, --texture-cache=MB the disk cache (0 turns it off)
+	size_t texture_budget_mb = 128;
+	size_t texture_cache_mb = 256;
+	//--nebula[=seed] draws a nebula made on the workers (procedural_sky.h) instead of the bkg1 images, the next seed each wave
+	bool use_nebula = false;
+	unsigned nebula_seed = (unsigned)time(NULL);
+	//--shaders-from-disk reads the shader files instead of embedded_shaders.h, for hot-reloading
+	bool shaders_from_disk = false;
+	//--vsync, --fps-cap and --jit, see frame_pacing.h
+	frame_pacing_config_t pacing_config = frame_pacing_default_config();
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--nebula") == 0)
+		{
+			use_nebula = true;
+		}
+		else if (strncmp(argv[i], "--nebula=", 9) == 0)
+		{
+			use_nebula = true;
+			nebula_seed = (unsigned)strtoul(argv[i] + 9, NULL, 10);
+		}
+		else if (strncmp(argv[i], "--texture-budget=", 17) == 0)
+		{
+			parse_megabytes(argv[i], argv[i] + 17, &texture_budget_mb);
+		}
+		else if (strncmp(argv[i], "--texture-cache=", 16) == 0)
+		{
+			parse_megabytes(argv[i], argv[i] + 16, &texture_cache_mb);
+		}
+		else if (strcmp(argv[i], "--shaders-from-disk") == 0)
+		{
+			shaders_from_disk = true;
+		}
+		else if (!frame_pacing_parse_arg(&pacing_config, argv[i]))
+		{
+			fprintf(stderr, "WARNING: unknown option %s\n", argv[i]);
+		}
+	}
+
+	//one mapped file for every image instead of an open and read per image
+	asset_pack_loaded = asset_pack_open(&asset_pack, ASSET_PACK_PATH);
+	if (!asset_pack_loaded)
+	{
+		gl_log("no asset pack at %s, reading loose files from %s\n", ASSET_PACK_PATH, RELPATH);
+	}
+	//the skybox's full-size faces, for when it has no baked tiers. the window size that picks one isn't known yet
+	const char* startup_images[] = { "spaceship_texture_map.jpg", "bkg1_back6.png", "bkg1_front5.png",
+		"bkg1_top3.png", "bkg1_bottom4.png", "bkg1_left2.png", "bkg1_right1.png" };
+	prefetch_images(startup_images, sizeof(startup_images) / sizeof(startup_images[0]));
+
+	//images decode on these, the main thread keeps the context and only uploads
+	thread_pool_t worker_pool;
+	thread_pool_init(&worker_pool, 0, image_arena_trim);
+	//jpegs with restart markers decode an interval per worker, even from inside a decode job
+	stbi_set_jpeg_parallel_for(jpeg_parallel_for, &worker_pool);
+	sky_workers = &worker_pool;
+	//flips, channel conversions and mip filtering on the workers use the widest kernels the cpu has
+	gl_log("image kernels: %s\n", image_simd_name(image_simd()));
+
 	if(!glfwInit())
 	{
 		fprintf(stderr, "Error: could not start GLFW3\n");
+		thread_pool_shutdown(&worker_pool);
 		return 1;
 	}
 	//make it fullscreen
@@ -191,6 +813,7 @@ int main()
 	{
 		fprintf(stderr, "Error: could not open a window\n");
 		glfwTerminate();
+		thread_pool_shutdown(&worker_pool);
 		return 1;
 	}
 	glfwMakeContextCurrent(window);
@@ -203,12 +826,60 @@ int main()
 	const GLubyte* version = glGetString(GL_VERSION);
 	//printf("Renderer: %s\n", renderer);
 	//printf("OpenGL version supported: %s\n", version);
+	gl_log("renderer: %s\nversion: %s\n", renderer, version);
+
+	//times the gpu side of each render pass, results end up in the profiler as GPU zones
+	gpu_timer_t gpu_timer;
+	gpu_timer_init(&gpu_timer);
 
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS);
 
-	//enable vsync
-	glfwSwapInterval(1);
+	//textures stream in behind 1x1 placeholders, mips made on the workers, see texture_streamer.h.
+	//a .ktx from tools/texture_baker next to an image is used instead of it
+	//the skybox loads the baked tier that fits the window and streams the next one in on resize
+	//textures not drawn lately lose mips over the --texture-budget (texture_residency.h)
+	//decoded images are kept in texture_cache/ for later launches
+	texture_cache_t texture_cache;
+	bool texture_cache_on = texture_cache_mb > 0 && texture_cache_open(&texture_cache, (executable_directory() + "texture_cache").c_str(), texture_cache_mb * 1024 * 1024);
+	texture_streamer_t texture_streamer;
+	texture_streamer_init(&texture_streamer, &worker_pool, load_image, probe_image, read_asset, 8 * 1024 * 1024);
+	residency_set_budget(&texture_streamer.residency, texture_budget_mb * 1024 * 1024);
+	if (texture_cache_on)
+	{
+		load_loose_hashes(texture_cache.dir.c_str());
+		texture_streamer_set_cache(&texture_streamer, &texture_cache, hash_image);
+	}
+	const char* skybox_faces[6] = { "bkg1_back6.png", "bkg1_front5.png", "bkg1_top3.png", "bkg1_bottom4.png", "bkg1_left2.png", "bkg1_right1.png" };
+	const char* second_skybox_faces[6] = { "bkg3_back6.png", "bkg3_front5.png", "bkg3_top3.png", "bkg3_bottom4.png", "bkg3_left2.png", "bkg3_right1.png" };
+	const unsigned char space_colour[4] = { 2, 2, 12, 255 };
+	const unsigned char hull_colour[4] = { 128, 128, 128, 255 };
+	skybox_set_t skybox = { use_nebula ? NULL : skybox_faces, nebula_seed, 0, 0, 0, NULL, 0, 0, NULL };
+	skybox_set_t second_skybox = { second_skybox_faces, 0, 0, 0, 0, NULL, 0, 0, NULL };
+	int startup_framebuffer_height = 0;
+	glfwGetFramebufferSize(window, NULL, &startup_framebuffer_height);
+	retier_skybox(&texture_streamer, &skybox, startup_framebuffer_height, space_colour);
+	//with ship.atlas there (tools/atlas_builder, baked --flip) the ship samples that atlas instead, its
+	//texcoords are moved into the texture map's rectangle where the mesh is built
+	atlas_t ship_atlas;
+	const atlas_entry_t* ship_atlas_entry = load_atlas_entry("ship.atlas", "spaceship_texture_map.jpg", &ship_atlas);
+	//flipped right side up on the worker
+	streamed_texture_t* ship_texture = texture_streamer_request_2d(&texture_streamer, ship_atlas_entry ? ship_atlas.texture.c_str() : "spaceship_texture_map.jpg",
+		GL_TEXTURE1, true, hull_colour);
+
+	//all programs are submitted here and waited on once meshes and textures are loaded, see shader_library.h.
+	//sources come from embedded_shaders.h (shaders.manifest) unless --shaders-from-disk
+	shader_library_t shader_library;
+	shader_library_init(&shader_library, (executable_directory() + "shader_cache").c_str(), shaders_from_disk);
+	shader_library_enable_parallel_compile(&shader_library, 0);
+	GLuint skybox_program = shader_library_request_program(&shader_library, "skybox_shader.vert", "skybox_shader.frag");
+	GLuint shader_program_red = shader_library_request_program(&shader_library, "test.vert", "mesh.frag", "FLAT_COLOUR=vec4(1.0,0.0,0.0,1.0)");
+	GLuint shader_program_VertexColourExample = shader_library_request_program(&shader_library, "mesh.vert", "mesh.frag", "VERTEX_COLOUR");
+	GLuint shader_program_ship = shader_library_request_program(&shader_library, "mesh.vert", "mesh.frag", "TEXTURED");
+	GLuint shader_program_asteroid = shader_library_request_program(&shader_library, "mesh.vert", "mesh.frag");
+
+	frame_pacer_t pacer;
+	frame_pacer_init(&pacer, pacing_config, vmode->refreshRate);
 
 
 	//set the cursor mode to GLFW_CURSOR_DISABLED. (GLFW will then take care of all the details of cursor re-centering and offset calculation and providing the application with a virtual cursor position)
@@ -261,60 +932,13 @@ int main()
 		asteroid_x, asteroid_y, asteroid_z, 1.0f				//3, 7, 11, 15,
 	};
 
-	float points_skybox[] = {
-		-100.0f,  100.0f, -100.0f,
-		-100.0f, -100.0f, -100.0f,
-		100.0f, -100.0f, -100.0f,
-		100.0f, -100.0f, -100.0f,
-		100.0f,  100.0f, -100.0f,
-		-100.0f,  100.0f, -100.0f,
-
-		-100.0f, -100.0f,  100.0f,
-		-100.0f, -100.0f, -100.0f,
-		-100.0f,  100.0f, -100.0f,
-		-100.0f,  100.0f, -100.0f,
-		-100.0f,  100.0f,  100.0f,
-		-100.0f, -100.0f,  100.0f,
-
-		100.0f, -100.0f, -100.0f,
-		100.0f, -100.0f,  100.0f,
-		100.0f,  100.0f,  100.0f,
-		100.0f,  100.0f,  100.0f,
-		100.0f,  100.0f, -100.0f,
-		100.0f, -100.0f, -100.0f,
-
-		-100.0f, -100.0f,  100.0f,
-		-100.0f,  100.0f,  100.0f,
-		100.0f,  100.0f,  100.0f,
-		100.0f,  100.0f,  100.0f,
-		100.0f, -100.0f,  100.0f,
-		-100.0f, -100.0f,  100.0f,
-
-		-100.0f,  100.0f, -100.0f,
-		100.0f,  100.0f, -100.0f,
-		100.0f,  100.0f,  100.0f,
-		100.0f,  100.0f,  100.0f,
-		-100.0f,  100.0f,  100.0f,
-		-100.0f,  100.0f, -100.0f,
-
-		-100.0f, -100.0f, -100.0f,
-		-100.0f, -100.0f,  100.0f,
-		100.0f, -100.0f, -100.0f,
-		100.0f, -100.0f, -100.0f,
-		-100.0f, -100.0f,  100.0f,
-		100.0f, -100.0f,  100.0f
-	};
-	GLuint vbo_sky;
-	glGenBuffers(1, &vbo_sky);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo_sky);
-	glBufferData(GL_ARRAY_BUFFER, 3 * 36 * sizeof(float), &points_skybox, GL_STATIC_DRAW);
+	//vertex position storage for the ship and asteroid, POSITION_FORMAT_HALF is the alternative
+	position_format_t mesh_position_format = POSITION_FORMAT_SNORM16;
 
+	//the skybox has no vertex buffer, skybox_shader.vert makes a full-screen triangle from gl_VertexID
+	//a core profile still wants some vao bound for the draw, so it gets an empty one
 	GLuint vao_sky;
 	glGenVertexArrays(1, &vao_sky);
-	glBindVertexArray(vao_sky);
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo_sky);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
 
 
 
@@ -678,21 +1302,137 @@ int main()
 
 	};
 
-		//create a vertex buffer object(vbo) to pass on our positions array to the GPU (Define vertex colours example)
-	GLuint tex_example_vbo = 0;
-	glGenBuffers(1, &tex_example_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, tex_example_vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(textureExamplePoints), textureExamplePoints, GL_STATIC_DRAW);
-
-	//create a vertex attribute object(VAO) so that we dont have to bind each vertex buffer object every time we draw a mesh.
-	//VAO remembers all the vertex buffers that you want and the memory layout of each one. 
-	//Set up the VAO once per mesh and bind it before every mesh you want to draw.
-	GLuint vao5 = 0;
-	glGenVertexArrays(1, &vao5);
-	glBindVertexArray(vao5);
-	glBindBuffer(GL_ARRAY_BUFFER, tex_example_vbo);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(0);
+	//create texture coordinates
+
+	GLfloat texcoords[] = {
+		//top side
+		//3 squares
+		0.0f,1.0f,
+		0.0f,0.0f,
+		0.333f,0.0f,
+
+		0.333f,0.0f,
+		0.333f,1.0f,
+		0.0f,1.0f,
+
+		0.0f,1.0f,
+		0.0f,0.0f,
+		0.333f,0.0f,
+
+		0.333f,0.0f,
+		0.333f,1.0f,
+		0.0f,1.0f,
+
+		0.0f,1.0f,
+		0.0f,0.0f,
+		0.333f,0.0f,
+
+		0.333f,0.0f,
+		0.333f,1.0f,
+		0.0f,1.0f,
+		//3 rectangles (front window)
+		0.0f,1.0f,
+		0.0f,0.0f,
+		0.333f,0.0f,
+
+		0.333f,0.0f,
+		0.333f,1.0f,
+		0.0f,1.0f,
+
+		0.0f,1.0f,
+		0.0f,0.0f,
+		0.333f,0.0f,
+
+		0.333f,0.0f,
+		0.333f,1.0f,
+		0.0f,1.0f,
+
+		0.7f,1.0f,
+		0.7f,0.0f,
+		1.0f,0.0f,
+
+		1.0f,0.0f,
+		1.0f,1.0f,
+		0.7f,1.0f,
+		//top long side
+		0.0f,0.5f,
+		0.0f,0.0f,
+		0.333f,0.0f,
+
+		0.333f,0.0f,
+		0.333f,1.0f,
+		0.0f,1.0f,
+		//top side fillers
+		0.0f,1.0f,
+		0.0f,0.0f,
+		0.333f,0.0f,
+
+		0.333f,0.0f,
+		0.333f,1.0f,
+		0.0f,1.0f,
+		//back side
+		0.0f,1.0f,
+		0.0f,0.0f,
+		0.333f,0.0f,
+
+		0.333f,0.0f,
+		0.333f,1.0f,
+		0.0f,1.0f,
+
+		0.0f,1.0f,
+		0.0f,0.0f,
+		0.333f,0.0f,
+
+		0.333f,0.0f,
+		0.333f,1.0f,
+		0.0f,1.0f,
+		//bottom side
+		0.0f,1.0f,
+		0.0f,0.0f,
+		0.333f,0.0f,
+
+		0.333f,0.0f,
+		0.333f,1.0f,
+		0.0f,1.0f,
+		//front
+		0.0f,1.0f,
+		0.0f,0.0f,
+		0.333f,0.0f,
+
+		0.333f,0.0f,
+		0.333f,1.0f,
+		0.0f,1.0f,
+		//left side
+		0.0f,1.0f,
+		0.0f,0.0f,
+		0.333f,0.0f,
+
+		0.333f,0.0f,
+		0.333f,1.0f,
+		0.0f,1.0f,
+		//right side
+		0.0f, 1.0f,
+		0.0f, 0.0f,
+		0.333f, 0.0f,
+
+		0.333f, 0.0f,
+		0.333f, 1.0f,
+		0.0f, 1.0f
+		//thrusters
+	};
+
+	if (ship_atlas_entry)
+	{
+		atlas_remap_uvs(ship_atlas_entry, texcoords, sizeof(texcoords) / (2 * sizeof(GLfloat)));
+	}
+	//the thrusters (last 48 vertices) have no texture coordinates yet, they get (0,0)
+	//merge the duplicated corners into an index buffer and interleave positions with texcoords in one vbo
+	indexed_mesh_t ship_mesh = build_indexed_mesh(textureExamplePoints, 132, texcoords, sizeof(texcoords) / (2 * sizeof(GLfloat)));
+	print_mesh_stats("ship", 132, ship_mesh);
+	//positions go to 16 bits relative to the bounding box and texcoords to unorm16, see quantise_mesh
+	quantised_mesh_t ship_mesh_q = quantise_mesh(ship_mesh, mesh_position_format);
+	print_quantise_stats("ship", ship_mesh, ship_mesh_q);
+	GLuint vao5 = create_quantised_mesh_vao(ship_mesh_q);
 
 
 	int asteroid_vertice_count = 24;
@@ -739,218 +1479,16 @@ int main()
 
 	};
 
-	//create a vertex buffer object(vbo) to pass on our positions array to the GPU (Define vertex colours example)
-	GLuint asteroid_vbo = 0;
-	glGenBuffers(1, &asteroid_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, asteroid_vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(asteroidPoints), asteroidPoints, GL_STATIC_DRAW);
-
-	//create a vertex attribute object(VAO) so that we dont have to bind each vertex buffer object every time we draw a mesh.
-	//VAO remembers all the vertex buffers that you want and the memory layout of each one. 
-	//Set up the VAO once per mesh and bind it before every mesh you want to draw.
-	GLuint vao6 = 0;
-	glGenVertexArrays(1, &vao6);
-	glBindVertexArray(vao6);
-	glBindBuffer(GL_ARRAY_BUFFER, asteroid_vbo);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(0);
-
-
-
-	//skybox shader
-	//parse vertex shader from external file
-	std::string skybox_vertex_source = ParseShader("skybox_shader.vert");
-	const GLchar * skybox_vertex_shader = (const GLchar *)skybox_vertex_source.c_str();
-
-	//parse fragment shader from external file
-	std::string skybox_fragment_source = ParseShader("skybox_shader.frag");
-	const GLchar * skybox_fragment_shader = (const GLchar *)skybox_fragment_source.c_str();
-
-	//compile the vertex shader
-	GLuint sky_vs = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(sky_vs, 1, &skybox_vertex_shader, NULL);
-	glCompileShader(sky_vs);
-
-	//compile the framgent shader
-	GLuint sky_fs = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(sky_fs, 1, &skybox_fragment_shader, NULL);
-	glCompileShader(sky_fs);
-
-	//using both the compiled vertex shader and compiled framgent shader we create a single, executable GPU shader program
-	GLuint skybox_program = glCreateProgram();
-	glAttachShader(skybox_program, sky_fs);
-	glAttachShader(skybox_program, sky_vs);
-	glLinkProgram(skybox_program);
-
-
-
-	//FIRST SHADER PURPLE COLOUR
-	//parse vertex shader from external file
-	std::string vertex_source = ParseShader("test.vert");
-	const GLchar * vertex_shader = (const GLchar *)vertex_source.c_str();
-
-	//parse fragment shader from external file
-	std::string fragment_source = ParseShader("test.frag");
-	const GLchar * fragment_shader = (const GLchar *)fragment_source.c_str();
-
-	//compile the vertex shader
-	GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vs, 1, &vertex_shader, NULL);
-	glCompileShader(vs);
-
-	//compile the framgent shader
-	GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fs, 1, &fragment_shader, NULL);
-	glCompileShader(fs);
-
-	//using both the compiled vertex shader and compiled framgent shader we create a single, executable GPU shader program
-	GLuint shader_program_purple = glCreateProgram();
-	glAttachShader(shader_program_purple, fs);
-	glAttachShader(shader_program_purple, vs);
-	glLinkProgram(shader_program_purple);
-
-
-	//SECOND SHADER RED COLOUR
-	//parse vertex shader from external file
-	std::string vertex_source2 = ParseShader("test.vert");
-	const GLchar * vertex_shader2 = (const GLchar *)vertex_source2.c_str();
-
-	//parse fragment shader from external file
-	std::string fragment_source2 = ParseShader("test2.frag");
-	const GLchar * fragment_shader2 = (const GLchar *)fragment_source2.c_str();
-
-	//compile the vertex shader
-	GLuint vs2 = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vs2, 1, &vertex_shader2, NULL);
-	glCompileShader(vs2);
-
-	//compile the framgent shader
-	GLuint fs2 = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fs2, 1, &fragment_shader2, NULL);
-	glCompileShader(fs2);
-
-	//using both the compiled vertex shader and compiled fragment shader we create a single, executable GPU shader program
-	GLuint shader_program_red = glCreateProgram();
-	glAttachShader(shader_program_red, fs2);
-	glAttachShader(shader_program_red, vs2);
-	glLinkProgram(shader_program_red);
-
-
-	//THIRD SHADER BLUE COLOUR
-	//parse vertex shader from external file
-	std::string vertex_source3 = ParseShader("test.vert");
-	const GLchar * vertex_shader3 = (const GLchar *)vertex_source3.c_str();
-
-	//parse fragment shader from external file
-	std::string fragment_source3 = ParseShader("test3.frag");
-	const GLchar * fragment_shader3 = (const GLchar *)fragment_source3.c_str();
-
-	//compile the framgent shader
-	GLuint fs3 = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fs3, 1, &fragment_shader3, NULL);
-	glCompileShader(fs3);
-
-	//using both the compiled vertex shader and compiled fragment shader we create a single, executable GPU shader program
-	GLuint shader_program_blue = glCreateProgram();
-	glAttachShader(shader_program_blue, vs2);
-	glAttachShader(shader_program_blue, fs3);
-	glLinkProgram(shader_program_blue);
-
-	//Fourth SHADER vertex colour example
-	//parse vertex shader from external file
-	std::string vertex_source4 = ParseShader("vertexColoursExample.vert");
-	const GLchar * vertex_shader4 = (const GLchar *)vertex_source4.c_str();
-
-	//parse fragment shader from external file
-	std::string fragment_source4 = ParseShader("vertexColoursExample.frag");
-	const GLchar * fragment_shader4 = (const GLchar *)fragment_source4.c_str();
-
-	//compile the vertex shader
-	GLuint vs4 = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vs4, 1, &vertex_shader4, NULL);
-	glCompileShader(vs4);
-
-	//compile the fragment shader
-	GLuint fs4 = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fs4, 1, &fragment_shader4, NULL);
-	glCompileShader(fs4);
-
-	//using both the compiled vertex shader and compiled fragment shader we create a single, executable GPU shader program
-	GLuint shader_program_VertexColourExample = glCreateProgram();
-	glAttachShader(shader_program_VertexColourExample, vs4);
-	glAttachShader(shader_program_VertexColourExample, fs4);
-	glLinkProgram(shader_program_VertexColourExample);
-
-	//set matrix to uniform matrix in shader
-	int matrix_location = glGetUniformLocation(shader_program_VertexColourExample,"matrix");
-	glUseProgram(shader_program_VertexColourExample);
-	glUniformMatrix4fv(matrix_location, 1, GL_FALSE, matrix);
-
-
-	//Fifth SHADER ship texture
-	//parse vertex shader from external file
-	std::string vertex_source5 = ParseShader("ship_shader.vert");
-	const GLchar * vertex_shader5 = (const GLchar *)vertex_source5.c_str();
-
-	//parse fragment shader from external file
-	std::string fragment_source5 = ParseShader("ship_shader.frag");
-	const GLchar * fragment_shader5 = (const GLchar *)fragment_source5.c_str();
-
-	//compile the vertex shader
-	GLuint vs5 = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vs5, 1, &vertex_shader5, NULL);
-	glCompileShader(vs5);
-
-	//compile the fragment shader
-	GLuint fs5 = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fs5, 1, &fragment_shader5, NULL);
-	glCompileShader(fs5);
-
-	//using both the compiled vertex shader and compiled fragment shader we create a single, executable GPU shader program
-	GLuint shader_program_ship = glCreateProgram();
-	glAttachShader(shader_program_ship, vs5);
-	glAttachShader(shader_program_ship, fs5);
-	glLinkProgram(shader_program_ship);
-
-	//set matrix to uniform matrix in shader
-	glUseProgram(shader_program_ship);
-	int matrix_location2 = glGetUniformLocation(shader_program_ship, "matrix");
-
-	glUniformMatrix4fv(matrix_location2, 1, GL_FALSE, matrix2);
-
-
-	//sixth SHADER asteroid
-	//parse vertex shader from external file
-	std::string vertex_source6 = ParseShader("asteroid.vert");
-	const GLchar * vertex_shader6 = (const GLchar *)vertex_source6.c_str();
-
-	//parse fragment shader from external file
-	std::string fragment_source6 = ParseShader("test.frag");
-	const GLchar * fragment_shader6 = (const GLchar *)fragment_source6.c_str();
-
-	//compile the vertex shader
-	GLuint vs6 = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vs6, 1, &vertex_shader6, NULL);
-	glCompileShader(vs6);
-
-	//compile the fragment shader
-	GLuint fs6 = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fs6, 1, &fragment_shader6, NULL);
-	glCompileShader(fs6);
-
-	//using both the compiled vertex shader and compiled fragment shader we create a single, executable GPU shader program
-	GLuint shader_program_asteroid = glCreateProgram();
-	glAttachShader(shader_program_asteroid, vs6);
-	glAttachShader(shader_program_asteroid, fs6);
-	glLinkProgram(shader_program_asteroid);
-
-	//set matrix to uniform matrix in shader
-	glUseProgram(shader_program_asteroid);
-	int matrix_location3 = glGetUniformLocation(shader_program_asteroid, "matrix");
-	glUniformMatrix4fv(matrix_location3, 1, GL_FALSE, matrix3);
+	indexed_mesh_t asteroid_mesh = build_indexed_mesh(asteroidPoints, asteroid_vertice_count, NULL, 0);
+	print_mesh_stats("asteroid", asteroid_vertice_count, asteroid_mesh);
+	quantised_mesh_t asteroid_mesh_q = quantise_mesh(asteroid_mesh, mesh_position_format);
+	print_quantise_stats("asteroid", asteroid_mesh, asteroid_mesh_q);
+	GLuint vao6 = create_quantised_mesh_vao(asteroid_mesh_q);
 
 
 
+	//pick up any programs the driver already finished while the meshes were built
+	shader_library_poll(&shader_library);
 
 	//sets clear color to grey
 	glClearColor(0.5, 0.5, 0.5, 1.0);
@@ -1048,7 +1586,7 @@ int main()
 	//creating perspective view
 	float near = 0.1f; //near clipping plane distance
 	float far = 300.0f; //far clipping plane distance
-	float fov = 67.0f * ONE_DEG_IN_RAD; // 67 is a good default for fov, then convert degree to rad
+	float fov = camera_fov; // 67 degrees is a good default for fov
 	float aspect = (float)vmode->width / (float)vmode->height;
 		
 	float range = tan(fov * 0.5f) * near;
@@ -1061,228 +1599,95 @@ int main()
 	mat4 proj_mat_ray = mat4( Sx, 0.0f, 0.0f,  0.0f, 0.0f,   Sy, 0.0f,  0.0f, 0.0f, 0.0f,   Sz, -1.0f, 0.0f, 0.0f,   Pz,  0.0f);
 
 
-	//loading in a texture
-	int img_x, img_y, img_n;
-	int force_channels = 4;
-	unsigned char* image_data = stbi_load(RELPATH"spaceship_texture_map.jpg",&img_x, &img_y, &img_n,force_channels);
-	if (!image_data)
-	{
-		printf("Error:image not found!!!");
-	}
+	shader_library_poll(&shader_library);
 
-	//swapping the image right side up
-	int width_in_bytes = img_x * 4;
-	unsigned char *top = NULL;
-	unsigned char *bottom = NULL;
-	unsigned char temp = 0;
-	int half_height = img_y / 2;
-
-	for (int row = 0; row < half_height;row++)
+	//everything from here on needs the shader programs, wait for whatever the driver hasn't finished
 	{
-		top = image_data + row * width_in_bytes;
-		bottom = image_data + (img_y - row - 1) * width_in_bytes;
-		for (int col = 0; col < width_in_bytes;col++)
-		{
-			temp = *top;
-			*top = *bottom;
-			*bottom = temp;
-			top++;
-			bottom++;
-		}
+		PROFILE_ZONE("shader finish");
+		shader_library_finish(&shader_library);
 	}
+	shader_library_print_stats(&shader_library);
+
+	//uniform locations, and the uniforms only set once, have to be looked up again after a shader
+	//hot-reload relinks a program, so that all happens here and is re-run on every reload
+	int matrix_location, matrix_location2, matrix_location3, ship_tex_loc, tex_loc;
+	int ship_view_matrix_location, ship_projection_matrix_location;
+	int asteroid_view_matrix_location, asteroid_projection_matrix_location;
+	int view_matrix_location, projection_matrix_location;
+	int skybox_inv_proj_view_location;
+	auto resolve_shader_uniforms = [&]()
+	{
+		//set matrix to uniform matrix in shader
+		matrix_location = glGetUniformLocation(shader_program_VertexColourExample,"matrix");
+		glUseProgram(shader_program_VertexColourExample);
+		glUniformMatrix4fv(matrix_location, 1, GL_FALSE, matrix);
 
-	//copying image data into OpenGL texture
-	//***note we are aleardy using gl_texture0 for our skybox so we use gl_texture1 here i believe***
-	//we need to manually swap our active textures in and out
-	GLuint tex = 0;
-	glGenTextures(1, &tex);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, tex);
-	//specify a two-dimensional texture image
-	glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,img_x,img_y,0,GL_RGBA,GL_UNSIGNED_BYTE,image_data);
-	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-
-	//set our texture uniform in the ship shader
-	int ship_tex_loc = glGetUniformLocation(shader_program_ship, "basic_texture");
-	glUseProgram(shader_program_ship);
-	glUniform1i(ship_tex_loc,1);
-
-
-
-
-	//create texture coordinates
-
-	GLfloat texcoords[] = {
-		//top side
-		//3 squares
-		0.0f,1.0f,
-		0.0f,0.0f,
-		0.333f,0.0f,
-
-		0.333f,0.0f,
-		0.333f,1.0f,
-		0.0f,1.0f,
-
-		0.0f,1.0f,
-		0.0f,0.0f,
-		0.333f,0.0f,
-
-		0.333f,0.0f,
-		0.333f,1.0f,
-		0.0f,1.0f,
-
-		0.0f,1.0f,
-		0.0f,0.0f,
-		0.333f,0.0f,
-
-		0.333f,0.0f,
-		0.333f,1.0f,
-		0.0f,1.0f,
-		//3 rectangles (front window)
-		0.0f,1.0f,
-		0.0f,0.0f,
-		0.333f,0.0f,
-
-		0.333f,0.0f,
-		0.333f,1.0f,
-		0.0f,1.0f,
 
-		0.0f,1.0f,
-		0.0f,0.0f,
-		0.333f,0.0f,
+		//set matrix to uniform matrix in shader
+		glUseProgram(shader_program_ship);
+		matrix_location2 = glGetUniformLocation(shader_program_ship, "matrix");
 
-		0.333f,0.0f,
-		0.333f,1.0f,
-		0.0f,1.0f,
+		set_model_matrix(matrix_location2, matrix2, ship_mesh_q.dequantise);
 
-		0.7f,1.0f,
-		0.7f,0.0f,
-		1.0f,0.0f,
 
-		1.0f,0.0f,
-		1.0f,1.0f,
-		0.7f,1.0f,
-		//top long side
-		0.0f,0.5f,
-		0.0f,0.0f,
-		0.333f,0.0f,
+		//set matrix to uniform matrix in shader
+		glUseProgram(shader_program_asteroid);
+		matrix_location3 = glGetUniformLocation(shader_program_asteroid, "matrix");
+		set_model_matrix(matrix_location3, matrix3, asteroid_mesh_q.dequantise);
 
-		0.333f,0.0f,
-		0.333f,1.0f,
-		0.0f,1.0f,
-		//top side fillers
-		0.0f,1.0f,
-		0.0f,0.0f,
-		0.333f,0.0f,
 
-		0.333f,0.0f,
-		0.333f,1.0f,
-		0.0f,1.0f,
-		//back side
-		0.0f,1.0f,
-		0.0f,0.0f,
-		0.333f,0.0f,
+		//set our texture uniform in the ship shader
+		ship_tex_loc = glGetUniformLocation(shader_program_ship, "basic_texture");
+		glUseProgram(shader_program_ship);
+		glUniform1i(ship_tex_loc,1);
 
-		0.333f,0.0f,
-		0.333f,1.0f,
-		0.0f,1.0f,
 
-		0.0f,1.0f,
-		0.0f,0.0f,
-		0.333f,0.0f,
+		//intialize the values of our projection and view matrices in the ship vertex shader
+		ship_view_matrix_location = glGetUniformLocation(shader_program_ship, "view");
+		glUseProgram(shader_program_ship);
+		glUniformMatrix4fv(ship_view_matrix_location, 1, GL_FALSE, view_mat.m);
+		ship_projection_matrix_location = glGetUniformLocation(shader_program_ship, "proj");
+		glUseProgram(shader_program_ship);
+		glUniformMatrix4fv(ship_projection_matrix_location, 1, GL_FALSE, proj_mat);
 
-		0.333f,0.0f,
-		0.333f,1.0f,
-		0.0f,1.0f,
-		//bottom side
-		0.0f,1.0f,
-		0.0f,0.0f,
-		0.333f,0.0f,
+		//intialize the values of our projection and view matrices in the asteroid vertex shader
+		asteroid_view_matrix_location = glGetUniformLocation(shader_program_asteroid, "view");
+		glUseProgram(shader_program_asteroid);
+		glUniformMatrix4fv(asteroid_view_matrix_location, 1, GL_FALSE, view_mat.m);
+		asteroid_projection_matrix_location = glGetUniformLocation(shader_program_asteroid, "proj");
+		glUseProgram(shader_program_asteroid);
+		glUniformMatrix4fv(asteroid_projection_matrix_location, 1, GL_FALSE, proj_mat);
 
-		0.333f,0.0f,
-		0.333f,1.0f,
-		0.0f,1.0f,
-		//front
-		0.0f,1.0f,
-		0.0f,0.0f,
-		0.333f,0.0f,
 
-		0.333f,0.0f,
-		0.333f,1.0f,
-		0.0f,1.0f,
-		//left side
-		0.0f,1.0f,
-		0.0f,0.0f,
-		0.333f,0.0f,
+		//intialize the values of our projection and view matrices in the entity vertex shader
+		view_matrix_location = glGetUniformLocation(shader_program_VertexColourExample, "view");
+		glUseProgram(shader_program_VertexColourExample);
+		glUniformMatrix4fv(view_matrix_location, 1, GL_FALSE, view_mat.m);
+		projection_matrix_location = glGetUniformLocation(shader_program_VertexColourExample, "proj");
+		glUseProgram(shader_program_VertexColourExample);
+		glUniformMatrix4fv(projection_matrix_location, 1, GL_FALSE, proj_mat);
 
-		0.333f,0.0f,
-		0.333f,1.0f,
-		0.0f,1.0f,
-		//right side
-		0.0f, 1.0f,
-		0.0f, 0.0f,
-		0.333f, 0.0f,
+		//intialize the inverse view-projection matrix in the skybox vertex shader
+		skybox_inv_proj_view_location = glGetUniformLocation(skybox_program, "inv_proj_view");
+		glUseProgram(skybox_program);
+		set_skybox_inverse_view_proj(skybox_inv_proj_view_location, proj_mat_ray, view_mat);
 
-		0.333f, 0.0f,
-		0.333f, 1.0f,
-		0.0f, 1.0f
-		//thrusters
+		//texture unit of the cube map, set again every frame before drawing the skybox
+		tex_loc = glGetUniformLocation(skybox_program, "cube_texture");
 	};
-
-	GLuint vt_vbo;
-	glGenBuffers(1,&vt_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vt_vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(texcoords), texcoords, GL_STATIC_DRAW);
-
-	//update the ship vao
-	glBindVertexArray(vao5);
-	glBindBuffer(GL_ARRAY_BUFFER, vt_vbo);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(1);
-
-
-
-
-	//intialize the values of our projection and view matrices in the ship vertex shader
-	int ship_view_matrix_location = glGetUniformLocation(shader_program_ship, "view");
-	glUseProgram(shader_program_ship);
-	glUniformMatrix4fv(ship_view_matrix_location, 1, GL_FALSE, view_mat.m);
-	int ship_projection_matrix_location = glGetUniformLocation(shader_program_ship, "proj");
-	glUseProgram(shader_program_ship);
-	glUniformMatrix4fv(ship_projection_matrix_location, 1, GL_FALSE, proj_mat);
-
-	//intialize the values of our projection and view matrices in the asteroid vertex shader
-	int asteroid_view_matrix_location = glGetUniformLocation(shader_program_asteroid, "view");
-	glUseProgram(shader_program_asteroid);
-	glUniformMatrix4fv(asteroid_view_matrix_location, 1, GL_FALSE, view_mat.m);
-	int asteroid_projection_matrix_location = glGetUniformLocation(shader_program_asteroid, "proj");
-	glUseProgram(shader_program_asteroid);
-	glUniformMatrix4fv(asteroid_projection_matrix_location, 1, GL_FALSE, proj_mat);
-
-
-
-
-
-
-	//intialize the values of our projection and view matrices in the entity vertex shader
-	int view_matrix_location = glGetUniformLocation(shader_program_VertexColourExample, "view");
-	glUseProgram(shader_program_VertexColourExample);
-	glUniformMatrix4fv(view_matrix_location, 1, GL_FALSE, view_mat.m);
-	int projection_matrix_location = glGetUniformLocation(shader_program_VertexColourExample, "proj");
-	glUseProgram(shader_program_VertexColourExample);
-	glUniformMatrix4fv(projection_matrix_location, 1, GL_FALSE, proj_mat);
-
-	//intialize the values of our projection and view matrices in the skybox vertex shader
-	int skybox_view_matrix_location = glGetUniformLocation(skybox_program, "view");
-	glUseProgram(skybox_program);
-	glUniformMatrix4fv(skybox_view_matrix_location, 1, GL_FALSE, view_mat.m);
-	int skybox_projection_matrix_location = glGetUniformLocation(skybox_program, "proj");
-	glUseProgram(skybox_program);
-	glUniformMatrix4fv(skybox_projection_matrix_location, 1, GL_FALSE, proj_mat);
+	resolve_shader_uniforms();
+
+	//watch every shader file so edits show up while the game runs, without reloading the skybox.
+	//embedded shaders have no files, so this only does something with --shaders-from-disk
+	file_watcher_t shader_watcher;
+	file_watcher_init(&shader_watcher);
+	std::vector<std::string> shader_files;
+	shader_library_list_source_files(&shader_library, shader_files);
+	for (size_t i = 0; i < shader_files.size(); i++)
+	{
+		file_watcher_add(&shader_watcher, shader_files[i].c_str());
+	}
+	std::vector<std::string> changed_shader_files;
 	
 
 	float speed = 1.0f; //move at 1 unit per second
@@ -1303,12 +1708,6 @@ int main()
 	bool has_turning_upgrade = false;
 	bool is_speed_boost_active = false;
 
-	GLuint skybox = 0;
-
-	create_cube_map(RELPATH"bkg1_back6.png", RELPATH"bkg1_front5.png", RELPATH"bkg1_top3.png", RELPATH"bkg1_bottom4.png", RELPATH"bkg1_left2.png", RELPATH"bkg1_right1.png",&skybox);
-
-	int tex_loc = glGetUniformLocation(skybox_program, "cube_texture");
-
 	glfwSetKeyCallback(window, key_callback);
 
 	int enemiesLeft = 10;
@@ -1323,19 +1722,57 @@ int main()
 	//#define SHOP      2
 
 	//drawing loop
+	bool first_frame_logged = false;
 	while (!glfwWindowShouldClose(window))
 	{
+		//in just-in-time mode this waits so input gets sampled as late as the frame allows
+		frame_pacer_begin_frame(&pacer);
+		texture_streamer_update(&texture_streamer);
+		bool swapped = false;
+
+		//relink only the programs using shader files that were saved since the last frame
+		if (file_watcher_poll(&shader_watcher, changed_shader_files) > 0)
+		{
+			PROFILE_ZONE("shader reload");
+			int relinked = 0;
+			for (size_t i = 0; i < changed_shader_files.size(); i++)
+			{
+				relinked += shader_library_reload_file(&shader_library, changed_shader_files[i].c_str());
+			}
+			if (relinked > 0)
+			{
+				resolve_shader_uniforms();
+			}
+			//an edit may have added an #include
+			shader_library_list_source_files(&shader_library, shader_files);
+			for (size_t i = 0; i < shader_files.size(); i++)
+			{
+				file_watcher_add(&shader_watcher, shader_files[i].c_str());
+			}
+		}
+
 		switch (gamestate)
 		{
 			case STARTMENU:
 			{
 				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 				glfwPollEvents();
+				frame_pacer_mark_input(&pacer);
+				frame_pacer_mark_submit(&pacer);
 				glfwSwapBuffers(window);
+				swapped = true;
 				break;
 			}
 			case GAMEPLAY:
 			{
+				PROFILE_ZONE("gameplay frame");
+				gpu_timer_begin_frame(&gpu_timer);
+
+				//update other events like the input handling
+				//(done first so the frame is built from the freshest input rather than last frame's)
+				glfwPollEvents();
+				frame_pacer_mark_input(&pacer);
+
 				//resets mouse position to center of screen and checks for mouse movement
 				if (mouseXDisplacement != 0.0 || mouseYDisplacement != 0.0)
 				{
@@ -1681,6 +2118,7 @@ int main()
 				//if (cam_moved)
 				if (1)
 				{
+					PROFILE_ZONE("camera update");
 
 
 
@@ -1808,23 +2246,13 @@ int main()
 
 					//pass in updated values to skybox vertex shader
 					glUseProgram(skybox_program);
-					glUniformMatrix4fv(skybox_view_matrix_location, 1, GL_FALSE, view_mat.m);
+					set_skybox_inverse_view_proj(skybox_inv_proj_view_location, proj_mat_ray, view_mat);
 
 
 				}
 
 				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-				
-				glDepthMask(GL_FALSE);
-				glUseProgram(skybox_program);
-				glUniform1i(tex_loc, 0);
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_CUBE_MAP, skybox);
-				glBindVertexArray(vao_sky);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-				glDepthMask(GL_TRUE);
-
 
 
 				//updates the x component of the matrix in this case the 12th array position
@@ -1844,21 +2272,11 @@ int main()
 				//wipe the drawing surface clear	
 
 
-				//glUseProgram(shader_program_purple);
-				//glBindVertexArray(vao);
-				////draw points 0-3 from the currently bound VAO with current in-use shader
-				//glDrawArrays(GL_TRIANGLES, 0, 6);
-
 				//glUseProgram(shader_program_red);
 				//glBindVertexArray(vao2);
 				////draw points 0-3 from the currently bound VAO with current in-use shader
 				//glDrawArrays(GL_TRIANGLES, 0, 3);
 
-				//glUseProgram(shader_program_blue);
-				//glBindVertexArray(vao3);
-				////draw points 0-3 from the currently bound VAO with current in-use shader
-				//glDrawArrays(GL_TRIANGLES, 0, 3);
-
 			//	glUseProgram(shader_program_VertexColourExample);
 				//glBindVertexArray(vao4);
 				//glDrawArrays(GL_TRIANGLES, 0, 12);
@@ -1867,8 +2285,14 @@ int main()
 				//matrix2[13] = enemy_ship_y;
 				//matrix2[14] = enemy_ship_z;
 
+				//how big things are drawn decides how fine a mip level the streamer brings in for them
+				int framebuffer_width = 0, framebuffer_height = 0;
+				glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+				float focal_pixels = framebuffer_height / (2.0f * tan(fov * 0.5f));
+
+				gpu_timer_begin(&gpu_timer, "ships");
 				glUseProgram(shader_program_ship);
-				glUniformMatrix4fv(matrix_location2, 1, GL_FALSE, matrix2);
+				set_model_matrix(matrix_location2, matrix2, ship_mesh_q.dequantise);
 				glBindVertexArray(vao5);
 				//glDrawArrays(GL_TRIANGLES, 0, 132);
 
@@ -1884,43 +2308,97 @@ int main()
 					matrix2[13] = enemies[i].y;
 					matrix2[14] = enemies[i].z;
 
-					glUniformMatrix4fv(matrix_location2, 1, GL_FALSE, matrix2);
+					set_model_matrix(matrix_location2, matrix2, ship_mesh_q.dequantise);
 					glBindVertexArray(vao5);
-					glDrawArrays(GL_TRIANGLES, 0, 132);
+					glDrawElements(GL_TRIANGLES, (GLsizei)ship_mesh_q.indices.size(), GL_UNSIGNED_SHORT, NULL);
+				}
+				//the hull texture wraps all the way round, so about twice the nearest ship's diameter on screen
+				if (enemiesLeft > 0)
+				{
+					float ship_pixels = 0.0f;
+					for (int i = 0; i < enemiesLeft; i++)
+					{
+						float distance = length(cam_pos - vec3(enemies[i].x, enemies[i].y, enemies[i].z));
+						ship_pixels = std::max(ship_pixels, 4.0f * sphere_radius * focal_pixels / std::max(distance, sphere_radius));
+					}
+					texture_streamer_touch(&texture_streamer, ship_texture, ship_pixels);
 				}
+				gpu_timer_end(&gpu_timer);
 
 
 				//draw asteroids here
+				gpu_timer_begin(&gpu_timer, "asteroid");
 				glUseProgram(shader_program_asteroid);
-				glUniformMatrix4fv(matrix_location3, 1, GL_FALSE, matrix3);
+				set_model_matrix(matrix_location3, matrix3, asteroid_mesh_q.dequantise);
 				glBindVertexArray(vao6);
-				glDrawArrays(GL_TRIANGLES, 0, asteroid_vertice_count);
+				glDrawElements(GL_TRIANGLES, (GLsizei)asteroid_mesh_q.indices.size(), GL_UNSIGNED_SHORT, NULL);
+				gpu_timer_end(&gpu_timer);
 
 
 
 				if (is_firing)
 				{
+					gpu_timer_begin(&gpu_timer, "laser");
 					glUseProgram(shader_program_red);
 					glBindVertexArray(vao3);
 					glDrawArrays(GL_TRIANGLES, 0, 3);
+					gpu_timer_end(&gpu_timer);
 					is_firing = false;
 				}
 
+				//skybox goes last: it sits on the far plane, so with GL_LEQUAL early-z throws away every pixel
+				//that a ship or asteroid already covered and only the visible background gets shaded
+				gpu_timer_begin(&gpu_timer, "skybox");
+				glDepthFunc(GL_LEQUAL);
+				glDepthMask(GL_FALSE);
+				glUseProgram(skybox_program);
+				glUniform1i(tex_loc, 0);
+				//a resized window may want another tier, the skybox that isn't shown is re-tiered when it's next shown
+				skybox_set_t* shown_set = use_second_skybox ? &second_skybox : &skybox;
+				if (!shown_set->texture || (framebuffer_height > 0 && shown_set->framebuffer_height != framebuffer_height))
+				{
+					retier_skybox(&texture_streamer, shown_set, framebuffer_height, space_colour);
+				}
+				streamed_texture_t* shown_skybox = skybox_texture(&texture_streamer, shown_set, space_colour);
+				//a cube face spans 90 degrees of view
+				texture_streamer_touch(&texture_streamer, shown_skybox, 2.0f * focal_pixels);
+				if (shown_set->next)
+				{
+					texture_streamer_touch(&texture_streamer, shown_set->next, 2.0f * focal_pixels);
+				}
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_CUBE_MAP, streamed_texture_name(shown_skybox));
+				glBindVertexArray(vao_sky);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+				glDepthMask(GL_TRUE);
+				glDepthFunc(GL_LESS);
+				gpu_timer_end(&gpu_timer);
+
 				if (enemiesLeft == 0)
 				{
 					wave_number++;
+					//the next wave's nebula, made when the first skybox is next drawn
+					if (!skybox.faces)
+					{
+						skybox.seed = nebula_seed + wave_number - 1;
+						skybox.framebuffer_height = 0;
+					}
 					cam_pos = { 0.0f, 0.0f, 2.0f };
 					gamestate = SHOP;
 				}
 
-				//update other events like the input handling
-				glfwPollEvents();
 				//put the stuff we've been drawing onto the display
-				glfwSwapBuffers(window);
+				{
+					PROFILE_ZONE("swap");
+					frame_pacer_mark_submit(&pacer);
+					glfwSwapBuffers(window);
+				}
+				swapped = true;
 				break;
 			}
 			case SHOP:
 			{
+				PROFILE_ZONE("shop frame");
 				system("cls");
 				printf("Wave cleared! You are now on wave %d.\n", wave_number);
 				printf("Welcome to the shop!\n");
@@ -1971,11 +2449,57 @@ int main()
 				break;
 			}
 		}	
+
+		//records input latency and, when capped (or for the shop, which never swaps), waits out the frame
+		frame_pacer_end_frame(&pacer, swapped);
+		if (swapped && !first_frame_logged)
+		{
+			gl_log("first frame presented %.1f ms after start\n", glfwGetTime() * 1000.0);
+			first_frame_logged = true;
+		}
+	}
+	frame_pacer_shutdown(&pacer);
+
+	residency_stats_t residency = residency_stats(&texture_streamer.residency);
+	gl_log("\ntextures: %i, %.1f MB resident of a %.0f MB budget (%.1f MB with nothing evicted, peak %.1f MB)\n",
+		residency.textures, residency.resident_bytes / (1024.0 * 1024.0), residency.budget / (1024.0 * 1024.0),
+		residency.full_bytes / (1024.0 * 1024.0), residency.peak_bytes / (1024.0 * 1024.0));
+	gl_log("texture evictions: %llu (%.1f MB freed), %llu times levels came back, %i below their finest level now (%i at placeholders), %llu frames over budget\n",
+		residency.evictions, residency.evicted_bytes / (1024.0 * 1024.0), residency.restores, residency.evicted_textures,
+		residency.placeholder_textures, residency.over_budget_frames);
+
+	image_arena_stats_t arena = image_arena_stats();
+	gl_log("image decoding: %llu allocations from arenas (%llu grown in place), %llu from the heap, arenas peaked at %.1f MB\n",
+		arena.arena_allocations, arena.grown_in_place, arena.heap_allocations, arena.peak_bytes / (1024.0 * 1024.0));
+
+	if (texture_cache_on)
+	{
+		texture_cache_stats_t cache = texture_cache_stats(&texture_cache);
+		gl_log("texture cache: %llu hits (%.1f MB not decoded), %llu misses, %llu stored, %llu trimmed, %i entries in %.1f MB\n",
+			cache.hits, cache.hit_bytes / (1024.0 * 1024.0), cache.misses, cache.stores, cache.trimmed, cache.entries,
+			cache.total_bytes / (1024.0 * 1024.0));
+		save_loose_hashes();
+	}
+
+	file_watcher_shutdown(&shader_watcher);
+	shader_library_destroy(&shader_library);
+	texture_streamer_destroy(&texture_streamer);
+	thread_pool_shutdown(&worker_pool);
+	if (asset_pack_loaded)
+	{
+		asset_pack_close(&asset_pack);
 	}
+	gpu_timer_destroy(&gpu_timer);
 
-	glDeleteProgram(shader_program_purple);
-	glDeleteProgram(shader_program_red);
-	glDeleteProgram(shader_program_blue);
+	//timings go to the log, the full trace can be opened in chrome://tracing or ui.perfetto.dev
+	gl_log("\nprofiler zone overhead: %.1f ns\n", profiler_measure_overhead());
+	FILE* log_file = fopen(GL_LOG_FILE, "a");
+	if (log_file)
+	{
+		profiler_write_summary(log_file);
+		fclose(log_file);
+	}
+	profiler_write_chrome_trace("profile_trace.json");
 
 	glfwTerminate();
 	return 0;
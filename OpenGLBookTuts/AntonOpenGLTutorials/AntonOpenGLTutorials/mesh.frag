@@ -0,0 +1,27 @@
+#version 410
+//fragment shader for everything but the skybox, see shaders.manifest
+//permutations: TEXTURED, VERTEX_COLOUR, FLAT_COLOUR=<vec4> for anything else
+
+#ifndef FLAT_COLOUR
+#define FLAT_COLOUR vec4(0.5, 0.5, 0.5, 1.0)
+#endif
+
+#ifdef TEXTURED
+in vec2 texture_coordinates;
+uniform sampler2D basic_texture;
+#endif
+#ifdef VERTEX_COLOUR
+in vec3 colour;
+#endif
+out vec4 frag_colour;
+
+void main()
+{
+#if defined(TEXTURED)
+	frag_colour = texture(basic_texture, texture_coordinates);
+#elif defined(VERTEX_COLOUR)
+	frag_colour = vec4(colour, 1.0);
+#else
+	frag_colour = FLAT_COLOUR;
+#endif
+}
@@ -0,0 +1,30 @@
+#version 410
+//vertex shader for the ship, asteroid and vertex coloured entity, see shaders.manifest
+//permutations: TEXTURED, VERTEX_COLOUR
+
+#if defined(TEXTURED) && defined(VERTEX_COLOUR)
+#error TEXTURED and VERTEX_COLOUR both use attribute location 1
+#endif
+
+#include "transform.glsl"
+
+layout(location = 0) in vec3 vertex_position;
+#ifdef TEXTURED
+layout(location = 1) in vec2 vt;
+out vec2 texture_coordinates;
+#endif
+#ifdef VERTEX_COLOUR
+layout(location = 1) in vec3 vertex_colour;
+out vec3 colour;
+#endif
+
+void main()
+{
+#ifdef TEXTURED
+	texture_coordinates = vt;
+#endif
+#ifdef VERTEX_COLOUR
+	colour = vertex_colour;
+#endif
+	gl_Position = transform_position(vertex_position);
+}
@@ -0,0 +1,392 @@
+#include "mesh_utils.h"
+#include "asset_hash.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+
+namespace {
+
+// hashes/compares a vertex by its raw float bits, which is all we need to
+// merge the duplicates that come out of a hand written triangle soup
+struct vertex_key_t {
+	const float *data;
+	int stride;
+};
+
+struct vertex_key_hash {
+	size_t operator()(const vertex_key_t &k) const {
+		return (size_t)asset_hash(k.data, k.stride * sizeof(float));
+	}
+};
+
+struct vertex_key_equal {
+	bool operator()(const vertex_key_t &a, const vertex_key_t &b) const {
+		return memcmp(a.data, b.data, a.stride * sizeof(float)) == 0;
+	}
+};
+
+} // namespace
+
+indexed_mesh_t build_indexed_mesh(const float *points, int point_count,
+	const float *texcoords, int texcoord_count) {
+	assert(point_count % 3 == 0);
+
+	indexed_mesh_t mesh;
+	mesh.has_texcoords = texcoords != NULL;
+	mesh.stride = mesh.has_texcoords ? 5 : 3;
+
+	// interleave the soup first so every vertex is one contiguous key
+	std::vector<float> soup(point_count * mesh.stride);
+	for (int i = 0; i < point_count; i++) {
+		float *v = &soup[i * mesh.stride];
+		v[0] = points[i * 3 + 0];
+		v[1] = points[i * 3 + 1];
+		v[2] = points[i * 3 + 2];
+		if (mesh.has_texcoords) {
+			bool in_range = i < texcoord_count;
+			v[3] = in_range ? texcoords[i * 2 + 0] : 0.0f;
+			v[4] = in_range ? texcoords[i * 2 + 1] : 0.0f;
+		}
+	}
+
+	std::unordered_map<vertex_key_t, unsigned short, vertex_key_hash,
+		vertex_key_equal> lookup;
+	mesh.indices.reserve(point_count);
+	for (int i = 0; i < point_count; i++) {
+		vertex_key_t key = { &soup[i * mesh.stride], mesh.stride };
+		auto found = lookup.find(key);
+		if (found != lookup.end()) {
+			mesh.indices.push_back(found->second);
+			continue;
+		}
+		assert(lookup.size() < 65536);
+		unsigned short index = (unsigned short)lookup.size();
+		lookup[key] = index;
+		mesh.vertices.insert(mesh.vertices.end(), key.data, key.data + mesh.stride);
+		mesh.indices.push_back(index);
+	}
+	mesh.vertex_count = (int)lookup.size();
+
+	// a triangle soup never reuses a vertex, so it misses once per vertex
+	mesh.acmr_before = 3.0f;
+	optimise_vertex_cache(mesh.indices, mesh.vertex_count, MESH_VERTEX_CACHE_SIZE);
+	optimise_vertex_fetch(mesh);
+	mesh.acmr_after = calc_acmr(mesh.indices.data(), (int)mesh.indices.size(),
+		mesh.vertex_count, MESH_VERTEX_CACHE_SIZE);
+	return mesh;
+}
+
+// Tipsify, from "Fast Triangle Reordering for Vertex Locality and Reduced
+// Overdraw" (Sander, Nehab, Barczak 2007). fans out around one vertex at a
+// time and picks the next fan vertex that is still likely to be in the cache
+void optimise_vertex_cache(std::vector<unsigned short> &indices, int vertex_count,
+	int cache_size) {
+	int triangle_count = (int)indices.size() / 3;
+	if (triangle_count == 0) {
+		return;
+	}
+
+	// vertex -> triangles adjacency, stored as offsets into one flat array
+	std::vector<int> live(vertex_count, 0);
+	for (size_t i = 0; i < indices.size(); i++) {
+		live[indices[i]]++;
+	}
+	std::vector<int> adjacency_offset(vertex_count + 1, 0);
+	for (int v = 0; v < vertex_count; v++) {
+		adjacency_offset[v + 1] = adjacency_offset[v] + live[v];
+	}
+	std::vector<int> adjacency(indices.size());
+	std::vector<int> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+	for (int t = 0; t < triangle_count; t++) {
+		for (int k = 0; k < 3; k++) {
+			adjacency[fill[indices[t * 3 + k]]++] = t;
+		}
+	}
+
+	std::vector<int> cache_time(vertex_count, 0);
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<int> dead_end;
+	std::vector<int> candidates;
+	std::vector<unsigned short> output;
+	output.reserve(indices.size());
+
+	int timestamp = cache_size + 1;
+	int cursor = 0;
+	int fan_vertex = indices[0];
+	while (fan_vertex >= 0) {
+		candidates.clear();
+		for (int a = adjacency_offset[fan_vertex]; a < adjacency_offset[fan_vertex + 1]; a++) {
+			int t = adjacency[a];
+			if (emitted[t]) {
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				int v = indices[t * 3 + k];
+				output.push_back((unsigned short)v);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (timestamp - cache_time[v] > cache_size) {
+					cache_time[v] = timestamp++;
+				}
+			}
+			emitted[t] = true;
+		}
+
+		// best candidate is the one that stays in the cache longest while still
+		// having triangles left to emit
+		int best = -1;
+		int best_priority = -1;
+		for (size_t c = 0; c < candidates.size(); c++) {
+			int v = candidates[c];
+			if (live[v] <= 0) {
+				continue;
+			}
+			int priority = 0;
+			if (timestamp - cache_time[v] + 2 * live[v] <= cache_size) {
+				priority = timestamp - cache_time[v];
+			}
+			if (priority > best_priority) {
+				best_priority = priority;
+				best = v;
+			}
+		}
+
+		// dead end: go back through recently used vertices, then scan forwards
+		if (best == -1) {
+			while (!dead_end.empty()) {
+				int v = dead_end.back();
+				dead_end.pop_back();
+				if (live[v] > 0) {
+					best = v;
+					break;
+				}
+			}
+		}
+		while (best == -1 && cursor < vertex_count) {
+			if (live[cursor] > 0) {
+				best = cursor;
+			}
+			cursor++;
+		}
+		fan_vertex = best;
+	}
+
+	assert(output.size() == indices.size());
+	indices.swap(output);
+}
+
+void optimise_vertex_fetch(indexed_mesh_t &mesh) {
+	std::vector<int> remap(mesh.vertex_count, -1);
+	std::vector<float> reordered(mesh.vertices.size());
+	int next = 0;
+	for (size_t i = 0; i < mesh.indices.size(); i++) {
+		int old_index = mesh.indices[i];
+		if (remap[old_index] < 0) {
+			remap[old_index] = next;
+			memcpy(&reordered[next * mesh.stride], &mesh.vertices[old_index * mesh.stride],
+				mesh.stride * sizeof(float));
+			next++;
+		}
+		mesh.indices[i] = (unsigned short)remap[old_index];
+	}
+	// vertices that no triangle references are dropped
+	reordered.resize(next * mesh.stride);
+	mesh.vertices.swap(reordered);
+	mesh.vertex_count = next;
+}
+
+float calc_acmr(const unsigned short *indices, int index_count, int vertex_count,
+	int cache_size) {
+	if (index_count < 3) {
+		return 0.0f;
+	}
+	// FIFO cache: a vertex is a hit if it entered less than cache_size misses ago
+	std::vector<int> entered_at(vertex_count, -cache_size - 1);
+	int misses = 0;
+	for (int i = 0; i < index_count; i++) {
+		int v = indices[i];
+		if (misses - entered_at[v] > cache_size) {
+			entered_at[v] = misses;
+			misses++;
+		}
+	}
+	return (float)misses / (float)(index_count / 3);
+}
+
+void print_mesh_stats(const char *name, int soup_vertex_count,
+	const indexed_mesh_t &mesh) {
+	printf("mesh %s: %i -> %i vertices, %i triangles, ACMR %.3f -> %.3f\n", name,
+		soup_vertex_count, mesh.vertex_count, (int)mesh.indices.size() / 3,
+		mesh.acmr_before, mesh.acmr_after);
+}
+
+// round-to-nearest-even float to half conversion, after F. Giesen's
+// float_to_half_fast3_rtne
+unsigned short float_to_half(float f) {
+	unsigned int x;
+	memcpy(&x, &f, sizeof(x));
+	unsigned short sign = (unsigned short)((x >> 16) & 0x8000);
+	x &= 0x7fffffff;
+
+	unsigned short h;
+	if (x >= 0x47800000) {
+		// too big for a half: infinity, or quiet NaN for NaN
+		h = (x > 0x7f800000) ? 0x7e00 : 0x7c00;
+	} else if (x < 0x38800000) {
+		// denormal half: let the FPU do the rounding by adding a magic number
+		unsigned int denorm_magic = ((127 - 15) + (23 - 10) + 1) << 23;
+		float magic, sum;
+		memcpy(&magic, &denorm_magic, sizeof(magic));
+		memcpy(&sum, &x, sizeof(sum));
+		sum += magic;
+		unsigned int bits;
+		memcpy(&bits, &sum, sizeof(bits));
+		h = (unsigned short)(bits - denorm_magic);
+	} else {
+		unsigned int mant_odd = (x >> 13) & 1;
+		x += ((unsigned int)(15 - 127) << 23) + 0xfff;
+		x += mant_odd;
+		h = (unsigned short)(x >> 13);
+	}
+	return h | sign;
+}
+
+float half_to_float(unsigned short h) {
+	unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+	unsigned int exponent = (h >> 10) & 0x1f;
+	unsigned int mantissa = h & 0x3ff;
+	unsigned int bits;
+	if (exponent == 0x1f) {
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	} else if (exponent == 0) {
+		// zero or denormal, value is mantissa * 2^-24
+		float value = (float)mantissa * (1.0f / 16777216.0f);
+		return sign ? -value : value;
+	} else {
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+namespace {
+
+short float_to_snorm16(float f) {
+	if (f > 1.0f) {
+		f = 1.0f;
+	} else if (f < -1.0f) {
+		f = -1.0f;
+	}
+	return (short)(f >= 0.0f ? f * 32767.0f + 0.5f : f * 32767.0f - 0.5f);
+}
+
+// GL 4.2+ conversion rule for normalised signed integers
+float snorm16_to_float(short s) {
+	float f = (float)s / 32767.0f;
+	return f < -1.0f ? -1.0f : f;
+}
+
+unsigned short float_to_unorm16(float f) {
+	if (f > 1.0f) {
+		f = 1.0f;
+	} else if (f < 0.0f) {
+		f = 0.0f;
+	}
+	return (unsigned short)(f * 65535.0f + 0.5f);
+}
+
+} // namespace
+
+quantised_mesh_t quantise_mesh(const indexed_mesh_t &mesh,
+	position_format_t position_format) {
+	quantised_mesh_t q;
+	q.position_format = position_format;
+	q.has_texcoords = mesh.has_texcoords;
+	q.vertex_count = mesh.vertex_count;
+	q.indices = mesh.indices;
+	int components = q.has_texcoords ? 6 : 4;
+	q.stride_bytes = components * (int)sizeof(unsigned short);
+
+	float bbox_min[3] = { 0.0f, 0.0f, 0.0f };
+	float bbox_max[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < mesh.vertex_count; i++) {
+		const float *v = &mesh.vertices[i * mesh.stride];
+		for (int k = 0; k < 3; k++) {
+			if (i == 0 || v[k] < bbox_min[k]) {
+				bbox_min[k] = v[k];
+			}
+			if (i == 0 || v[k] > bbox_max[k]) {
+				bbox_max[k] = v[k];
+			}
+		}
+	}
+	float centre[3], half_extent[3];
+	for (int k = 0; k < 3; k++) {
+		centre[k] = (bbox_min[k] + bbox_max[k]) * 0.5f;
+		half_extent[k] = (bbox_max[k] - bbox_min[k]) * 0.5f;
+		// flat axis: every vertex sits on the centre, any scale will do
+		if (half_extent[k] <= 0.0f) {
+			half_extent[k] = 1.0f;
+		}
+	}
+	memset(q.dequantise, 0, sizeof(q.dequantise));
+	q.dequantise[0] = half_extent[0];
+	q.dequantise[5] = half_extent[1];
+	q.dequantise[10] = half_extent[2];
+	q.dequantise[12] = centre[0];
+	q.dequantise[13] = centre[1];
+	q.dequantise[14] = centre[2];
+	q.dequantise[15] = 1.0f;
+
+	q.max_position_error = 0.0f;
+	q.max_texcoord_error = 0.0f;
+	q.vertices.resize(mesh.vertex_count * components);
+	for (int i = 0; i < mesh.vertex_count; i++) {
+		const float *v = &mesh.vertices[i * mesh.stride];
+		unsigned short *out = &q.vertices[i * components];
+		for (int k = 0; k < 3; k++) {
+			float normalised = (v[k] - centre[k]) / half_extent[k];
+			float decoded;
+			if (position_format == POSITION_FORMAT_HALF) {
+				out[k] = float_to_half(normalised);
+				decoded = half_to_float(out[k]);
+			} else {
+				short s = float_to_snorm16(normalised);
+				out[k] = (unsigned short)s;
+				decoded = snorm16_to_float(s);
+			}
+			float error = fabsf(decoded * half_extent[k] + centre[k] - v[k]);
+			if (error > q.max_position_error) {
+				q.max_position_error = error;
+			}
+		}
+		out[3] = 0;
+		if (q.has_texcoords) {
+			for (int k = 0; k < 2; k++) {
+				out[4 + k] = float_to_unorm16(v[3 + k]);
+				float error = fabsf((float)out[4 + k] / 65535.0f - v[3 + k]);
+				if (error > q.max_texcoord_error) {
+					q.max_texcoord_error = error;
+				}
+			}
+		}
+	}
+	return q;
+}
+
+void print_quantise_stats(const char *name, const indexed_mesh_t &mesh,
+	const quantised_mesh_t &quantised) {
+	printf("mesh %s: quantised to %s, %i -> %i bytes per vertex, max position "
+		"error %g", name,
+		quantised.position_format == POSITION_FORMAT_HALF ? "half" : "snorm16",
+		mesh.stride * (int)sizeof(float), quantised.stride_bytes,
+		quantised.max_position_error);
+	if (quantised.has_texcoords) {
+		printf(", max texcoord error %g", quantised.max_texcoord_error);
+	}
+	printf("\n");
+}
@@ -0,0 +1,83 @@
+#pragma once
+/******************************************************************************\
+| Mesh processing for the hard-coded triangle soups in main.cpp.               |
+| Takes a non-indexed list of positions (and optional texcoords), removes      |
+| duplicate vertices into an index buffer, reorders the triangles for the      |
+| post-transform vertex cache (Tipsify) and lays positions and texcoords out   |
+| interleaved in a single array so each mesh needs only one vertex buffer.     |
+| Indexed meshes can then be quantised to 16-bit vertex formats.               |
+| No OpenGL in here, uploading is left to the caller.                          |
+\******************************************************************************/
+#ifndef _MESH_UTILS_H_
+#define _MESH_UTILS_H_
+
+#include <vector>
+
+// size of the simulated FIFO cache used for optimising and for ACMR reports.
+// 16 is a conservative figure for the post-transform cache on most GPUs
+#define MESH_VERTEX_CACHE_SIZE 16
+
+struct indexed_mesh_t {
+	// interleaved vertex data, 'stride' floats per vertex (x,y,z[,s,t])
+	std::vector<float> vertices;
+	std::vector<unsigned short> indices;
+	int stride;
+	bool has_texcoords;
+	int vertex_count;
+	// average cache miss ratio (transformed vertices per triangle) of the
+	// original triangle soup and of the final index buffer
+	float acmr_before;
+	float acmr_after;
+};
+
+// builds an indexed, cache-optimised mesh from a triangle soup of
+// 'point_count' xyz positions. 'texcoords' may be NULL; if it holds fewer
+// than 'point_count' st pairs the remaining vertices get (0,0)
+indexed_mesh_t build_indexed_mesh(const float *points, int point_count,
+	const float *texcoords, int texcoord_count);
+
+// reorders triangles in-place to improve post-transform cache hits
+void optimise_vertex_cache(std::vector<unsigned short> &indices, int vertex_count,
+	int cache_size);
+// reorders vertices into first-use order so vertex fetches walk memory forwards
+void optimise_vertex_fetch(indexed_mesh_t &mesh);
+// average cache miss ratio of an index list through a FIFO cache of 'cache_size'
+float calc_acmr(const unsigned short *indices, int index_count, int vertex_count,
+	int cache_size);
+
+void print_mesh_stats(const char *name, int soup_vertex_count,
+	const indexed_mesh_t &mesh);
+
+// storage for quantised positions. both are relative to the mesh bounding box,
+// i.e. the box is mapped to [-1,1] and the dequantise matrix maps it back
+enum position_format_t {
+	POSITION_FORMAT_SNORM16, // GL_SHORT, normalised
+	POSITION_FORMAT_HALF     // GL_HALF_FLOAT
+};
+
+// vertex layout is 4 x 16-bit position (xyz + padding, keeps texcoords 4-byte
+// aligned) followed by 2 x unorm16 texcoords if the mesh has them
+struct quantised_mesh_t {
+	std::vector<unsigned short> vertices;
+	std::vector<unsigned short> indices;
+	position_format_t position_format;
+	bool has_texcoords;
+	int stride_bytes;
+	int vertex_count;
+	// column-major 4x4 matrix taking [-1,1] positions back to model space.
+	// post-multiply the model matrix with it
+	float dequantise[16];
+	// largest per-component error after decoding, in model units / uv units
+	float max_position_error;
+	float max_texcoord_error;
+};
+
+quantised_mesh_t quantise_mesh(const indexed_mesh_t &mesh,
+	position_format_t position_format);
+void print_quantise_stats(const char *name, const indexed_mesh_t &mesh,
+	const quantised_mesh_t &quantised);
+
+unsigned short float_to_half(float f);
+float half_to_float(unsigned short h);
+
+#endif
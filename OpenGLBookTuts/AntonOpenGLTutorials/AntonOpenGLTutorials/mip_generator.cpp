@@ -0,0 +1,254 @@
+#include "mip_generator.h"
+#include "image_arena.h"
+#include "image_ops.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_USE_SSE2 1
+#else
+#define MIP_USE_SSE2 0
+#endif
+
+namespace {
+
+const float pi = 3.14159265358979f;
+
+float sinc(float x) {
+	if (fabsf(x) < 1e-5f) {
+		return 1.0f;
+	}
+	x *= pi;
+	return sinf(x) / x;
+}
+
+// zeroth order modified Bessel function of the first kind, for the Kaiser window
+double bessel_i0(double x) {
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; k++) {
+		double half = x / (2.0 * k);
+		term *= half * half;
+		sum += term;
+		if (term < sum * 1e-12) {
+			break;
+		}
+	}
+	return sum;
+}
+
+// in destination pixels
+float filter_radius(mip_filter_t filter) {
+	return filter == MIP_FILTER_BOX ? 0.5f : 3.0f;
+}
+
+float filter_weight(mip_filter_t filter, float x) {
+	const float alpha = 4.0f;
+	float radius = filter_radius(filter);
+	if (fabsf(x) >= radius) {
+		return filter == MIP_FILTER_BOX && fabsf(x) == radius ? 0.5f : 0.0f;
+	}
+	switch (filter) {
+	case MIP_FILTER_KAISER: {
+		float r = x / radius;
+		return sinc(x) * (float)(bessel_i0(alpha * sqrt(1.0 - r * r)) / bessel_i0(alpha));
+	}
+	case MIP_FILTER_LANCZOS:
+		return sinc(x) * sinc(x / radius);
+	default:
+		return 1.0f;
+	}
+}
+
+// for each destination pixel, 'taps' source pixels (clamped to the edge) and their weights
+struct filter_table_t {
+	int taps;
+	std::vector<int> index;
+	std::vector<float> weight;
+};
+
+void build_table(int src, int dst, mip_filter_t filter, filter_table_t &table) {
+	float scale = (float)src / dst;
+	float radius = filter_radius(filter) * scale;
+	table.taps = (int)ceilf(radius * 2.0f) + 1;
+	table.index.resize((size_t)dst * table.taps);
+	table.weight.resize((size_t)dst * table.taps);
+	for (int d = 0; d < dst; d++) {
+		float center = (d + 0.5f) * scale; // pixel centres are at i + 0.5
+		int first = (int)floorf(center - radius);
+		float sum = 0.0f;
+		for (int k = 0; k < table.taps; k++) {
+			int i = first + k;
+			float w = filter_weight(filter, (i + 0.5f - center) / scale);
+			table.index[d * table.taps + k] = std::min(std::max(i, 0), src - 1);
+			table.weight[d * table.taps + k] = w;
+			sum += w;
+		}
+		for (int k = 0; k < table.taps; k++) {
+			table.weight[d * table.taps + k] /= sum;
+		}
+	}
+}
+
+// 'src' is w x h RGBA floats, 'dst' gets dw x h
+void resample_rows(const float *src, int w, int h, int dw, const filter_table_t &table, float *dst) {
+	for (int y = 0; y < h; y++) {
+		const float *row = src + (size_t)y * w * 4;
+		float *out = dst + (size_t)y * dw * 4;
+		for (int d = 0; d < dw; d++) {
+			const int *index = &table.index[d * table.taps];
+			const float *weight = &table.weight[d * table.taps];
+#if MIP_USE_SSE2
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < table.taps; k++) {
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weight[k]),
+					_mm_loadu_ps(row + index[k] * 4)));
+			}
+			_mm_storeu_ps(out + d * 4, sum);
+#else
+			float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+			for (int k = 0; k < table.taps; k++) {
+				for (int c = 0; c < 4; c++) {
+					sum[c] += weight[k] * row[index[k] * 4 + c];
+				}
+			}
+			memcpy(out + d * 4, sum, sizeof(sum));
+#endif
+		}
+	}
+}
+
+// 'src' is w x h RGBA floats, 'dst' gets w x dh. whole rows at a time, so the
+// source is read in order
+void resample_columns(const float *src, int w, int dh, const filter_table_t &table, float *dst) {
+	size_t row_floats = (size_t)w * 4;
+	for (int d = 0; d < dh; d++) {
+		float *out = dst + d * row_floats;
+		memset(out, 0, row_floats * sizeof(float));
+		for (int k = 0; k < table.taps; k++) {
+			float weight = table.weight[d * table.taps + k];
+			if (weight == 0.0f) {
+				continue;
+			}
+			const float *row = src + table.index[d * table.taps + k] * row_floats;
+			size_t x = 0;
+#if MIP_USE_SSE2
+			__m128 w4 = _mm_set1_ps(weight);
+			for (; x < row_floats; x += 4) {
+				_mm_storeu_ps(out + x,
+					_mm_add_ps(_mm_loadu_ps(out + x), _mm_mul_ps(w4, _mm_loadu_ps(row + x))));
+			}
+#endif
+			for (; x < row_floats; x++) {
+				out[x] += weight * row[x];
+			}
+		}
+	}
+}
+
+// floats to 'channels' bytes, the first three through the sRGB curve if 'srgb'
+void to_bytes(const float *src, size_t count, int channels, bool srgb, unsigned char *dst) {
+	if (srgb) {
+		image_linear_to_srgb(src, dst, count);
+	} else {
+		for (size_t i = 0; i < count * 4; i++) {
+			float v = std::min(std::max(src[i], 0.0f), 1.0f); // sinc lobes overshoot
+			dst[i] = (unsigned char)(v * 255.0f + 0.5f);
+		}
+	}
+	if (channels == 3) {
+		image_rgba_to_rgb(dst, dst, count);
+	}
+}
+
+} // namespace
+
+const char *mip_filter_name(mip_filter_t filter) {
+	switch (filter) {
+	case MIP_FILTER_BOX: return "box";
+	case MIP_FILTER_KAISER: return "kaiser";
+	case MIP_FILTER_LANCZOS: return "lanczos";
+	default: return "none";
+	}
+}
+
+bool mip_filter_from_name(const char *name, mip_filter_t *filter) {
+	const mip_filter_t filters[3] = {MIP_FILTER_BOX, MIP_FILTER_KAISER, MIP_FILTER_LANCZOS};
+	for (int i = 0; i < 3; i++) {
+		if (strcmp(name, mip_filter_name(filters[i])) == 0) {
+			*filter = filters[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+int mip_level_count(int w, int h) {
+	int levels = 1;
+	while (w > 1 || h > 1) {
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+		levels++;
+	}
+	return levels;
+}
+
+void generate_mips(const unsigned char *pixels, int w, int h, int channels, mip_filter_t filter,
+	bool srgb, std::vector<mip_level_t> &levels) {
+	levels.clear();
+	if (filter == MIP_FILTER_NONE || (w <= 1 && h <= 1)) {
+		return;
+	}
+	// all the scratch up front, sized for the first level: later ones only shrink
+	size_t count = (size_t)w * h;
+	size_t rows_count = (size_t)std::max(1, w / 2) * h;
+	size_t next_count = (size_t)std::max(1, w / 2) * std::max(1, h / 2);
+	unsigned char *rgba = channels == 3 ? (unsigned char *)image_malloc(count * 4) : NULL;
+	float *current = (float *)image_malloc(count * 4 * sizeof(float));
+	float *rows = (float *)image_malloc(rows_count * 4 * sizeof(float));
+	float *next = (float *)image_malloc(next_count * 4 * sizeof(float));
+	if ((channels == 3 && !rgba) || !current || !rows || !next) {
+		image_free(next);
+		image_free(rows);
+		image_free(current);
+		image_free(rgba);
+		return;
+	}
+	if (rgba) {
+		image_rgb_to_rgba(pixels, rgba, count, 255);
+		pixels = rgba;
+	}
+	if (srgb) {
+		image_srgb_to_linear(pixels, current, count);
+	} else {
+		for (size_t i = 0; i < count * 4; i++) {
+			current[i] = pixels[i] / 255.0f;
+		}
+	}
+	levels.resize(mip_level_count(w, h) - 1);
+	filter_table_t table;
+	for (size_t index = 0; index < levels.size(); index++) {
+		int dw = std::max(1, w / 2);
+		int dh = std::max(1, h / 2);
+		build_table(w, dw, filter, table);
+		resample_rows(current, w, h, dw, table, rows);
+		build_table(h, dh, filter, table);
+		resample_columns(rows, dw, dh, table, next);
+
+		// the row pass is done with, its buffer holds the bytes on their way out
+		unsigned char *bytes = (unsigned char *)rows;
+		to_bytes(next, (size_t)dw * dh, channels, srgb, bytes);
+		mip_level_t &level = levels[index];
+		level.width = dw;
+		level.height = dh;
+		level.pixels.assign(bytes, bytes + (size_t)dw * dh * channels);
+		// the next level comes from this one at full precision, not the rounded bytes
+		std::swap(current, next);
+		w = dw;
+		h = dh;
+	}
+	image_free(next);
+	image_free(rows);
+	image_free(current);
+	image_free(rgba);
+}
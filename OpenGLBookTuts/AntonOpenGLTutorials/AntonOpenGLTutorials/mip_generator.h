@@ -0,0 +1,51 @@
+#pragma once
+/******************************************************************************\
+| CPU mip chain generation, so textures don't depend on what the driver's      |
+| glGenerateMipmap does or costs.                                              |
+| Each level is resampled from the previous one at float precision with a      |
+| separable filter, rows then columns, edges clamped:                          |
+|   box      the 2x2 average, cheapest, a little blurry and aliasing           |
+|   kaiser   windowed sinc (Kaiser window, alpha 4, 3 lobes), sharp without    |
+|            much ringing, the default                                         |
+|   lanczos  Lanczos 3, sharpest, can ring around hard edges                   |
+| With 'srgb' the colour channels are filtered in linear light (alpha is       |
+| always linear), otherwise dark and bright texels average too dark.           |
+| RGB images are filtered as RGBA and the levels come back as RGB again, the   |
+| conversions (and the sRGB curve) are image_ops.h's. The filter loops work    |
+| on a whole RGBA pixel per SSE register where SSE2 is there (any x64 build).  |
+| The float scratch (about 28 bytes a source pixel, reused for every level)    |
+| comes from image_malloc, so inside an image_arena_begin/end scope, as the    |
+| decode workers call it, it's a pointer bump rather than the heap; only the   |
+| levels handed back are vectors of their own.                                 |
+| No OpenGL in here, the texture baker and the image decode workers both use   |
+| it.                                                                          |
+\******************************************************************************/
+#ifndef _MIP_GENERATOR_H_
+#define _MIP_GENERATOR_H_
+
+#include <vector>
+
+enum mip_filter_t {
+	MIP_FILTER_NONE, // level 0 only
+	MIP_FILTER_BOX,
+	MIP_FILTER_KAISER,
+	MIP_FILTER_LANCZOS
+};
+
+struct mip_level_t {
+	int width, height;
+	std::vector<unsigned char> pixels; // as many channels as the image
+};
+
+const char *mip_filter_name(mip_filter_t filter);
+// false if 'name' isn't box, kaiser or lanczos
+bool mip_filter_from_name(const char *name, mip_filter_t *filter);
+// levels in a full chain down to 1x1, each level half the last (rounded down)
+int mip_level_count(int w, int h);
+
+// levels 1 and below of 'pixels' (w x h, 'channels' 3 or 4) into 'levels',
+// so levels[0] is the half size one. nothing for MIP_FILTER_NONE
+void generate_mips(const unsigned char *pixels, int w, int h, int channels, mip_filter_t filter,
+	bool srgb, std::vector<mip_level_t> &levels);
+
+#endif
@@ -0,0 +1,452 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "procedural_sky.h"
+#include "image_ops.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PROCEDURAL_SKY_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+// MSVC compiles any intrinsic without a switch, the CPU check is what keeps them safe
+#define SSE2_FUNCTION
+#define AVX2_FUNCTION
+#else
+#define SSE2_FUNCTION __attribute__((target("sse2")))
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#else
+#define PROCEDURAL_SKY_X86 0
+#endif
+
+namespace {
+
+const char *const side_names[6] = {"front", "back", "top", "bottom", "left", "right"};
+// the GL cube side each face is uploaded to (0 +X, 1 -X, 2 +Y, 3 -Y, 4 +Z, 5 -Z),
+// texture_streamer.cpp's cube_sides
+const int gl_sides[6] = {5, 4, 2, 3, 1, 0};
+
+const unsigned PRIME_X = 0x8da6b343u;
+const unsigned PRIME_Y = 0xd8163841u;
+const unsigned PRIME_Z = 0xcb1ab31fu;
+const unsigned OCTAVE_SEED = 0x9e3779b9u;
+// not quite 2, so the lattices of the octaves never line up
+const float LACUNARITY = 2.02f;
+const float HASH_TO_FLOAT = 1.0f / 2147483648.0f;
+
+// lowbias32: every input bit changes about half the output bits
+unsigned mix(unsigned h) {
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return h;
+}
+
+float fade(float t) {
+	return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+float lerp(float a, float b, float t) {
+	return a + (b - a) * t;
+}
+
+// lattice value noise, -1..1. the SIMD kernels do the same operations in the
+// same order, so all three give the same sky
+float value_noise(float x, float y, float z, unsigned seed) {
+	float fx = floorf(x), fy = floorf(y), fz = floorf(z);
+	unsigned hx = (unsigned)(int)fx * PRIME_X;
+	unsigned hy = (unsigned)(int)fy * PRIME_Y;
+	unsigned hz = (unsigned)(int)fz * PRIME_Z;
+	float u = fade(x - fx), v = fade(y - fy), w = fade(z - fz);
+	float c[8];
+	for (int i = 0; i < 8; i++) {
+		unsigned h = (hx + (i & 1 ? PRIME_X : 0)) ^ (hy + (i & 2 ? PRIME_Y : 0)) ^
+			(hz + (i & 4 ? PRIME_Z : 0)) ^ seed;
+		c[i] = (float)(int)mix(h) * HASH_TO_FLOAT;
+	}
+	return lerp(lerp(lerp(c[0], c[1], u), lerp(c[2], c[3], u), v),
+		lerp(lerp(c[4], c[5], u), lerp(c[6], c[7], u), v), w);
+}
+
+// the sum the octaves are divided by, so fbm stays in -1..1
+float octave_total(int octaves) {
+	float total = 0.0f, amplitude = 1.0f;
+	for (int o = 0; o < octaves; o++) {
+		total += amplitude;
+		amplitude *= 0.5f;
+	}
+	return total;
+}
+
+void fbm_scalar(const float *x, const float *y, const float *z, size_t begin, size_t count,
+	float frequency, int octaves, unsigned seed, float *out) {
+	float total = octave_total(octaves);
+	for (size_t i = begin; i < count; i++) {
+		float sum = 0.0f, amplitude = 1.0f, f = frequency;
+		unsigned s = seed;
+		for (int o = 0; o < octaves; o++) {
+			sum = sum + amplitude * value_noise(x[i] * f, y[i] * f, z[i] * f, s);
+			amplitude *= 0.5f;
+			f *= LACUNARITY;
+			s += OCTAVE_SEED;
+		}
+		out[i] = sum / total;
+	}
+}
+
+#if PROCEDURAL_SKY_X86
+
+// SSE2 has no 32-bit multiply, it's made from two 32x32->64 ones
+SSE2_FUNCTION inline __m128i mullo_sse2(__m128i a, __m128i b) {
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+		_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+SSE2_FUNCTION inline __m128i mix_sse2(__m128i h) {
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+	h = mullo_sse2(h, _mm_set1_epi32((int)0x7feb352du));
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+	h = mullo_sse2(h, _mm_set1_epi32((int)0x846ca68bu));
+	return _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+}
+
+SSE2_FUNCTION inline __m128 fade_sse2(__m128 t) {
+	__m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)),
+		_mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+	return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+SSE2_FUNCTION inline __m128 lerp_sse2(__m128 a, __m128 b, __m128 t) {
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+// truncation rounds negative values up, one less where it did
+SSE2_FUNCTION inline __m128i floor_sse2(__m128 x) {
+	__m128i truncated = _mm_cvttps_epi32(x);
+	__m128 above = _mm_cmplt_ps(x, _mm_cvtepi32_ps(truncated));
+	return _mm_add_epi32(truncated, _mm_castps_si128(above));
+}
+
+SSE2_FUNCTION __m128 value_noise_sse2(__m128 x, __m128 y, __m128 z, __m128i seed) {
+	__m128i ix = floor_sse2(x), iy = floor_sse2(y), iz = floor_sse2(z);
+	__m128 u = fade_sse2(_mm_sub_ps(x, _mm_cvtepi32_ps(ix)));
+	__m128 v = fade_sse2(_mm_sub_ps(y, _mm_cvtepi32_ps(iy)));
+	__m128 w = fade_sse2(_mm_sub_ps(z, _mm_cvtepi32_ps(iz)));
+	__m128i px = _mm_set1_epi32((int)PRIME_X);
+	__m128i py = _mm_set1_epi32((int)PRIME_Y);
+	__m128i pz = _mm_set1_epi32((int)PRIME_Z);
+	__m128i hx[2], hy[2], hz[2];
+	hx[0] = mullo_sse2(ix, px);
+	hy[0] = mullo_sse2(iy, py);
+	hz[0] = mullo_sse2(iz, pz);
+	hx[1] = _mm_add_epi32(hx[0], px);
+	hy[1] = _mm_add_epi32(hy[0], py);
+	hz[1] = _mm_add_epi32(hz[0], pz);
+	__m128 scale = _mm_set1_ps(HASH_TO_FLOAT);
+	__m128 c[8];
+	for (int i = 0; i < 8; i++) {
+		__m128i h = _mm_xor_si128(_mm_xor_si128(_mm_xor_si128(hx[i & 1], hy[(i >> 1) & 1]),
+			hz[(i >> 2) & 1]), seed);
+		c[i] = _mm_mul_ps(_mm_cvtepi32_ps(mix_sse2(h)), scale);
+	}
+	return lerp_sse2(lerp_sse2(lerp_sse2(c[0], c[1], u), lerp_sse2(c[2], c[3], u), v),
+		lerp_sse2(lerp_sse2(c[4], c[5], u), lerp_sse2(c[6], c[7], u), v), w);
+}
+
+SSE2_FUNCTION void fbm_sse2(const float *x, const float *y, const float *z, size_t count,
+	float frequency, int octaves, unsigned seed, float *out) {
+	__m128 total = _mm_set1_ps(octave_total(octaves));
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+		__m128 sum = _mm_setzero_ps();
+		float amplitude = 1.0f, f = frequency;
+		unsigned s = seed;
+		for (int o = 0; o < octaves; o++) {
+			__m128 scale = _mm_set1_ps(f);
+			__m128 n = value_noise_sse2(_mm_mul_ps(px, scale), _mm_mul_ps(py, scale),
+				_mm_mul_ps(pz, scale), _mm_set1_epi32((int)s));
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(amplitude), n));
+			amplitude *= 0.5f;
+			f *= LACUNARITY;
+			s += OCTAVE_SEED;
+		}
+		_mm_storeu_ps(out + i, _mm_div_ps(sum, total));
+	}
+	fbm_scalar(x, y, z, i, count, frequency, octaves, seed, out);
+}
+
+AVX2_FUNCTION inline __m256i mix_avx2(__m256i h) {
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+	h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0x7feb352du));
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+	h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0x846ca68bu));
+	return _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+}
+
+AVX2_FUNCTION inline __m256 fade_avx2(__m256 t) {
+	__m256 inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t,
+		_mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+	return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+}
+
+AVX2_FUNCTION inline __m256 lerp_avx2(__m256 a, __m256 b, __m256 t) {
+	return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+}
+
+AVX2_FUNCTION __m256 value_noise_avx2(__m256 x, __m256 y, __m256 z, __m256i seed) {
+	__m256 fx = _mm256_floor_ps(x), fy = _mm256_floor_ps(y), fz = _mm256_floor_ps(z);
+	__m256 u = fade_avx2(_mm256_sub_ps(x, fx));
+	__m256 v = fade_avx2(_mm256_sub_ps(y, fy));
+	__m256 w = fade_avx2(_mm256_sub_ps(z, fz));
+	__m256i px = _mm256_set1_epi32((int)PRIME_X);
+	__m256i py = _mm256_set1_epi32((int)PRIME_Y);
+	__m256i pz = _mm256_set1_epi32((int)PRIME_Z);
+	__m256i hx[2], hy[2], hz[2];
+	hx[0] = _mm256_mullo_epi32(_mm256_cvtps_epi32(fx), px);
+	hy[0] = _mm256_mullo_epi32(_mm256_cvtps_epi32(fy), py);
+	hz[0] = _mm256_mullo_epi32(_mm256_cvtps_epi32(fz), pz);
+	hx[1] = _mm256_add_epi32(hx[0], px);
+	hy[1] = _mm256_add_epi32(hy[0], py);
+	hz[1] = _mm256_add_epi32(hz[0], pz);
+	__m256 scale = _mm256_set1_ps(HASH_TO_FLOAT);
+	__m256 c[8];
+	for (int i = 0; i < 8; i++) {
+		__m256i h = _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(hx[i & 1],
+			hy[(i >> 1) & 1]), hz[(i >> 2) & 1]), seed);
+		c[i] = _mm256_mul_ps(_mm256_cvtepi32_ps(mix_avx2(h)), scale);
+	}
+	return lerp_avx2(lerp_avx2(lerp_avx2(c[0], c[1], u), lerp_avx2(c[2], c[3], u), v),
+		lerp_avx2(lerp_avx2(c[4], c[5], u), lerp_avx2(c[6], c[7], u), v), w);
+}
+
+AVX2_FUNCTION void fbm_avx2(const float *x, const float *y, const float *z, size_t count,
+	float frequency, int octaves, unsigned seed, float *out) {
+	__m256 total = _mm256_set1_ps(octave_total(octaves));
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i);
+		__m256 pz = _mm256_loadu_ps(z + i);
+		__m256 sum = _mm256_setzero_ps();
+		float amplitude = 1.0f, f = frequency;
+		unsigned s = seed;
+		for (int o = 0; o < octaves; o++) {
+			__m256 scale = _mm256_set1_ps(f);
+			__m256 n = value_noise_avx2(_mm256_mul_ps(px, scale), _mm256_mul_ps(py, scale),
+				_mm256_mul_ps(pz, scale), _mm256_set1_epi32((int)s));
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(amplitude), n));
+			amplitude *= 0.5f;
+			f *= LACUNARITY;
+			s += OCTAVE_SEED;
+		}
+		_mm256_storeu_ps(out + i, _mm256_div_ps(sum, total));
+	}
+	fbm_scalar(x, y, z, i, count, frequency, octaves, seed, out);
+}
+
+#endif
+
+// 'octaves' of value noise at the points (x, y, z) * 'frequency', each twice
+// the frequency and half the amplitude of the one before, -1..1
+void fbm(const float *x, const float *y, const float *z, size_t count, float frequency,
+	int octaves, unsigned seed, float *out) {
+#if PROCEDURAL_SKY_X86
+	switch (image_simd()) {
+	case IMAGE_SIMD_AVX2:
+		fbm_avx2(x, y, z, count, frequency, octaves, seed, out);
+		return;
+	case IMAGE_SIMD_SSE2:
+		fbm_sse2(x, y, z, count, frequency, octaves, seed, out);
+		return;
+	default:
+		break;
+	}
+#endif
+	fbm_scalar(x, y, z, 0, count, frequency, octaves, seed, out);
+}
+
+// 0..1 from the 8 bits of a hash at 'shift'
+float unit(unsigned h, int shift) {
+	return (float)((h >> shift) & 0xff) / 255.0f;
+}
+
+void hue_to_rgb(float hue, float saturation, float value, float rgb[3]) {
+	for (int c = 0; c < 3; c++) {
+		float k = fmodf(hue * 6.0f + (c == 0 ? 5.0f : (c == 1 ? 3.0f : 1.0f)), 6.0f);
+		float ramp = std::max(0.0f, std::min(std::min(k, 4.0f - k), 1.0f));
+		rgb[c] = value * (1.0f - saturation * ramp);
+	}
+}
+
+// what the seed picks, in linear light
+struct palette_t {
+	float deep[3]; // thin gas everywhere
+	float near[3]; // and the two colours of the dense clouds
+	float far[3];
+	float core[3]; // the densest parts glow
+	float coverage; // how much of the sky has nebula
+	float warp; // how far the clouds are swirled
+	float star_density;
+};
+
+palette_t make_palette(unsigned seed) {
+	palette_t palette;
+	unsigned h = mix(seed ^ 0x51ed270bu), g = mix(h);
+	float hue = unit(h, 0);
+	float spread = 0.15f + 0.35f * unit(h, 8);
+	hue_to_rgb(hue, 0.8f, 0.6f, palette.near);
+	hue_to_rgb(fmodf(hue + spread, 1.0f), 0.85f, 0.5f, palette.far);
+	hue_to_rgb(fmodf(hue + 0.5f * spread, 1.0f), 0.35f, 1.0f, palette.core);
+	hue_to_rgb(fmodf(hue + 0.6f, 1.0f), 0.6f, 0.012f, palette.deep);
+	palette.coverage = 0.2f + 0.3f * unit(h, 16);
+	palette.warp = 0.4f + 0.8f * unit(h, 24);
+	palette.star_density = 0.1f + 0.2f * unit(g, 0);
+	return palette;
+}
+
+float smoothstep(float edge0, float edge1, float x) {
+	float t = std::max(0.0f, std::min((x - edge0) / (edge1 - edge0), 1.0f));
+	return t * t * (3.0f - 2.0f * t);
+}
+
+// one layer of stars: at most one per cell of a grid 'cells' across the unit
+// sphere's diameter, kept away from the cell's sides so it's never cut off.
+// 'texel' is a texel's width in cell units, a star is about that wide
+float stars(float x, float y, float z, float cells, float texel, float density, unsigned seed) {
+	float sx = x * cells, sy = y * cells, sz = z * cells;
+	float cx = floorf(sx), cy = floorf(sy), cz = floorf(sz);
+	unsigned h = mix(((unsigned)(int)cx * PRIME_X) ^ ((unsigned)(int)cy * PRIME_Y) ^
+		((unsigned)(int)cz * PRIME_Z) ^ seed);
+	if (unit(h, 0) > density) {
+		return 0.0f;
+	}
+	// a point in the middle of the cell, on the sphere
+	float px = cx + 0.3f + 0.4f * unit(h, 8), py = cy + 0.3f + 0.4f * unit(h, 16);
+	float pz = cz + 0.3f + 0.4f * unit(h, 24);
+	float length = sqrtf(px * px + py * py + pz * pz);
+	float on_sphere = cells / length;
+	px *= on_sphere;
+	py *= on_sphere;
+	pz *= on_sphere;
+	if (floorf(px) != cx || floorf(py) != cy || floorf(pz) != cz) {
+		return 0.0f; // it would be drawn by another cell's texels
+	}
+	float dx = sx - px, dy = sy - py, dz = sz - pz;
+	float radius = std::min(0.7f * texel, 0.15f);
+	float brightness = unit(mix(h), 0);
+	brightness = brightness * brightness * brightness * brightness;
+	// the same light whatever the size: a narrower star is brighter in the middle
+	float peak = std::min(1.0f, 0.02f / (radius * radius)) * (0.2f + 4.0f * brightness);
+	return peak * expf(-(dx * dx + dy * dy + dz * dz) / (radius * radius));
+}
+
+// the direction through texel (s, t) of a GL cube side, -1..1 across it
+void side_direction(int side, float s, float t, float *x, float *y, float *z) {
+	switch (side) {
+	case 0: *x = 1.0f; *y = -t; *z = -s; break;
+	case 1: *x = -1.0f; *y = -t; *z = s; break;
+	case 2: *x = s; *y = 1.0f; *z = t; break;
+	case 3: *x = s; *y = -1.0f; *z = -t; break;
+	case 4: *x = s; *y = -t; *z = 1.0f; break;
+	default: *x = -s; *y = -t; *z = -1.0f; break;
+	}
+	float length = sqrtf(*x * *x + *y * *y + *z * *z);
+	*x /= length;
+	*y /= length;
+	*z /= length;
+}
+
+void sky_rows(unsigned seed, int size, int face, const palette_t &palette, size_t begin,
+	size_t end, unsigned char *rgb) {
+	std::vector<float> x(size), y(size), z(size), warp(size), wx(size), wy(size), wz(size);
+	std::vector<float> density(size), tint(size), dust(size), linear((size_t)size * 4);
+	std::vector<unsigned char> rgba((size_t)size * 4);
+	int side = gl_sides[face];
+	float texel = 2.0f / size;
+	for (size_t row = begin; row < end; row++) {
+		float t = ((float)row + 0.5f) * texel - 1.0f;
+		for (int i = 0; i < size; i++) {
+			side_direction(side, ((float)i + 0.5f) * texel - 1.0f, t, &x[i], &y[i], &z[i]);
+		}
+		// the clouds are sampled at positions pushed around by another field,
+		// which turns blobs into filaments and swirls
+		fbm(x.data(), y.data(), z.data(), size, 1.5f, 3, seed ^ 0x1u, warp.data());
+		for (int i = 0; i < size; i++) {
+			float push = warp[i] * palette.warp;
+			wx[i] = x[i] + push;
+			wy[i] = y[i] - push;
+			wz[i] = z[i] + push * 0.5f;
+		}
+		fbm(wx.data(), wy.data(), wz.data(), size, 1.8f, 6, seed ^ 0x2u, density.data());
+		fbm(wx.data(), wy.data(), wz.data(), size, 1.1f, 3, seed ^ 0x3u, tint.data());
+		fbm(x.data(), y.data(), z.data(), size, 6.0f, 4, seed ^ 0x4u, dust.data());
+		for (int i = 0; i < size; i++) {
+			float cloud = smoothstep(0.1f - palette.coverage, 0.8f, density[i]);
+			float lanes = 1.0f - 0.8f * smoothstep(0.1f, 0.45f, dust[i]);
+			float mixed = smoothstep(-0.4f, 0.4f, tint[i]);
+			float core = cloud * cloud * cloud * cloud;
+			cloud *= cloud;
+			float light = 0.0f;
+			light += stars(x[i], y[i], z[i], 70.0f, 70.0f * texel, palette.star_density,
+				seed ^ 0x5u);
+			light += 0.4f * stars(x[i], y[i], z[i], 160.0f, 160.0f * texel,
+				palette.star_density, seed ^ 0x6u);
+			float *out = &linear[(size_t)i * 4];
+			for (int c = 0; c < 3; c++) {
+				float gas = palette.near[c] + (palette.far[c] - palette.near[c]) * mixed;
+				float value = palette.deep[c] + 0.3f * cloud * lanes * gas +
+					0.4f * core * lanes * palette.core[c] +
+					light * (0.8f + 0.2f * gas);
+				out[c] = 1.0f - expf(-value); // rolls off instead of clipping
+			}
+			out[3] = 1.0f;
+		}
+		image_linear_to_srgb(linear.data(), rgba.data(), size);
+		image_rgba_to_rgb(rgba.data(), rgb + row * size * 3, size);
+	}
+}
+
+} // namespace
+
+std::string procedural_sky_face_name(unsigned seed, int size, int face) {
+	char name[64];
+	snprintf(name, sizeof(name), "nebula_%u_%i_%s.sky", seed, size, side_names[face]);
+	return name;
+}
+
+bool procedural_sky_parse_name(const char *name, unsigned *seed, int *size, int *face) {
+	char side[16] = {0};
+	int length = 0;
+	if (sscanf(name, "nebula_%u_%i_%15[a-z].sky%n", seed, size, side, &length) != 3 ||
+		name[length] != '\0' || length == 0) {
+		return false;
+	}
+	if (*size < 1 || *size > PROCEDURAL_SKY_MAX_SIZE) {
+		return false;
+	}
+	for (int i = 0; i < 6; i++) {
+		if (strcmp(side, side_names[i]) == 0) {
+			*face = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void procedural_sky_face(thread_pool_t *pool, unsigned seed, int size, int face,
+	unsigned char *rgb) {
+	palette_t palette = make_palette(seed);
+	// a few rows a range, so the workers' scratch rows are reused
+	size_t rows_per_range = 8;
+	size_t ranges = ((size_t)size + rows_per_range - 1) / rows_per_range;
+	thread_pool_parallel_for_nested(pool, ranges, [&](size_t begin, size_t end) {
+		sky_rows(seed, size, face, palette, begin * rows_per_range,
+			std::min(end * rows_per_range, (size_t)size), rgb);
+	});
+}
@@ -0,0 +1,39 @@
+#pragma once
+/******************************************************************************\
+| Nebula skyboxes made on the CPU from a seed, instead of read from images.    |
+| Every texel is a direction on the sky, and its colour is a function of that  |
+| direction only, so the faces meet without seams at any size. The nebula is   |
+| fractal value noise (octaves of 3D lattice noise, domain warped by another   |
+| field) coloured from a palette the seed picks. Two layers of stars are       |
+| scattered one per cell of a 3D grid at most, sized to about a texel, so a    |
+| sky looks the same at every resolution.                                      |
+| The noise runs 4 (SSE2) or 8 (AVX2) directions at a time, with the kernels   |
+| image_simd picks. A face's rows are spread over a thread_pool_t and six      |
+| faces decode at once on the texture streamer's workers. Faces are named      |
+| like images (procedural_sky_face_name), so main.cpp's loader makes them      |
+| where it would otherwise decode a file, and they stream in, get mips and     |
+| count against the texture budget like any other skybox.                      |
+| No OpenGL in here.                                                           |
+\******************************************************************************/
+#ifndef _PROCEDURAL_SKY_H_
+#define _PROCEDURAL_SKY_H_
+
+#include "thread_pool.h"
+#include <string>
+
+// the largest face generated, 12 MB of RGB before its mips
+#define PROCEDURAL_SKY_MAX_SIZE 2048
+
+// the image name of face 'face' of sky 'seed', 'size' texels across:
+// nebula_<seed>_<size>_<side>.sky. faces are in the order
+// texture_streamer_request_cube takes them (front, back, top, bottom, left,
+// right) and each is made for the cube side the streamer uploads it to
+std::string procedural_sky_face_name(unsigned seed, int size, int face);
+// false for any name procedural_sky_face_name didn't make
+bool procedural_sky_parse_name(const char *name, unsigned *seed, int *size, int *face);
+// fills 'rgb' (size * size * 3 bytes, sRGB, top row first) with the face. the
+// rows are spread over 'pool' (NULL makes it all here), it's safe from a job
+void procedural_sky_face(thread_pool_t *pool, unsigned seed, int size, int face,
+	unsigned char *rgb);
+
+#endif
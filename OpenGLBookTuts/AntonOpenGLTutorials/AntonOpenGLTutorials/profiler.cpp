@@ -0,0 +1,189 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "profiler.h"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string.h>
+#include <vector>
+
+thread_local profile_thread_buffer_t *profiler_thread_buffer = NULL;
+
+namespace {
+
+std::mutex g_buffers_mutex;
+std::vector<profile_thread_buffer_t *> g_buffers;
+profile_thread_buffer_t *g_gpu_buffer = NULL;
+
+// time origin of the trace, in ticks and in OS clock nanoseconds
+unsigned long long g_origin_ticks = 0;
+long long g_origin_ns = 0;
+
+long long os_clock_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+profile_thread_buffer_t *new_buffer(const char *name, bool is_gpu) {
+	profile_thread_buffer_t *buffer = new profile_thread_buffer_t;
+	memset(buffer, 0, sizeof(*buffer));
+	buffer->is_gpu = is_gpu;
+	std::lock_guard<std::mutex> lock(g_buffers_mutex);
+	buffer->thread_id = (int)g_buffers.size() + 1;
+	snprintf(buffer->name, sizeof(buffer->name), "%s %i", name, buffer->thread_id);
+	g_buffers.push_back(buffer);
+	return buffer;
+}
+
+// ticks elapsed since the trace origin, as microseconds for the JSON
+double ticks_to_trace_us(unsigned long long ticks) {
+	return profiler_ticks_to_ns(ticks - g_origin_ticks) / 1000.0;
+}
+
+} // namespace
+
+#if !PROFILER_USE_TSC
+unsigned long long profiler_ticks() {
+	return (unsigned long long)os_clock_ns();
+}
+#endif
+
+void profiler_init() {
+	g_origin_ns = os_clock_ns();
+	g_origin_ticks = profiler_ticks();
+}
+
+double profiler_ticks_to_ns(unsigned long long ticks) {
+#if PROFILER_USE_TSC
+	// the longer the program has run the better this calibration gets
+	long long elapsed_ns = os_clock_ns() - g_origin_ns;
+	unsigned long long elapsed_ticks = profiler_ticks() - g_origin_ticks;
+	if (elapsed_ns <= 0 || elapsed_ticks == 0) {
+		return (double)ticks;
+	}
+	return (double)ticks * ((double)elapsed_ns / (double)elapsed_ticks);
+#else
+	return (double)ticks;
+#endif
+}
+
+profile_thread_buffer_t *profiler_create_thread_buffer() {
+	profiler_thread_buffer = new_buffer("thread", false);
+	return profiler_thread_buffer;
+}
+
+void profiler_set_thread_name(const char *name) {
+	profile_thread_buffer_t *buffer = profiler_get_thread_buffer();
+	snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+}
+
+void profiler_record_gpu(const char *name, unsigned long long submit_ticks,
+	unsigned long long duration_ns) {
+	if (!g_gpu_buffer) {
+		g_gpu_buffer = new_buffer("GPU", true);
+		snprintf(g_gpu_buffer->name, sizeof(g_gpu_buffer->name), "GPU");
+	}
+	unsigned int head = g_gpu_buffer->head;
+	profile_zone_t &zone = g_gpu_buffer->zones[head & (PROFILER_RING_SIZE - 1)];
+	zone.name = name;
+	zone.start = submit_ticks;
+	zone.end = duration_ns;
+	g_gpu_buffer->head = head + 1;
+}
+
+double profiler_measure_overhead() {
+	const int iterations = 100000;
+	profile_thread_buffer_t *buffer = profiler_get_thread_buffer();
+	// don't let the test zones push real ones out of the ring
+	unsigned int saved_head = buffer->head;
+	std::vector<profile_zone_t> saved(buffer->zones, buffer->zones + PROFILER_RING_SIZE);
+
+	// the same loop with nothing in it, a volatile counter keeps it from being optimised out
+	volatile int counter = 0;
+	unsigned long long empty_start = profiler_ticks();
+	for (int i = 0; i < iterations; i++) {
+		counter = counter + 1;
+	}
+	unsigned long long empty_end = profiler_ticks();
+
+	unsigned long long start = profiler_ticks();
+	for (int i = 0; i < iterations; i++) {
+		counter = counter + 1;
+		PROFILE_ZONE("profiler overhead");
+	}
+	unsigned long long end = profiler_ticks();
+
+	memcpy(buffer->zones, saved.data(), sizeof(buffer->zones));
+	buffer->head = saved_head;
+	unsigned long long loop = empty_end - empty_start;
+	unsigned long long zones = end - start;
+	return profiler_ticks_to_ns(zones > loop ? zones - loop : 0) / iterations;
+}
+
+bool profiler_write_chrome_trace(const char *file_name) {
+	FILE *file = fopen(file_name, "w");
+	if (!file) {
+		fprintf(stderr, "ERROR: could not open %s for writing\n", file_name);
+		return false;
+	}
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	bool first = true;
+	std::lock_guard<std::mutex> lock(g_buffers_mutex);
+	for (size_t b = 0; b < g_buffers.size(); b++) {
+		const profile_thread_buffer_t *buffer = g_buffers[b];
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,"
+			"\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", buffer->thread_id,
+			buffer->name);
+		first = false;
+
+		unsigned int head = buffer->head;
+		unsigned int oldest = head > PROFILER_RING_SIZE ? head - PROFILER_RING_SIZE : 0;
+		for (unsigned int i = oldest; i < head; i++) {
+			const profile_zone_t &zone = buffer->zones[i & (PROFILER_RING_SIZE - 1)];
+			double duration_us = buffer->is_gpu ? zone.end / 1000.0
+				: profiler_ticks_to_ns(zone.end - zone.start) / 1000.0;
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,"
+				"\"ts\":%.3f,\"dur\":%.3f}", zone.name, buffer->thread_id,
+				ticks_to_trace_us(zone.start), duration_us);
+		}
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
+
+void profiler_write_summary(FILE *file) {
+	struct zone_stats_t {
+		int count;
+		double total_ns;
+		double max_ns;
+	};
+	std::lock_guard<std::mutex> lock(g_buffers_mutex);
+	for (size_t b = 0; b < g_buffers.size(); b++) {
+		const profile_thread_buffer_t *buffer = g_buffers[b];
+		std::map<std::string, zone_stats_t> stats;
+		unsigned int head = buffer->head;
+		unsigned int oldest = head > PROFILER_RING_SIZE ? head - PROFILER_RING_SIZE : 0;
+		for (unsigned int i = oldest; i < head; i++) {
+			const profile_zone_t &zone = buffer->zones[i & (PROFILER_RING_SIZE - 1)];
+			double ns = buffer->is_gpu ? (double)zone.end
+				: profiler_ticks_to_ns(zone.end - zone.start);
+			zone_stats_t &s = stats[zone.name];
+			s.count++;
+			s.total_ns += ns;
+			if (ns > s.max_ns) {
+				s.max_ns = ns;
+			}
+		}
+		if (stats.empty()) {
+			continue;
+		}
+		fprintf(file, "%s:\n", buffer->name);
+		for (std::map<std::string, zone_stats_t>::iterator it = stats.begin();
+			it != stats.end(); ++it) {
+			fprintf(file, "  %-20s %6i calls  avg %8.3f ms  max %8.3f ms\n",
+				it->first.c_str(), it->second.count,
+				it->second.total_ns / it->second.count / 1e6, it->second.max_ns / 1e6);
+		}
+	}
+}
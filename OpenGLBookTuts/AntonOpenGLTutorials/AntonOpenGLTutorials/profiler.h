@@ -0,0 +1,117 @@
+#pragma once
+/******************************************************************************\
+| Scoped-zone CPU profiler with Chrome/Perfetto trace export.                  |
+| Zones are recorded as raw CPU timestamps into a fixed-size ring buffer per   |
+| thread, so recording is a counter read on enter and on exit plus one store.  |
+| Timestamps are only converted to nanoseconds when a trace is written, and    |
+| nesting isn't tracked at all: the trace viewer nests zones by their times.   |
+| The two counter reads are most of a zone's cost. That's about 10 ns on bare  |
+| metal, but a VM that traps rdtsc pays 20 ns or more for each, so the 50 ns   |
+| an empty zone is meant to stay under isn't met on every machine.             |
+| profiler_measure_overhead says what it is on this one.                       |
+| No OpenGL in here (see gpu_timer.h for GPU passes), so it works without a    |
+| window too.                                                                  |
+|                                                                              |
+| usage: { PROFILE_ZONE("update"); ... } then profiler_write_chrome_trace()    |
+| and open the file in chrome://tracing or ui.perfetto.dev                     |
+\******************************************************************************/
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdio.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PROFILER_USE_TSC 1
+#else
+#define PROFILER_USE_TSC 0
+#endif
+
+// zones kept per thread, older ones are overwritten. must be a power of 2
+#define PROFILER_RING_SIZE 16384
+
+struct profile_zone_t {
+	const char *name; // must be a string literal / outlive the profiler
+	unsigned long long start;
+	// end timestamp; for GPU zones the duration in nanoseconds
+	unsigned long long end;
+};
+
+struct profile_thread_buffer_t {
+	profile_zone_t zones[PROFILER_RING_SIZE];
+	// number of zones ever written, index into zones is head % PROFILER_RING_SIZE
+	volatile unsigned int head;
+	int thread_id;
+	bool is_gpu;
+	char name[32];
+};
+
+extern thread_local profile_thread_buffer_t *profiler_thread_buffer;
+profile_thread_buffer_t *profiler_create_thread_buffer();
+
+// raw timestamp, in TSC ticks on x86 and nanoseconds elsewhere
+#if PROFILER_USE_TSC
+inline unsigned long long profiler_ticks() { return __rdtsc(); }
+#else
+unsigned long long profiler_ticks();
+#endif
+
+// converts a tick interval to nanoseconds, calibrated against the OS clock
+double profiler_ticks_to_ns(unsigned long long ticks);
+
+inline profile_thread_buffer_t *profiler_get_thread_buffer() {
+	profile_thread_buffer_t *buffer = profiler_thread_buffer;
+	return buffer ? buffer : profiler_create_thread_buffer();
+}
+
+struct profile_scope_t {
+	profile_scope_t(const char *name) {
+		buffer = profiler_get_thread_buffer();
+		zone_name = name;
+		start = profiler_ticks();
+	}
+	~profile_scope_t() {
+		unsigned long long end = profiler_ticks();
+		unsigned int head = buffer->head;
+		profile_zone_t &zone = buffer->zones[head & (PROFILER_RING_SIZE - 1)];
+		zone.name = zone_name;
+		zone.start = start;
+		zone.end = end;
+		buffer->head = head + 1;
+	}
+	profile_thread_buffer_t *buffer;
+	const char *zone_name;
+	unsigned long long start;
+};
+
+#ifdef PROFILER_DISABLED
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) profile_scope_t PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#endif
+
+// call once at startup, before any zones, to set the trace time origin
+void profiler_init();
+// name shown for the calling thread in the trace
+void profiler_set_thread_name(const char *name);
+// records a GPU zone: 'submit_ticks' is the CPU time the pass was issued at
+// (GPU and CPU clocks aren't correlated), 'duration_ns' the GPU time it took
+void profiler_record_gpu(const char *name, unsigned long long submit_ticks,
+	unsigned long long duration_ns);
+
+// average cost of an empty zone in nanoseconds, measured on the calling thread
+// (the loop it's timed in is measured too and taken off)
+double profiler_measure_overhead();
+// writes every zone still in the ring buffers as Chrome trace event JSON.
+// call it when other threads are idle, it does not lock their buffers
+bool profiler_write_chrome_trace(const char *file_name);
+// per zone name count / average / max, in milliseconds
+void profiler_write_summary(FILE *file);
+
+#endif
@@ -0,0 +1,518 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "shader_library.h"
+#include "shader_preprocessor.h"
+#include "asset_hash.h"
+#include "embedded_shaders.h"
+#include "file_system.h"
+#include "steady_time.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+// header in front of the driver's blob in each cache file
+struct program_cache_header_t {
+	char magic[4];
+	unsigned int binary_format;
+	unsigned int length;
+	unsigned int padding;
+	unsigned long long key;
+};
+
+const char *stage_name(GLenum type) {
+	return type == GL_VERTEX_SHADER ? "vertex" : "fragment";
+}
+
+// folds 'value' into the hash 'seed'
+unsigned long long hash_combine(unsigned long long seed, unsigned long long value) {
+	return asset_hash(&value, sizeof(value), seed);
+}
+
+// key into 'shaders' for a stage with this source hash
+unsigned long long shader_key(GLenum type, unsigned long long source_hash) {
+	return hash_combine(hash_string(stage_name(type)), source_hash);
+}
+
+const embedded_shader_t *find_embedded_shader(const std::string &file_name,
+	const std::string &permutation) {
+	for (int i = 0; i < embedded_shader_count; i++) {
+		if (file_name == embedded_shaders[i].file &&
+			permutation == embedded_shaders[i].permutation) {
+			return &embedded_shaders[i];
+		}
+	}
+	return NULL;
+}
+
+std::string cache_file_name(const shader_library_t *library, unsigned long long key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", key);
+	return library->cache_dir + "/" + name;
+}
+
+bool load_cached_program(const shader_library_t *library, GLuint program,
+	unsigned long long key) {
+	std::string file_name = cache_file_name(library, key);
+	FILE *file = fopen(file_name.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+	program_cache_header_t header;
+	std::vector<char> binary;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+		memcmp(header.magic, "GLPB", 4) == 0 && header.key == key;
+	if (ok) {
+		binary.resize(header.length);
+		ok = fread(binary.data(), 1, binary.size(), file) == binary.size();
+	}
+	fclose(file);
+	if (!ok) {
+		return false;
+	}
+
+	// link status is read when the program is finished, not here, so a
+	// binary load can overlap other work like a link does
+	glProgramBinary(program, header.binary_format, binary.data(), (GLsizei)binary.size());
+	return true;
+}
+
+void save_cached_program(const shader_library_t *library, GLuint program,
+	unsigned long long key) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+	std::vector<char> binary(length);
+	GLenum binary_format = 0;
+	glGetProgramBinary(program, length, NULL, &binary_format, binary.data());
+
+	program_cache_header_t header;
+	memcpy(header.magic, "GLPB", 4);
+	header.binary_format = binary_format;
+	header.length = (unsigned int)length;
+	header.padding = 0;
+	header.key = key;
+
+	std::string file_name = cache_file_name(library, key);
+	FILE *file = fopen(file_name.c_str(), "wb");
+	if (!file) {
+		fprintf(stderr, "WARNING: could not write program cache file %s\n", file_name.c_str());
+		return;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(binary.data(), 1, binary.size(), file);
+	fclose(file);
+}
+
+bool load_sources(const shader_library_t *library, shader_program_record_t &record) {
+	const embedded_shader_t *vertex = find_embedded_shader(record.vertex_file, record.permutation);
+	const embedded_shader_t *fragment = find_embedded_shader(record.fragment_file,
+		record.permutation);
+	if (!library->from_disk) {
+		if (!vertex || !fragment) {
+			fprintf(stderr, "ERROR: %s + %s [%s] isn't embedded, add it to library->shaders.manifest and "
+				"regenerate embedded_shaders.h, or run with --library->shaders-from-disk\n",
+				record.vertex_file.c_str(), record.fragment_file.c_str(),
+				record.permutation.c_str());
+			return false;
+		}
+		record.vertex_source = vertex->source;
+		record.fragment_source = fragment->source;
+		record.vertex_hash = vertex->hash;
+		record.fragment_hash = fragment->hash;
+		record.files.clear();
+	} else {
+		std::vector<std::string> fragment_files;
+		if (!preprocess_shader(record.vertex_file.c_str(), record.permutation,
+			record.vertex_source, record.files) ||
+			!preprocess_shader(record.fragment_file.c_str(), record.permutation,
+			record.fragment_source, fragment_files)) {
+			return false;
+		}
+		for (size_t i = 0; i < fragment_files.size(); i++) {
+			if (std::find(record.files.begin(), record.files.end(), fragment_files[i]) ==
+				record.files.end()) {
+				record.files.push_back(fragment_files[i]);
+			}
+		}
+		record.vertex_hash = hash_string(record.vertex_source);
+		record.fragment_hash = hash_string(record.fragment_source);
+		if ((vertex && vertex->hash != record.vertex_hash) ||
+			(fragment && fragment->hash != record.fragment_hash)) {
+			printf("shader library: %s + %s [%s] differs from embedded_shaders.h, "
+				"regenerate it before shipping\n", record.vertex_file.c_str(),
+				record.fragment_file.c_str(), record.permutation.c_str());
+		}
+	}
+	record.vertex_key = shader_key(GL_VERTEX_SHADER, record.vertex_hash);
+	record.fragment_key = shader_key(GL_FRAGMENT_SHADER, record.fragment_hash);
+	record.key = hash_combine(hash_combine(library->driver_hash, record.vertex_hash),
+		record.fragment_hash);
+	return true;
+}
+
+void submit_link(shader_library_t *library, shader_program_record_t &record) {
+	GLuint vs = shader_library_get_shader(library, GL_VERTEX_SHADER, record.vertex_source, record.vertex_hash);
+	GLuint fs = shader_library_get_shader(library, GL_FRAGMENT_SHADER, record.fragment_source, record.fragment_hash);
+	glAttachShader(record.program, vs);
+	glAttachShader(record.program, fs);
+	if (library->binary_cache_enabled) {
+		glProgramParameteri(record.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(record.program);
+	library->link_count++;
+	record.state = SHADER_PROGRAM_LINKING;
+}
+
+bool is_complete(const shader_library_t *library, GLuint program) {
+	// without the extension any status query waits for the driver, so only
+	// shader_library_finish is allowed to ask
+	if (!library->parallel_compile) {
+		return false;
+	}
+	GLint complete = GL_FALSE;
+	glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+void print_shader_log(GLuint shader, const std::string &file_name) {
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE) {
+		char log[2048];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		fprintf(stderr, "ERROR: shader %s failed to compile:\n%s\n", file_name.c_str(), log);
+	}
+}
+
+void print_link_errors(const shader_library_t *library, GLuint program,
+	const shader_program_record_t &record) {
+	std::map<unsigned long long, GLuint>::const_iterator vs = library->shaders.find(record.vertex_key);
+	std::map<unsigned long long, GLuint>::const_iterator fs = library->shaders.find(record.fragment_key);
+	if (vs != library->shaders.end()) {
+		print_shader_log(vs->second, record.vertex_file);
+	}
+	if (fs != library->shaders.end()) {
+		print_shader_log(fs->second, record.fragment_file);
+	}
+	char log[2048];
+	glGetProgramInfoLog(program, sizeof(log), NULL, log);
+	fprintf(stderr, "ERROR: program %s + %s [%s] failed to link:\n%s\n",
+		record.vertex_file.c_str(), record.fragment_file.c_str(), record.permutation.c_str(), log);
+}
+
+void finish_program(shader_library_t *library, shader_program_record_t &record) {
+	GLint status = GL_FALSE;
+	glGetProgramiv(record.program, GL_LINK_STATUS, &status);
+
+	if (record.state == SHADER_PROGRAM_LOADING_BINARY) {
+		if (status == GL_TRUE) {
+			library->cache_hit_count++;
+			record.state = SHADER_PROGRAM_READY;
+		} else {
+			// the driver refused the binary, e.g. after a settings change
+			remove(cache_file_name(library, record.key).c_str());
+			submit_link(library, record);
+			return;
+		}
+	} else if (status == GL_TRUE) {
+		// library->shaders stay attached, other library->programs may still be made from them
+		if (library->binary_cache_enabled) {
+			save_cached_program(library, record.program, record.key);
+		}
+		record.state = SHADER_PROGRAM_READY;
+	} else {
+		print_link_errors(library, record.program, record);
+		library->failed_count++;
+		record.state = SHADER_PROGRAM_FAILED;
+	}
+
+	record.vertex_source.clear();
+	record.fragment_source.clear();
+	library->pending_count--;
+	if (library->pending_count == 0) {
+		library->total_seconds += now_seconds() - library->batch_start;
+	}
+}
+
+// deletes shader objects no program's current sources use any more
+void release_unused_shaders(shader_library_t *library) {
+	std::map<unsigned long long, GLuint>::iterator it = library->shaders.begin();
+	while (it != library->shaders.end()) {
+		bool used = false;
+		for (size_t i = 0; i < library->programs.size() && !used; i++) {
+			used = library->programs[i].vertex_key == it->first || library->programs[i].fragment_key == it->first;
+		}
+		if (used) {
+			++it;
+		} else {
+			// stays alive while still attached to a program
+			glDeleteShader(it->second);
+			it = library->shaders.erase(it);
+		}
+	}
+}
+
+} // namespace
+
+void shader_library_init(shader_library_t *library, const char *cache_dir, bool read_from_disk) {
+	library->cache_dir.clear();
+	library->from_disk = read_from_disk;
+	library->binary_cache_enabled = false;
+	library->parallel_compile = false;
+	library->driver_hash = 0;
+	library->shaders.clear();
+	library->programs.clear();
+	library->pending_count = 0;
+	library->compile_count = 0;
+	library->shader_reuse_count = 0;
+	library->cache_hit_count = 0;
+	library->link_count = 0;
+	library->failed_count = 0;
+	library->batch_start = 0.0;
+	library->total_seconds = 0.0;
+	library->wait_seconds = 0.0;
+
+	// a driver update invalidates every binary, so the driver string is part of the key
+	std::string driver;
+	const char *strings[] = {
+		(const char *)glGetString(GL_VENDOR),
+		(const char *)glGetString(GL_RENDERER),
+		(const char *)glGetString(GL_VERSION)
+	};
+	for (int i = 0; i < 3; i++) {
+		driver += strings[i] ? strings[i] : "";
+		driver += "\n";
+	}
+	library->driver_hash = hash_string(driver);
+
+	GLint binary_formats = 0;
+	if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) {
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+	}
+	if (cache_dir && binary_formats > 0) {
+		library->cache_dir = cache_dir;
+		make_directory(cache_dir);
+		library->binary_cache_enabled = true;
+	}
+}
+
+bool shader_library_enable_parallel_compile(shader_library_t *library, unsigned int threads) {
+	// 0xFFFFFFFF is the spec's "implementation decides"
+	GLuint count = threads ? threads : 0xFFFFFFFFu;
+	if (GLEW_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(count);
+		library->parallel_compile = true;
+	} else if (GLEW_ARB_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsARB(count);
+		library->parallel_compile = true;
+	}
+	return library->parallel_compile;
+}
+
+GLuint shader_library_get_shader(shader_library_t *library, GLenum type,
+	const std::string &source, unsigned long long source_hash) {
+	unsigned long long key = shader_key(type, source_hash);
+	std::map<unsigned long long, GLuint>::iterator found = library->shaders.find(key);
+	if (found != library->shaders.end()) {
+		library->shader_reuse_count++;
+		return found->second;
+	}
+
+	GLuint shader = glCreateShader(type);
+	const GLchar *text = source.c_str();
+	glShaderSource(shader, 1, &text, NULL);
+	glCompileShader(shader);
+	library->compile_count++;
+	library->shaders[key] = shader;
+	return shader;
+}
+
+GLuint shader_library_request_program(shader_library_t *library, const char *vertex_file,
+	const char *fragment_file, const char *permutation) {
+	std::string key = normalise_permutation_key(permutation);
+	for (size_t i = 0; i < library->programs.size(); i++) {
+		if (library->programs[i].vertex_file == vertex_file && library->programs[i].fragment_file == fragment_file &&
+			library->programs[i].permutation == key) {
+			return library->programs[i].program;
+		}
+	}
+	double start = now_seconds();
+
+	shader_program_record_t record;
+	record.vertex_file = vertex_file;
+	record.fragment_file = fragment_file;
+	record.permutation = key;
+	if (!load_sources(library, record)) {
+		return 0;
+	}
+	record.program = glCreateProgram();
+
+	if (library->binary_cache_enabled && load_cached_program(library, record.program, record.key)) {
+		record.state = SHADER_PROGRAM_LOADING_BINARY;
+	} else {
+		submit_link(library, record);
+	}
+
+	if (library->pending_count == 0) {
+		library->batch_start = start;
+	}
+	library->pending_count++;
+	library->programs.push_back(record);
+	return record.program;
+}
+
+GLuint shader_library_get_program(shader_library_t *library, const char *vertex_file,
+	const char *fragment_file, const char *permutation) {
+	GLuint program = shader_library_request_program(library, vertex_file, fragment_file, permutation);
+	shader_library_finish(library);
+	for (size_t i = 0; i < library->programs.size(); i++) {
+		if (library->programs[i].program == program && library->programs[i].state == SHADER_PROGRAM_FAILED) {
+			return 0;
+		}
+	}
+	return program;
+}
+
+bool shader_library_poll(shader_library_t *library) {
+	for (size_t i = 0; i < library->programs.size() && library->pending_count > 0; i++) {
+		shader_program_record_t &record = library->programs[i];
+		if ((record.state == SHADER_PROGRAM_LOADING_BINARY || record.state == SHADER_PROGRAM_LINKING) &&
+			is_complete(library, record.program)) {
+			finish_program(library, record);
+		}
+	}
+	return library->pending_count == 0;
+}
+
+void shader_library_finish(shader_library_t *library) {
+	double start = now_seconds();
+	// a rejected binary goes back to linking, hence the outer loop
+	while (library->pending_count > 0) {
+		for (size_t i = 0; i < library->programs.size(); i++) {
+			shader_program_record_t &record = library->programs[i];
+			if (record.state == SHADER_PROGRAM_LOADING_BINARY || record.state == SHADER_PROGRAM_LINKING) {
+				finish_program(library, record);
+			}
+		}
+	}
+	library->wait_seconds += now_seconds() - start;
+}
+
+void shader_library_list_source_files(const shader_library_t *library,
+	std::vector<std::string> &files) {
+	files.clear();
+	for (size_t i = 0; i < library->programs.size(); i++) {
+		for (size_t j = 0; j < library->programs[i].files.size(); j++) {
+			if (std::find(files.begin(), files.end(), library->programs[i].files[j]) == files.end()) {
+				files.push_back(library->programs[i].files[j]);
+			}
+		}
+	}
+}
+
+int shader_library_reload_file(shader_library_t *library, const char *file_name) {
+	double start = now_seconds();
+	int replaced = 0;
+	int failed = 0;
+	for (size_t i = 0; i < library->programs.size(); i++) {
+		shader_program_record_t &record = library->programs[i];
+		if (std::find(record.files.begin(), record.files.end(), file_name) == record.files.end()) {
+			continue;
+		}
+		if (record.state != SHADER_PROGRAM_READY && record.state != SHADER_PROGRAM_FAILED) {
+			continue; // still being built from the old files, shader_library_finish first
+		}
+		// an edit can add or drop includes, so the file list is rebuilt too
+		shader_program_record_t updated = record;
+		if (!load_sources(library, updated)) {
+			fprintf(stderr, "ERROR: keeping the previous %s + %s\n",
+				record.vertex_file.c_str(), record.fragment_file.c_str());
+			failed++;
+			continue;
+		}
+		// saved without changes, nothing to do
+		if (record.state == SHADER_PROGRAM_READY && updated.vertex_key == record.vertex_key &&
+			updated.fragment_key == record.fragment_key) {
+			continue;
+		}
+
+		// test-linked in a program of its own first, a failed link would wipe the old one
+		updated.program = glCreateProgram();
+		submit_link(library, updated);
+		GLint status = GL_FALSE;
+		glGetProgramiv(updated.program, GL_LINK_STATUS, &status);
+		if (status != GL_TRUE) {
+			print_link_errors(library, updated.program, updated);
+			glDeleteProgram(updated.program);
+			fprintf(stderr, "ERROR: keeping the previous %s + %s\n",
+				record.vertex_file.c_str(), record.fragment_file.c_str());
+			failed++;
+			continue;
+		}
+		glDeleteProgram(updated.program);
+
+		// relinked in place so the caller's program name stays valid
+		GLuint attached[2];
+		GLsizei attached_count = 0;
+		glGetAttachedShaders(record.program, 2, &attached_count, attached);
+		for (GLsizei j = 0; j < attached_count; j++) {
+			glDetachShader(record.program, attached[j]);
+		}
+		updated.program = record.program;
+		submit_link(library, updated);
+		glGetProgramiv(updated.program, GL_LINK_STATUS, &status);
+		if (status != GL_TRUE) {
+			print_link_errors(library, updated.program, updated);
+			library->failed_count++;
+			updated.state = SHADER_PROGRAM_FAILED;
+		} else {
+			if (library->binary_cache_enabled) {
+				save_cached_program(library, updated.program, updated.key);
+			}
+			updated.state = SHADER_PROGRAM_READY;
+		}
+		updated.vertex_source.clear();
+		updated.fragment_source.clear();
+		record = updated;
+		replaced++;
+	}
+	release_unused_shaders(library);
+	if (replaced > 0 || failed > 0) {
+		printf("shader library: reloaded %s, %i library->programs relinked, %i kept after errors, "
+			"%.2f ms\n", file_name, replaced, failed, (now_seconds() - start) * 1000.0);
+	}
+	return replaced;
+}
+
+void shader_library_print_stats(const shader_library_t *library) {
+	const char *start_kind = library->cache_hit_count == (int)library->programs.size() && !library->programs.empty()
+		? "warm" : (library->cache_hit_count == 0 ? "cold" : "partly warm");
+	printf("shader library: %s start, %i library->programs (%i from binary cache, %i linked, "
+		"%i failed), %i library->shaders compiled, %i reused\n", start_kind, (int)library->programs.size(),
+		library->cache_hit_count, library->link_count, library->failed_count, library->compile_count, library->shader_reuse_count);
+	printf("shader library: %.2f ms from first request to ready, %.2f ms of it blocked "
+		"in finish, parallel compile %s\n", library->total_seconds * 1000.0, library->wait_seconds * 1000.0,
+		library->parallel_compile ? "on" : "not supported");
+	if (library->pending_count > 0) {
+		printf("shader library: %i library->programs still pending\n", library->pending_count);
+	}
+	if (!library->binary_cache_enabled) {
+		printf("shader library: driver has no program binary formats, cache disabled\n");
+	}
+}
+
+void shader_library_destroy(shader_library_t *library) {
+	for (size_t i = 0; i < library->programs.size(); i++) {
+		glDeleteProgram(library->programs[i].program);
+	}
+	for (std::map<unsigned long long, GLuint>::iterator it = library->shaders.begin();
+		it != library->shaders.end(); ++it) {
+		glDeleteShader(it->second);
+	}
+	library->programs.clear();
+	library->shaders.clear();
+	library->pending_count = 0;
+}
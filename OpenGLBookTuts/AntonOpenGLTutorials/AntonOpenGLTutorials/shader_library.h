@@ -0,0 +1,123 @@
+#pragma once
+/******************************************************************************\
+| Owns every shader and program object.                                        |
+| Sources are the preprocessed permutations compiled into embedded_shaders.h,  |
+| so startup reads no shader files, or, for development, the files on disk.    |
+| Shader objects are keyed by a hash of their stage and source, so a stage     |
+| shared by several programs (the grey mesh.frag) is only compiled once.       |
+| Linked programs are saved with glGetProgramBinary into a cache directory,    |
+| keyed by the sources and the driver (vendor/renderer/version string), and    |
+| later launches load them back with glProgramBinary without compiling.        |
+| Compile and link errors are printed with the driver's info log.              |
+|                                                                              |
+| Programs are requested up front and finished later:                          |
+| shader_library_request_program only submits the compile and link, and status |
+| is not read back until shader_library_poll or shader_library_finish. With    |
+| KHR/ARB_parallel_shader_compile the driver compiles on its own threads and   |
+| poll checks GL_COMPLETION_STATUS without blocking, so the caller can decode  |
+| textures and fill buffers in the meantime. Without the extension poll does   |
+| nothing and finish takes the whole wait.                                     |
+|                                                                              |
+| shader_library_reload_file rebuilds only the programs that use a changed     |
+| file, for hot reloading from a file_watcher_t.                               |
+\******************************************************************************/
+#ifndef _SHADER_LIBRARY_H_
+#define _SHADER_LIBRARY_H_
+
+#include <GL/glew.h>
+#include <map>
+#include <string>
+#include <vector>
+
+enum shader_program_state_t {
+	SHADER_PROGRAM_LOADING_BINARY,
+	SHADER_PROGRAM_LINKING,
+	SHADER_PROGRAM_READY,
+	SHADER_PROGRAM_FAILED
+};
+
+struct shader_program_record_t {
+	std::string vertex_file;
+	std::string fragment_file;
+	std::string permutation; // normalised
+	// both stages' files and everything they include, for hot-reload.
+	// empty for embedded sources
+	std::vector<std::string> files;
+	unsigned long long vertex_hash; // hash_string of the sources
+	unsigned long long fragment_hash;
+	// preprocessed, kept until the program is ready, a rejected binary is rebuilt from them
+	std::string vertex_source;
+	std::string fragment_source;
+	unsigned long long key; // program binary cache key
+	unsigned long long vertex_key; // keys into 'shaders'
+	unsigned long long fragment_key;
+	GLuint program;
+	shader_program_state_t state;
+};
+
+struct shader_library_t {
+	std::string cache_dir;
+	bool from_disk; // sources are read and preprocessed, which hot-reload needs
+	bool binary_cache_enabled;
+	bool parallel_compile;
+	unsigned long long driver_hash;
+	std::map<unsigned long long, GLuint> shaders;
+	std::vector<shader_program_record_t> programs;
+	int pending_count;
+
+	int compile_count;
+	int shader_reuse_count;
+	int cache_hit_count;
+	int link_count;
+	int failed_count;
+	// from the first request of a batch until its last program is finished
+	double batch_start;
+	double total_seconds;
+	// time spent blocked inside shader_library_finish
+	double wait_seconds;
+};
+
+// 'cache_dir' is created if missing, NULL disables the binary cache.
+// sources come from embedded_shaders.h unless 'read_from_disk' is set, then
+// the shader files are read and preprocessed, which hot-reload needs
+void shader_library_init(shader_library_t *library, const char *cache_dir, bool read_from_disk);
+// asks the driver for background compiler threads, 0 lets it pick.
+// false if neither parallel compile extension is there
+bool shader_library_enable_parallel_compile(shader_library_t *library, unsigned int threads);
+
+// compiled shader object for this stage/source, 'source_hash' being
+// hash_string(source). compilation is only submitted, errors are reported
+// when a program using it is finished
+GLuint shader_library_get_shader(shader_library_t *library, GLenum type,
+	const std::string &source, unsigned long long source_hash);
+// submits the compile and link of a program from a vertex and fragment
+// shader file and returns its name straight away, 0 if a file is missing.
+// 'permutation' is a key of defines for both stages, see shader_preprocessor.h.
+// the same files and key always give back the same program
+GLuint shader_library_request_program(shader_library_t *library, const char *vertex_file,
+	const char *fragment_file, const char *permutation = "");
+// request then finish, for programs needed right away. 0 on failure
+GLuint shader_library_get_program(shader_library_t *library, const char *vertex_file,
+	const char *fragment_file, const char *permutation = "");
+
+// finishes the programs the driver is done with, never blocks.
+// true once nothing is left pending
+bool shader_library_poll(shader_library_t *library);
+// waits for and finishes every pending program
+void shader_library_finish(shader_library_t *library);
+
+// every shader and include file used by a program, for a file watcher
+void shader_library_list_source_files(const shader_library_t *library,
+	std::vector<std::string> &files);
+// rebuilds the programs using 'file_name', directly or through an #include,
+// from what is on disk now. a program that fails to compile or link keeps
+// its previous version. returns how many were relinked; they keep their
+// names, but uniform locations and values have to be set again
+int shader_library_reload_file(shader_library_t *library, const char *file_name);
+
+// startup report: programs from cache vs linked, compiles, time taken
+void shader_library_print_stats(const shader_library_t *library);
+// deletes every program and shader, call while the context is still current
+void shader_library_destroy(shader_library_t *library);
+
+#endif
@@ -0,0 +1,164 @@
+#include "shader_preprocessor.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+std::string directory_of(const std::string &path) {
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// text after leading whitespace and a '#', with spaces between '#' and the
+// directive skipped ("# version 410" is valid GLSL). empty if not a directive
+std::string directive_of(const std::string &line) {
+	size_t i = line.find_first_not_of(" \t");
+	if (i == std::string::npos || line[i] != '#') {
+		return std::string();
+	}
+	i = line.find_first_not_of(" \t", i + 1);
+	return i == std::string::npos ? std::string() : line.substr(i);
+}
+
+bool starts_with(const std::string &text, const char *prefix) {
+	return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+struct preprocess_state_t {
+	std::vector<std::string> *files;
+	std::string header; // #version line and the permutation defines
+	std::string body;
+	bool have_version;
+};
+
+bool expand_file(preprocess_state_t &state, const std::string &path, const char *included_from,
+	int included_at) {
+	std::ifstream stream(path.c_str());
+	if (!stream) {
+		if (included_from) {
+			fprintf(stderr, "ERROR: %s(%i): can't open include file %s\n", included_from,
+				included_at, path.c_str());
+		} else {
+			fprintf(stderr, "ERROR: could not open shader file %s\n", path.c_str());
+		}
+		return false;
+	}
+	int file_number = (int)state.files->size();
+	state.files->push_back(path);
+
+	std::ostringstream line_directive;
+	line_directive << "#line 1 " << file_number << "\n";
+	state.body += line_directive.str();
+
+	std::string line;
+	int line_number = 0;
+	while (std::getline(stream, line)) {
+		line_number++;
+		if (!line.empty() && line[line.size() - 1] == '\r') {
+			line.erase(line.size() - 1);
+		}
+		std::string directive = directive_of(line);
+		if (starts_with(directive, "version")) {
+			if (included_from) {
+				fprintf(stderr, "ERROR: %s(%i): #version in an included file\n", path.c_str(),
+					line_number);
+				return false;
+			}
+			state.header = "#version" + directive.substr(7) + "\n" + state.header;
+			state.have_version = true;
+			state.body += "\n"; // keeps the line numbers right
+			continue;
+		}
+		if (!starts_with(directive, "include")) {
+			state.body += line;
+			state.body += "\n";
+			continue;
+		}
+
+		size_t open = directive.find('"');
+		size_t close = open == std::string::npos ? open : directive.find('"', open + 1);
+		if (close == std::string::npos) {
+			fprintf(stderr, "ERROR: %s(%i): expected #include \"file\"\n", path.c_str(),
+				line_number);
+			return false;
+		}
+		std::string include_path = directory_of(path) + directive.substr(open + 1, close - open - 1);
+		if (std::find(state.files->begin(), state.files->end(), include_path) ==
+			state.files->end()) {
+			if (!expand_file(state, include_path, path.c_str(), line_number)) {
+				return false;
+			}
+		}
+		// back to this file after the include
+		line_directive.str(std::string());
+		line_directive << "#line " << line_number + 1 << " " << file_number << "\n";
+		state.body += line_directive.str();
+	}
+	return true;
+}
+
+} // namespace
+
+unsigned long long hash_string(const std::string &text, unsigned long long seed) {
+	return asset_hash(text.data(), text.size(), seed);
+}
+
+void split_permutation_key(const std::string &key, std::vector<std::string> &defines) {
+	defines.clear();
+	std::istringstream stream(key);
+	std::string define;
+	while (stream >> define) {
+		defines.push_back(define);
+	}
+}
+
+std::string normalise_permutation_key(const std::string &key) {
+	std::vector<std::string> defines;
+	split_permutation_key(key, defines);
+	std::sort(defines.begin(), defines.end());
+	defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+	std::string result;
+	for (size_t i = 0; i < defines.size(); i++) {
+		result += (i ? " " : "") + defines[i];
+	}
+	return result;
+}
+
+bool preprocess_shader(const char *file_name, const std::string &key, std::string &source,
+	std::vector<std::string> &files) {
+	files.clear();
+	preprocess_state_t state;
+	state.files = &files;
+	state.have_version = false;
+
+	std::vector<std::string> defines;
+	split_permutation_key(normalise_permutation_key(key), defines);
+	for (size_t i = 0; i < defines.size(); i++) {
+		std::string define = defines[i];
+		size_t equals = define.find('=');
+		if (equals != std::string::npos) {
+			define[equals] = ' ';
+		}
+		state.header += "#define " + define + "\n";
+	}
+
+	if (!expand_file(state, file_name, NULL, 0)) {
+		return false;
+	}
+	if (!state.have_version) {
+		fprintf(stderr, "ERROR: %s has no #version line\n", file_name);
+		return false;
+	}
+
+	std::string file_list;
+	for (size_t i = 0; i < files.size(); i++) {
+		std::ostringstream entry;
+		entry << "// " << i << ": " << files[i] << "\n";
+		file_list += entry.str();
+	}
+	source = state.header + file_list + state.body;
+	return true;
+}
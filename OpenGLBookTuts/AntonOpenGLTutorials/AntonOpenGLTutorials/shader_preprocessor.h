@@ -0,0 +1,38 @@
+#pragma once
+/******************************************************************************\
+| GLSL source preprocessing done before the driver sees a shader.              |
+| #include "file" is replaced with that file, found relative to the file       |
+| including it. A file goes in at most once per shader, so includes need no    |
+| guards and can't recurse forever.                                            |
+| A permutation key, e.g. "TEXTURED" or "FLAT_COLOUR=vec4(1.0,0.0,0.0,1.0)",   |
+| becomes #defines right after the #version line. Everything else (#ifdef,     |
+| #if defined(...)) is left to the GLSL compiler's own preprocessor.           |
+| Each file gets its own GLSL source string number through #line, so a driver  |
+| error like "1(14)" is line 14 of the file listed as 1 in the comment at the  |
+| top of the expanded source.                                                  |
+| No OpenGL in here, the offline tools/shader_permutations uses it as well.    |
+\******************************************************************************/
+#ifndef _SHADER_PREPROCESSOR_H_
+#define _SHADER_PREPROCESSOR_H_
+
+#include "asset_hash.h"
+#include <string>
+#include <vector>
+
+// asset_hash of the text, used for source and cache keys
+unsigned long long hash_string(const std::string &text,
+	unsigned long long seed = ASSET_HASH_SEED);
+
+// sorts and de-duplicates the NAME[=value] entries of a permutation key, so
+// "B A" and "A B" give the same key. values can't contain spaces
+std::string normalise_permutation_key(const std::string &key);
+// the NAME[=value] entries of a permutation key
+void split_permutation_key(const std::string &key, std::vector<std::string> &defines);
+
+// expands 'file_name' for the permutation 'key'. 'files' gets every file the
+// result was built from, the top-level file first. false (with the reason
+// printed) if a file is missing, there's no #version or an #include is malformed
+bool preprocess_shader(const char *file_name, const std::string &key, std::string &source,
+	std::vector<std::string> &files);
+
+#endif
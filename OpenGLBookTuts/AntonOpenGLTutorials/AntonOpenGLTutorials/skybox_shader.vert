@@ -1,11 +1,15 @@
 #version 410
 
-
-in vec3 vertex_position;
-uniform mat4 proj, view;
+//no vertex buffer: one triangle that covers the whole screen is made from gl_VertexID
+//(0 -> (-1,-1), 1 -> (3,-1), 2 -> (-1,3))
+uniform mat4 inv_proj_view;
 out vec3 texcoords;
 
 void main() {
-  texcoords = vertex_position;
-  gl_Position = proj * mat4(mat3(view)) * vec4(vertex_position, 1.0);
-}
\ No newline at end of file
+  vec2 ndc = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+  //unproject a point on the far plane to get the view direction through this pixel
+  vec4 world = inv_proj_view * vec4(ndc, 1.0, 1.0);
+  texcoords = world.xyz / world.w;
+  //z = w puts the triangle exactly on the far plane (depth 1.0)
+  gl_Position = vec4(ndc, 1.0, 1.0);
+}
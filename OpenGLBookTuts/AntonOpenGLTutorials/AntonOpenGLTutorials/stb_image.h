@@ -216,6 +216,17 @@ Blazej Dariusz Roszkowski                                     github:Michaelange
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
 //
+// Define STBI_FAST_PNG for a faster inflate (a 64-bit bit buffer refilled
+// eight bytes at a time, and an 11-bit literal/length table that resolves
+// two literals in one lookup) and SSE2 PNG unfiltering for 8-bit RGB and
+// RGBA rows. Output is byte-identical to the default path.
+//
+// Define STBI_FAST_JPEG for AVX2 JPEG kernels, picked at run time like the
+// SSE2 ones (the IDCT two blocks at a time, YCbCr to RGB for 3 and 4 channel
+// output and the 2x upsamplers), and to decode the restart intervals of
+// baseline JPEGs loaded from memory on several threads, see
+// stbi_set_jpeg_parallel_for. Output is byte-identical to the default path.
+//
 // ===========================================================================
 //
 // HDR image support   (disable by defining STBI_NO_HDR)
@@ -447,6 +458,21 @@ extern "C" {
 	// flip the image vertically, so the first pixel in the output array is the bottom left
 	STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+#ifdef STBI_FAST_JPEG
+	// runs task(arg, 0) to task(arg, count - 1) in any order, on any threads,
+	// and returns once they've all finished
+	typedef void stbi_parallel_for(void *user, int count, void(*task)(void *arg, int index), void *arg);
+
+	// baseline JPEGs loaded from memory that have restart markers decode their
+	// restart intervals through this. NULL (the default) decodes on the calling
+	// thread only
+	STBIDEF void stbi_set_jpeg_parallel_for(stbi_parallel_for *parallel_for, void *user);
+
+	// caps the JPEG kernels: 0 for the C ones, 1 for SSE2 (or NEON), 2 (the
+	// default) for AVX2. for comparing them, set it before decoding anything
+	STBIDEF void stbi_set_jpeg_simd(int max_level);
+#endif
+
 	// ZLIB client - used by PNG, available for other purposes
 
 	STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -668,6 +694,50 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2, for the JPEG decoder with STBI_FAST_JPEG. unlike SSE2 it can't be
+// assumed on x64, so the kernels are compiled for it (with a target attribute
+// on GCC/Clang) and only picked when the CPU and OS support it
+#if defined(STBI_FAST_JPEG) && defined(STBI_SSE2) && !defined(STBI_NO_AVX2)
+#if (defined(_MSC_VER) && _MSC_VER >= 1800) || (!defined(_MSC_VER) && defined(__GNUC__))
+#define STBI_AVX2
+#endif
+#endif
+
+#ifdef STBI_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define STBI__AVX2_FUNCTION
+
+static int stbi__avx2_available(void)
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return 0;
+	__cpuid(info, 1);
+	// AVX and OSXSAVE, then the OS has to save the ymm registers
+	if ((info[2] & 0x18000000) != 0x18000000 || (_xgetbv(0) & 6) != 6) return 0;
+	__cpuidex(info, 7, 0);
+	return (info[1] >> 5) & 1;
+}
+#else
+#include <cpuid.h>
+#define STBI__AVX2_FUNCTION __attribute__((target("avx2")))
+
+static int stbi__avx2_available(void)
+{
+	unsigned int a, b, c, d, xcr0_low, xcr0_high;
+	if (!__get_cpuid(1, &a, &b, &c, &d)) return 0;
+	// AVX and OSXSAVE, then the OS has to save the ymm registers
+	if ((c & 0x18000000) != 0x18000000) return 0;
+	__asm__ volatile("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+	if ((xcr0_low & 6) != 6) return 0;
+	// fails when the CPU has no leaf 7
+	if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return 0;
+	return (b >> 5) & 1;
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -970,6 +1040,23 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
 	stbi__vertically_flip_on_load = flag_true_if_should_flip;
 }
 
+#ifdef STBI_FAST_JPEG
+static stbi_parallel_for *stbi__jpeg_parallel_for = NULL;
+static void *stbi__jpeg_parallel_user = NULL;
+static int stbi__jpeg_simd = 2;
+
+STBIDEF void stbi_set_jpeg_parallel_for(stbi_parallel_for *parallel_for, void *user)
+{
+	stbi__jpeg_parallel_for = parallel_for;
+	stbi__jpeg_parallel_user = user;
+}
+
+STBIDEF void stbi_set_jpeg_simd(int max_level)
+{
+	stbi__jpeg_simd = max_level;
+}
+#endif
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
 	memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1752,6 +1839,15 @@ typedef struct
 	void(*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
 	void(*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
 	stbi_uc *(*resample_row_hv_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+#ifdef STBI_FAST_JPEG
+	stbi_uc *(*resample_row_h_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+	// with a kernel for two blocks, baseline blocks wait here for a second one
+	void(*idct_pair_kernel)(stbi_uc *out0, int out_stride0, short data0[64], stbi_uc *out1, int out_stride1, short data1[64]);
+	// only as aligned as the heap makes stbi__jpeg, the pair kernel loads it unaligned
+	short idct_pending[64];
+	stbi_uc *idct_pending_out;
+	int idct_pending_stride;
+#endif
 } stbi__jpeg;
 
 static int stbi__build_huffman(stbi__huffman *h, int *count)
@@ -2455,6 +2551,192 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// the sse2 IDCT on two blocks at once, one in each 128-bit half. every step
+// of it stays within a half, so it's bit-identical to the generic C version too
+static STBI__AVX2_FUNCTION void stbi__idct_avx2_pair(stbi_uc *out0, int out_stride0, short data0[64], stbi_uc *out1, int out_stride1, short data1[64])
+{
+	__m256i row0, row1, row2, row3, row4, row5, row6, row7;
+	__m256i tmp;
+
+	// dot product constant: even elems=x, odd elems=y
+#define dct_const(x,y)  _mm256_set1_epi32((int) (((unsigned int) (y) << 16) | (unsigned short) (x)))
+
+	// out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+	// out(1) = c1[even]*x + c1[odd]*y
+#define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##lo = _mm256_unpacklo_epi16((x),(y)); \
+      __m256i c0##hi = _mm256_unpackhi_epi16((x),(y)); \
+      __m256i out0##_l = _mm256_madd_epi16(c0##lo, c0); \
+      __m256i out0##_h = _mm256_madd_epi16(c0##hi, c0); \
+      __m256i out1##_l = _mm256_madd_epi16(c0##lo, c1); \
+      __m256i out1##_h = _mm256_madd_epi16(c0##hi, c1)
+
+	// out = in << 12  (in 16-bit, out 32-bit)
+#define dct_widen(out, in) \
+      __m256i out##_l = _mm256_srai_epi32(_mm256_unpacklo_epi16(_mm256_setzero_si256(), (in)), 4); \
+      __m256i out##_h = _mm256_srai_epi32(_mm256_unpackhi_epi16(_mm256_setzero_si256(), (in)), 4)
+
+	// wide add
+#define dct_wadd(out, a, b) \
+      __m256i out##_l = _mm256_add_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_add_epi32(a##_h, b##_h)
+
+	// wide sub
+#define dct_wsub(out, a, b) \
+      __m256i out##_l = _mm256_sub_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_sub_epi32(a##_h, b##_h)
+
+	// butterfly a/b, add bias, then shift by "s" and pack
+#define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased_l = _mm256_add_epi32(a##_l, bias); \
+         __m256i abiased_h = _mm256_add_epi32(a##_h, bias); \
+         dct_wadd(sum, abiased, b); \
+         dct_wsub(dif, abiased, b); \
+         out0 = _mm256_packs_epi32(_mm256_srai_epi32(sum_l, s), _mm256_srai_epi32(sum_h, s)); \
+         out1 = _mm256_packs_epi32(_mm256_srai_epi32(dif_l, s), _mm256_srai_epi32(dif_h, s)); \
+      }
+
+	// 8-bit interleave step (for transposes)
+#define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi8(a, b); \
+      b = _mm256_unpackhi_epi8(tmp, b)
+
+	// 16-bit interleave step (for transposes)
+#define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi16(a, b); \
+      b = _mm256_unpackhi_epi16(tmp, b)
+
+#define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m256i sum04 = _mm256_add_epi16(row0, row4); \
+         __m256i dif04 = _mm256_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m256i sum17 = _mm256_add_epi16(row1, row7); \
+         __m256i sum35 = _mm256_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+	// row k of the first block in the low half, of the second in the high half
+#define dct_load(row, k) \
+      row = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (data0 + k * 8))), \
+         _mm_loadu_si128((const __m128i *) (data1 + k * 8)), 1)
+
+	// the low 8 bytes of each half, to each block's output
+#define dct_store(v) \
+      _mm_storel_epi64((__m128i *) out0, _mm256_castsi256_si128(v)); out0 += out_stride0; \
+      _mm_storel_epi64((__m128i *) out1, _mm256_extracti128_si256(v, 1)); out1 += out_stride1
+
+	__m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+	__m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f(0.765366865f), stbi__f2f(0.5411961f));
+	__m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+	__m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+	__m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f(0.298631336f), stbi__f2f(-1.961570560f));
+	__m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f(3.072711026f));
+	__m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f(2.053119869f), stbi__f2f(-0.390180644f));
+	__m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f(1.501321110f));
+
+	// rounding biases in column/row passes, see stbi__idct_block for explanation.
+	__m256i bias_0 = _mm256_set1_epi32(512);
+	__m256i bias_1 = _mm256_set1_epi32(65536 + (128 << 17));
+
+	// load
+	dct_load(row0, 0);
+	dct_load(row1, 1);
+	dct_load(row2, 2);
+	dct_load(row3, 3);
+	dct_load(row4, 4);
+	dct_load(row5, 5);
+	dct_load(row6, 6);
+	dct_load(row7, 7);
+
+	// column pass
+	dct_pass(bias_0, 10);
+
+	{
+		// 16bit 8x8 transpose pass 1
+		dct_interleave16(row0, row4);
+		dct_interleave16(row1, row5);
+		dct_interleave16(row2, row6);
+		dct_interleave16(row3, row7);
+
+		// transpose pass 2
+		dct_interleave16(row0, row2);
+		dct_interleave16(row1, row3);
+		dct_interleave16(row4, row6);
+		dct_interleave16(row5, row7);
+
+		// transpose pass 3
+		dct_interleave16(row0, row1);
+		dct_interleave16(row2, row3);
+		dct_interleave16(row4, row5);
+		dct_interleave16(row6, row7);
+	}
+
+	// row pass
+	dct_pass(bias_1, 17);
+
+	{
+		// pack
+		__m256i p0 = _mm256_packus_epi16(row0, row1);
+		__m256i p1 = _mm256_packus_epi16(row2, row3);
+		__m256i p2 = _mm256_packus_epi16(row4, row5);
+		__m256i p3 = _mm256_packus_epi16(row6, row7);
+
+		// 8bit 8x8 transpose, as in the sse2 version
+		dct_interleave8(p0, p2);
+		dct_interleave8(p1, p3);
+		dct_interleave8(p0, p1);
+		dct_interleave8(p2, p3);
+		dct_interleave8(p0, p2);
+		dct_interleave8(p1, p3);
+
+		// store
+		dct_store(p0);
+		dct_store(_mm256_shuffle_epi32(p0, 0x4e));
+		dct_store(p2);
+		dct_store(_mm256_shuffle_epi32(p2, 0x4e));
+		dct_store(p1);
+		dct_store(_mm256_shuffle_epi32(p1, 0x4e));
+		dct_store(p3);
+		dct_store(_mm256_shuffle_epi32(p3, 0x4e));
+	}
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_wadd
+#undef dct_wsub
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+#undef dct_load
+#undef dct_store
+}
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2697,8 +2979,199 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
 	// since we don't even allow 1<<30 pixels
 }
 
+#ifdef STBI_FAST_JPEG
+// baseline blocks go through the IDCT in pairs when there's a kernel for two,
+// the first one waiting in idct_pending for the second
+static void stbi__jpeg_idct(stbi__jpeg *j, stbi_uc *out, int out_stride, short data[64])
+{
+	if (!j->idct_pair_kernel) {
+		j->idct_block_kernel(out, out_stride, data);
+	}
+	else if (j->idct_pending_out) {
+		j->idct_pair_kernel(j->idct_pending_out, j->idct_pending_stride, j->idct_pending, out, out_stride, data);
+		j->idct_pending_out = NULL;
+	}
+	else {
+		memcpy(j->idct_pending, data, sizeof(j->idct_pending));
+		j->idct_pending_out = out;
+		j->idct_pending_stride = out_stride;
+	}
+}
+
+// the last block of a scan may have no partner. the single block kernel uses
+// aligned loads and stbi__jpeg is heap memory (8-byte aligned on Win32), so
+// the block goes through an aligned copy on the stack
+static void stbi__jpeg_idct_flush(stbi__jpeg *j)
+{
+	if (j->idct_pending_out) {
+		STBI_SIMD_ALIGN(short, data[64]);
+		memcpy(data, j->idct_pending, sizeof(data));
+		j->idct_block_kernel(j->idct_pending_out, j->idct_pending_stride, data);
+		j->idct_pending_out = NULL;
+	}
+}
+
+// one MCU of a baseline scan, numbered in scan order
+static int stbi__jpeg_decode_baseline_mcu(stbi__jpeg *z, short data[64], int mcu)
+{
+	int i, j, k, x, y;
+	if (z->scan_n == 1) {
+		int n = z->order[0];
+		int w = (z->img_comp[n].x + 7) >> 3;
+		int ha = z->img_comp[n].ha;
+		i = mcu % w;
+		j = mcu / w;
+		if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+		stbi__jpeg_idct(z, z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
+		return 1;
+	}
+	i = mcu % z->img_mcu_x;
+	j = mcu / z->img_mcu_x;
+	for (k = 0; k < z->scan_n; ++k) {
+		int n = z->order[k];
+		for (y = 0; y < z->img_comp[n].v; ++y) {
+			for (x = 0; x < z->img_comp[n].h; ++x) {
+				int x2 = (i*z->img_comp[n].h + x) * 8;
+				int y2 = (j*z->img_comp[n].v + y) * 8;
+				int ha = z->img_comp[n].ha;
+				if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+				stbi__jpeg_idct(z, z->img_comp[n].data + z->img_comp[n].w2*y2 + x2, z->img_comp[n].w2, data);
+			}
+		}
+	}
+	return 1;
+}
+
+// images smaller than this aren't worth handing to other threads
+#define STBI__JPEG_PARALLEL_MIN_PIXELS  (256 * 256)
+// restart intervals are grouped into at most this many tasks
+#define STBI__JPEG_PARALLEL_MAX_TASKS   64
+
+typedef struct
+{
+	stbi__jpeg *z;
+	stbi_uc **start, **end; // where each restart interval's bytes are
+	int intervals, tasks, mcus;
+	int *ok;
+} stbi__jpeg_parallel;
+
+static void stbi__jpeg_parallel_task(void *arg, int index)
+{
+	stbi__jpeg_parallel *p = (stbi__jpeg_parallel *)arg;
+	int first = p->intervals * index / p->tasks;
+	int last = p->intervals * (index + 1) / p->tasks;
+	int k, m;
+	STBI_SIMD_ALIGN(short, data[64]);
+	stbi__context s = *p->z->s;
+	// a copy of the decoder for the tables and kernels, with its own bit reader
+	stbi__jpeg *j = (stbi__jpeg *)stbi__malloc(sizeof(stbi__jpeg));
+	p->ok[index] = 0;
+	if (!j) { stbi__err("outofmem", "Out of memory"); return; }
+	*j = *p->z;
+	j->s = &s;
+	j->idct_pending_out = NULL;
+	for (k = first; k < last; ++k) {
+		int end = (k + 1) * j->restart_interval;
+		if (end > p->mcus) end = p->mcus;
+		s.img_buffer = p->start[k];
+		s.img_buffer_end = p->end[k];
+		stbi__jpeg_reset(j);
+		for (m = k * j->restart_interval; m < end; ++m) {
+			if (!stbi__jpeg_decode_baseline_mcu(j, data, m)) {
+				STBI_FREE(j);
+				return;
+			}
+		}
+	}
+	stbi__jpeg_idct_flush(j);
+	STBI_FREE(j);
+	p->ok[index] = 1;
+}
+
+// every restart interval starts with the bit reader and the dc prediction
+// reset, so with the whole scan in memory each can be decoded on its own once
+// its restart marker is found. returns -1 to decode on this thread instead:
+// not from memory, too small, or the markers don't match the intervals
+static int stbi__parse_entropy_coded_data_parallel(stbi__jpeg *z)
+{
+	stbi__jpeg_parallel p;
+	stbi_uc *at = z->s->img_buffer, *end = z->s->img_buffer_end;
+	int k, found = 0, result = 1;
+	if (z->s->io.read || z->s->img_x * z->s->img_y < STBI__JPEG_PARALLEL_MIN_PIXELS) return -1;
+	if (z->scan_n == 1) {
+		int n = z->order[0];
+		p.mcus = ((z->img_comp[n].x + 7) >> 3) * ((z->img_comp[n].y + 7) >> 3);
+	}
+	else {
+		p.mcus = z->img_mcu_x * z->img_mcu_y;
+	}
+	p.intervals = (p.mcus + z->restart_interval - 1) / z->restart_interval;
+	if (p.intervals < 2) return -1;
+	p.start = (stbi_uc **)stbi__malloc_mad2(p.intervals, 2 * sizeof(stbi_uc *), 0);
+	if (!p.start) return stbi__err("outofmem", "Out of memory");
+	p.end = p.start + p.intervals;
+
+	// entropy-coded bytes only have 0xff followed by 0 (a stuffed 0xff), more
+	// 0xff fill, or a marker; RST0-7 between intervals, anything else ends the scan
+	p.start[0] = at;
+	for (;;) {
+		stbi_uc *ff = (stbi_uc *)memchr(at, 0xff, end - at);
+		if (!ff || ff + 1 >= end) {
+			at = end;
+			break;
+		}
+		if (ff[1] == 0x00 || ff[1] == 0xff) {
+			at = ff + (ff[1] == 0x00 ? 2 : 1);
+			continue;
+		}
+		if (!STBI__RESTART(ff[1])) {
+			at = ff;
+			break;
+		}
+		if (found + 1 == p.intervals) {
+			found = -1; // more markers than intervals
+			break;
+		}
+		p.end[found++] = ff;
+		p.start[found] = at = ff + 2;
+	}
+	if (found != p.intervals - 1) {
+		STBI_FREE(p.start);
+		return -1;
+	}
+	p.end[found] = at;
+
+	p.z = z;
+	p.tasks = p.intervals < STBI__JPEG_PARALLEL_MAX_TASKS ? p.intervals : STBI__JPEG_PARALLEL_MAX_TASKS;
+	p.ok = (int *)stbi__malloc_mad2(p.tasks, sizeof(int), 0);
+	if (!p.ok) {
+		STBI_FREE(p.start);
+		return stbi__err("outofmem", "Out of memory");
+	}
+	stbi__jpeg_parallel_for(stbi__jpeg_parallel_user, p.tasks, stbi__jpeg_parallel_task, &p);
+	for (k = 0; k < p.tasks; ++k)
+		if (!p.ok[k]) result = 0;
+	STBI_FREE(p.ok);
+	STBI_FREE(p.start);
+
+	// carry on from the marker after the scan, as if the bit reader had stopped there
+	z->s->img_buffer = at;
+	z->marker = STBI__MARKER_none;
+	return result;
+}
+#else
+#define stbi__jpeg_idct(j, out, out_stride, data)  (j)->idct_block_kernel(out, out_stride, data)
+#define stbi__jpeg_idct_flush(j)                    ((void) 0)
+#endif
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
+#ifdef STBI_FAST_JPEG
+	if (!z->progressive && z->restart_interval && stbi__jpeg_parallel_for) {
+		int result = stbi__parse_entropy_coded_data_parallel(z);
+		if (result >= 0) return result;
+	}
+#endif
 	stbi__jpeg_reset(z);
 	if (!z->progressive) {
 		if (z->scan_n == 1) {
@@ -2715,17 +3188,18 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 				for (i = 0; i < w; ++i) {
 					int ha = z->img_comp[n].ha;
 					if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-					z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
+					stbi__jpeg_idct(z, z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
 					// every data block is an MCU, so countdown the restart interval
 					if (--z->todo <= 0) {
 						if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
 						// if it's NOT a restart, then just bail, so we get corrupt data
 						// rather than no data
-						if (!STBI__RESTART(z->marker)) return 1;
+						if (!STBI__RESTART(z->marker)) { stbi__jpeg_idct_flush(z); return 1; }
 						stbi__jpeg_reset(z);
 					}
 				}
 			}
+			stbi__jpeg_idct_flush(z);
 			return 1;
 		}
 		else { // interleaved
@@ -2744,7 +3218,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 								int y2 = (j*z->img_comp[n].v + y) * 8;
 								int ha = z->img_comp[n].ha;
 								if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-								z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*y2 + x2, z->img_comp[n].w2, data);
+								stbi__jpeg_idct(z, z->img_comp[n].data + z->img_comp[n].w2*y2 + x2, z->img_comp[n].w2, data);
 							}
 						}
 					}
@@ -2752,11 +3226,12 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 					// so now count down the restart interval
 					if (--z->todo <= 0) {
 						if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-						if (!STBI__RESTART(z->marker)) return 1;
+						if (!STBI__RESTART(z->marker)) { stbi__jpeg_idct_flush(z); return 1; }
 						stbi__jpeg_reset(z);
 					}
 				}
 			}
+			stbi__jpeg_idct_flush(z);
 			return 1;
 		}
 	}
@@ -3374,6 +3849,92 @@ static stbi_uc *stbi__resample_row_hv_2_simd(stbi_uc *out, stbi_uc *in_near, stb
 }
 #endif
 
+#ifdef STBI_AVX2
+// the generic 2x upsamplers, 16 input pixels a step. the neighbours come from
+// unaligned loads one pixel either side rather than shifts, which would have
+// to cross the 128-bit halves
+static STBI__AVX2_FUNCTION stbi_uc *stbi__resample_row_h_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+	int i;
+	stbi_uc *input = in_near;
+
+	if (w == 1) {
+		out[0] = out[1] = input[0];
+		return out;
+	}
+
+	out[0] = input[0];
+	out[1] = stbi__div4(input[0] * 3 + input[1] + 2);
+	for (i = 1; i + 16 < w; i += 16) {
+		__m256i prev = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (input + i - 1)));
+		__m256i curr = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (input + i)));
+		__m256i next = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (input + i + 1)));
+		// 3 * curr + 2, shared by both outputs
+		__m256i n = _mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(curr, 1), curr), _mm256_set1_epi16(2));
+		__m256i even = _mm256_srli_epi16(_mm256_add_epi16(n, prev), 2);
+		__m256i odd = _mm256_srli_epi16(_mm256_add_epi16(n, next), 2);
+		// interleaving within the halves then packing them puts all 32 bytes in order
+		__m256i outv = _mm256_packus_epi16(_mm256_unpacklo_epi16(even, odd), _mm256_unpackhi_epi16(even, odd));
+		_mm256_storeu_si256((__m256i *) (out + i * 2), outv);
+	}
+	for (; i < w - 1; ++i) {
+		int n = 3 * input[i] + 2;
+		out[i * 2 + 0] = stbi__div4(n + input[i - 1]);
+		out[i * 2 + 1] = stbi__div4(n + input[i + 1]);
+	}
+	out[i * 2 + 0] = stbi__div4(input[w - 2] * 3 + input[w - 1] + 2);
+	out[i * 2 + 1] = input[w - 1];
+
+	STBI_NOTUSED(in_far);
+	STBI_NOTUSED(hs);
+
+	return out;
+}
+
+static STBI__AVX2_FUNCTION stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+	int i, t0, t1;
+	if (w == 1) {
+		out[0] = out[1] = stbi__div4(3 * in_near[0] + in_far[0] + 2);
+		return out;
+	}
+
+	t1 = 3 * in_near[0] + in_far[0];
+	out[0] = stbi__div4(t1 + 2);
+	for (i = 1; i + 16 <= w; i += 16) {
+		// vertical pass, 3*near + far, for these pixels and the ones before them
+		__m256i prev_near = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (in_near + i - 1)));
+		__m256i prev_far = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (in_far + i - 1)));
+		__m256i curr_near = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (in_near + i)));
+		__m256i curr_far = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (in_far + i)));
+		__m256i prev = _mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(prev_near, 1), prev_near), prev_far);
+		__m256i curr = _mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(curr_near, 1), curr_near), curr_far);
+
+		// horizontal pass, as the generic loop: out[i*2-1] from 3*prev + curr,
+		// out[i*2] from 3*curr + prev
+		__m256i bias = _mm256_set1_epi16(8);
+		__m256i sum = _mm256_add_epi16(_mm256_add_epi16(prev, curr), bias);
+		__m256i odd = _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_slli_epi16(prev, 1)), 4);
+		__m256i even = _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_slli_epi16(curr, 1)), 4);
+		__m256i outv = _mm256_packus_epi16(_mm256_unpacklo_epi16(odd, even), _mm256_unpackhi_epi16(odd, even));
+		_mm256_storeu_si256((__m256i *) (out + i * 2 - 1), outv);
+	}
+
+	t1 = 3 * in_near[i - 1] + in_far[i - 1];
+	for (; i < w; ++i) {
+		t0 = t1;
+		t1 = 3 * in_near[i] + in_far[i];
+		out[i * 2 - 1] = stbi__div16(3 * t0 + t1 + 8);
+		out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+	}
+	out[w * 2 - 1] = stbi__div4(t1 + 2);
+
+	STBI_NOTUSED(hs);
+
+	return out;
+}
+#endif
+
 static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
 {
 	// resample with nearest-neighbor
@@ -3548,6 +4109,112 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// the sse2 conversion 16 pixels a step, and for 3 channel output too: the
+// 4 channel pixels are packed down to 3 bytes each with a byte shuffle
+static STBI__AVX2_FUNCTION void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+	int i = 0;
+
+	if (step == 3 || step == 4) {
+		__m128i signflip = _mm_set1_epi8(-0x80);
+		__m256i cr_const0 = _mm256_set1_epi16((short)(1.40200f*4096.0f + 0.5f));
+		__m256i cr_const1 = _mm256_set1_epi16(-(short)(0.71414f*4096.0f + 0.5f));
+		__m256i cb_const0 = _mm256_set1_epi16(-(short)(0.34414f*4096.0f + 0.5f));
+		__m256i cb_const1 = _mm256_set1_epi16((short)(1.77200f*4096.0f + 0.5f));
+		__m256i y_bias = _mm256_set1_epi16(128);
+		__m256i xw = _mm256_set1_epi16(255); // alpha channel
+		// per half: bytes 0-2, 4-6, 8-10 and 12-14 to the front, then the two
+		// halves' 12 bytes together
+		__m256i rgb_bytes = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		__m256i rgb_words = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+		for (; i + 15 < count; i += 16) {
+			// load, unpack to short: y as y << 8 | 128, cr and cb as (x - 128) << 8
+			__m128i y_bytes = _mm_loadu_si128((const __m128i *) (y + i));
+			__m128i cr_biased = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (pcr + i)), signflip);
+			__m128i cb_biased = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (pcb + i)), signflip);
+			__m256i yw = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(y_bytes), 8), y_bias);
+			__m256i crw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(cr_biased), 8);
+			__m256i cbw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(cb_biased), 8);
+
+			// color transform
+			__m256i yws = _mm256_srli_epi16(yw, 4);
+			__m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+			__m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+			__m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+			__m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+			__m256i rws = _mm256_add_epi16(cr0, yws);
+			__m256i gwt = _mm256_add_epi16(cb0, yws);
+			__m256i bws = _mm256_add_epi16(yws, cb1);
+			__m256i gws = _mm256_add_epi16(gwt, cr1);
+
+			// descale
+			__m256i rw = _mm256_srai_epi16(rws, 4);
+			__m256i bw = _mm256_srai_epi16(bws, 4);
+			__m256i gw = _mm256_srai_epi16(gws, 4);
+
+			// back to byte, set up for transpose
+			__m256i brb = _mm256_packus_epi16(rw, bw);
+			__m256i gxb = _mm256_packus_epi16(gw, xw);
+
+			// transpose to interleave channels: o0 has pixels 0-3 and 8-11,
+			// o1 has 4-7 and 12-15
+			__m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+			__m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+			__m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+			__m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+			__m256i first = _mm256_permute2x128_si256(o0, o1, 0x20);
+			__m256i second = _mm256_permute2x128_si256(o0, o1, 0x31);
+
+			// store
+			if (step == 4) {
+				_mm256_storeu_si256((__m256i *) (out + 0), first);
+				_mm256_storeu_si256((__m256i *) (out + 32), second);
+				out += 64;
+			}
+			else {
+				first = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(first, rgb_bytes), rgb_words);
+				second = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(second, rgb_bytes), rgb_words);
+				_mm_storeu_si128((__m128i *) (out + 0), _mm256_castsi256_si128(first));
+				_mm_storel_epi64((__m128i *) (out + 16), _mm256_extracti128_si256(first, 1));
+				_mm_storeu_si128((__m128i *) (out + 24), _mm256_castsi256_si128(second));
+				_mm_storel_epi64((__m128i *) (out + 40), _mm256_extracti128_si256(second, 1));
+				out += 48;
+			}
+		}
+	}
+
+	for (; i < count; ++i) {
+		int y_fixed = (y[i] << 20) + (1 << 19); // rounding
+		int r, g, b;
+		int cr = pcr[i] - 128;
+		int cb = pcb[i] - 128;
+		r = y_fixed + cr * stbi__float2fixed(1.40200f);
+		g = y_fixed + cr * -stbi__float2fixed(0.71414f) + ((cb*-stbi__float2fixed(0.34414f)) & 0xffff0000);
+		b = y_fixed + cb * stbi__float2fixed(1.77200f);
+		r >>= 20;
+		g >>= 20;
+		b >>= 20;
+		if ((unsigned)r > 255) { if (r < 0) r = 0; else r = 255; }
+		if ((unsigned)g > 255) { if (g < 0) g = 0; else g = 255; }
+		if ((unsigned)b > 255) { if (b < 0) b = 0; else b = 255; }
+		out[0] = (stbi_uc)r;
+		out[1] = (stbi_uc)g;
+		out[2] = (stbi_uc)b;
+		out[3] = 255;
+		out += step;
+	}
+}
+#endif
+
+#ifdef STBI_FAST_JPEG
+#define STBI__JPEG_SIMD(level)  (stbi__jpeg_simd >= (level))
+#else
+#define STBI__JPEG_SIMD(level)  1
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
@@ -3555,8 +4222,14 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
 	j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
 	j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
 
+#ifdef STBI_FAST_JPEG
+	j->resample_row_h_2_kernel = stbi__resample_row_h_2;
+	j->idct_pair_kernel = NULL;
+	j->idct_pending_out = NULL;
+#endif
+
 #ifdef STBI_SSE2
-	if (stbi__sse2_available()) {
+	if (STBI__JPEG_SIMD(1) && stbi__sse2_available()) {
 		j->idct_block_kernel = stbi__idct_simd;
 		j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
 		j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
@@ -3564,9 +4237,20 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
 #endif
 
 #ifdef STBI_NEON
-	j->idct_block_kernel = stbi__idct_simd;
-	j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
-	j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+	if (STBI__JPEG_SIMD(1)) {
+		j->idct_block_kernel = stbi__idct_simd;
+		j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
+		j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+	}
+#endif
+
+#ifdef STBI_AVX2
+	if (STBI__JPEG_SIMD(2) && stbi__avx2_available()) {
+		j->idct_pair_kernel = stbi__idct_avx2_pair;
+		j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+		j->resample_row_h_2_kernel = stbi__resample_row_h_2_avx2;
+		j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+	}
 #endif
 }
 
@@ -3640,7 +4324,11 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
 
 			if (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
 			else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
+#ifdef STBI_FAST_JPEG
+			else if (r->hs == 2 && r->vs == 1) r->resample = z->resample_row_h_2_kernel;
+#else
 			else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
+#endif
 			else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
 			else                               r->resample = stbi__resample_row_generic;
 		}
@@ -3903,6 +4591,32 @@ static int stbi__zbuild_huffman(stbi__zhuffman *z, const stbi_uc *sizelist, int
 //    we require PNG read all the IDATs and combine them into a single
 //    memory buffer
 
+#ifdef STBI_FAST_PNG
+// one lookup of the low STBI__ZFAST_LENGTH_BITS bits of the bit buffer
+#define STBI__ZFAST_LENGTH_BITS    11
+#define STBI__ZFAST_DISTANCE_BITS  10
+
+enum
+{
+	STBI__ZFAST_SLOW,      // code longer than the table, walk the canonical code
+	STBI__ZFAST_LITERAL,   // value is the literal
+	STBI__ZFAST_LITERALS,  // two literals, first in the low byte of value
+	STBI__ZFAST_LENGTH,    // value is the length base, extra its extra bits
+	STBI__ZFAST_END,       // end of block
+	STBI__ZFAST_INVALID    // length symbols 286 and 287
+};
+
+typedef struct
+{
+	stbi_uc bits; // consumed by the whole entry
+	stbi_uc kind;
+	stbi_uc extra;
+	stbi__uint16 value;
+} stbi__zfast_entry;
+
+typedef unsigned long long stbi__zbits;
+#endif
+
 typedef struct
 {
 	stbi_uc *zbuffer, *zbuffer_end;
@@ -3915,6 +4629,10 @@ typedef struct
 	int   z_expandable;
 
 	stbi__zhuffman z_length, z_distance;
+#ifdef STBI_FAST_PNG
+	stbi__zfast_entry fast_length[1 << STBI__ZFAST_LENGTH_BITS];
+	stbi__zfast_entry fast_distance[1 << STBI__ZFAST_DISTANCE_BITS];
+#endif
 } stbi__zbuf;
 
 stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
@@ -4007,6 +4725,262 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
 
+#ifdef STBI_FAST_PNG
+// fills 'table' from a code already checked by stbi__zbuild_huffman, with the
+// same canonical code assignment. 'symbol' turns a symbol into an entry
+static void stbi__zbuild_fast(stbi__zfast_entry *table, int table_bits, const stbi_uc *sizelist, int num,
+	void(*symbol)(stbi__zfast_entry *e, int symbol))
+{
+	int i, j, code, next_code[16], sizes[16];
+	memset(sizes, 0, sizeof(sizes));
+	memset(table, 0, sizeof(stbi__zfast_entry) << table_bits);
+	for (i = 0; i < num; ++i)
+		++sizes[sizelist[i]];
+	sizes[0] = 0;
+	code = 0;
+	for (i = 1; i < 16; ++i) {
+		next_code[i] = code;
+		code = (code + sizes[i]) << 1;
+	}
+	for (i = 0; i < num; ++i) {
+		int s = sizelist[i];
+		if (!s) continue;
+		code = next_code[s]++;
+		if (s > table_bits) continue;
+		for (j = stbi__bit_reverse(code, s); j < (1 << table_bits); j += 1 << s) {
+			symbol(&table[j], i);
+			table[j].bits = (stbi_uc)s;
+		}
+	}
+}
+
+static void stbi__zfast_length_symbol(stbi__zfast_entry *e, int symbol)
+{
+	if (symbol < 256) {
+		e->kind = STBI__ZFAST_LITERAL;
+		e->value = (stbi__uint16)symbol;
+	}
+	else if (symbol == 256) {
+		e->kind = STBI__ZFAST_END;
+	}
+	else if (symbol < 286) {
+		e->kind = STBI__ZFAST_LENGTH;
+		e->value = (stbi__uint16)stbi__zlength_base[symbol - 257];
+		e->extra = (stbi_uc)stbi__zlength_extra[symbol - 257];
+	}
+	else {
+		e->kind = STBI__ZFAST_INVALID;
+	}
+}
+
+static void stbi__zfast_distance_symbol(stbi__zfast_entry *e, int symbol)
+{
+	e->kind = symbol < 30 ? STBI__ZFAST_LENGTH : STBI__ZFAST_INVALID;
+	e->value = (stbi__uint16)stbi__zdist_base[symbol];
+	e->extra = (stbi_uc)stbi__zdist_extra[symbol];
+}
+
+static void stbi__zbuild_fast_tables(stbi__zbuf *a, const stbi_uc *lengths, int hlit, const stbi_uc *distances, int hdist)
+{
+	int j;
+	stbi__zfast_entry *t = a->fast_length;
+	stbi__zbuild_fast(t, STBI__ZFAST_LENGTH_BITS, lengths, hlit, stbi__zfast_length_symbol);
+	stbi__zbuild_fast(a->fast_distance, STBI__ZFAST_DISTANCE_BITS, distances, hdist, stbi__zfast_distance_symbol);
+	// a literal whose code leaves room for a second one gets both. going down,
+	// the entry the second lookup reads (j >> bits < j) is still a single one
+	for (j = (1 << STBI__ZFAST_LENGTH_BITS) - 1; j >= 0; --j) {
+		stbi__zfast_entry *first = &t[j];
+		stbi__zfast_entry *second;
+		if (first->kind != STBI__ZFAST_LITERAL) continue;
+		second = &t[j >> first->bits];
+		if (second->kind == STBI__ZFAST_LITERAL && first->bits + second->bits <= STBI__ZFAST_LENGTH_BITS) {
+			first->kind = STBI__ZFAST_LITERALS;
+			first->value = (stbi__uint16)(first->value | (second->value << 8));
+			first->bits = (stbi_uc)(first->bits + second->bits);
+		}
+	}
+}
+
+// the symbol for a code longer than the table, as stbi__zhuffman_decode_slowpath
+static int stbi__zfast_slow_symbol(stbi__zhuffman *z, stbi__zbits *bits, int *count, int table_bits)
+{
+	int b, s, k = stbi__bit_reverse((int)(*bits & 0xffff), 16);
+	for (s = table_bits + 1; ; ++s)
+		if (k < z->maxcode[s])
+			break;
+	if (s >= 16) return -1;
+	b = (k >> (16 - s)) - z->firstcode[s] + z->firstsymbol[s];
+	*bits >>= s;
+	*count -= s;
+	return z->value[b];
+}
+
+stbi_inline static stbi__zbits stbi__zload64(const stbi_uc *p)
+{
+#if defined(STBI__X86_TARGET) || defined(STBI__X64_TARGET)
+	stbi__zbits v;
+	memcpy(&v, p, 8); // little-endian, unaligned loads are fine
+	return v;
+#else
+	return (stbi__zbits)p[0] | ((stbi__zbits)p[1] << 8) | ((stbi__zbits)p[2] << 16) | ((stbi__zbits)p[3] << 24) |
+		((stbi__zbits)p[4] << 32) | ((stbi__zbits)p[5] << 40) | ((stbi__zbits)p[6] << 48) | ((stbi__zbits)p[7] << 56);
+#endif
+}
+
+// stbi__parse_huffman_block with the bit buffer in registers. it holds at
+// least 56 bits after a refill, enough for a length, a distance and both
+// their extra bits. past the end of the input it reads zeros, as stbi__zget8
+static int stbi__parse_huffman_block_fast(stbi__zbuf *a)
+{
+	char *zout = a->zout;
+	const stbi_uc *in = a->zbuffer;
+	const stbi_uc *in_end = a->zbuffer_end;
+	stbi__zbits bits = a->code_buffer;
+	int count = a->num_bits;
+	int phantom = 0; // zero bytes fed in past the end
+	int result = 1;
+	for (;;) {
+		const stbi__zfast_entry *e;
+		int len, dist, symbol;
+		stbi_uc *p;
+		if (count < 48) {
+			if (in_end - in >= 8) {
+				// bits above 'count' are left as they were loaded, the next refill ORs in the same bytes
+				bits |= stbi__zload64(in) << count;
+				in += (63 - count) >> 3;
+				count |= 56;
+			}
+			else {
+				while (count <= 56) {
+					if (in < in_end) bits |= (stbi__zbits)*in++ << count;
+					else ++phantom;
+					count += 8;
+				}
+			}
+		}
+		e = &a->fast_length[bits & ((1 << STBI__ZFAST_LENGTH_BITS) - 1)];
+		if (e->kind == STBI__ZFAST_LITERALS) {
+			if (zout + 2 > a->zout_end) {
+				if (!stbi__zexpand(a, zout, 2)) { result = 0; break; }
+				zout = a->zout;
+			}
+			zout[0] = (char)(e->value & 255);
+			zout[1] = (char)(e->value >> 8);
+			zout += 2;
+			bits >>= e->bits;
+			count -= e->bits;
+			continue;
+		}
+		if (e->kind == STBI__ZFAST_SLOW) {
+			symbol = stbi__zfast_slow_symbol(&a->z_length, &bits, &count, STBI__ZFAST_LENGTH_BITS);
+			if (symbol < 0 || symbol >= 286) { result = stbi__err("bad huffman code", "Corrupt PNG"); break; }
+			if (symbol < 256) {
+				len = 0;
+				dist = symbol; // a literal
+			}
+			else if (symbol == 256) {
+				break;
+			}
+			else {
+				len = stbi__zlength_base[symbol - 257];
+				if (stbi__zlength_extra[symbol - 257]) {
+					len += (int)(bits & ((1 << stbi__zlength_extra[symbol - 257]) - 1));
+					bits >>= stbi__zlength_extra[symbol - 257];
+					count -= stbi__zlength_extra[symbol - 257];
+				}
+				dist = -1;
+			}
+		}
+		else {
+			bits >>= e->bits;
+			count -= e->bits;
+			if (e->kind == STBI__ZFAST_LITERAL) {
+				len = 0;
+				dist = e->value;
+			}
+			else if (e->kind == STBI__ZFAST_END) {
+				break;
+			}
+			else if (e->kind == STBI__ZFAST_INVALID) {
+				result = stbi__err("bad huffman code", "Corrupt PNG");
+				break;
+			}
+			else {
+				len = e->value + (int)(bits & ((1 << e->extra) - 1));
+				bits >>= e->extra;
+				count -= e->extra;
+				dist = -1;
+			}
+		}
+		if (len == 0) {
+			if (zout >= a->zout_end) {
+				if (!stbi__zexpand(a, zout, 1)) { result = 0; break; }
+				zout = a->zout;
+			}
+			*zout++ = (char)dist;
+			continue;
+		}
+
+		e = &a->fast_distance[bits & ((1 << STBI__ZFAST_DISTANCE_BITS) - 1)];
+		if (e->kind == STBI__ZFAST_SLOW) {
+			symbol = stbi__zfast_slow_symbol(&a->z_distance, &bits, &count, STBI__ZFAST_DISTANCE_BITS);
+			if (symbol < 0 || symbol >= 30) { result = stbi__err("bad huffman code", "Corrupt PNG"); break; }
+			dist = stbi__zdist_base[symbol];
+			if (stbi__zdist_extra[symbol]) {
+				dist += (int)(bits & ((1 << stbi__zdist_extra[symbol]) - 1));
+				bits >>= stbi__zdist_extra[symbol];
+				count -= stbi__zdist_extra[symbol];
+			}
+		}
+		else if (e->kind == STBI__ZFAST_INVALID) {
+			result = stbi__err("bad huffman code", "Corrupt PNG");
+			break;
+		}
+		else {
+			bits >>= e->bits;
+			count -= e->bits;
+			dist = e->value + (int)(bits & ((1 << e->extra) - 1));
+			bits >>= e->extra;
+			count -= e->extra;
+		}
+		if (zout - a->zout_start < dist) { result = stbi__err("bad dist", "Corrupt PNG"); break; }
+		if (zout + len > a->zout_end) {
+			if (!stbi__zexpand(a, zout, len)) { result = 0; break; }
+			zout = a->zout;
+		}
+		p = (stbi_uc *)(zout - dist);
+		if (dist == 1) {
+			memset(zout, *p, len);
+			zout += len;
+		}
+		else if (dist >= 8 && zout + len + 8 <= a->zout_end) {
+			// 8 bytes at a time, never reading what this copy hasn't written yet.
+			// the last copy can run past 'len', into space the next output overwrites
+			char *end = zout + len;
+			do {
+				memcpy(zout, p, 8);
+				zout += 8;
+				p += 8;
+			} while (zout < end);
+			zout = end;
+		}
+		else {
+			do *zout++ = *p++; while (--len);
+		}
+	}
+	// hand the whole bytes still in the buffer back to the input
+	while (count >= 8) {
+		if (phantom > 0) --phantom;
+		else --in;
+		count -= 8;
+	}
+	a->code_buffer = (stbi__uint32)(bits & ((1u << count) - 1));
+	a->num_bits = count;
+	a->zbuffer = (stbi_uc *)in;
+	if (result) a->zout = zout;
+	return result;
+}
+#else
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
 	char *zout = a->zout;
@@ -4050,6 +5024,7 @@ static int stbi__parse_huffman_block(stbi__zbuf *a)
 		}
 	}
 }
+#endif
 
 static int stbi__compute_huffman_codes(stbi__zbuf *a)
 {
@@ -4098,6 +5073,9 @@ static int stbi__compute_huffman_codes(stbi__zbuf *a)
 	if (n != ntot) return stbi__err("bad codelengths", "Corrupt PNG");
 	if (!stbi__zbuild_huffman(&a->z_length, lencodes, hlit)) return 0;
 	if (!stbi__zbuild_huffman(&a->z_distance, lencodes + hlit, hdist)) return 0;
+#ifdef STBI_FAST_PNG
+	stbi__zbuild_fast_tables(a, lencodes, hlit, lencodes + hlit, hdist);
+#endif
 	return 1;
 }
 
@@ -4193,11 +5171,18 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
 				// use fixed code lengths
 				if (!stbi__zbuild_huffman(&a->z_length, stbi__zdefault_length, 288)) return 0;
 				if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance, 32)) return 0;
+#ifdef STBI_FAST_PNG
+				stbi__zbuild_fast_tables(a, stbi__zdefault_length, 288, stbi__zdefault_distance, 32);
+#endif
 			}
 			else {
 				if (!stbi__compute_huffman_codes(a)) return 0;
 			}
+#ifdef STBI_FAST_PNG
+			if (!stbi__parse_huffman_block_fast(a)) return 0;
+#else
 			if (!stbi__parse_huffman_block(a)) return 0;
+#endif
 		}
 	} while (!final);
 	return 1;
@@ -4368,6 +5353,151 @@ static int stbi__paeth(int a, int b, int c)
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
 // create the png data from post-deflated data
+#if defined(STBI_FAST_PNG) && defined(STBI_SSE2)
+// one 3 or 4 byte pixel in the low lanes of a register and back
+// (3 byte ones are put together in a register, a memcpy goes through the stack)
+stbi_inline static __m128i stbi__png_load3(const stbi_uc *p)
+{
+	return _mm_cvtsi32_si128(p[0] | (p[1] << 8) | (p[2] << 16));
+}
+
+stbi_inline static __m128i stbi__png_load4(const stbi_uc *p)
+{
+	int v;
+	memcpy(&v, p, 4);
+	return _mm_cvtsi32_si128(v);
+}
+
+stbi_inline static void stbi__png_store3(stbi_uc *p, __m128i v)
+{
+	int w = _mm_cvtsi128_si32(v);
+	p[0] = STBI__BYTECAST(w);
+	p[1] = STBI__BYTECAST(w >> 8);
+	p[2] = STBI__BYTECAST(w >> 16);
+}
+
+stbi_inline static void stbi__png_store4(stbi_uc *p, __m128i v)
+{
+	int w = _mm_cvtsi128_si32(v);
+	memcpy(p, &w, 4);
+}
+
+// d + (a + b) / 2 for every channel. _mm_avg_epu8 rounds up, the filter down
+stbi_inline static __m128i stbi__png_avg_pixel(__m128i a, __m128i b, __m128i d)
+{
+	__m128i odd = _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1));
+	return _mm_add_epi8(d, _mm_sub_epi8(_mm_avg_epu8(a, b), odd));
+}
+
+// d + the paeth predictor, with a, b and c widened to 16 bits:
+// pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|, ties go to a, then b
+stbi_inline static __m128i stbi__png_paeth_pixel(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i pa = _mm_sub_epi16(b, c);
+	__m128i pb = _mm_sub_epi16(a, c);
+	__m128i pc = _mm_add_epi16(pa, pb);
+	__m128i smallest, pick, pred;
+	pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+	pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+	pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+	smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+	pick = _mm_cmpeq_epi16(smallest, pb);
+	pred = _mm_or_si128(_mm_and_si128(pick, b), _mm_andnot_si128(pick, c));
+	pick = _mm_cmpeq_epi16(smallest, pa);
+	pred = _mm_or_si128(_mm_and_si128(pick, a), _mm_andnot_si128(pick, pred));
+	return _mm_add_epi8(d, _mm_packus_epi16(pred, pred));
+}
+
+// unfilters the rest of an 8-bit row of 3 or 4 byte pixels, the first pixel
+// is done. 'n' is the bytes left. 0 for the filters it doesn't do.
+// sub is a prefix sum over the pixels in a register, avg and paeth depend on
+// the pixel to the left so they go a pixel at a time with every channel at once
+static int stbi__png_unfilter_sse2(int filter, stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int n, int bpp)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a, c;
+	int k = 0;
+	if (!stbi__sse2_available()) return 0;
+	switch (filter) {
+	case STBI__F_up:
+		for (; k + 16 <= n; k += 16) {
+			__m128i d = _mm_loadu_si128((const __m128i *)(raw + k));
+			__m128i b = _mm_loadu_si128((const __m128i *)(prior + k));
+			_mm_storeu_si128((__m128i *)(cur + k), _mm_add_epi8(d, b));
+		}
+		for (; k < n; ++k) cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+		return 1;
+	case STBI__F_sub:
+		// 4 pixels a step, adding each to the next then pairs to the next pair.
+		// a 3 byte step stores 16 bytes, the 4 past the pixels are written again next step
+		if (bpp == 3) {
+			a = stbi__png_load3(cur - 3);
+			for (; k + 16 <= n; k += 12) {
+				__m128i d = _mm_loadu_si128((const __m128i *)(raw + k));
+				d = _mm_add_epi8(d, _mm_slli_si128(d, 3));
+				d = _mm_add_epi8(d, _mm_slli_si128(d, 6));
+				a = _mm_or_si128(a, _mm_slli_si128(a, 3));
+				a = _mm_or_si128(a, _mm_slli_si128(a, 6));
+				d = _mm_add_epi8(d, a);
+				_mm_storeu_si128((__m128i *)(cur + k), d);
+				a = _mm_and_si128(_mm_srli_si128(d, 9), _mm_setr_epi32(0xffffff, 0, 0, 0));
+			}
+		}
+		else {
+			a = stbi__png_load4(cur - 4);
+			for (; k + 16 <= n; k += 16) {
+				__m128i d = _mm_loadu_si128((const __m128i *)(raw + k));
+				d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+				d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+				d = _mm_add_epi8(d, _mm_shuffle_epi32(a, 0x00));
+				_mm_storeu_si128((__m128i *)(cur + k), d);
+				a = _mm_srli_si128(d, 12);
+			}
+		}
+		for (; k < n; ++k) cur[k] = STBI__BYTECAST(raw[k] + cur[k - bpp]);
+		return 1;
+	case STBI__F_avg:
+		if (bpp == 3) {
+			for (a = stbi__png_load3(cur - 3); k < n; k += 3) {
+				a = stbi__png_avg_pixel(a, stbi__png_load3(prior + k), stbi__png_load3(raw + k));
+				stbi__png_store3(cur + k, a);
+			}
+		}
+		else {
+			for (a = stbi__png_load4(cur - 4); k < n; k += 4) {
+				a = stbi__png_avg_pixel(a, stbi__png_load4(prior + k), stbi__png_load4(raw + k));
+				stbi__png_store4(cur + k, a);
+			}
+		}
+		return 1;
+	case STBI__F_paeth:
+		if (bpp == 3) {
+			__m128i d = stbi__png_load3(cur - 3);
+			c = _mm_unpacklo_epi8(stbi__png_load3(prior - 3), zero);
+			for (; k < n; k += 3) {
+				__m128i b = _mm_unpacklo_epi8(stbi__png_load3(prior + k), zero);
+				d = stbi__png_paeth_pixel(_mm_unpacklo_epi8(d, zero), b, c, stbi__png_load3(raw + k));
+				stbi__png_store3(cur + k, d);
+				c = b;
+			}
+		}
+		else {
+			__m128i d = stbi__png_load4(cur - 4);
+			c = _mm_unpacklo_epi8(stbi__png_load4(prior - 4), zero);
+			for (; k < n; k += 4) {
+				__m128i b = _mm_unpacklo_epi8(stbi__png_load4(prior + k), zero);
+				d = stbi__png_paeth_pixel(_mm_unpacklo_epi8(d, zero), b, c, stbi__png_load4(raw + k));
+				stbi__png_store4(cur + k, d);
+				c = b;
+			}
+		}
+		return 1;
+	}
+	return 0;
+}
+#endif
+
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
 	int bytes = (depth == 16 ? 2 : 1);
@@ -4451,6 +5581,13 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
 		// this is a little gross, so that we don't switch per-pixel or per-component
 		if (depth < 8 || img_n == out_n) {
 			int nk = (width - 1)*filter_bytes;
+#if defined(STBI_FAST_PNG) && defined(STBI_SSE2)
+			if (depth == 8 && (filter_bytes == 3 || filter_bytes == 4) &&
+				stbi__png_unfilter_sse2(filter, cur, prior, raw, nk, filter_bytes)) {
+				raw += nk;
+				continue;
+			}
+#endif
 #define STBI__CASE(f) \
              case f:     \
                 for (k=0; k < nk; ++k)
@@ -0,0 +1,23 @@
+#pragma once
+/******************************************************************************\
+| The clock everything that measures how long something took reads: the        |
+| monotonic std::chrono::steady_clock, as a double so intervals are a plain    |
+| subtraction. Only differences mean anything, the origin is arbitrary.        |
+| Inline so the tools get it without linking anything else.                    |
+\******************************************************************************/
+#ifndef _STEADY_TIME_H_
+#define _STEADY_TIME_H_
+
+#include <chrono>
+
+inline double now_seconds() {
+	return std::chrono::duration<double>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline double now_ms() {
+	return std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
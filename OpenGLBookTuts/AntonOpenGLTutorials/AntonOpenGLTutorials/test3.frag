@@ -1,6 +0,0 @@
-	#version 410
-	out vec4 frag_colour;
-	void main()
-	{
-		frag_colour = vec4(0.0, 0.0, 1.0, 1.0);
-	};
\ No newline at end of file
@@ -0,0 +1,328 @@
+#include "texture_atlas.h"
+#include "mip_generator.h"
+#include <algorithm>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+int round_up_4(int value) {
+	return (value + 3) & ~3;
+}
+
+bool overlaps(const atlas_rect_t &a, const atlas_rect_t &b) {
+	return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+bool contains(const atlas_rect_t &outer, const atlas_rect_t &inner) {
+	return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width &&
+		inner.y + inner.height <= outer.y + outer.height;
+}
+
+// the room an entry takes in the atlas, gutters included
+int slot_width(const atlas_t *atlas, const atlas_entry_t &entry) {
+	return round_up_4(entry.width) + 2 * atlas->padding;
+}
+
+int slot_height(const atlas_t *atlas, const atlas_entry_t &entry) {
+	return round_up_4(entry.height) + 2 * atlas->padding;
+}
+
+void compute_uvs(atlas_t *atlas) {
+	for (size_t i = 0; i < atlas->entries.size(); i++) {
+		atlas_entry_t &entry = atlas->entries[i];
+		float top = (float)entry.y / atlas->height;
+		float bottom = (float)(entry.y + entry.height) / atlas->height;
+		entry.u0 = (float)entry.x / atlas->width;
+		entry.u1 = (float)(entry.x + entry.width) / atlas->width;
+		// flipped, the image's last row is nearest v = 0
+		entry.v0 = atlas->bottom_up ? 1.0f - bottom : top;
+		entry.v1 = atlas->bottom_up ? 1.0f - top : bottom;
+	}
+}
+
+} // namespace
+
+void maxrects_init(maxrects_t *bin, int width, int height) {
+	bin->width = width;
+	bin->height = height;
+	bin->free.clear();
+	atlas_rect_t all = { 0, 0, width, height };
+	bin->free.push_back(all);
+}
+
+bool maxrects_insert(maxrects_t *bin, int width, int height, atlas_rect_t *placed) {
+	int best = -1;
+	int best_short = INT_MAX, best_long = INT_MAX;
+	for (size_t i = 0; i < bin->free.size(); i++) {
+		const atlas_rect_t &f = bin->free[i];
+		if (f.width < width || f.height < height) {
+			continue;
+		}
+		int short_side = std::min(f.width - width, f.height - height);
+		int long_side = std::max(f.width - width, f.height - height);
+		if (short_side < best_short || (short_side == best_short && long_side < best_long)) {
+			best = (int)i;
+			best_short = short_side;
+			best_long = long_side;
+		}
+	}
+	if (best < 0) {
+		return false;
+	}
+	atlas_rect_t r = { bin->free[best].x, bin->free[best].y, width, height };
+
+	// every free rectangle the new one overlaps becomes the (up to four) maximal
+	// ones left around it
+	std::vector<atlas_rect_t> split;
+	for (size_t i = 0; i < bin->free.size(); i++) {
+		const atlas_rect_t f = bin->free[i];
+		if (!overlaps(f, r)) {
+			split.push_back(f);
+			continue;
+		}
+		if (r.x > f.x) {
+			atlas_rect_t left = { f.x, f.y, r.x - f.x, f.height };
+			split.push_back(left);
+		}
+		if (r.x + r.width < f.x + f.width) {
+			atlas_rect_t right = { r.x + r.width, f.y, f.x + f.width - r.x - r.width, f.height };
+			split.push_back(right);
+		}
+		if (r.y > f.y) {
+			atlas_rect_t above = { f.x, f.y, f.width, r.y - f.y };
+			split.push_back(above);
+		}
+		if (r.y + r.height < f.y + f.height) {
+			atlas_rect_t below = { f.x, r.y + r.height, f.width, f.y + f.height - r.y - r.height };
+			split.push_back(below);
+		}
+	}
+	// and the ones inside another are dropped, the first of equal ones kept
+	bin->free.clear();
+	for (size_t i = 0; i < split.size(); i++) {
+		bool inside = false;
+		for (size_t j = 0; j < split.size() && !inside; j++) {
+			inside = j != i && contains(split[j], split[i]) && (!contains(split[i], split[j]) || j < i);
+		}
+		if (!inside) {
+			bin->free.push_back(split[i]);
+		}
+	}
+	*placed = r;
+	return true;
+}
+
+bool atlas_pack(atlas_t *atlas, int padding, int max_size) {
+	atlas->array = false;
+	atlas->layers = 0;
+	atlas->padding = round_up_4(std::max(0, padding));
+	size_t count = atlas->entries.size();
+	// largest first, by the longer side then area
+	std::vector<size_t> order(count);
+	long long area = 0;
+	int widest = 0, tallest = 0;
+	for (size_t i = 0; i < count; i++) {
+		order[i] = i;
+		int w = slot_width(atlas, atlas->entries[i]), h = slot_height(atlas, atlas->entries[i]);
+		area += (long long)w * h;
+		widest = std::max(widest, w);
+		tallest = std::max(tallest, h);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		int wa = slot_width(atlas, atlas->entries[a]), ha = slot_height(atlas, atlas->entries[a]);
+		int wb = slot_width(atlas, atlas->entries[b]), hb = slot_height(atlas, atlas->entries[b]);
+		if (std::max(wa, ha) != std::max(wb, hb)) {
+			return std::max(wa, ha) > std::max(wb, hb);
+		}
+		return (long long)wa * ha > (long long)wb * hb;
+	});
+
+	// power-of-2 sizes in order of area, square before 2:1 and 2:1 before 1:2
+	std::vector<atlas_rect_t> sizes;
+	for (int w = 4; w <= max_size; w *= 2) {
+		for (int h = std::max(4, w / 2); h <= std::min(max_size, w * 2); h *= 2) {
+			atlas_rect_t size = { 0, 0, w, h };
+			sizes.push_back(size);
+		}
+	}
+	std::stable_sort(sizes.begin(), sizes.end(), [](const atlas_rect_t &a, const atlas_rect_t &b) {
+		long long area_a = (long long)a.width * a.height, area_b = (long long)b.width * b.height;
+		if (area_a != area_b) {
+			return area_a < area_b;
+		}
+		return std::abs(a.width - a.height) < std::abs(b.width - b.height) ||
+			(std::abs(a.width - a.height) == std::abs(b.width - b.height) && a.width > b.width);
+	});
+	for (size_t s = 0; s < sizes.size(); s++) {
+		const atlas_rect_t &size = sizes[s];
+		if ((long long)size.width * size.height < area || size.width < widest || size.height < tallest) {
+			continue;
+		}
+		maxrects_t bin;
+		maxrects_init(&bin, size.width, size.height);
+		bool fits = true;
+		for (size_t i = 0; i < count && fits; i++) {
+			atlas_entry_t &entry = atlas->entries[order[i]];
+			atlas_rect_t placed;
+			fits = maxrects_insert(&bin, slot_width(atlas, entry), slot_height(atlas, entry), &placed);
+			entry.x = placed.x + atlas->padding;
+			entry.y = placed.y + atlas->padding;
+			entry.layer = 0;
+		}
+		if (fits) {
+			atlas->width = size.width;
+			atlas->height = size.height;
+			compute_uvs(atlas);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool atlas_make_array(atlas_t *atlas) {
+	atlas->array = true;
+	atlas->padding = 0;
+	atlas->layers = (int)atlas->entries.size();
+	for (size_t i = 0; i < atlas->entries.size(); i++) {
+		atlas_entry_t &entry = atlas->entries[i];
+		if (entry.width != atlas->entries[0].width || entry.height != atlas->entries[0].height) {
+			fprintf(stderr, "ERROR: %s is %ix%i, array layers have to be %ix%i like %s\n",
+				entry.name.c_str(), entry.width, entry.height, atlas->entries[0].width,
+				atlas->entries[0].height, atlas->entries[0].name.c_str());
+			return false;
+		}
+		entry.x = entry.y = 0;
+		entry.layer = (int)i;
+	}
+	atlas->width = atlas->entries.empty() ? 0 : atlas->entries[0].width;
+	atlas->height = atlas->entries.empty() ? 0 : atlas->entries[0].height;
+	compute_uvs(atlas);
+	return true;
+}
+
+int atlas_level_count(const atlas_t *atlas) {
+	int levels = mip_level_count(atlas->width, atlas->height);
+	if (atlas->array) {
+		return levels;
+	}
+	// a level may only have as much filter reach as it has gutter left
+	int gutter_levels = 1;
+	while ((atlas->padding >> gutter_levels) > 0) {
+		gutter_levels++;
+	}
+	return std::min(levels, gutter_levels);
+}
+
+void atlas_compose(const atlas_t *atlas, const std::vector<const unsigned char *> &images,
+	std::vector<unsigned char> &rgba) {
+	size_t layer_bytes = (size_t)atlas->width * atlas->height * 4;
+	rgba.assign(layer_bytes * std::max(1, atlas->layers), 0);
+	for (size_t i = 0; i < atlas->entries.size(); i++) {
+		const atlas_entry_t &entry = atlas->entries[i];
+		unsigned char *layer = rgba.data() + layer_bytes * entry.layer;
+		int pad = atlas->padding;
+		int slot_w = atlas->array ? entry.width : slot_width(atlas, entry);
+		int slot_h = atlas->array ? entry.height : slot_height(atlas, entry);
+		for (int y = 0; y < slot_h; y++) {
+			int source_y = std::min(std::max(y - pad, 0), entry.height - 1);
+			const unsigned char *source = images[i] + (size_t)source_y * entry.width * 4;
+			unsigned char *row = layer + ((size_t)(entry.y - pad + y) * atlas->width + entry.x - pad) * 4;
+			for (int x = 0; x < slot_w; x++) {
+				int source_x = std::min(std::max(x - pad, 0), entry.width - 1);
+				memcpy(row + x * 4, source + source_x * 4, 4);
+			}
+		}
+	}
+}
+
+const atlas_entry_t *atlas_find(const atlas_t *atlas, const char *name) {
+	for (size_t i = 0; i < atlas->entries.size(); i++) {
+		if (atlas->entries[i].name == name) {
+			return &atlas->entries[i];
+		}
+	}
+	return NULL;
+}
+
+void atlas_remap_uvs(const atlas_entry_t *entry, float *uvs, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		uvs[i * 2] = entry->u0 + uvs[i * 2] * (entry->u1 - entry->u0);
+		uvs[i * 2 + 1] = entry->v0 + uvs[i * 2 + 1] * (entry->v1 - entry->v0);
+	}
+}
+
+bool atlas_write_manifest(const char *path, const atlas_t *atlas) {
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "ERROR: could not write %s\n", path);
+		return false;
+	}
+	fprintf(file, "# written by tools/atlas_builder, rebuild it rather than editing this.\n"
+		"#   %s <texture> <width> <height> <layers> <padding> <levels> <bottom up>\n"
+		"#   <image> <width> <height> <x> <y> <layer> <u0> <v0> <u1> <v1>\n"
+		"# names can't have spaces, texcoords are the image's rectangle in the texture.\n",
+		atlas->array ? "array" : "atlas");
+	fprintf(file, "%s %s %i %i %i %i %i %i\n", atlas->array ? "array" : "atlas",
+		atlas->texture.c_str(), atlas->width, atlas->height, atlas->layers, atlas->padding,
+		atlas->levels, atlas->bottom_up ? 1 : 0);
+	for (size_t i = 0; i < atlas->entries.size(); i++) {
+		const atlas_entry_t &e = atlas->entries[i];
+		fprintf(file, "%s %i %i %i %i %i %.9g %.9g %.9g %.9g\n", e.name.c_str(), e.width, e.height,
+			e.x, e.y, e.layer, e.u0, e.v0, e.u1, e.v1);
+	}
+	if (fclose(file) != 0) {
+		fprintf(stderr, "ERROR: could not write %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+bool atlas_parse_manifest(const char *text, size_t size, atlas_t *atlas, const char *name) {
+	atlas->entries.clear();
+	bool have_header = false;
+	int line_number = 0;
+	for (size_t start = 0; start < size;) {
+		size_t end = start;
+		while (end < size && text[end] != '\n') {
+			end++;
+		}
+		std::string line(text + start, end - start);
+		start = end + 1;
+		line_number++;
+		if (line.empty() || line[0] == '#' || line.find_first_not_of(" \t\r") == std::string::npos) {
+			continue;
+		}
+		char word[256], texture[256];
+		int bottom_up = 0;
+		if (!have_header) {
+			if (sscanf(line.c_str(), "%255s %255s %i %i %i %i %i %i", word, texture, &atlas->width,
+				&atlas->height, &atlas->layers, &atlas->padding, &atlas->levels, &bottom_up) != 8 ||
+				(strcmp(word, "atlas") != 0 && strcmp(word, "array") != 0)) {
+				fprintf(stderr, "ERROR: %s:%i: expected atlas|array <texture> ...\n", name, line_number);
+				return false;
+			}
+			atlas->array = strcmp(word, "array") == 0;
+			atlas->texture = texture;
+			atlas->bottom_up = bottom_up != 0;
+			have_header = true;
+			continue;
+		}
+		atlas_entry_t e;
+		if (sscanf(line.c_str(), "%255s %i %i %i %i %i %f %f %f %f", word, &e.width, &e.height, &e.x,
+			&e.y, &e.layer, &e.u0, &e.v0, &e.u1, &e.v1) != 10) {
+			fprintf(stderr, "ERROR: %s:%i: expected <image> <width> <height> <x> <y> <layer> "
+				"<u0> <v0> <u1> <v1>\n", name, line_number);
+			return false;
+		}
+		e.name = word;
+		atlas->entries.push_back(e);
+	}
+	if (!have_header) {
+		fprintf(stderr, "ERROR: %s has no atlas|array line\n", name);
+		return false;
+	}
+	return true;
+}
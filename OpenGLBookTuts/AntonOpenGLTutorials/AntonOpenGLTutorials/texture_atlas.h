@@ -0,0 +1,84 @@
+#pragma once
+/******************************************************************************\
+| Packs many small images into one texture so they draw with one bind, either  |
+| as a 2D atlas or as the layers of a 2D array texture.                        |
+|   atlas  images of any size are placed with MaxRects (best short side fit),  |
+|          largest first, in the smallest power-of-2 texture they fit. Each    |
+|          image keeps a gutter of its own edge texels around it so filtering  |
+|          and the first few mips don't mix in its neighbours. Positions are   |
+|          multiples of 4, so no BC block straddles two images.                |
+|   array  every image is a layer of its own and they must all be one size.    |
+|          Each layer gets a full mip chain and nothing can bleed.             |
+| tools/atlas_builder bakes the texture (a .ktx) and writes a .atlas manifest  |
+| next to it. The game reads the manifest and moves each mesh's texcoords into |
+| its image's rectangle (atlas_remap_uvs), or picks the image's layer.         |
+| Texcoords have to stay inside 0..1: an atlas can't repeat one of its images. |
+| No OpenGL in here.                                                           |
+\******************************************************************************/
+#ifndef _TEXTURE_ATLAS_H_
+#define _TEXTURE_ATLAS_H_
+
+#include <string>
+#include <vector>
+
+struct atlas_rect_t {
+	int x, y, width, height;
+};
+
+// the free space of one bin, as maximal (overlapping) rectangles
+struct maxrects_t {
+	int width, height;
+	std::vector<atlas_rect_t> free;
+};
+
+void maxrects_init(maxrects_t *bin, int width, int height);
+// places a 'width' x 'height' rectangle where it leaves the shortest leftover
+// side, false if it fits nowhere
+bool maxrects_insert(maxrects_t *bin, int width, int height, atlas_rect_t *placed);
+
+struct atlas_entry_t {
+	std::string name; // the image it was made from, as the game requests it
+	int width, height; // the image's, without the gutter
+	int x, y; // top-left texel in the atlas, or 0, 0 in an array
+	int layer; // 0 in an atlas
+	float u0, v0, u1, v1; // the image's texcoord rectangle in the baked texture
+};
+
+struct atlas_t {
+	std::string texture; // the baked .ktx
+	bool array;
+	bool bottom_up; // rows were flipped for GL before baking, v0 is the image's bottom
+	int width, height;
+	int layers; // 0 for an atlas
+	int padding; // gutter texels around each image
+	int levels; // mip levels the texture was baked with
+	std::vector<atlas_entry_t> entries;
+};
+
+// places every entry (name, width and height set) in a power-of-2 atlas no
+// bigger than 'max_size' a side. 'padding' is rounded up to a multiple of 4.
+// false if they don't fit
+bool atlas_pack(atlas_t *atlas, int padding, int max_size);
+// one layer per entry, false (with the reason printed) if the sizes differ
+bool atlas_make_array(atlas_t *atlas);
+// the mip levels an atlas can have before the gutters run out, a full chain
+// for arrays
+int atlas_level_count(const atlas_t *atlas);
+
+// copies each entry's RGBA pixels into an atlas-sized RGBA image (or a layer of
+// an array, one after another) and fills the gutters from the image's edges.
+// 'images' are in entry order, each entry's width x height, top row first
+void atlas_compose(const atlas_t *atlas, const std::vector<const unsigned char *> &images,
+	std::vector<unsigned char> &rgba);
+
+// NULL if the atlas has no image called 'name'
+const atlas_entry_t *atlas_find(const atlas_t *atlas, const char *name);
+// moves 'count' u, v pairs from 0..1 over the image into its rectangle
+void atlas_remap_uvs(const atlas_entry_t *entry, float *uvs, size_t count);
+
+// the .atlas manifest, text, one image per line. false (with the reason
+// printed) if it can't be written or read back
+bool atlas_write_manifest(const char *path, const atlas_t *atlas);
+bool atlas_parse_manifest(const char *text, size_t size, atlas_t *atlas, const char *name);
+
+#endif
@@ -0,0 +1,403 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "texture_cache.h"
+#include "asset_hash.h"
+#include "file_system.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+namespace {
+
+struct cache_header_t {
+	char magic[4]; // "TXCH"
+	unsigned int version;
+	unsigned long long key;
+	int x, y, n, channels;
+	unsigned int level_count;
+	unsigned int reserved;
+};
+
+struct cache_level_t {
+	int width, height;
+	unsigned long long offset; // from the start of the file
+	unsigned long long bytes;
+};
+
+// level data starts on these boundaries, so the copies out of the mapping are aligned
+const size_t LEVEL_ALIGNMENT = 64;
+
+size_t aligned(size_t offset) {
+	return (offset + LEVEL_ALIGNMENT - 1) & ~(LEVEL_ALIGNMENT - 1);
+}
+
+std::string entry_path(const texture_cache_t *cache, unsigned long long key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.tex", key);
+	return cache->dir + "/" + name;
+}
+
+// the key of a file called <16 hex digits>.tex, false for anything else
+bool key_from_name(const char *name, unsigned long long *key) {
+	if (strlen(name) != 20 || strcmp(name + 16, ".tex") != 0) {
+		return false;
+	}
+	char *end = NULL;
+	*key = strtoull(name, &end, 16);
+	return end == name + 16;
+}
+
+// sets the write time to now, the last use that survives to the next launch
+void touch_file(const char *path) {
+#ifdef _WIN32
+	_utime(path, NULL);
+#else
+	utime(path, NULL);
+#endif
+}
+
+bool is_temp_name(const char *name) {
+	size_t length = strlen(name);
+	return length > 4 && strcmp(name + length - 4, ".tmp") == 0;
+}
+
+// every entry in the directory with its size and write time. leftover temp
+// files from a run that didn't finish writing are deleted
+void scan_directory(texture_cache_t *cache) {
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	HANDLE find = FindFirstFileA((cache->dir + "/*").c_str(), &found);
+	if (find == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	do {
+		std::string path = cache->dir + "/" + found.cFileName;
+		unsigned long long key = 0;
+		if (is_temp_name(found.cFileName)) {
+			remove(path.c_str());
+		} else if (key_from_name(found.cFileName, &key)) {
+			ULARGE_INTEGER written;
+			written.LowPart = found.ftLastWriteTime.dwLowDateTime;
+			written.HighPart = found.ftLastWriteTime.dwHighDateTime;
+			texture_cache_file_t file;
+			file.size = ((size_t)found.nFileSizeHigh << 32) | found.nFileSizeLow;
+			// FILETIME counts 100ns ticks from 1601
+			file.last_used = (long long)((written.QuadPart - 116444736000000000ull) / 10000000ull);
+			cache->files[key] = file;
+		}
+	} while (FindNextFileA(find, &found));
+	FindClose(find);
+#else
+	DIR *dir = opendir(cache->dir.c_str());
+	if (!dir) {
+		return;
+	}
+	while (struct dirent *found = readdir(dir)) {
+		std::string path = cache->dir + "/" + found->d_name;
+		unsigned long long key = 0;
+		struct stat info;
+		if (is_temp_name(found->d_name)) {
+			remove(path.c_str());
+		} else if (key_from_name(found->d_name, &key) && stat(path.c_str(), &info) == 0) {
+			texture_cache_file_t file;
+			file.size = (size_t)info.st_size;
+			file.last_used = (long long)info.st_mtime;
+			cache->files[key] = file;
+		}
+	}
+	closedir(dir);
+#endif
+}
+
+// deletes an entry's file and forgets it, called with the mutex held
+void forget(texture_cache_t *cache, unsigned long long key) {
+	std::map<unsigned long long, texture_cache_file_t>::iterator it = cache->files.find(key);
+	if (it == cache->files.end()) {
+		return;
+	}
+	remove(entry_path(cache, key).c_str());
+	cache->stats.total_bytes -= it->second.size;
+	cache->files.erase(it);
+}
+
+// least recently used first until it fits, called with the mutex held
+void trim(texture_cache_t *cache) {
+	while (cache->stats.total_bytes > cache->max_bytes && !cache->files.empty()) {
+		std::map<unsigned long long, texture_cache_file_t>::iterator oldest = cache->files.begin();
+		for (std::map<unsigned long long, texture_cache_file_t>::iterator it = cache->files.begin();
+			it != cache->files.end(); ++it) {
+			if (it->second.last_used < oldest->second.last_used) {
+				oldest = it;
+			}
+		}
+		forget(cache, oldest->first);
+		cache->stats.trimmed++;
+	}
+}
+
+void clear_entry(texture_cache_entry_t *entry) {
+	entry->levels.clear();
+	entry->base = NULL;
+	entry->size = 0;
+#ifdef _WIN32
+	entry->file = INVALID_HANDLE_VALUE;
+	entry->mapping = NULL;
+#else
+	entry->fd = -1;
+#endif
+}
+
+bool map_entry(texture_cache_entry_t *entry, const char *path) {
+#ifdef _WIN32
+	entry->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (entry->file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(entry->file, &size) || size.QuadPart == 0) {
+		return false;
+	}
+	entry->size = (size_t)size.QuadPart;
+	entry->mapping = CreateFileMappingA(entry->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!entry->mapping) {
+		return false;
+	}
+	entry->base = (const unsigned char *)MapViewOfFile(entry->mapping, FILE_MAP_READ, 0, 0, 0);
+	return entry->base != NULL;
+#else
+	entry->fd = open(path, O_RDONLY);
+	if (entry->fd < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(entry->fd, &info) != 0 || info.st_size == 0) {
+		return false;
+	}
+	entry->size = (size_t)info.st_size;
+	void *base = mmap(NULL, entry->size, PROT_READ, MAP_PRIVATE, entry->fd, 0);
+	if (base == MAP_FAILED) {
+		return false;
+	}
+	entry->base = (const unsigned char *)base;
+	// it's read front to back, once, straight away
+	madvise(base, entry->size, MADV_WILLNEED);
+	return true;
+#endif
+}
+
+// the header and level table agree with the key and the file's size
+bool parse_entry(texture_cache_entry_t *entry, unsigned long long key) {
+	if (entry->size < sizeof(cache_header_t)) {
+		return false;
+	}
+	const cache_header_t *header = (const cache_header_t *)entry->base;
+	size_t table_end = sizeof(cache_header_t) + (size_t)header->level_count * sizeof(cache_level_t);
+	if (memcmp(header->magic, "TXCH", 4) != 0 || header->version != TEXTURE_CACHE_VERSION ||
+		header->key != key || header->level_count == 0 || header->level_count > 32 ||
+		table_end > entry->size) {
+		return false;
+	}
+	const cache_level_t *levels = (const cache_level_t *)(header + 1);
+	for (unsigned int i = 0; i < header->level_count; i++) {
+		if (levels[i].width <= 0 || levels[i].height <= 0 || levels[i].offset > entry->size ||
+			levels[i].bytes > entry->size - levels[i].offset ||
+			levels[i].bytes != (unsigned long long)levels[i].width * levels[i].height * header->channels) {
+			return false;
+		}
+		texture_cache_level_t level;
+		level.width = levels[i].width;
+		level.height = levels[i].height;
+		level.pixels = entry->base + levels[i].offset;
+		level.bytes = (size_t)levels[i].bytes;
+		entry->levels.push_back(level);
+	}
+	entry->x = header->x;
+	entry->y = header->y;
+	entry->n = header->n;
+	entry->channels = header->channels;
+	return entry->levels[0].width == entry->x && entry->levels[0].height == entry->y;
+}
+
+bool write_entry(const char *path, unsigned long long key, int x, int y, int n, int channels,
+	const std::vector<texture_cache_level_t> &levels, size_t *size) {
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		return false;
+	}
+	cache_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "TXCH", 4);
+	header.version = TEXTURE_CACHE_VERSION;
+	header.key = key;
+	header.x = x;
+	header.y = y;
+	header.n = n;
+	header.channels = channels;
+	header.level_count = (unsigned int)levels.size();
+	std::vector<cache_level_t> table(levels.size());
+	size_t offset = aligned(sizeof(header) + table.size() * sizeof(cache_level_t));
+	for (size_t i = 0; i < levels.size(); i++) {
+		table[i].width = levels[i].width;
+		table[i].height = levels[i].height;
+		table[i].offset = offset;
+		table[i].bytes = levels[i].bytes;
+		offset = aligned(offset + levels[i].bytes);
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(table.data(), sizeof(cache_level_t), table.size(), file) == table.size();
+	static const unsigned char padding[LEVEL_ALIGNMENT] = {0};
+	size_t written = sizeof(header) + table.size() * sizeof(cache_level_t);
+	for (size_t i = 0; ok && i < levels.size(); i++) {
+		ok = fwrite(padding, 1, (size_t)table[i].offset - written, file) == table[i].offset - written &&
+			fwrite(levels[i].pixels, 1, levels[i].bytes, file) == levels[i].bytes;
+		written = (size_t)table[i].offset + levels[i].bytes;
+	}
+	ok = fclose(file) == 0 && ok;
+	*size = written;
+	return ok;
+}
+
+} // namespace
+
+bool texture_cache_open(texture_cache_t *cache, const char *dir, size_t max_bytes) {
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	memset(&cache->stats, 0, sizeof(cache->stats));
+	cache->files.clear();
+	cache->temp_count = 0;
+	cache->max_bytes = max_bytes;
+	if (!make_directory(dir)) {
+		fprintf(stderr, "WARNING: could not make the texture cache directory %s\n", dir);
+		cache->dir.clear();
+		return false;
+	}
+	cache->dir = dir;
+	scan_directory(cache);
+	for (std::map<unsigned long long, texture_cache_file_t>::iterator it = cache->files.begin();
+		it != cache->files.end(); ++it) {
+		cache->stats.total_bytes += it->second.size;
+	}
+	trim(cache);
+	return true;
+}
+
+unsigned long long texture_cache_key(unsigned long long content_hash, int force_channels,
+	bool flip, bool bgra, int mip_filter) {
+	int settings[5] = {TEXTURE_CACHE_VERSION, force_channels, flip ? 1 : 0, bgra ? 1 : 0, mip_filter};
+	return asset_hash(settings, sizeof(settings), content_hash);
+}
+
+bool texture_cache_find(texture_cache_t *cache, unsigned long long key,
+	texture_cache_entry_t *entry) {
+	clear_entry(entry);
+	std::string path;
+	{
+		std::lock_guard<std::mutex> lock(cache->mutex);
+		if (cache->dir.empty() || cache->files.find(key) == cache->files.end()) {
+			cache->stats.misses++;
+			return false;
+		}
+		path = entry_path(cache, key);
+	}
+	// mapped without the lock, a trim on another thread deleting it underneath is
+	// fine: the mapping keeps the data (on Windows the file goes once it's unmapped)
+	bool ok = map_entry(entry, path.c_str()) && parse_entry(entry, key);
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	if (!ok) {
+		texture_cache_close_entry(entry);
+		fprintf(stderr, "WARNING: texture cache entry %s is damaged, decoding again\n", path.c_str());
+		forget(cache, key);
+		cache->stats.misses++;
+		return false;
+	}
+	std::map<unsigned long long, texture_cache_file_t>::iterator it = cache->files.find(key);
+	if (it != cache->files.end()) {
+		it->second.last_used = (long long)time(NULL);
+		touch_file(path.c_str());
+	}
+	cache->stats.hits++;
+	for (size_t i = 0; i < entry->levels.size(); i++) {
+		cache->stats.hit_bytes += entry->levels[i].bytes;
+	}
+	return true;
+}
+
+void texture_cache_close_entry(texture_cache_entry_t *entry) {
+#ifdef _WIN32
+	if (entry->base) {
+		UnmapViewOfFile(entry->base);
+	}
+	if (entry->mapping) {
+		CloseHandle(entry->mapping);
+	}
+	if (entry->file != INVALID_HANDLE_VALUE) {
+		CloseHandle(entry->file);
+	}
+#else
+	if (entry->base) {
+		munmap((void *)entry->base, entry->size);
+	}
+	if (entry->fd >= 0) {
+		close(entry->fd);
+	}
+#endif
+	clear_entry(entry);
+}
+
+bool texture_cache_store(texture_cache_t *cache, unsigned long long key, int x, int y, int n,
+	int channels, const std::vector<texture_cache_level_t> &levels) {
+	std::string temp_path;
+	{
+		std::lock_guard<std::mutex> lock(cache->mutex);
+		if (cache->dir.empty() || levels.empty()) {
+			return false;
+		}
+		char name[48];
+		snprintf(name, sizeof(name), "%016llx.%llu.tmp", key, cache->temp_count++);
+		temp_path = cache->dir + "/" + name;
+	}
+	size_t size = 0;
+	if (!write_entry(temp_path.c_str(), key, x, y, n, channels, levels, &size)) {
+		fprintf(stderr, "WARNING: could not write texture cache file %s\n", temp_path.c_str());
+		remove(temp_path.c_str());
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	if (size > cache->max_bytes) {
+		remove(temp_path.c_str());
+		return false;
+	}
+	// a decode of the same image on another worker may have got there first
+	forget(cache, key);
+	std::string path = entry_path(cache, key);
+	if (rename(temp_path.c_str(), path.c_str()) != 0) {
+		remove(temp_path.c_str());
+		return false;
+	}
+	texture_cache_file_t file;
+	file.size = size;
+	file.last_used = (long long)time(NULL);
+	cache->files[key] = file;
+	cache->stats.total_bytes += size;
+	cache->stats.stores++;
+	trim(cache);
+	return true;
+}
+
+texture_cache_stats_t texture_cache_stats(texture_cache_t *cache) {
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	texture_cache_stats_t stats = cache->stats;
+	stats.entries = (int)cache->files.size();
+	return stats;
+}
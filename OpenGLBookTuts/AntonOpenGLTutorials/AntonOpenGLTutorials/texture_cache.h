@@ -0,0 +1,90 @@
+#pragma once
+/******************************************************************************\
+| Decoded textures kept on disk, so a launch that has seen an image before     |
+| copies it out of a mapped file instead of decoding it again.                 |
+| An entry is the image exactly as it's uploaded: flipped, converted to its    |
+| channel count (R/B swapped for BGRA), with its whole mip chain. It's one     |
+| file per entry, <key>.tex, in the cache directory. The key is the image's    |
+| content hash (asset_hash of the file, which is also the asset pack's) with   |
+| the settings it was loaded with folded in, so a changed image or setting     |
+| misses and the old entry is simply never read again. Entries are written to  |
+| a temp file and renamed into place, so a crash never leaves a half entry.    |
+| The directory is kept under its size limit by deleting the least recently    |
+| used entries. A hit sets the file's write time, so the order survives        |
+| between launches.                                                            |
+| All calls are safe from any thread, the decode workers use it directly.      |
+| No OpenGL in here.                                                           |
+\******************************************************************************/
+#ifndef _TEXTURE_CACHE_H_
+#define _TEXTURE_CACHE_H_
+
+#include <map>
+#include <mutex>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// bumped whenever the file layout or what's stored in it changes
+#define TEXTURE_CACHE_VERSION 1
+
+struct texture_cache_level_t {
+	int width, height;
+	const unsigned char *pixels;
+	size_t bytes;
+};
+
+// a mapped entry, its levels point into the mapping until texture_cache_close_entry
+struct texture_cache_entry_t {
+	int x, y, n, channels; // as batch_image_t has them
+	std::vector<texture_cache_level_t> levels; // level 0 first
+	const unsigned char *base;
+	size_t size;
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#else
+	int fd;
+#endif
+};
+
+struct texture_cache_file_t {
+	size_t size;
+	long long last_used; // seconds since 1970
+};
+
+struct texture_cache_stats_t {
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long stores;
+	unsigned long long trimmed; // entries deleted to stay under the limit
+	size_t hit_bytes; // copied out of the cache instead of decoded
+	size_t total_bytes; // in the directory now
+	int entries;
+};
+
+struct texture_cache_t {
+	std::string dir; // empty when there's no cache
+	size_t max_bytes;
+	std::mutex mutex;
+	std::map<unsigned long long, texture_cache_file_t> files;
+	unsigned long long temp_count; // names the temp files entries are written to
+	texture_cache_stats_t stats;
+};
+
+// uses (and creates) the directory 'dir' and trims it down to 'max_bytes'.
+// false leaves the cache off: every find misses and every store is dropped
+bool texture_cache_open(texture_cache_t *cache, const char *dir, size_t max_bytes);
+// the key for an image with content hash 'content_hash' loaded with these settings
+unsigned long long texture_cache_key(unsigned long long content_hash, int force_channels,
+	bool flip, bool bgra, int mip_filter);
+// maps the entry for 'key', false if there's none or it's damaged (it's
+// deleted then). counts as a use
+bool texture_cache_find(texture_cache_t *cache, unsigned long long key,
+	texture_cache_entry_t *entry);
+void texture_cache_close_entry(texture_cache_entry_t *entry);
+// writes an entry for 'key' and trims the cache back under its limit
+bool texture_cache_store(texture_cache_t *cache, unsigned long long key, int x, int y, int n,
+	int channels, const std::vector<texture_cache_level_t> &levels);
+texture_cache_stats_t texture_cache_stats(texture_cache_t *cache);
+
+#endif
@@ -0,0 +1,1036 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "texture_codec.h"
+#include "image_ops.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TEXTURE_CODEC_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+// MSVC compiles any intrinsic without a switch, the CPU check is what keeps them safe
+#define SSE2_FUNCTION
+#define AVX2_FUNCTION
+#else
+#define SSE2_FUNCTION __attribute__((target("sse2")))
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#else
+#define TEXTURE_CODEC_X86 0
+#endif
+
+namespace {
+
+const unsigned char ktx_identifier[12] = {
+	0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct ktx_header_t {
+	unsigned char identifier[12];
+	unsigned int endianness;
+	unsigned int gl_type;
+	unsigned int gl_type_size;
+	unsigned int gl_format;
+	unsigned int gl_internal_format;
+	unsigned int gl_base_internal_format;
+	unsigned int pixel_width;
+	unsigned int pixel_height;
+	unsigned int pixel_depth;
+	unsigned int array_elements;
+	unsigned int faces;
+	unsigned int mip_levels;
+	unsigned int key_value_bytes;
+};
+
+const char ktx_orientation_key[] = "KTXorientation";
+
+// BC7 interpolation weights out of 64, by index bits
+const int bc7_weights2[4] = {0, 21, 43, 64};
+const int bc7_weights3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+const int bc7_weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+const int *bc7_weights(int index_bits) {
+	return index_bits == 2 ? bc7_weights2 : (index_bits == 3 ? bc7_weights3 : bc7_weights4);
+}
+
+// a block's pixels both ways round: pixel by pixel for the endpoint fits,
+// channel by channel for the index search
+struct block_pixels_t {
+	float px[16][4];
+	float channel[4][16];
+};
+
+float clamp_channel(float v) {
+	return v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v);
+}
+
+void to_block(const unsigned char rgba[64], block_pixels_t &block) {
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 4; c++) {
+			block.px[i][c] = block.channel[c][i] = rgba[i * 4 + c];
+		}
+	}
+}
+
+// the block with alpha swapped for R (rotation 1), G (2) or B (3), the way
+// BC7 modes 4 and 5 store it
+void rotate_block(const block_pixels_t &block, int rotation, block_pixels_t &out) {
+	out = block;
+	if (rotation == 0) {
+		return;
+	}
+	int c = rotation - 1;
+	for (int i = 0; i < 16; i++) {
+		std::swap(out.px[i][c], out.px[i][3]);
+		std::swap(out.channel[c][i], out.channel[3][i]);
+	}
+}
+
+// index search ----------------------------------------------------------------
+// the nearest of 'count' palette entries to each pixel, by squared error over
+// channels first .. first + channels - 1. returns the summed error. every
+// version adds the same terms in the same order and keeps the first of equal
+// errors, so they all pick the same indices
+
+float nearest_scalar(const block_pixels_t &block, const float palette[16][4], int count,
+	int first, int channels, unsigned char idx[16]) {
+	float total = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		float best = 1e30f;
+		for (int p = 0; p < count; p++) {
+			float error = 0.0f;
+			for (int c = first; c < first + channels; c++) {
+				float d = block.channel[c][i] - palette[p][c];
+				error += d * d;
+			}
+			if (error < best) {
+				best = error;
+				idx[i] = (unsigned char)p;
+			}
+		}
+		total += best;
+	}
+	return total;
+}
+
+#if TEXTURE_CODEC_X86
+SSE2_FUNCTION float nearest_sse2(const block_pixels_t &block, const float palette[16][4],
+	int count, int first, int channels, unsigned char idx[16]) {
+	float best_error[16];
+	for (int g = 0; g < 16; g += 4) {
+		__m128 pixel[4];
+		for (int c = first; c < first + channels; c++) {
+			pixel[c] = _mm_loadu_ps(&block.channel[c][g]);
+		}
+		__m128 best = _mm_set1_ps(1e30f);
+		__m128i best_index = _mm_setzero_si128();
+		for (int p = 0; p < count; p++) {
+			__m128 error = _mm_setzero_ps();
+			for (int c = first; c < first + channels; c++) {
+				__m128 d = _mm_sub_ps(pixel[c], _mm_set1_ps(palette[p][c]));
+				error = _mm_add_ps(error, _mm_mul_ps(d, d));
+			}
+			__m128 closer = _mm_cmplt_ps(error, best);
+			__m128i closer_mask = _mm_castps_si128(closer);
+			best = _mm_or_ps(_mm_and_ps(closer, error), _mm_andnot_ps(closer, best));
+			best_index = _mm_or_si128(_mm_and_si128(closer_mask, _mm_set1_epi32(p)),
+				_mm_andnot_si128(closer_mask, best_index));
+		}
+		int lanes[4];
+		_mm_storeu_ps(best_error + g, best);
+		_mm_storeu_si128((__m128i *)lanes, best_index);
+		for (int l = 0; l < 4; l++) {
+			idx[g + l] = (unsigned char)lanes[l];
+		}
+	}
+	float total = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		total += best_error[i];
+	}
+	return total;
+}
+
+AVX2_FUNCTION float nearest_avx2(const block_pixels_t &block, const float palette[16][4],
+	int count, int first, int channels, unsigned char idx[16]) {
+	float best_error[16];
+	for (int g = 0; g < 16; g += 8) {
+		__m256 pixel[4];
+		for (int c = first; c < first + channels; c++) {
+			pixel[c] = _mm256_loadu_ps(&block.channel[c][g]);
+		}
+		__m256 best = _mm256_set1_ps(1e30f);
+		__m256 best_index = _mm256_setzero_ps(); // int lanes, blended as floats
+		for (int p = 0; p < count; p++) {
+			__m256 error = _mm256_setzero_ps();
+			for (int c = first; c < first + channels; c++) {
+				__m256 d = _mm256_sub_ps(pixel[c], _mm256_set1_ps(palette[p][c]));
+				error = _mm256_add_ps(error, _mm256_mul_ps(d, d));
+			}
+			__m256 closer = _mm256_cmp_ps(error, best, _CMP_LT_OQ);
+			best = _mm256_blendv_ps(best, error, closer);
+			best_index = _mm256_blendv_ps(best_index, _mm256_castsi256_ps(_mm256_set1_epi32(p)),
+				closer);
+		}
+		int lanes[8];
+		_mm256_storeu_ps(best_error + g, best);
+		_mm256_storeu_si256((__m256i *)lanes, _mm256_castps_si256(best_index));
+		for (int l = 0; l < 8; l++) {
+			idx[g + l] = (unsigned char)lanes[l];
+		}
+	}
+	float total = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		total += best_error[i];
+	}
+	return total;
+}
+#endif
+
+float nearest_indices(const block_pixels_t &block, const float palette[16][4], int count,
+	int first, int channels, unsigned char idx[16]) {
+#if TEXTURE_CODEC_X86
+	switch (image_simd()) {
+	case IMAGE_SIMD_AVX2: return nearest_avx2(block, palette, count, first, channels, idx);
+	case IMAGE_SIMD_SSE2: return nearest_sse2(block, palette, count, first, channels, idx);
+	default: break;
+	}
+#endif
+	return nearest_scalar(block, palette, count, first, channels, idx);
+}
+
+// endpoints -------------------------------------------------------------------
+
+// the ends of the block's colours along their principal axis, over channels
+// first .. first + channels - 1. the axis is found by power iteration on the
+// covariance
+void principal_endpoints(const float px[16][4], int first, int channels, float lo[4],
+	float hi[4]) {
+	int end = first + channels;
+	if (channels == 1) {
+		// a single channel's axis is itself, its ends are the smallest and largest value
+		for (int c = 0; c < 4; c++) {
+			lo[c] = hi[c] = 255.0f;
+		}
+		lo[first] = hi[first] = px[0][first];
+		for (int i = 0; i < 16; i++) {
+			lo[first] = std::min(lo[first], px[i][first]);
+			hi[first] = std::max(hi[first], px[i][first]);
+		}
+		return;
+	}
+	float mean[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	float low[4] = {255.0f, 255.0f, 255.0f, 255.0f};
+	float high[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	for (int i = 0; i < 16; i++) {
+		for (int c = first; c < end; c++) {
+			mean[c] += px[i][c] / 16.0f;
+			low[c] = std::min(low[c], px[i][c]);
+			high[c] = std::max(high[c], px[i][c]);
+		}
+	}
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++) {
+		for (int a = first; a < end; a++) {
+			for (int b = first; b < end; b++) {
+				covariance[a][b] += (px[i][a] - mean[a]) * (px[i][b] - mean[b]);
+			}
+		}
+	}
+	float axis[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	for (int c = first; c < end; c++) {
+		axis[c] = high[c] - low[c];
+	}
+	for (int iteration = 0; iteration < 8; iteration++) {
+		float next[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		float largest = 0.0f;
+		for (int a = first; a < end; a++) {
+			for (int b = first; b < end; b++) {
+				next[a] += covariance[a][b] * axis[b];
+			}
+			largest = std::max(largest, fabsf(next[a]));
+		}
+		if (largest < 1e-6f) {
+			break; // flat block, or the box diagonal already is the axis
+		}
+		for (int c = first; c < end; c++) {
+			axis[c] = next[c] / largest;
+		}
+	}
+	float length = 0.0f;
+	for (int c = first; c < end; c++) {
+		length += axis[c] * axis[c];
+	}
+	length = sqrtf(length);
+	for (int c = 0; c < 4; c++) {
+		lo[c] = hi[c] = c >= first && c < end ? mean[c] : 255.0f;
+	}
+	if (length < 1e-6f) {
+		return;
+	}
+	float t_min = 0.0f, t_max = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		float t = 0.0f;
+		for (int c = first; c < end; c++) {
+			t += (px[i][c] - mean[c]) * axis[c] / length;
+		}
+		t_min = std::min(t_min, t);
+		t_max = std::max(t_max, t);
+	}
+	for (int c = first; c < end; c++) {
+		lo[c] = clamp_channel(mean[c] + axis[c] / length * t_min);
+		hi[c] = clamp_channel(mean[c] + axis[c] / length * t_max);
+	}
+}
+
+// least squares endpoints for fixed interpolation weights, pixel i being
+// (1 - t[i]) * e0 + t[i] * e1, over channels first .. first + channels - 1.
+// false if the weights don't pin both down
+bool fit_endpoints(const float px[16][4], const float t[16], int first, int channels, float e0[4],
+	float e1[4]) {
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	float bx[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	for (int i = 0; i < 16; i++) {
+		float a = 1.0f - t[i];
+		float b = t[i];
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int c = first; c < first + channels; c++) {
+			ax[c] += a * px[i][c];
+			bx[c] += b * px[i][c];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f) {
+		return false;
+	}
+	for (int c = first; c < first + channels; c++) {
+		e0[c] = clamp_channel((ax[c] * bb - bx[c] * ab) / determinant);
+		e1[c] = clamp_channel((bx[c] * aa - ax[c] * ab) / determinant);
+	}
+	return true;
+}
+
+void put_bits(unsigned char *block, int &position, unsigned int value, int count) {
+	for (int i = 0; i < count; i++, position++) {
+		if ((value >> i) & 1) {
+			block[position >> 3] |= (unsigned char)(1 << (position & 7));
+		}
+	}
+}
+
+unsigned int get_bits(const unsigned char *block, int &position, int count) {
+	unsigned int value = 0;
+	for (int i = 0; i < count; i++, position++) {
+		value |= (unsigned int)((block[position >> 3] >> (position & 7)) & 1) << i;
+	}
+	return value;
+}
+
+// BC1 colour ------------------------------------------------------------------
+
+unsigned short pack_565(const float c[3]) {
+	int r = (int)(c[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int)(c[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int)(c[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+void unpack_565(unsigned short v, int out[3]) {
+	int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+	out[0] = (r << 3) | (r >> 2);
+	out[1] = (g << 2) | (g >> 4);
+	out[2] = (b << 3) | (b >> 2);
+}
+
+// 'four_colour' is what c0 > c1 selects in BC1, BC3 colour blocks always are
+void colour_palette(unsigned short c0, unsigned short c1, bool four_colour, int palette[4][4]) {
+	unpack_565(c0, palette[0]);
+	unpack_565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = 255;
+	for (int c = 0; c < 3; c++) {
+		if (four_colour) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		} else {
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	palette[3][3] = four_colour ? 255 : 0;
+}
+
+// always four colour mode, that's the one BC3 has and BC1 rarely gains from the other
+void encode_colour(const block_pixels_t &block, unsigned char *out) {
+	static const float index_weight[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+	float e0[4], e1[4];
+	principal_endpoints(block.px, 0, 3, e1, e0);
+	float best_error = 1e30f;
+	unsigned short best_c0 = 0, best_c1 = 0;
+	unsigned char best_idx[16] = {};
+	for (int iteration = 0; iteration < 3; iteration++) {
+		unsigned short c0 = pack_565(e0);
+		unsigned short c1 = pack_565(e1);
+		if (c0 < c1) {
+			std::swap(c0, c1);
+		}
+		int palette[4][4];
+		colour_palette(c0, c1, true, palette);
+		float entries[16][4];
+		for (int p = 0; p < 4; p++) {
+			for (int c = 0; c < 4; c++) {
+				entries[p][c] = (float)palette[p][c];
+			}
+		}
+		unsigned char idx[16];
+		float error = nearest_indices(block, entries, 4, 0, 3, idx);
+		if (c0 == c1) {
+			memset(idx, 0, sizeof(idx)); // decodes as three colour mode, index 0 is still c0
+		}
+		if (error < best_error) {
+			best_error = error;
+			best_c0 = c0;
+			best_c1 = c1;
+			memcpy(best_idx, idx, sizeof(idx));
+		}
+		if (c0 == c1) {
+			break;
+		}
+		float t[16];
+		for (int i = 0; i < 16; i++) {
+			t[i] = index_weight[idx[i]];
+		}
+		if (!fit_endpoints(block.px, t, 0, 3, e0, e1)) {
+			break;
+		}
+	}
+	memset(out, 0, 8);
+	out[0] = (unsigned char)(best_c0 & 0xff);
+	out[1] = (unsigned char)(best_c0 >> 8);
+	out[2] = (unsigned char)(best_c1 & 0xff);
+	out[3] = (unsigned char)(best_c1 >> 8);
+	int position = 32;
+	for (int i = 0; i < 16; i++) {
+		put_bits(out, position, best_idx[i], 2);
+	}
+}
+
+void decode_colour(const unsigned char *block, bool always_four_colour, unsigned char rgba[64]) {
+	unsigned short c0 = (unsigned short)(block[0] | (block[1] << 8));
+	unsigned short c1 = (unsigned short)(block[2] | (block[3] << 8));
+	int palette[4][4];
+	colour_palette(c0, c1, always_four_colour || c0 > c1, palette);
+	int position = 32;
+	for (int i = 0; i < 16; i++) {
+		unsigned int index = get_bits(block, position, 2);
+		for (int c = 0; c < 4; c++) {
+			rgba[i * 4 + c] = (unsigned char)palette[index][c];
+		}
+	}
+}
+
+// BC3 alpha (BC4) -------------------------------------------------------------
+
+void alpha_palette(int a0, int a1, int palette[8]) {
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1) {
+		for (int i = 1; i < 7; i++) {
+			palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+		}
+	} else {
+		for (int i = 1; i < 5; i++) {
+			palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+void encode_alpha(const block_pixels_t &block, unsigned char *out) {
+	int a_min = 255, a_max = 0;
+	for (int i = 0; i < 16; i++) {
+		int a = (int)(block.px[i][3] + 0.5f);
+		a_min = std::min(a_min, a);
+		a_max = std::max(a_max, a);
+	}
+	memset(out, 0, 8);
+	out[0] = (unsigned char)a_max;
+	out[1] = (unsigned char)a_min;
+	if (a_max == a_min) {
+		return; // every index 0
+	}
+	int palette[8];
+	alpha_palette(a_max, a_min, palette);
+	float entries[16][4];
+	for (int p = 0; p < 8; p++) {
+		entries[p][3] = (float)palette[p];
+	}
+	unsigned char idx[16];
+	nearest_indices(block, entries, 8, 3, 1, idx);
+	int position = 16;
+	for (int i = 0; i < 16; i++) {
+		put_bits(out, position, idx[i], 3);
+	}
+}
+
+void decode_alpha(const unsigned char *block, unsigned char rgba[64]) {
+	int palette[8];
+	alpha_palette(block[0], block[1], palette);
+	int position = 16;
+	for (int i = 0; i < 16; i++) {
+		rgba[i * 4 + 3] = (unsigned char)palette[get_bits(block, position, 3)];
+	}
+}
+
+// BC7 modes 4, 5 and 6 ----------------------------------------------------------
+// mode 6 is one RGBA endpoint pair (7 bits and a p-bit) with 4-bit indices,
+// best for smooth blocks whose alpha follows the colour. modes 4 and 5 index
+// colour and alpha apart, after an optional swap of alpha with one colour
+// channel (the rotation): mode 5 with 7-bit colour, 8-bit alpha and 2-bit
+// indices, mode 4 with 5-bit colour, 6-bit alpha and one set of 3-bit indices.
+// every block tries them all and keeps the one with the least error
+
+// a chosen block, everything the bit layout needs
+struct bc7_block_t {
+	int mode;
+	int rotation; // modes 4 and 5
+	int index_mode; // mode 4: 0 gives colour the 2-bit indices, 1 the 3-bit ones
+	int q0[4], q1[4]; // quantised endpoints, alpha (after the rotation) in [3]
+	int p0, p1; // mode 6's p-bits
+	unsigned char colour_idx[16]; // every channel's for mode 6
+	unsigned char alpha_idx[16];
+	float error;
+};
+
+int bc7_unquantise(int q, int bits) {
+	q <<= 8 - bits;
+	return q | (q >> bits);
+}
+
+// endpoints for channels first .. first + channels - 1 of 'block' with
+// 'endpoint_bits' a channel and 'index_bits' indices: 'start0' and 'start1'
+// (the principal axis' ends) refined by least squares against the indices
+// they pick. returns the error
+float bc7_fit(const block_pixels_t &block, int first, int channels, int endpoint_bits,
+	int index_bits, const float start0[4], const float start1[4], int q0[4], int q1[4],
+	unsigned char idx[16]) {
+	int count = 1 << index_bits;
+	const int *weights = bc7_weights(index_bits);
+	int top = (1 << endpoint_bits) - 1;
+	float e0[4], e1[4];
+	memcpy(e0, start0, sizeof(e0));
+	memcpy(e1, start1, sizeof(e1));
+	float best_error = 1e30f;
+	for (int iteration = 0; iteration < 3; iteration++) {
+		int a[4], b[4], v0[4], v1[4];
+		for (int c = first; c < first + channels; c++) {
+			a[c] = std::min(top, std::max(0, (int)(e0[c] * top / 255.0f + 0.5f)));
+			b[c] = std::min(top, std::max(0, (int)(e1[c] * top / 255.0f + 0.5f)));
+			v0[c] = bc7_unquantise(a[c], endpoint_bits);
+			v1[c] = bc7_unquantise(b[c], endpoint_bits);
+		}
+		float palette[16][4];
+		for (int p = 0; p < count; p++) {
+			for (int c = first; c < first + channels; c++) {
+				palette[p][c] = (float)(((64 - weights[p]) * v0[c] + weights[p] * v1[c] + 32) >> 6);
+			}
+		}
+		unsigned char iteration_idx[16];
+		float error = nearest_indices(block, palette, count, first, channels, iteration_idx);
+		if (error >= best_error) {
+			break; // the refit stopped helping
+		}
+		best_error = error;
+		for (int c = first; c < first + channels; c++) {
+			q0[c] = a[c];
+			q1[c] = b[c];
+		}
+		memcpy(idx, iteration_idx, 16);
+		float t[16];
+		for (int i = 0; i < 16; i++) {
+			t[i] = weights[iteration_idx[i]] / 64.0f;
+		}
+		if (error == 0.0f || !fit_endpoints(block.px, t, first, channels, e0, e1)) {
+			break;
+		}
+	}
+	return best_error;
+}
+
+// 7 bits plus the shared p-bit, the value the decoder will rebuild in 'value'
+void bc7_quantise(const float e[4], int p_bit, int q[4], int value[4]) {
+	for (int c = 0; c < 4; c++) {
+		int v = (int)floorf((e[c] - p_bit) / 2.0f + 0.5f);
+		q[c] = std::min(127, std::max(0, v));
+		value[c] = (q[c] << 1) | p_bit;
+	}
+}
+
+void bc7_mode6(const block_pixels_t &block, bc7_block_t &out) {
+	out.mode = 6;
+	out.rotation = out.index_mode = 0;
+	out.error = 1e30f;
+	float e0[4], e1[4];
+	principal_endpoints(block.px, 0, 4, e0, e1);
+	for (int iteration = 0; iteration < 3; iteration++) {
+		unsigned char iteration_idx[16];
+		float iteration_error = 1e30f;
+		for (int p = 0; p < 4; p++) {
+			int p0 = p & 1, p1 = p >> 1;
+			int q0[4], q1[4], v0[4], v1[4];
+			bc7_quantise(e0, p0, q0, v0);
+			bc7_quantise(e1, p1, q1, v1);
+			float palette[16][4];
+			for (int i = 0; i < 16; i++) {
+				for (int c = 0; c < 4; c++) {
+					palette[i][c] = (float)(((64 - bc7_weights4[i]) * v0[c] +
+						bc7_weights4[i] * v1[c] + 32) >> 6);
+				}
+			}
+			unsigned char idx[16];
+			float error = nearest_indices(block, palette, 16, 0, 4, idx);
+			if (error < iteration_error) {
+				iteration_error = error;
+				memcpy(iteration_idx, idx, sizeof(idx));
+			}
+			if (error < out.error) {
+				out.error = error;
+				memcpy(out.q0, q0, sizeof(q0));
+				memcpy(out.q1, q1, sizeof(q1));
+				out.p0 = p0;
+				out.p1 = p1;
+				memcpy(out.colour_idx, idx, sizeof(idx));
+			}
+		}
+		float t[16];
+		for (int i = 0; i < 16; i++) {
+			t[i] = bc7_weights4[iteration_idx[i]] / 64.0f;
+		}
+		if (out.error == 0.0f || !fit_endpoints(block.px, t, 0, 4, e0, e1)) {
+			break;
+		}
+	}
+}
+
+// mode 4 or 5 for a block already rotated, 'colour0' and 'colour1' the ends of
+// its colour's principal axis and 'alpha0' and 'alpha1' its alpha's. gives up
+// once the colour alone has 'limit' error or more
+void bc7_separate_alpha(const block_pixels_t &rotated, int mode, int rotation, int index_mode,
+	const float colour0[4], const float colour1[4], const float alpha0[4], const float alpha1[4],
+	float limit, bc7_block_t &out) {
+	int colour_bits = mode == 4 ? 5 : 7;
+	int alpha_bits = mode == 4 ? 6 : 8;
+	int colour_index_bits = mode == 4 && index_mode == 1 ? 3 : 2;
+	int alpha_index_bits = mode == 4 && index_mode == 0 ? 3 : 2;
+	out.mode = mode;
+	out.rotation = rotation;
+	out.index_mode = index_mode;
+	out.p0 = out.p1 = 0;
+	out.error = bc7_fit(rotated, 0, 3, colour_bits, colour_index_bits, colour0, colour1, out.q0,
+		out.q1, out.colour_idx);
+	if (out.error >= limit) {
+		return;
+	}
+	out.error += bc7_fit(rotated, 3, 1, alpha_bits, alpha_index_bits, alpha0, alpha1, out.q0,
+		out.q1, out.alpha_idx);
+}
+
+// the first index of a set has an implied 0 top bit, so if it's set the set's
+// endpoints are swapped and its indices reversed
+void bc7_fix_anchor(int *q0, int *q1, int first, int channels, unsigned char idx[16],
+	int index_bits) {
+	int count = 1 << index_bits;
+	if (idx[0] < count / 2) {
+		return;
+	}
+	for (int c = first; c < first + channels; c++) {
+		std::swap(q0[c], q1[c]);
+	}
+	for (int i = 0; i < 16; i++) {
+		idx[i] = (unsigned char)(count - 1 - idx[i]);
+	}
+}
+
+void put_indices(unsigned char *out, int &position, const unsigned char idx[16], int index_bits) {
+	put_bits(out, position, idx[0], index_bits - 1);
+	for (int i = 1; i < 16; i++) {
+		put_bits(out, position, idx[i], index_bits);
+	}
+}
+
+void write_bc7(bc7_block_t &b, unsigned char *out) {
+	memset(out, 0, 16);
+	int position = 0;
+	put_bits(out, position, 1u << b.mode, b.mode + 1);
+	if (b.mode == 6) {
+		if (b.colour_idx[0] >= 8) {
+			std::swap(b.p0, b.p1);
+		}
+		bc7_fix_anchor(b.q0, b.q1, 0, 4, b.colour_idx, 4);
+		for (int c = 0; c < 4; c++) {
+			put_bits(out, position, b.q0[c], 7);
+			put_bits(out, position, b.q1[c], 7);
+		}
+		put_bits(out, position, b.p0, 1);
+		put_bits(out, position, b.p1, 1);
+		put_indices(out, position, b.colour_idx, 4);
+		return;
+	}
+	int colour_bits = b.mode == 4 ? 5 : 7;
+	int alpha_bits = b.mode == 4 ? 6 : 8;
+	int colour_index_bits = b.mode == 4 && b.index_mode == 1 ? 3 : 2;
+	int alpha_index_bits = b.mode == 4 && b.index_mode == 0 ? 3 : 2;
+	bc7_fix_anchor(b.q0, b.q1, 0, 3, b.colour_idx, colour_index_bits);
+	bc7_fix_anchor(b.q0, b.q1, 3, 1, b.alpha_idx, alpha_index_bits);
+	put_bits(out, position, b.rotation, 2);
+	if (b.mode == 4) {
+		put_bits(out, position, b.index_mode, 1);
+	}
+	for (int c = 0; c < 3; c++) {
+		put_bits(out, position, b.q0[c], colour_bits);
+		put_bits(out, position, b.q1[c], colour_bits);
+	}
+	put_bits(out, position, b.q0[3], alpha_bits);
+	put_bits(out, position, b.q1[3], alpha_bits);
+	// the 2-bit set first, then mode 4's 3-bit one
+	bool colour_first = colour_index_bits == 2;
+	put_indices(out, position, colour_first ? b.colour_idx : b.alpha_idx, 2);
+	put_indices(out, position, colour_first ? b.alpha_idx : b.colour_idx,
+		colour_first ? alpha_index_bits : colour_index_bits);
+}
+
+void encode_bc7(const block_pixels_t &block, unsigned char *out) {
+	bc7_block_t best;
+	bc7_mode6(block, best);
+	for (int rotation = 0; rotation < 4 && best.error > 0.0f; rotation++) {
+		block_pixels_t rotated;
+		rotate_block(block, rotation, rotated);
+		float colour0[4], colour1[4], alpha0[4], alpha1[4];
+		principal_endpoints(rotated.px, 0, 3, colour0, colour1);
+		principal_endpoints(rotated.px, 3, 1, alpha0, alpha1);
+		// mode 5, then mode 4 with 2-bit and with 3-bit colour indices
+		for (int candidate = 0; candidate < 3; candidate++) {
+			bc7_block_t b;
+			bc7_separate_alpha(rotated, candidate == 0 ? 5 : 4, rotation, candidate == 2 ? 1 : 0,
+				colour0, colour1, alpha0, alpha1, best.error, b);
+			if (b.error < best.error) {
+				best = b;
+			}
+		}
+	}
+	write_bc7(best, out);
+}
+
+void decode_bc7(const unsigned char *block, unsigned char rgba[64]) {
+	int mode = 0;
+	while (mode < 8 && !((block[0] >> mode) & 1)) {
+		mode++;
+	}
+	if (mode < 4 || mode > 6) {
+		for (int i = 0; i < 16; i++) {
+			rgba[i * 4 + 0] = 255; // magenta: a mode this decoder doesn't do
+			rgba[i * 4 + 1] = 0;
+			rgba[i * 4 + 2] = 255;
+			rgba[i * 4 + 3] = 255;
+		}
+		return;
+	}
+	int position = mode + 1;
+	int v0[4], v1[4];
+	if (mode == 6) {
+		int q0[4], q1[4];
+		for (int c = 0; c < 4; c++) {
+			q0[c] = (int)get_bits(block, position, 7);
+			q1[c] = (int)get_bits(block, position, 7);
+		}
+		int p0 = (int)get_bits(block, position, 1);
+		int p1 = (int)get_bits(block, position, 1);
+		for (int c = 0; c < 4; c++) {
+			v0[c] = (q0[c] << 1) | p0;
+			v1[c] = (q1[c] << 1) | p1;
+		}
+		for (int i = 0; i < 16; i++) {
+			int w = bc7_weights4[get_bits(block, position, i == 0 ? 3 : 4)];
+			for (int c = 0; c < 4; c++) {
+				rgba[i * 4 + c] = (unsigned char)(((64 - w) * v0[c] + w * v1[c] + 32) >> 6);
+			}
+		}
+		return;
+	}
+	int rotation = (int)get_bits(block, position, 2);
+	int index_mode = mode == 4 ? (int)get_bits(block, position, 1) : 0;
+	int colour_bits = mode == 4 ? 5 : 7;
+	int alpha_bits = mode == 4 ? 6 : 8;
+	for (int c = 0; c < 3; c++) {
+		v0[c] = bc7_unquantise((int)get_bits(block, position, colour_bits), colour_bits);
+		v1[c] = bc7_unquantise((int)get_bits(block, position, colour_bits), colour_bits);
+	}
+	v0[3] = bc7_unquantise((int)get_bits(block, position, alpha_bits), alpha_bits);
+	v1[3] = bc7_unquantise((int)get_bits(block, position, alpha_bits), alpha_bits);
+	int set_bits[2] = {2, mode == 4 ? 3 : 2};
+	int sets[2][16];
+	for (int s = 0; s < 2; s++) {
+		for (int i = 0; i < 16; i++) {
+			sets[s][i] = (int)get_bits(block, position, i == 0 ? set_bits[s] - 1 : set_bits[s]);
+		}
+	}
+	int colour_set = index_mode == 1 ? 1 : 0;
+	const int *colour_weights = bc7_weights(set_bits[colour_set]);
+	const int *alpha_weights = bc7_weights(set_bits[1 - colour_set]);
+	for (int i = 0; i < 16; i++) {
+		int w = colour_weights[sets[colour_set][i]];
+		for (int c = 0; c < 3; c++) {
+			rgba[i * 4 + c] = (unsigned char)(((64 - w) * v0[c] + w * v1[c] + 32) >> 6);
+		}
+		w = alpha_weights[sets[1 - colour_set][i]];
+		rgba[i * 4 + 3] = (unsigned char)(((64 - w) * v0[3] + w * v1[3] + 32) >> 6);
+		if (rotation != 0) {
+			std::swap(rgba[i * 4 + rotation - 1], rgba[i * 4 + 3]);
+		}
+	}
+}
+
+} // namespace
+
+const char *texture_format_name(texture_format_t format) {
+	switch (format) {
+	case TEXTURE_BC1: return "BC1";
+	case TEXTURE_BC3: return "BC3";
+	default: return "BC7";
+	}
+}
+
+unsigned int texture_format_gl_internal(texture_format_t format) {
+	switch (format) {
+	case TEXTURE_BC1: return KTX_COMPRESSED_RGB_S3TC_DXT1;
+	case TEXTURE_BC3: return KTX_COMPRESSED_RGBA_S3TC_DXT5;
+	default: return KTX_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+}
+
+bool texture_format_from_gl(unsigned int gl_internal_format, texture_format_t *format) {
+	switch (gl_internal_format) {
+	case KTX_COMPRESSED_RGB_S3TC_DXT1: *format = TEXTURE_BC1; return true;
+	case KTX_COMPRESSED_RGBA_S3TC_DXT5: *format = TEXTURE_BC3; return true;
+	case KTX_COMPRESSED_RGBA_BPTC_UNORM: *format = TEXTURE_BC7; return true;
+	default: return false;
+	}
+}
+
+size_t texture_block_bytes(texture_format_t format) {
+	return format == TEXTURE_BC1 ? 8 : 16;
+}
+
+size_t texture_compressed_size(texture_format_t format, int w, int h) {
+	return (size_t)((w + 3) / 4) * ((h + 3) / 4) * texture_block_bytes(format);
+}
+
+void encode_block(texture_format_t format, const unsigned char rgba[64], unsigned char *block) {
+	block_pixels_t pixels;
+	to_block(rgba, pixels);
+	switch (format) {
+	case TEXTURE_BC1:
+		encode_colour(pixels, block);
+		break;
+	case TEXTURE_BC3:
+		encode_alpha(pixels, block);
+		encode_colour(pixels, block + 8);
+		break;
+	case TEXTURE_BC7:
+		encode_bc7(pixels, block);
+		break;
+	}
+}
+
+void decode_block(texture_format_t format, const unsigned char *block, unsigned char rgba[64]) {
+	switch (format) {
+	case TEXTURE_BC1:
+		decode_colour(block, false, rgba);
+		break;
+	case TEXTURE_BC3:
+		decode_colour(block + 8, true, rgba);
+		decode_alpha(block, rgba);
+		break;
+	case TEXTURE_BC7:
+		decode_bc7(block, rgba);
+		break;
+	}
+}
+
+void compress_image(thread_pool_t *pool, texture_format_t format, const unsigned char *rgba,
+	int w, int h, std::vector<unsigned char> &blocks) {
+	int blocks_x = (w + 3) / 4;
+	int blocks_y = (h + 3) / 4;
+	size_t block_bytes = texture_block_bytes(format);
+	blocks.resize(texture_compressed_size(format, w, h));
+	unsigned char *out = blocks.data();
+	thread_pool_parallel_for(pool, blocks_y, [=](size_t begin, size_t end) {
+		unsigned char pixels[64];
+		for (int by = (int)begin; by < (int)end; by++) {
+			for (int bx = 0; bx < blocks_x; bx++) {
+				for (int i = 0; i < 16; i++) {
+					int x = std::min(bx * 4 + (i & 3), w - 1);
+					int y = std::min(by * 4 + (i >> 2), h - 1);
+					memcpy(pixels + i * 4, rgba + ((size_t)y * w + x) * 4, 4);
+				}
+				encode_block(format, pixels, out + ((size_t)by * blocks_x + bx) * block_bytes);
+			}
+		}
+	});
+}
+
+void decompress_image(texture_format_t format, const unsigned char *blocks, int w, int h,
+	std::vector<unsigned char> &rgba) {
+	int blocks_x = (w + 3) / 4;
+	int blocks_y = (h + 3) / 4;
+	size_t block_bytes = texture_block_bytes(format);
+	rgba.resize((size_t)w * h * 4);
+	unsigned char pixels[64];
+	for (int by = 0; by < blocks_y; by++) {
+		for (int bx = 0; bx < blocks_x; bx++) {
+			decode_block(format, blocks + ((size_t)by * blocks_x + bx) * block_bytes, pixels);
+			for (int i = 0; i < 16; i++) {
+				int x = bx * 4 + (i & 3);
+				int y = by * 4 + (i >> 2);
+				if (x < w && y < h) {
+					memcpy(&rgba[((size_t)y * w + x) * 4], pixels + i * 4, 4);
+				}
+			}
+		}
+	}
+}
+
+double image_psnr(const unsigned char *a, const unsigned char *b, int w, int h, int channels) {
+	double squared = 0.0;
+	size_t pixels = (size_t)w * h;
+	for (size_t i = 0; i < pixels; i++) {
+		for (int c = 0; c < channels; c++) {
+			double d = (double)a[i * 4 + c] - b[i * 4 + c];
+			squared += d * d;
+		}
+	}
+	if (squared == 0.0) {
+		return 99.0;
+	}
+	double mse = squared / ((double)pixels * channels);
+	return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+bool ktx_parse(const unsigned char *data, size_t size, ktx_image_t *image, const char *name) {
+	ktx_header_t header;
+	if (size < sizeof(header)) {
+		fprintf(stderr, "ERROR: %s is too short for a KTX file\n", name);
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.identifier, ktx_identifier, sizeof(ktx_identifier)) != 0 ||
+		header.endianness != 0x04030201) {
+		fprintf(stderr, "ERROR: %s is not a little-endian KTX 1.1 file\n", name);
+		return false;
+	}
+	texture_format_t format;
+	if (header.gl_type != 0 || !texture_format_from_gl(header.gl_internal_format, &format) ||
+		header.faces != 1 || header.array_elements > 2048 || header.pixel_depth != 0) {
+		fprintf(stderr, "ERROR: %s is not a 2D or 2D array BC1/BC3/BC7 texture\n", name);
+		return false;
+	}
+	image->gl_internal_format = header.gl_internal_format;
+	image->width = (int)header.pixel_width;
+	image->height = (int)header.pixel_height;
+	image->layers = (int)header.array_elements;
+	image->bottom_up = false;
+	image->levels.clear();
+	image->level_sizes.clear();
+	if (size - sizeof(header) < header.key_value_bytes) {
+		fprintf(stderr, "ERROR: %s: key/value data runs past the end\n", name);
+		return false;
+	}
+	// key/value pairs: a 4 byte length, "key\0value\0", padding to 4 bytes
+	for (size_t offset = sizeof(header); offset + 4 <= sizeof(header) + header.key_value_bytes;) {
+		unsigned int pair_size = 0;
+		memcpy(&pair_size, data + offset, 4);
+		const char *pair = (const char *)data + offset + 4;
+		if (pair_size > header.key_value_bytes) {
+			break;
+		}
+		size_t key_length = strnlen(pair, pair_size);
+		if (key_length < pair_size && strcmp(pair, ktx_orientation_key) == 0) {
+			image->bottom_up = strstr(std::string(pair + key_length + 1,
+				pair_size - key_length - 1).c_str(), "T=u") != NULL;
+		}
+		offset += 4 + ((pair_size + 3) & ~3u);
+	}
+	size_t offset = sizeof(header) + header.key_value_bytes;
+	unsigned int levels = std::max(1u, header.mip_levels);
+	int w = image->width, h = image->height;
+	for (unsigned int level = 0; level < levels; level++) {
+		unsigned int level_size = 0;
+		if (offset > size || size - offset < 4) {
+			break;
+		}
+		memcpy(&level_size, data + offset, 4);
+		offset += 4;
+		if (level_size != texture_compressed_size(format, w, h) * std::max(1, image->layers) ||
+			size - offset < level_size) {
+			break;
+		}
+		image->levels.push_back(data + offset);
+		image->level_sizes.push_back(level_size);
+		offset += (level_size + 3) & ~3u;
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+	}
+	if (image->levels.size() != levels) {
+		fprintf(stderr, "ERROR: %s: mip level %u is truncated or the wrong size\n", name,
+			(unsigned int)image->levels.size());
+		return false;
+	}
+	return true;
+}
+
+bool ktx_write(const char *path, texture_format_t format, int w, int h, int layers, bool bottom_up,
+	const std::vector<std::vector<unsigned char>> &levels) {
+	ktx_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.identifier, ktx_identifier, sizeof(ktx_identifier));
+	header.endianness = 0x04030201;
+	header.gl_type_size = 1;
+	header.gl_internal_format = texture_format_gl_internal(format);
+	header.gl_base_internal_format = format == TEXTURE_BC1 ? KTX_RGB : KTX_RGBA;
+	header.pixel_width = (unsigned int)w;
+	header.pixel_height = (unsigned int)h;
+	header.array_elements = (unsigned int)layers;
+	header.faces = 1;
+	header.mip_levels = (unsigned int)levels.size();
+	std::vector<unsigned char> key_values;
+	if (bottom_up) {
+		std::string pair = std::string(ktx_orientation_key) + '\0' + "S=r,T=u" + '\0';
+		unsigned int pair_size = (unsigned int)pair.size();
+		key_values.resize(4 + ((pair_size + 3) & ~3u), 0);
+		memcpy(key_values.data(), &pair_size, 4);
+		memcpy(key_values.data() + 4, pair.data(), pair.size());
+	}
+	header.key_value_bytes = (unsigned int)key_values.size();
+
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "ERROR: could not write %s\n", path);
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(key_values.data(), 1, key_values.size(), file) == key_values.size();
+	for (size_t i = 0; ok && i < levels.size(); i++) {
+		// block data is always a multiple of 8 bytes, so no mip padding
+		unsigned int level_size = (unsigned int)levels[i].size();
+		ok = fwrite(&level_size, 4, 1, file) == 1 &&
+			fwrite(levels[i].data(), 1, levels[i].size(), file) == levels[i].size();
+	}
+	if (fclose(file) != 0 || !ok) {
+		fprintf(stderr, "ERROR: could not write %s\n", path);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+/******************************************************************************\
+| Block compression (BC1, BC3, BC7) for the offline texture baker, and the     |
+| KTX (version 1) container the results are stored in.                         |
+|   BC1  RGB,  4 bits a pixel: two RGB565 endpoints and 2-bit indices          |
+|   BC3  RGBA, 8 bits a pixel: a BC4 alpha block then a BC1 colour block       |
+|   BC7  RGBA, 8 bits a pixel: mode 6 (one RGBA 7.7.7.7+p endpoint pair, 4-bit |
+|        indices) for smooth images like the skyboxes, or modes 4 and 5 with   |
+|        colour and alpha (or a channel rotated into alpha) indexed apart,     |
+|        whichever of them has the least error for the block                   |
+| Endpoints come from the principal axis of the block's colours and are then   |
+| refined by least squares against the chosen indices, keeping whichever       |
+| quantised pair has the least error. The nearest palette entry search has     |
+| SSE2 and AVX2 kernels, picked by image_simd(), all giving the same blocks.   |
+| Images are compressed a row of blocks at a time on a thread_pool_t.          |
+| The decoders are there to measure what the encoders did (PSNR); BC7 decodes  |
+| modes 4, 5 and 6, which is everything the encoder writes.                    |
+| No OpenGL in here, the GL enums KTX needs are spelled out below.             |
+\******************************************************************************/
+#ifndef _TEXTURE_CODEC_H_
+#define _TEXTURE_CODEC_H_
+
+#include "thread_pool.h"
+#include <stddef.h>
+#include <vector>
+
+enum texture_format_t {
+	TEXTURE_BC1,
+	TEXTURE_BC3,
+	TEXTURE_BC7
+};
+
+// glInternalFormat / glBaseInternalFormat values, as stored in the KTX header
+#define KTX_COMPRESSED_RGB_S3TC_DXT1 0x83F0
+#define KTX_COMPRESSED_RGBA_S3TC_DXT5 0x83F3
+#define KTX_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define KTX_RGB 0x1907
+#define KTX_RGBA 0x1908
+
+const char *texture_format_name(texture_format_t format);
+unsigned int texture_format_gl_internal(texture_format_t format);
+// false if 'gl_internal_format' isn't one of the three above
+bool texture_format_from_gl(unsigned int gl_internal_format, texture_format_t *format);
+size_t texture_block_bytes(texture_format_t format);
+// bytes of a w x h level, partial blocks at the edges count as whole ones
+size_t texture_compressed_size(texture_format_t format, int w, int h);
+
+// one 4x4 block, 'rgba' is 16 pixels row by row
+void encode_block(texture_format_t format, const unsigned char rgba[64], unsigned char *block);
+void decode_block(texture_format_t format, const unsigned char *block, unsigned char rgba[64]);
+
+// 'rgba' is w x h, 4 channels. edge blocks repeat the last row and column.
+// 'pool' may be NULL to encode on the calling thread
+void compress_image(thread_pool_t *pool, texture_format_t format, const unsigned char *rgba,
+	int w, int h, std::vector<unsigned char> &blocks);
+void decompress_image(texture_format_t format, const unsigned char *blocks, int w, int h,
+	std::vector<unsigned char> &rgba);
+
+// peak signal to noise ratio in dB over the first 'channels' channels of
+// two 4 channel images, 99 if they're identical
+double image_psnr(const unsigned char *a, const unsigned char *b, int w, int h, int channels);
+
+// a KTX file's header and where its levels are. 'levels' point into the
+// bytes that were parsed, one face per level (faces = 1). an array's levels
+// hold every layer of that size, one after the other
+struct ktx_image_t {
+	unsigned int gl_internal_format;
+	int width, height;
+	int layers; // 0 for a plain 2D texture
+	bool bottom_up; // KTXorientation S=r,T=u: rows stored the way glTexImage2D wants them
+	std::vector<const unsigned char *> levels;
+	std::vector<size_t> level_sizes;
+};
+
+// false (with the reason printed) for anything but a single-face 2D or 2D
+// array compressed texture
+bool ktx_parse(const unsigned char *data, size_t size, ktx_image_t *image, const char *name);
+// 'levels' are the compressed mip levels, largest first, each with all
+// 'layers' in it for an array (0 writes a plain 2D texture). 'bottom_up'
+// records that the rows were flipped before encoding
+bool ktx_write(const char *path, texture_format_t format, int w, int h, int layers, bool bottom_up,
+	const std::vector<std::vector<unsigned char>> &levels);
+
+#endif
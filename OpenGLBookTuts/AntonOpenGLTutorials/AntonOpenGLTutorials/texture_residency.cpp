@@ -0,0 +1,169 @@
+#include "texture_residency.h"
+#include <algorithm>
+
+namespace {
+
+size_t bytes_from(const residency_texture_t &texture, int base_level) {
+	size_t bytes = 0;
+	for (size_t level = (size_t)std::max(0, base_level); level < texture.level_bytes.size(); level++) {
+		bytes += texture.level_bytes[level];
+	}
+	return bytes;
+}
+
+residency_texture_t *find(texture_residency_t *residency, int id) {
+	for (size_t i = 0; i < residency->textures.size(); i++) {
+		if (residency->textures[i].id == id) {
+			return &residency->textures[i];
+		}
+	}
+	return NULL;
+}
+
+// the least recently used texture that can still give something up, biggest
+// first among equals. NULL when everything left is in use or pinned
+residency_texture_t *eviction_candidate(texture_residency_t *residency,
+	const std::vector<int> &refused) {
+	residency_texture_t *best = NULL;
+	for (size_t i = 0; i < residency->textures.size(); i++) {
+		residency_texture_t &t = residency->textures[i];
+		if (t.pinned || t.base_level >= (int)t.level_bytes.size() ||
+			t.last_used + residency->keep_frames >= residency->frame ||
+			std::find(refused.begin(), refused.end(), t.id) != refused.end()) {
+			continue;
+		}
+		if (!best || t.last_used < best->last_used || (t.last_used == best->last_used &&
+			bytes_from(t, t.base_level) > bytes_from(*best, best->base_level))) {
+			best = &t;
+		}
+	}
+	return best;
+}
+
+} // namespace
+
+void residency_init(texture_residency_t *residency, const residency_backend_t &backend,
+	size_t budget) {
+	residency->backend = backend;
+	residency->budget = budget;
+	residency->frame = 0;
+	residency->keep_frames = 60;
+	residency->textures.clear();
+	residency->stats = residency_stats_t();
+}
+
+void residency_set_budget(texture_residency_t *residency, size_t budget) {
+	residency->budget = budget;
+}
+
+void residency_add(texture_residency_t *residency, int id, const size_t *level_bytes, int levels) {
+	residency_remove(residency, id);
+	residency_texture_t texture;
+	texture.id = id;
+	texture.level_bytes.assign(level_bytes, level_bytes + levels);
+	texture.base_level = 0;
+	texture.last_used = residency->frame;
+	texture.pinned = false;
+	residency->textures.push_back(texture);
+}
+
+void residency_remove(texture_residency_t *residency, int id) {
+	for (size_t i = 0; i < residency->textures.size(); i++) {
+		if (residency->textures[i].id == id) {
+			residency->textures.erase(residency->textures.begin() + i);
+			return;
+		}
+	}
+}
+
+void residency_set_pinned(texture_residency_t *residency, int id, bool pinned) {
+	residency_texture_t *texture = find(residency, id);
+	if (texture) {
+		texture->pinned = pinned;
+	}
+}
+
+void residency_touch(texture_residency_t *residency, int id) {
+	residency_texture_t *texture = find(residency, id);
+	if (!texture) {
+		return;
+	}
+	texture->last_used = residency->frame;
+}
+
+void residency_set_base_level(texture_residency_t *residency, int id, int base_level) {
+	residency_texture_t *texture = find(residency, id);
+	if (!texture) {
+		return;
+	}
+	base_level = std::max(0, std::min(base_level, (int)texture->level_bytes.size()));
+	if (base_level < texture->base_level) {
+		residency->stats.restores++;
+	}
+	texture->base_level = base_level;
+}
+
+void residency_end_frame(texture_residency_t *residency) {
+	size_t resident = 0;
+	for (size_t i = 0; i < residency->textures.size(); i++) {
+		resident += bytes_from(residency->textures[i], residency->textures[i].base_level);
+	}
+	residency->stats.peak_bytes = std::max(residency->stats.peak_bytes, resident);
+
+	std::vector<int> refused; // couldn't give anything up this frame
+	while (resident > residency->budget) {
+		residency_texture_t *texture = eviction_candidate(residency, refused);
+		if (!texture) {
+			residency->stats.over_budget_frames++;
+			break;
+		}
+		// as few of its largest levels as get back under budget, all of them if need be
+		size_t had = bytes_from(*texture, texture->base_level);
+		int levels = (int)texture->level_bytes.size();
+		int base = texture->base_level + 1;
+		while (base < levels && resident - had + bytes_from(*texture, base) > residency->budget) {
+			base++;
+		}
+		int got = residency->backend.evict(residency->backend.user, texture->id, base);
+		residency->stats.evictions++;
+		got = std::max(0, std::min(got, levels));
+		if (got <= texture->base_level) {
+			refused.push_back(texture->id);
+			continue;
+		}
+		size_t left = bytes_from(*texture, got);
+		residency->stats.evicted_bytes += had - left;
+		resident -= had - left;
+		texture->base_level = got;
+	}
+	residency->frame++;
+}
+
+int residency_base_level(const texture_residency_t *residency, int id) {
+	for (size_t i = 0; i < residency->textures.size(); i++) {
+		if (residency->textures[i].id == id) {
+			return residency->textures[i].base_level;
+		}
+	}
+	return -1;
+}
+
+residency_stats_t residency_stats(const texture_residency_t *residency) {
+	residency_stats_t stats = residency->stats;
+	stats.budget = residency->budget;
+	stats.resident_bytes = stats.full_bytes = 0;
+	stats.textures = (int)residency->textures.size();
+	stats.evicted_textures = stats.placeholder_textures = 0;
+	for (size_t i = 0; i < residency->textures.size(); i++) {
+		const residency_texture_t &t = residency->textures[i];
+		stats.resident_bytes += bytes_from(t, t.base_level);
+		stats.full_bytes += bytes_from(t, 0);
+		if (t.base_level > 0) {
+			stats.evicted_textures++;
+		}
+		if (t.base_level >= (int)t.level_bytes.size()) {
+			stats.placeholder_textures++;
+		}
+	}
+	return stats;
+}
@@ -0,0 +1,79 @@
+#pragma once
+/******************************************************************************\
+| Keeps the textures in video memory under a budget.                           |
+| Every texture is tracked with the bytes of each of its mip levels (all faces |
+| or layers together). Once a frame, when the total is over budget, the least  |
+| recently used texture that hasn't been used for a while gives up its         |
+| largest levels, as few as get back under, and then its smaller ones too      |
+| down to its placeholder. The next one in line goes after that.               |
+| The textures themselves belong to a residency_backend_t, the streamer's      |
+| shrinks them with glCopyImageSubData. It also grows them again, a level at a |
+| time as their size on screen asks for it, and reports each new base level    |
+| with residency_set_base_level. This file does the bookkeeping only, so a     |
+| fake backend can drive it without OpenGL, as tools/residency_test does.      |
+\******************************************************************************/
+#ifndef _TEXTURE_RESIDENCY_H_
+#define _TEXTURE_RESIDENCY_H_
+
+#include <stddef.h>
+#include <vector>
+
+struct residency_backend_t {
+	void *user;
+	// keep only texture 'id''s levels from 'base_level' down, the placeholder
+	// when 'base_level' is its level count. returns the base level it ended up
+	// with, which may be lower if it couldn't (or higher, if it went all the
+	// way to the placeholder)
+	int (*evict)(void *user, int id, int base_level);
+};
+
+struct residency_stats_t {
+	size_t budget;
+	size_t resident_bytes; // every tracked texture's resident levels
+	size_t peak_bytes;
+	size_t full_bytes; // what they'd take with nothing evicted
+	int textures;
+	int evicted_textures; // below their finest level right now
+	int placeholder_textures; // down to the placeholder right now
+	unsigned long long evictions; // calls to the backend's evict
+	unsigned long long restores; // base levels lowered again, finer levels streamed back in
+	unsigned long long evicted_bytes; // freed by evictions, all told
+	unsigned long long over_budget_frames; // everything left was in use
+};
+
+struct residency_texture_t {
+	int id;
+	std::vector<size_t> level_bytes;
+	int base_level; // levels above it are gone, level count means the placeholder
+	unsigned long long last_used; // frame
+	bool pinned; // never evicted
+};
+
+struct texture_residency_t {
+	residency_backend_t backend;
+	size_t budget;
+	unsigned long long frame;
+	unsigned keep_frames; // textures used in the last this many frames stay
+	std::vector<residency_texture_t> textures;
+	residency_stats_t stats;
+};
+
+// 'budget' in bytes, SIZE_MAX for none
+void residency_init(texture_residency_t *residency, const residency_backend_t &backend,
+	size_t budget);
+void residency_set_budget(texture_residency_t *residency, size_t budget);
+// starts tracking 'id' with all its levels resident, counted as used this frame
+void residency_add(texture_residency_t *residency, int id, const size_t *level_bytes, int levels);
+void residency_remove(texture_residency_t *residency, int id);
+void residency_set_pinned(texture_residency_t *residency, int id, bool pinned);
+// 'id' is drawn with this frame
+void residency_touch(texture_residency_t *residency, int id);
+// the backend has grown (or shrunk) 'id' to 'base_level' on its own
+void residency_set_base_level(texture_residency_t *residency, int id, int base_level);
+// evicts down to the budget, then starts the next frame
+void residency_end_frame(texture_residency_t *residency);
+// the base level of 'id', -1 if it isn't tracked
+int residency_base_level(const texture_residency_t *residency, int id);
+residency_stats_t residency_stats(const texture_residency_t *residency);
+
+#endif
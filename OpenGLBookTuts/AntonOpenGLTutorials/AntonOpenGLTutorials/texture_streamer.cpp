@@ -0,0 +1,825 @@
+#include "texture_streamer.h"
+#include "profiler.h"
+#include "texture_codec.h"
+#include "steady_time.h"
+#include <algorithm>
+#include <float.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+GLenum face_target(const streamed_texture_t *texture, int face) {
+	return texture->target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face :
+		GL_TEXTURE_2D;
+}
+
+// faces are given front, back, top, bottom, left, right
+const GLenum cube_sides[6] = {
+	GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, GL_TEXTURE_CUBE_MAP_POSITIVE_Z,
+	GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
+	GL_TEXTURE_CUBE_MAP_NEGATIVE_X, GL_TEXTURE_CUBE_MAP_POSITIVE_X};
+
+GLenum side_target(const streamed_texture_t *texture, int face) {
+	return texture->target == GL_TEXTURE_CUBE_MAP ? cube_sides[face] : GL_TEXTURE_2D;
+}
+
+// RGB images stay RGB on the GPU too. RGBA goes up as BGRA, which is what most
+// drivers store, so they copy it instead of swizzling it
+GLenum storage_format(int channels) {
+	return channels == 3 ? GL_RGB8 : GL_RGBA8;
+}
+
+GLenum upload_format(int channels) {
+	return channels == 3 ? GL_RGB : GL_BGRA;
+}
+
+GLenum upload_type(int channels) {
+	return channels == 3 ? GL_UNSIGNED_BYTE : GL_UNSIGNED_INT_8_8_8_8_REV;
+}
+
+void set_parameters(GLenum target) {
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	if (target == GL_TEXTURE_CUBE_MAP) {
+		glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	}
+}
+
+// where the next upload can be written, NULL if the GPU still reads that segment
+unsigned char *begin_segment(texture_streamer_t *streamer) {
+	int segment = streamer->next_segment;
+	GLsync &fence = streamer->fences[segment];
+	if (fence) {
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED) {
+			return NULL;
+		}
+		glDeleteSync(fence);
+		fence = 0;
+	}
+	GLintptr offset = (GLintptr)segment * TEXTURE_STREAMER_SEGMENT_BYTES;
+	if (streamer->mapped) {
+		return streamer->mapped + offset;
+	}
+	GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+	if (streamer->have_sync) {
+		access |= GL_MAP_UNSYNCHRONIZED_BIT; // the fence already says it's free
+	}
+	return (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset,
+		TEXTURE_STREAMER_SEGMENT_BYTES, access);
+}
+
+// called with the segment's data written and the texture bound on the upload unit
+void end_segment(texture_streamer_t *streamer, const streamed_texture_t *texture, int level,
+	int rows) {
+	int segment = streamer->next_segment;
+	if (!streamer->mapped) {
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	int w = std::max(1, texture->width >> level);
+	glTexSubImage2D(side_target(texture, texture->face), level - texture->base_level, 0,
+		texture->row, w, rows, upload_format(texture->channels), upload_type(texture->channels),
+		(const void *)((size_t)segment * TEXTURE_STREAMER_SEGMENT_BYTES));
+	if (streamer->have_sync) {
+		streamer->fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	streamer->next_segment = (segment + 1) % TEXTURE_STREAMER_SEGMENTS;
+}
+
+void swap_in(streamed_texture_t *texture) {
+	glActiveTexture(texture->unit);
+	glBindTexture(texture->target, texture->texture);
+	glDeleteTextures(1, &texture->placeholder);
+	texture->placeholder = 0;
+	texture->ready = true;
+	printf("texture streamer: %s%s ready at %ix%i %.1f ms after the request\n",
+		texture->names[0].c_str(), texture->names.size() > 1 ? " (cube map)" : "",
+		std::max(1, texture->width >> texture->uploaded_level),
+		std::max(1, texture->height >> texture->uploaded_level), now_ms() - texture->requested_ms);
+}
+
+bool format_supported(texture_format_t format) {
+	if (format == TEXTURE_BC7) {
+		return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+	}
+	return GLEW_EXT_texture_compression_s3tc != 0;
+}
+
+std::string baked_name(const std::string &name) {
+	size_t dot = name.find_last_of('.');
+	return (dot == std::string::npos ? name : name.substr(0, dot)) + ".ktx";
+}
+
+// reads the baked .ktx of every face into 'ktx', if they are all there, agree
+// with each other (and the texture, once it has a size) and the driver can
+// sample the format. false leaves the texture as it was
+bool read_baked(texture_streamer_t *streamer, streamed_texture_t *texture) {
+	size_t count = texture->names.size();
+	std::vector<std::vector<unsigned char>> files(count);
+	std::vector<ktx_image_t> faces(count);
+	for (size_t i = 0; i < count; i++) {
+		std::string name = baked_name(texture->names[i]);
+		if (!streamer->read(name.c_str(), files[i])) {
+			return false; // not baked
+		}
+		if (!ktx_parse(files[i].data(), files[i].size(), &faces[i], name.c_str())) {
+			return false;
+		}
+		if ((faces[i].layers > 0) != (texture->target == GL_TEXTURE_2D_ARRAY)) {
+			fprintf(stderr, "WARNING: %s %s a texture array, using the image\n", name.c_str(),
+				faces[i].layers > 0 ? "is" : "isn't");
+			return false;
+		}
+		if (faces[i].bottom_up != texture->flip) {
+			fprintf(stderr, "WARNING: %s was baked %s --flip, using the image\n", name.c_str(),
+				texture->flip ? "without" : "with");
+			return false;
+		}
+		if (i > 0 && (faces[i].gl_internal_format != faces[0].gl_internal_format ||
+			faces[i].width != faces[0].width || faces[i].height != faces[0].height ||
+			faces[i].levels.size() != faces[0].levels.size())) {
+			fprintf(stderr, "WARNING: %s doesn't match the other baked faces, using the images\n",
+				name.c_str());
+			return false;
+		}
+	}
+	if (texture->baked && (faces[0].gl_internal_format != texture->internal_format ||
+		faces[0].width != texture->width || faces[0].height != texture->height ||
+		(int)faces[0].levels.size() != texture->levels)) {
+		fprintf(stderr, "ERROR: %s changed since it was first read\n",
+			baked_name(texture->names[0]).c_str());
+		return false;
+	}
+	texture_format_t format;
+	texture_format_from_gl(faces[0].gl_internal_format, &format);
+	if (!format_supported(format)) {
+		printf("texture streamer: the driver has no %s, using %s\n", texture_format_name(format),
+			texture->names[0].c_str());
+		return false;
+	}
+	// the parsed levels point into the files, which keep their buffers when moved
+	texture->ktx_files.swap(files);
+	texture->ktx.swap(faces);
+	return true;
+}
+
+// the pixels of the levels still to upload: the baked files, or decode jobs
+// for the images. false if they can't be had
+bool start_source(texture_streamer_t *streamer, streamed_texture_t *texture) {
+	if (texture->baked) {
+		return !texture->ktx.empty() || read_baked(streamer, texture);
+	}
+	if (!texture->decoding) {
+		image_batch_free(&texture->images);
+		image_batch_init(&texture->images, streamer->decode);
+		image_batch_set_cache(&texture->images, streamer->cache, streamer->hash);
+		size_t face_bytes = (size_t)texture->width * texture->height * texture->channels;
+		if (streamer->mapped && !texture->staging && texture->wanted_level == 0) {
+			// level 0 is decoded straight into a buffer of its own and uploaded from there.
+			// only when level 0 is wanted: the buffer is the size of every face's level 0,
+			// which the residency budget doesn't count, and a preview doesn't need it
+			GLint unpack = 0;
+			glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack);
+			GLsizeiptr size = (GLsizeiptr)(face_bytes * texture->names.size());
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glGenBuffers(1, &texture->staging);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->staging);
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+			texture->staging_memory = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+				size, flags);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpack);
+		}
+		for (size_t i = 0; i < texture->names.size(); i++) {
+			image_batch_add(&texture->images, texture->names[i].c_str(), texture->channels,
+				texture->flip, texture->channels == 4, streamer->mip_filter);
+			if (texture->staging_memory) {
+				image_batch_set_destination(&texture->images, i,
+					texture->staging_memory + face_bytes * i, face_bytes);
+			}
+		}
+		image_batch_start(&texture->images, streamer->pool);
+		texture->decoding = true;
+	}
+	return true;
+}
+
+// the staging buffer, once nothing decodes into it. the GPU keeps it until it
+// has finished uploading from it
+void free_staging(streamed_texture_t *texture) {
+	if (!texture->staging) {
+		return;
+	}
+	GLint unpack = 0;
+	glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->staging);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpack == (GLint)texture->staging ? 0 : unpack);
+	glDeleteBuffers(1, &texture->staging);
+	texture->staging = 0;
+	texture->staging_memory = NULL;
+}
+
+// frees the pixels once nothing more is wanted from them. decoded images are
+// only let go of when every decode has finished, waiting would stall the frame
+void release_source(streamed_texture_t *texture) {
+	std::vector<std::vector<unsigned char>>().swap(texture->ktx_files);
+	texture->ktx.clear();
+	if (!texture->decoding) {
+		return;
+	}
+	for (size_t i = 0; i < texture->images.images.size(); i++) {
+		if (!image_batch_ready(&texture->images, i)) {
+			return;
+		}
+	}
+	image_batch_free(&texture->images);
+	free_staging(texture);
+	texture->decoding = false;
+}
+
+// the finest level a texture drawn 'pixels' across needs: the smallest one
+// that is still at least that big
+int level_for_size(const streamed_texture_t *texture, float pixels) {
+	int size = std::max(texture->width, texture->height);
+	int level = 0;
+	while (level + 1 < texture->levels && (float)(size >> (level + 1)) >= pixels) {
+		level++;
+	}
+	return level;
+}
+
+// the level shown first, until the texture is drawn and its size is known
+int preview_level(const streamed_texture_t *texture) {
+	int level = 0;
+	while (level + 1 < texture->levels &&
+		std::max(texture->width, texture->height) >> level > TEXTURE_STREAMER_PREVIEW_SIZE) {
+		level++;
+	}
+	return level;
+}
+
+// storage can only start below level 0 when levels can be copied into bigger
+// storage as finer ones are wanted
+bool can_resize(const texture_streamer_t *streamer) {
+	return streamer->immutable_storage && (GLEW_VERSION_4_3 || GLEW_ARB_copy_image);
+}
+
+// the placeholder colour as a 1x1 texture bound on the texture's unit
+void make_placeholder(streamed_texture_t *texture) {
+	glGenTextures(1, &texture->placeholder);
+	glActiveTexture(texture->unit);
+	glBindTexture(texture->target, texture->placeholder);
+	if (texture->target == GL_TEXTURE_2D_ARRAY) {
+		glTexImage3D(texture->target, 0, GL_RGBA8, 1, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+			texture->placeholder_colour);
+	} else {
+		for (int i = 0; i < (int)texture->names.size(); i++) {
+			glTexImage2D(face_target(texture, i), 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+				texture->placeholder_colour);
+		}
+	}
+	set_parameters(texture->target);
+}
+
+// gives the texture storage for the levels from 'base' down and frees the old
+// one, copying over the complete levels both have with glCopyImageSubData (a
+// level that was half uploaded starts again). 'levels' frees it and goes back
+// to the placeholder. without texture storage a baked texture goes up whole
+// right here, it can't be left undefined. the new storage is bound on the
+// texture's unit if it's ready, the upload unit otherwise
+void set_storage(texture_streamer_t *streamer, streamed_texture_t *texture, int base) {
+	GLenum target = texture->target;
+	int depth = target == GL_TEXTURE_CUBE_MAP ? 6 : std::max(1, texture->layers);
+	GLint unpack = 0;
+	glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GLuint storage = 0;
+	int uploaded = std::max(texture->uploaded_level, base);
+	if (base < texture->levels) {
+		int levels = texture->levels - base;
+		int w = std::max(1, texture->width >> base);
+		int h = std::max(1, texture->height >> base);
+		glGenTextures(1, &storage);
+		glActiveTexture(streamer->upload_unit);
+		glBindTexture(target, storage);
+		if (streamer->immutable_storage) {
+			if (target == GL_TEXTURE_2D_ARRAY) {
+				glTexStorage3D(target, levels, texture->internal_format, w, h, texture->layers);
+			} else {
+				glTexStorage2D(target, levels, texture->internal_format, w, h);
+			}
+		} else if (texture->baked) {
+			for (int level = 0; level < levels; level++) {
+				const ktx_image_t &ktx = texture->ktx[0];
+				int lw = std::max(1, w >> level), lh = std::max(1, h >> level);
+				if (target == GL_TEXTURE_2D_ARRAY) {
+					glCompressedTexImage3D(target, level, texture->internal_format, lw, lh,
+						texture->layers, 0, (GLsizei)ktx.level_sizes[base + level],
+						ktx.levels[base + level]);
+					continue;
+				}
+				for (size_t i = 0; i < texture->ktx.size(); i++) {
+					glCompressedTexImage2D(side_target(texture, (int)i), level, texture->internal_format,
+						lw, lh, 0, (GLsizei)texture->ktx[i].level_sizes[base + level],
+						texture->ktx[i].levels[base + level]);
+				}
+			}
+			uploaded = base;
+		} else {
+			for (int level = 0; level < levels; level++) {
+				for (int i = 0; i < (int)texture->names.size(); i++) {
+					glTexImage2D(face_target(texture, i), level, texture->internal_format,
+						std::max(1, w >> level), std::max(1, h >> level), 0,
+						upload_format(texture->channels), upload_type(texture->channels), NULL);
+				}
+			}
+		}
+		set_parameters(target);
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		if (levels > 1) {
+			glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		}
+		if (texture->texture) {
+			for (int level = uploaded; level < texture->levels; level++) {
+				glCopyImageSubData(texture->texture, target, level - texture->base_level, 0, 0, 0,
+					storage, target, level - base, 0, 0, 0, std::max(1, texture->width >> level),
+					std::max(1, texture->height >> level), depth);
+			}
+		}
+		if (uploaded < texture->levels) {
+			glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, uploaded - base);
+		}
+	} else {
+		uploaded = texture->levels;
+	}
+	glDeleteTextures(1, &texture->texture);
+	texture->texture = storage;
+	texture->base_level = base;
+	texture->uploaded_level = uploaded;
+	texture->face = texture->row = 0;
+	if (texture->ready && storage) {
+		glActiveTexture(texture->unit);
+		glBindTexture(target, storage);
+	} else if (texture->ready) {
+		make_placeholder(texture);
+		texture->ready = false;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpack);
+}
+
+// the baked texture's size and format, or the images' from their headers, and
+// the placeholder. storage comes from the first update that streams it
+void start_loading(texture_streamer_t *streamer, streamed_texture_t *texture) {
+	GLenum target = texture->target;
+	int count = (int)texture->names.size();
+	texture->requested_ms = now_ms();
+	GLint active = 0;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+	make_placeholder(texture);
+	if (streamer->read && read_baked(streamer, texture)) {
+		const ktx_image_t &ktx = texture->ktx[0];
+		texture->baked = true;
+		texture->width = ktx.width;
+		texture->height = ktx.height;
+		texture->layers = ktx.layers;
+		texture->levels = (int)ktx.levels.size();
+		texture->internal_format = ktx.gl_internal_format;
+		texture->level_bytes.assign(texture->levels, 0);
+		for (int level = 0; level < texture->levels; level++) {
+			for (size_t i = 0; i < texture->ktx.size(); i++) {
+				texture->level_bytes[level] += texture->ktx[i].level_sizes[level];
+			}
+		}
+		texture_format_t format;
+		texture_format_from_gl(texture->internal_format, &format);
+		printf("texture streamer: %s%s from %s, %s with %i levels\n", texture->names[0].c_str(),
+			count > 1 ? " (cube map)" : (texture->layers > 0 ? " (array)" : ""),
+			baked_name(texture->names[0]).c_str(), texture_format_name(format), texture->levels);
+	} else if (target == GL_TEXTURE_2D_ARRAY) {
+		// arrays are only ever baked, tools/atlas_builder makes them
+		fprintf(stderr, "ERROR: could not load the texture array %s\n", texture->names[0].c_str());
+		texture->failed = true;
+	} else {
+		// every face has to be there and the same size before any storage is made. the
+		// texture is RGB if every face is, RGBA otherwise (grey images are expanded)
+		int channels = 3;
+		for (int i = 0; i < count; i++) {
+			const char *name = texture->names[i].c_str();
+			int x = 0, y = 0, n = 0;
+			if (!streamer->probe(name, &x, &y, &n)) {
+				fprintf(stderr, "ERROR: could not load %s\n", name);
+				texture->failed = true;
+			} else if (i > 0 && (x != texture->width || y != texture->height)) {
+				fprintf(stderr, "ERROR: %s is %ix%i, the other faces are %ix%i\n", name, x, y,
+					texture->width, texture->height);
+				texture->failed = true;
+			} else if ((size_t)x * 4 > TEXTURE_STREAMER_SEGMENT_BYTES) {
+				fprintf(stderr, "ERROR: %s is too wide to stream\n", name);
+				texture->failed = true;
+			}
+			texture->width = x;
+			texture->height = y;
+			if (n != 3) {
+				channels = 4;
+			}
+		}
+		texture->channels = channels;
+		if (!texture->failed) {
+			if ((texture->width & (texture->width - 1)) != 0 ||
+				(texture->height & (texture->height - 1)) != 0) {
+				fprintf(stderr, "WARNING: image %s is not power-of-2 dimensions\n",
+					texture->names[0].c_str());
+			}
+			texture->levels = streamer->mip_filter == MIP_FILTER_NONE ? 1 :
+				mip_level_count(texture->width, texture->height);
+			texture->internal_format = storage_format(channels);
+			texture->level_bytes.clear();
+			for (int level = 0; level < texture->levels; level++) {
+				texture->level_bytes.push_back((size_t)std::max(1, texture->width >> level) *
+					std::max(1, texture->height >> level) * channels * count);
+			}
+		}
+	}
+	texture->base_level = texture->uploaded_level = texture->levels;
+	texture->wanted_level = preview_level(texture);
+	glActiveTexture(active);
+}
+
+streamed_texture_t *request(texture_streamer_t *streamer, GLenum target,
+	const char *const *names, int count, GLenum unit, bool flip,
+	const unsigned char placeholder[4]) {
+	streamed_texture_t *texture = new streamed_texture_t;
+	texture->target = target;
+	texture->unit = unit;
+	texture->texture = 0;
+	texture->internal_format = 0;
+	texture->width = texture->height = 0;
+	texture->levels = 1;
+	texture->layers = 0;
+	texture->channels = 4;
+	texture->baked = false;
+	texture->decoding = false;
+	texture->staging = 0;
+	texture->staging_memory = NULL;
+	texture->face = texture->row = 0;
+	texture->ready = false;
+	texture->failed = false;
+	texture->released = false;
+	texture->flip = flip;
+	texture->screen_pixels = 0.0f;
+	texture->placeholder = 0;
+	memcpy(texture->placeholder_colour, placeholder, 4);
+	image_batch_init(&texture->images, streamer->decode);
+	for (int i = 0; i < count; i++) {
+		texture->names.push_back(names[i]);
+	}
+	texture->id = (int)streamer->textures.size();
+	streamer->textures.push_back(texture);
+	start_loading(streamer, texture);
+	if (!texture->failed) {
+		residency_add(&streamer->residency, texture->id, texture->level_bytes.data(),
+			(int)texture->level_bytes.size());
+		residency_set_base_level(&streamer->residency, texture->id, texture->base_level);
+	}
+	return texture;
+}
+
+// residency_backend_t's evict: keeps the levels from 'base_level' down (or
+// only the placeholder, which is all there is without copy_image) and doesn't
+// stream finer ones again until a draw asks for them
+int evict_texture(void *user, int id, int base_level) {
+	texture_streamer_t *streamer = (texture_streamer_t *)user;
+	streamed_texture_t *texture = streamer->textures[id];
+	if (texture->failed || base_level <= texture->base_level) {
+		return texture->base_level;
+	}
+	if (!can_resize(streamer)) {
+		base_level = texture->levels;
+	}
+	GLint active = 0;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+	set_storage(streamer, texture, base_level);
+	texture->wanted_level = std::max(texture->wanted_level, base_level);
+	release_source(texture);
+	if (base_level >= texture->levels) {
+		printf("texture streamer: evicted %s to its placeholder\n", texture->names[0].c_str());
+	} else {
+		printf("texture streamer: evicted %s down to %ix%i\n", texture->names[0].c_str(),
+			std::max(1, texture->width >> base_level), std::max(1, texture->height >> base_level));
+	}
+	glActiveTexture(active);
+	return base_level;
+}
+
+// uploads the next level's rows (all faces) within the frame budget, called with
+// the texture bound on the upload unit and the ring bound. false once the ring
+// is full
+bool upload_image_rows(texture_streamer_t *streamer, streamed_texture_t *texture,
+	size_t *uploaded) {
+	int face_count = (int)texture->names.size();
+	int level = texture->uploaded_level - 1;
+	while (texture->face < face_count && *uploaded < streamer->frame_budget) {
+		if (!image_batch_ready(&texture->images, texture->face)) {
+			return true; // faces go up in order, the next texture may be further along
+		}
+		const batch_image_t &image = texture->images.images[texture->face];
+		if (!image.pixels || image.x != texture->width || image.y != texture->height ||
+			(int)image.mips.size() != texture->levels - 1) {
+			fprintf(stderr, "ERROR: could not load %s\n", image.name.c_str());
+			texture->failed = true;
+			return true;
+		}
+		const unsigned char *pixels = level == 0 ? image.pixels : image.mips[level - 1].pixels.data();
+		int level_height = std::max(1, texture->height >> level);
+		size_t row_bytes = (size_t)std::max(1, texture->width >> level) * texture->channels;
+		size_t budget_rows = (streamer->frame_budget - *uploaded) / row_bytes;
+		int rows = level_height - texture->row;
+		rows = (int)std::min((size_t)rows, budget_rows > 0 ? budget_rows : 1);
+
+		if (texture->staging_memory && image.pixels == image.dest && level == 0) {
+			// decoded into the staging buffer, it goes up from there without a copy
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->staging);
+			size_t offset = (size_t)(image.dest - texture->staging_memory) + texture->row * row_bytes;
+			glTexSubImage2D(side_target(texture, texture->face), -texture->base_level, 0,
+				texture->row, texture->width, rows, upload_format(texture->channels),
+				upload_type(texture->channels), (const void *)offset);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamer->buffer);
+		} else {
+			rows = (int)std::min((size_t)rows, TEXTURE_STREAMER_SEGMENT_BYTES / row_bytes);
+			unsigned char *segment = begin_segment(streamer);
+			if (!segment) {
+				return false; // the GPU is behind, try again next frame
+			}
+			memcpy(segment, pixels + texture->row * row_bytes, rows * row_bytes);
+			end_segment(streamer, texture, level, rows);
+		}
+		*uploaded += rows * row_bytes;
+		texture->row += rows;
+		if (texture->row == level_height) {
+			texture->row = 0;
+			texture->face++;
+		}
+	}
+	return true;
+}
+
+// uploads the next level of a baked texture, a face at a time, straight from
+// the file (it's compressed and small next to the images)
+void upload_baked_level(texture_streamer_t *streamer, streamed_texture_t *texture,
+	size_t *uploaded) {
+	int level = texture->uploaded_level - 1;
+	int w = std::max(1, texture->width >> level);
+	int h = std::max(1, texture->height >> level);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	while (texture->face < (int)texture->ktx.size() && *uploaded < streamer->frame_budget) {
+		const ktx_image_t &ktx = texture->ktx[texture->face];
+		if (texture->target == GL_TEXTURE_2D_ARRAY) {
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level - texture->base_level, 0, 0, 0, w, h,
+				texture->layers, texture->internal_format, (GLsizei)ktx.level_sizes[level],
+				ktx.levels[level]);
+		} else {
+			glCompressedTexSubImage2D(side_target(texture, texture->face), level - texture->base_level,
+				0, 0, w, h, texture->internal_format, (GLsizei)ktx.level_sizes[level], ktx.levels[level]);
+		}
+		*uploaded += ktx.level_sizes[level];
+		texture->face++;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamer->buffer);
+}
+
+// frees a released texture and its slot once no worker decodes into it any more
+void drop_released(texture_streamer_t *streamer, streamed_texture_t *texture) {
+	release_source(texture);
+	if (!texture->decoding) {
+		free_staging(texture);
+		streamer->textures[texture->id] = NULL;
+		delete texture;
+	}
+}
+
+// textures that are still only the placeholder first, then the ones furthest
+// from the level they want, each level short being twice too blurry
+bool upload_sooner(const streamed_texture_t *a, const streamed_texture_t *b) {
+	if (a->ready != b->ready) {
+		return !a->ready;
+	}
+	return a->uploaded_level - a->wanted_level > b->uploaded_level - b->wanted_level;
+}
+
+} // namespace
+
+void texture_streamer_init(texture_streamer_t *streamer, thread_pool_t *pool,
+	image_decode_function_t decode, image_probe_function_t probe, asset_read_function_t read,
+	size_t frame_budget) {
+	streamer->pool = pool;
+	streamer->decode = decode;
+	streamer->probe = probe;
+	streamer->read = read;
+	streamer->cache = NULL;
+	streamer->hash = NULL;
+	streamer->frame_budget = frame_budget;
+	streamer->mip_filter = MIP_FILTER_KAISER;
+	streamer->immutable_storage = GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+	streamer->have_sync = GLEW_VERSION_3_2 || GLEW_ARB_sync;
+	for (int i = 0; i < TEXTURE_STREAMER_SEGMENTS; i++) {
+		streamer->fences[i] = 0;
+	}
+	streamer->next_segment = 0;
+	streamer->textures.clear();
+	residency_backend_t backend = { streamer, evict_texture };
+	residency_init(&streamer->residency, backend, SIZE_MAX);
+
+	GLint units = 0;
+	glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &units);
+	streamer->upload_unit = GL_TEXTURE0 + units - 1;
+
+	GLsizeiptr size = (GLsizeiptr)TEXTURE_STREAMER_SEGMENTS * TEXTURE_STREAMER_SEGMENT_BYTES;
+	glGenBuffers(1, &streamer->buffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamer->buffer);
+	streamer->mapped = NULL;
+	if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+		streamer->mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+			flags);
+	} else {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	printf("texture streamer: %i x %i KB %s, %zu KB per frame\n", TEXTURE_STREAMER_SEGMENTS,
+		TEXTURE_STREAMER_SEGMENT_BYTES / 1024,
+		streamer->mapped ? "persistently mapped" : "mapped per upload", frame_budget / 1024);
+}
+
+streamed_texture_t *texture_streamer_request_2d(texture_streamer_t *streamer, const char *name,
+	GLenum unit, bool flip, const unsigned char placeholder[4]) {
+	return request(streamer, GL_TEXTURE_2D, &name, 1, unit, flip, placeholder);
+}
+
+streamed_texture_t *texture_streamer_request_cube(texture_streamer_t *streamer,
+	const char *const faces[6], GLenum unit, const unsigned char placeholder[4]) {
+	return request(streamer, GL_TEXTURE_CUBE_MAP, faces, 6, unit, false, placeholder);
+}
+
+streamed_texture_t *texture_streamer_request_array(texture_streamer_t *streamer, const char *name,
+	GLenum unit, const unsigned char placeholder[4]) {
+	return request(streamer, GL_TEXTURE_2D_ARRAY, &name, 1, unit, false, placeholder);
+}
+
+void texture_streamer_touch(texture_streamer_t *streamer, streamed_texture_t *texture,
+	float screen_pixels) {
+	texture->screen_pixels = std::max(texture->screen_pixels,
+		screen_pixels > 0.0f ? screen_pixels : FLT_MAX);
+	residency_touch(&streamer->residency, texture->id);
+}
+
+void texture_streamer_release(texture_streamer_t *streamer, streamed_texture_t *texture) {
+	residency_remove(&streamer->residency, texture->id);
+	glDeleteTextures(1, &texture->texture);
+	glDeleteTextures(1, &texture->placeholder);
+	texture->texture = texture->placeholder = 0;
+	texture->ready = false;
+	texture->wanted_level = texture->uploaded_level = texture->levels;
+	texture->released = true;
+	drop_released(streamer, texture);
+}
+
+void texture_streamer_set_cache(texture_streamer_t *streamer, texture_cache_t *cache,
+	image_hash_function_t hash) {
+	streamer->cache = cache;
+	streamer->hash = hash;
+}
+
+size_t texture_streamer_update(texture_streamer_t *streamer) {
+	// last frame's draws have touched what they use, everything else may go
+	residency_end_frame(&streamer->residency);
+	// and said how big they drew it
+	for (size_t t = 0; t < streamer->textures.size(); t++) {
+		streamed_texture_t *texture = streamer->textures[t];
+		if (!texture) {
+			continue;
+		}
+		if (texture->released) {
+			drop_released(streamer, texture);
+			continue;
+		}
+		if (texture->screen_pixels > 0.0f && !texture->failed) {
+			texture->wanted_level = level_for_size(texture, texture->screen_pixels);
+		}
+		texture->screen_pixels = 0.0f;
+		if (texture->uploaded_level <= texture->wanted_level) {
+			release_source(texture);
+		}
+	}
+	if (texture_streamer_idle(streamer)) {
+		return 0;
+	}
+	PROFILE_ZONE("texture streaming");
+	std::vector<streamed_texture_t *> pending;
+	for (size_t t = 0; t < streamer->textures.size(); t++) {
+		streamed_texture_t *texture = streamer->textures[t];
+		if (texture && !texture->failed && texture->uploaded_level > texture->wanted_level) {
+			pending.push_back(texture);
+		}
+	}
+	std::stable_sort(pending.begin(), pending.end(), upload_sooner);
+
+	GLint active = 0;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+	glActiveTexture(streamer->upload_unit);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamer->buffer);
+	GLint alignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // RGB rows are packed, not padded to 4 bytes
+
+	size_t uploaded = 0;
+	bool ring_full = false;
+	for (size_t t = 0; t < pending.size() && !ring_full && uploaded < streamer->frame_budget; t++) {
+		streamed_texture_t *texture = pending[t];
+		if (!start_source(streamer, texture)) {
+			fprintf(stderr, "ERROR: could not load %s again\n", baked_name(texture->names[0]).c_str());
+			texture->failed = true;
+			continue;
+		}
+		int base = can_resize(streamer) ? texture->wanted_level : 0;
+		if (base < texture->base_level) {
+			set_storage(streamer, texture, base);
+			residency_set_base_level(&streamer->residency, texture->id, texture->base_level);
+			glActiveTexture(streamer->upload_unit);
+		}
+		glBindTexture(texture->target, texture->texture);
+		// coarse to fine, every face of a level before the next finer one starts
+		int face_count = texture->baked ? (int)texture->ktx.size() : (int)texture->names.size();
+		while (texture->uploaded_level > texture->wanted_level && !texture->failed &&
+			uploaded < streamer->frame_budget) {
+			if (texture->baked) {
+				upload_baked_level(streamer, texture, &uploaded);
+			} else if (!upload_image_rows(streamer, texture, &uploaded)) {
+				ring_full = true;
+				break;
+			}
+			if (texture->face < face_count) {
+				break; // out of budget, or the next face isn't decoded yet
+			}
+			texture->face = 0;
+			texture->uploaded_level--;
+			glTexParameteri(texture->target, GL_TEXTURE_BASE_LEVEL,
+				texture->uploaded_level - texture->base_level);
+		}
+		if (!texture->ready && texture->uploaded_level < texture->levels) {
+			swap_in(texture);
+			glActiveTexture(streamer->upload_unit);
+		}
+		if (texture->uploaded_level <= texture->wanted_level) {
+			release_source(texture);
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glActiveTexture(active);
+	return uploaded;
+}
+
+bool texture_streamer_idle(const texture_streamer_t *streamer) {
+	for (size_t i = 0; i < streamer->textures.size(); i++) {
+		const streamed_texture_t *texture = streamer->textures[i];
+		if (texture && !texture->failed && texture->uploaded_level > texture->wanted_level) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void texture_streamer_destroy(texture_streamer_t *streamer) {
+	for (size_t i = 0; i < streamer->textures.size(); i++) {
+		streamed_texture_t *texture = streamer->textures[i];
+		if (!texture) {
+			continue;
+		}
+		image_batch_free(&texture->images);
+		free_staging(texture);
+		glDeleteTextures(1, &texture->texture);
+		glDeleteTextures(1, &texture->placeholder);
+		delete texture;
+	}
+	streamer->textures.clear();
+	for (int i = 0; i < TEXTURE_STREAMER_SEGMENTS; i++) {
+		if (streamer->fences[i]) {
+			glDeleteSync(streamer->fences[i]);
+			streamer->fences[i] = 0;
+		}
+	}
+	if (streamer->mapped) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamer->buffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		streamer->mapped = NULL;
+	}
+	glDeleteBuffers(1, &streamer->buffer);
+	streamer->buffer = 0;
+}
@@ -0,0 +1,172 @@
+#pragma once
+/******************************************************************************\
+| Loads textures without the frame waiting for them.                           |
+| A request returns straight away with a 1x1 placeholder bound on the          |
+| texture's unit, sized from the image headers alone (the probe, stbi_info).   |
+| The pixels are decoded, and their mip chain generated (mip_generator.h), on  |
+| a thread_pool_t. texture_streamer_update, once a frame, copies decoded rows  |
+| into a ring of TEXTURE_STREAMER_SEGMENTS segments of one persistently mapped |
+| pixel unpack buffer and uploads them with glTexSubImage from there. Each     |
+| segment gets a fence and is only written again once the GPU is done with it. |
+| No more than the frame budget (in bytes) goes up per frame, so streaming     |
+| never causes a hitch. With persistent mapping, level 0 skips the ring: a     |
+| decode started when level 0 is wanted gets a staging buffer of its own, the  |
+| workers write the faces straight into it (image_batch_set_destination) and   |
+| they go up from there. Decodes for coarser levels don't get one.             |
+| Levels go up coarse to fine and only as far as the texture's size on screen  |
+| needs: texture_streamer_touch says how many pixels across it was drawn, and  |
+| the smallest level at least that big is the one it wants. Until the first    |
+| touch a TEXTURE_STREAMER_PREVIEW_SIZE level is wanted. Immutable storage     |
+| starts at the wanted level and grows (glCopyImageSubData into bigger         |
+| storage) when a finer one is wanted. GL_TEXTURE_BASE_LEVEL follows each      |
+| level as its last face arrives, so only complete levels are sampled. The     |
+| textures furthest from their wanted level get the budget first, ones still   |
+| at their placeholder before all others. The real texture is bound on the     |
+| unit in place of the placeholder as soon as its first level is up, so draw   |
+| code that binds once keeps working. Code that rebinds every frame binds      |
+| streamed_texture_name.                                                       |
+| With a texture cache (texture_streamer_set_cache) an image seen on an        |
+| earlier launch is copied out of its cache entry instead of being decoded.    |
+| Images keep their channels: RGB ones get GL_RGB8 storage and upload 3 bytes  |
+| a texel, RGBA ones are swapped to BGRA on the worker, the layout drivers     |
+| keep them in. Images decode whole, the decoded levels are kept until the     |
+| wanted one is up and decoded again if a finer one is wanted later.           |
+| A texture baked by tools/texture_baker (a .ktx per image, BC1/BC3/BC7 with   |
+| mips) is used instead of the images when there's one for every face and the  |
+| driver has the format. It needs no decoding, its levels go up a face at a    |
+| time with glCompressedTexSubImage straight from the file.                    |
+| Atlases from tools/atlas_builder are plain baked 2D textures (request the    |
+| .ktx by name); its texture arrays can only be loaded baked, there are no     |
+| images behind them to fall back on.                                          |
+| Every texture counts against the residency budget (texture_residency.h):     |
+| ones that haven't been drawn for a while lose their largest levels, or go    |
+| back to their placeholder, once it's exceeded, and stream in again when      |
+| they're next drawn.                                                          |
+| texture_streamer_release frees a texture that isn't needed any more (the    |
+| skybox's old resolution tier, say).                                          |
+| Without ARB_buffer_storage the segments are mapped per upload instead,       |
+| without ARB_texture_storage the storage comes from glTexImage2D. Without     |
+| texture storage or ARB_copy_image storage can't grow: it has every level     |
+| from the start (baked textures go up whole) and eviction goes straight back  |
+| to the placeholder.                                                          |
+\******************************************************************************/
+#ifndef _TEXTURE_STREAMER_H_
+#define _TEXTURE_STREAMER_H_
+
+#include "image_batch.h"
+#include "texture_codec.h"
+#include "texture_residency.h"
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+#define TEXTURE_STREAMER_SEGMENTS 3
+// one 1024x1024 RGBA cube face
+#define TEXTURE_STREAMER_SEGMENT_BYTES (4 * 1024 * 1024)
+// the largest side of the level a texture starts at
+#define TEXTURE_STREAMER_PREVIEW_SIZE 64
+
+// image size and channel count from the header only, false if unreadable
+typedef bool (*image_probe_function_t)(const char *name, int *x, int *y, int *n);
+// the whole file 'name' as is, false if there's no such file
+typedef bool (*asset_read_function_t)(const char *name, std::vector<unsigned char> &bytes);
+
+struct streamed_texture_t {
+	std::vector<std::string> names; // one, or the six cube faces
+	GLenum target; // GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP or GL_TEXTURE_2D_ARRAY
+	GLenum unit; // GL_TEXTUREn it's bound on
+	GLuint placeholder;
+	unsigned char placeholder_colour[4];
+	GLuint texture;
+	GLenum internal_format;
+	int width, height;
+	int levels;
+	std::vector<size_t> level_bytes; // every face's, what the residency budget counts
+	int layers; // an array's, 0 otherwise
+	int channels; // 3, or 4 uploaded as BGRA
+	bool baked; // its levels come from 'ktx'
+	std::vector<std::vector<unsigned char>> ktx_files; // while a baked texture has levels to upload
+	std::vector<ktx_image_t> ktx; // one per face, pointing into 'ktx_files'
+	image_batch_t images;
+	bool decoding; // 'images' holds every face, or is decoding them
+	GLuint staging; // pixel unpack buffer the faces' level 0 is decoded into, 0 for none
+	unsigned char *staging_memory; // persistently mapped
+	int face; // upload position in level uploaded_level - 1
+	int row;
+	int base_level; // 'texture' starts at this level, 'levels' when only the placeholder is left
+	int uploaded_level; // the finest level every face has, 'levels' before the first
+	int wanted_level; // the finest level its size on screen needs, 'levels' for none
+	float screen_pixels; // the largest size it was touched with since the last update
+	bool ready; // 'texture' is bound on 'unit' now
+	bool failed; // keeps the placeholder, or the levels it got
+	bool released; // freed as soon as its decodes finish
+	bool flip;
+	int id; // in the streamer's residency
+	double requested_ms;
+};
+
+struct texture_streamer_t {
+	thread_pool_t *pool;
+	image_decode_function_t decode;
+	image_probe_function_t probe;
+	asset_read_function_t read; // NULL never looks for baked textures
+	texture_cache_t *cache; // decoded images from earlier launches, NULL for none
+	image_hash_function_t hash;
+	size_t frame_budget;
+	mip_filter_t mip_filter; // for the mip chains the workers make, kaiser unless changed
+	GLenum upload_unit; // a unit nothing draws with, so half-uploaded textures are never sampled
+	GLuint buffer;
+	unsigned char *mapped; // NULL unless persistently mapped
+	bool immutable_storage;
+	bool have_sync;
+	GLsync fences[TEXTURE_STREAMER_SEGMENTS];
+	int next_segment;
+	std::vector<streamed_texture_t *> textures;
+	texture_residency_t residency; // no budget unless residency_set_budget gives it one
+};
+
+// the texture to bind right now, the placeholder until it's ready
+inline GLuint streamed_texture_name(const streamed_texture_t *texture) {
+	return texture->ready ? texture->texture : texture->placeholder;
+}
+
+// true once every level its size on screen wants is up
+inline bool streamed_texture_complete(const streamed_texture_t *texture) {
+	return texture->ready && texture->uploaded_level <= texture->wanted_level;
+}
+
+// 'frame_budget' is the most bytes texture_streamer_update uploads per call
+void texture_streamer_init(texture_streamer_t *streamer, thread_pool_t *pool,
+	image_decode_function_t decode, image_probe_function_t probe, asset_read_function_t read,
+	size_t frame_budget);
+// 'placeholder' is the RGBA colour shown until the texture is ready. 'flip'
+// turns the rows bottom-up, the way the ship's texture coordinates want them
+streamed_texture_t *texture_streamer_request_2d(texture_streamer_t *streamer, const char *name,
+	GLenum unit, bool flip, const unsigned char placeholder[4]);
+// faces in the order front, back, top, bottom, left, right
+streamed_texture_t *texture_streamer_request_cube(texture_streamer_t *streamer,
+	const char *const faces[6], GLenum unit, const unsigned char placeholder[4]);
+// a 2D array baked by tools/atlas_builder, 'name' is its .ktx. keeps the
+// placeholder if it's missing or the driver can't sample its format
+streamed_texture_t *texture_streamer_request_array(texture_streamer_t *streamer, const char *name,
+	GLenum unit, const unsigned char placeholder[4]);
+// marks 'texture' as drawn this frame, 'screen_pixels' across at the most (0
+// for every level), so it isn't evicted and streams in the level that needs
+void texture_streamer_touch(texture_streamer_t *streamer, streamed_texture_t *texture,
+	float screen_pixels);
+// images are looked up in 'cache' by their 'hash' before they're decoded, and
+// stored there after. set before the first request
+void texture_streamer_set_cache(texture_streamer_t *streamer, texture_cache_t *cache,
+	image_hash_function_t hash);
+// frees 'texture', its decodes once they finish, and the pointer is not to be
+// used again. the caller binds something else on its unit
+void texture_streamer_release(texture_streamer_t *streamer, streamed_texture_t *texture);
+// evicts down to the residency budget, then uploads up to the frame budget and
+// swaps in textures with a level up. returns the bytes uploaded. leaves the
+// active texture unit as it found it
+size_t texture_streamer_update(texture_streamer_t *streamer);
+// true when no texture has a level it wants left to upload
+bool texture_streamer_idle(const texture_streamer_t *streamer);
+void texture_streamer_destroy(texture_streamer_t *streamer);
+
+#endif
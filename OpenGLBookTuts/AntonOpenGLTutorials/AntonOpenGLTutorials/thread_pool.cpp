@@ -0,0 +1,149 @@
+#include "thread_pool.h"
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdio.h>
+
+namespace {
+
+void worker_main(thread_pool_t *pool, unsigned index) {
+	char name[32];
+	snprintf(name, sizeof(name), "worker %u", index);
+	profiler_set_thread_name(name);
+	bool idle = true; // nothing run since the last idle call
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(pool->mutex);
+			if (pool->jobs.empty() && !idle && pool->idle) {
+				lock.unlock();
+				pool->idle();
+				idle = true;
+				continue;
+			}
+			pool->wake.wait(lock, [pool] { return pool->stopping || !pool->jobs.empty(); });
+			if (pool->jobs.empty()) {
+				return; // stopping and nothing left
+			}
+			job = std::move(pool->jobs.front());
+			pool->jobs.pop_front();
+		}
+		job();
+		idle = false;
+	}
+}
+
+// shared with the helper jobs, which may only start after the caller returned
+struct nested_for_t {
+	const std::function<void(size_t begin, size_t end)> *body;
+	size_t count, ranges;
+	std::atomic<size_t> next;
+	size_t done;
+	std::mutex mutex;
+	std::condition_variable finished;
+};
+
+void run_nested_ranges(nested_for_t *work) {
+	for (;;) {
+		size_t range = work->next++;
+		if (range >= work->ranges) {
+			return;
+		}
+		(*work->body)(work->count * range / work->ranges, work->count * (range + 1) / work->ranges);
+		std::lock_guard<std::mutex> lock(work->mutex);
+		if (++work->done == work->ranges) {
+			work->finished.notify_one();
+		}
+	}
+}
+
+} // namespace
+
+void thread_pool_init(thread_pool_t *pool, unsigned threads, void (*idle)()) {
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+		if (threads == 0) {
+			threads = 2; // unknown
+		}
+	}
+	pool->stopping = false;
+	pool->idle = idle;
+	pool->workers.clear();
+	for (unsigned i = 0; i < threads; i++) {
+		pool->workers.push_back(std::thread(worker_main, pool, i));
+	}
+}
+
+void thread_pool_submit(thread_pool_t *pool, std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->jobs.push_back(std::move(job));
+	}
+	pool->wake.notify_one();
+}
+
+void thread_pool_parallel_for(thread_pool_t *pool, size_t count,
+	const std::function<void(size_t begin, size_t end)> &body) {
+	if (!pool || pool->workers.size() < 2 || count < 2) {
+		if (count > 0) {
+			body(0, count);
+		}
+		return;
+	}
+	// a few ranges per worker, so one slow range doesn't leave the others idle
+	size_t ranges = std::min(count, pool->workers.size() * 4);
+	std::mutex mutex;
+	std::condition_variable finished;
+	size_t remaining = ranges;
+	for (size_t i = 0; i < ranges; i++) {
+		size_t begin = count * i / ranges;
+		size_t end = count * (i + 1) / ranges;
+		thread_pool_submit(pool, [&, begin, end] {
+			body(begin, end);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--remaining == 0) {
+				finished.notify_one();
+			}
+		});
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [&] { return remaining == 0; });
+}
+
+void thread_pool_parallel_for_nested(thread_pool_t *pool, size_t count,
+	const std::function<void(size_t begin, size_t end)> &body) {
+	if (!pool || pool->workers.size() < 2 || count < 2) {
+		if (count > 0) {
+			body(0, count);
+		}
+		return;
+	}
+	std::shared_ptr<nested_for_t> work = std::make_shared<nested_for_t>();
+	work->body = &body;
+	work->count = count;
+	work->ranges = std::min(count, pool->workers.size() * 4);
+	work->next = 0;
+	work->done = 0;
+	// 'body' is only called for ranges taken before they ran out, and those finish
+	// before this returns. helpers starting later find nothing to do
+	size_t helpers = std::min(work->ranges - 1, pool->workers.size());
+	for (size_t i = 0; i < helpers; i++) {
+		thread_pool_submit(pool, [work] { run_nested_ranges(work.get()); });
+	}
+	run_nested_ranges(work.get());
+	std::unique_lock<std::mutex> lock(work->mutex);
+	work->finished.wait(lock, [&] { return work->done == work->ranges; });
+}
+
+void thread_pool_shutdown(thread_pool_t *pool) {
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->stopping = true;
+	}
+	pool->wake.notify_all();
+	for (size_t i = 0; i < pool->workers.size(); i++) {
+		pool->workers[i].join();
+	}
+	pool->workers.clear();
+}
@@ -0,0 +1,45 @@
+#pragma once
+/******************************************************************************\
+| Fixed set of worker threads running queued jobs, first in first out.         |
+| For CPU work that would otherwise sit on the main (GL context) thread, like  |
+| decoding images. Jobs must not touch OpenGL: no worker has a context.        |
+| Workers show up in the profiler trace as "worker 0", "worker 1", ...         |
+\******************************************************************************/
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct thread_pool_t {
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping;
+	void (*idle)(); // see thread_pool_init
+};
+
+// starts 'threads' workers, 0 for one per hardware thread. each worker calls
+// 'idle' (if not NULL) once whenever it runs out of jobs, before it waits for
+// more: the place to hand back per-thread memory
+void thread_pool_init(thread_pool_t *pool, unsigned threads, void (*idle)() = NULL);
+void thread_pool_submit(thread_pool_t *pool, std::function<void()> job);
+// calls 'body' on [begin, end) ranges covering [0, count) from the workers and
+// returns when they've all run. 'pool' may be NULL, then it all runs here.
+// never call it from a job, the worker would wait on itself
+void thread_pool_parallel_for(thread_pool_t *pool, size_t count,
+	const std::function<void(size_t begin, size_t end)> &body);
+// the same, but safe to call from a job: the caller takes ranges too and only
+// waits for ones a worker has already started, so it finishes even when every
+// worker is busy (or waiting in here itself)
+void thread_pool_parallel_for_nested(thread_pool_t *pool, size_t count,
+	const std::function<void(size_t begin, size_t end)> &body);
+// runs whatever is still queued, then joins the workers
+void thread_pool_shutdown(thread_pool_t *pool);
+
+#endif
@@ -0,0 +1,9 @@
+//model-view-projection transform shared by the mesh shaders
+
+uniform mat4 matrix;
+uniform mat4 view, proj;
+
+vec4 transform_position(vec3 position)
+{
+	return proj * view * matrix * vec4(position, 1.0);
+}
@@ -0,0 +1,333 @@
+/******************************************************************************\
+| asset_packer: builds an asset pack (see asset_pack.h) from loose files.      |
+|                                                                              |
+| Every regular file in the given directories, and any file named on its own,  |
+| becomes an entry named after the file (no directory), so the game asks for   |
+| "bkg1_back6.png" whether it comes from the pack or from the skybox folder.   |
+| Each entry is deflated and kept that way only if it came out at least        |
+| ASSET_MIN_SAVING smaller; PNG and JPEG never do and are stored as is, so     |
+| stb_image decodes them straight out of the mapping. Entries start on page    |
+| boundaries. The finished pack is opened again and every hash checked         |
+| before the tool reports success.                                             |
+|                                                                              |
+| build, from this directory:                                                  |
+|   g++ -std=c++11 -O2 -I../AntonOpenGLTutorials asset_packer.cpp              |
+|       ../AntonOpenGLTutorials/asset_pack.cpp -o asset_packer                 |
+|   cl /EHsc /O2 /I..\AntonOpenGLTutorials asset_packer.cpp                    |
+|       ..\AntonOpenGLTutorials\asset_pack.cpp                                 |
+| usage:                                                                       |
+|   asset_packer "../../external resources/assets.pak"                         |
+|       "../../external resources/skybox" [more directories or files]          |
+| exits with 1 if anything failed                                              |
+\******************************************************************************/
+#define _CRT_SECURE_NO_WARNINGS
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG // only stbi_zlib is used, for checking the pack
+#include "stb_image.h"
+#include "asset_pack.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// deflated entries must be at least this much smaller to be kept deflated
+#define ASSET_MIN_SAVING 0.1
+
+namespace {
+
+struct input_file_t {
+	std::string path;
+	std::string name;
+};
+
+std::string file_name_of(const std::string &path) {
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// appends the regular files of 'path' if it's a directory, else 'path' itself
+void list_inputs(const std::string &path, std::vector<input_file_t> &inputs) {
+	std::vector<std::string> found;
+	bool directory = false;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((path + "\\*").c_str(), &data);
+	if (find != INVALID_HANDLE_VALUE) {
+		directory = true;
+		do {
+			if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+				found.push_back(path + "/" + data.cFileName);
+			}
+		} while (FindNextFileA(find, &data));
+		FindClose(find);
+	}
+#else
+	if (DIR *dir = opendir(path.c_str())) {
+		directory = true;
+		while (struct dirent *item = readdir(dir)) {
+			std::string child = path + "/" + item->d_name;
+			struct stat info;
+			if (stat(child.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+				found.push_back(child);
+			}
+		}
+		closedir(dir);
+	}
+#endif
+	if (!directory) {
+		found.push_back(path);
+	}
+	for (size_t i = 0; i < found.size(); i++) {
+		input_file_t input;
+		input.path = found[i];
+		input.name = file_name_of(found[i]);
+		inputs.push_back(input);
+	}
+}
+
+bool read_file(const std::string &path, std::vector<unsigned char> &bytes) {
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	bytes.resize(size > 0 ? (size_t)size : 0);
+	bool ok = size >= 0 && fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	fclose(file);
+	return ok;
+}
+
+// raw deflate (RFC 1951) as a single block with the fixed Huffman codes and a
+// hash chain LZ77 matcher. nowhere near zlib -9, but the assets that compress
+// at all are text, where this gets most of the way
+struct bit_writer_t {
+	std::vector<unsigned char> *out;
+	unsigned int bits;
+	int count;
+};
+
+void put_bits(bit_writer_t &writer, unsigned int value, int length) {
+	writer.bits |= value << writer.count;
+	writer.count += length;
+	while (writer.count >= 8) {
+		writer.out->push_back((unsigned char)writer.bits);
+		writer.bits >>= 8;
+		writer.count -= 8;
+	}
+}
+
+// Huffman codes go out most significant bit first
+void put_code(bit_writer_t &writer, unsigned int code, int length) {
+	unsigned int reversed = 0;
+	for (int i = 0; i < length; i++) {
+		reversed = (reversed << 1) | ((code >> i) & 1);
+	}
+	put_bits(writer, reversed, length);
+}
+
+void put_literal(bit_writer_t &writer, int symbol) {
+	if (symbol < 144) {
+		put_code(writer, 0x30 + symbol, 8);
+	} else if (symbol < 256) {
+		put_code(writer, 0x190 + symbol - 144, 9);
+	} else if (symbol < 280) {
+		put_code(writer, symbol - 256, 7);
+	} else {
+		put_code(writer, 0xc0 + symbol - 280, 8);
+	}
+}
+
+const int length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51,
+	59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const int length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4,
+	4, 5, 5, 5, 5, 0};
+const int distance_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257,
+	385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const int distance_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9,
+	10, 10, 11, 11, 12, 12, 13, 13};
+
+void put_match(bit_writer_t &writer, int length, int distance) {
+	int l = 28;
+	while (length_base[l] > length) {
+		l--;
+	}
+	put_literal(writer, 257 + l);
+	put_bits(writer, length - length_base[l], length_extra[l]);
+	int d = 29;
+	while (distance_base[d] > distance) {
+		d--;
+	}
+	put_code(writer, d, 5);
+	put_bits(writer, distance - distance_base[d], distance_extra[d]);
+}
+
+void deflate(const std::vector<unsigned char> &in, std::vector<unsigned char> &out) {
+	const int window = 32768;
+	const int hash_size = 1 << 15;
+	const int max_chain = 64;
+	const int max_length = 258;
+	out.clear();
+	bit_writer_t writer = {&out, 0, 0};
+	put_bits(writer, 1, 1); // last block
+	put_bits(writer, 1, 2); // fixed Huffman codes
+
+	std::vector<int> head(hash_size, -1);
+	std::vector<int> previous(in.size(), -1);
+	int size = (int)in.size();
+	int i = 0;
+	while (i < size) {
+		int best_length = 0;
+		int best_distance = 0;
+		if (i + 3 <= size) {
+			unsigned int hash = ((in[i] << 10) ^ (in[i + 1] << 5) ^ in[i + 2]) & (hash_size - 1);
+			int limit = std::min(max_length, size - i);
+			int chain = 0;
+			for (int candidate = head[hash]; candidate >= 0 && i - candidate <= window &&
+				chain < max_chain; candidate = previous[candidate], chain++) {
+				int length = 0;
+				while (length < limit && in[candidate + length] == in[i + length]) {
+					length++;
+				}
+				if (length > best_length) {
+					best_length = length;
+					best_distance = i - candidate;
+					if (length == limit) {
+						break;
+					}
+				}
+			}
+		}
+		int advance = best_length >= 3 ? best_length : 1;
+		if (best_length >= 3) {
+			put_match(writer, best_length, best_distance);
+		} else {
+			put_literal(writer, in[i]);
+		}
+		// every position passed over goes into the chains, matches can start anywhere
+		for (int end = i + advance; i < end; i++) {
+			if (i + 3 <= size) {
+				unsigned int hash = ((in[i] << 10) ^ (in[i + 1] << 5) ^ in[i + 2]) & (hash_size - 1);
+				previous[i] = head[hash];
+				head[hash] = i;
+			}
+		}
+	}
+	put_literal(writer, 256); // end of block
+	put_bits(writer, 0, 7); // flush the last partial byte
+}
+
+void pad_to(std::vector<unsigned char> &pack, size_t alignment) {
+	pack.resize((pack.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+bool compare_names(const input_file_t &a, const input_file_t &b) {
+	return a.name < b.name;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		fprintf(stderr, "usage: asset_packer <pack> <directory or file>...\n");
+		return 1;
+	}
+	const char *pack_path = argv[1];
+	std::vector<input_file_t> inputs;
+	for (int i = 2; i < argc; i++) {
+		list_inputs(argv[i], inputs);
+	}
+	std::sort(inputs.begin(), inputs.end(), compare_names);
+	for (size_t i = 0; i < inputs.size(); i++) {
+		if (inputs[i].name.size() >= ASSET_NAME_LENGTH) {
+			fprintf(stderr, "ERROR: %s: name longer than %i characters\n", inputs[i].path.c_str(),
+				ASSET_NAME_LENGTH - 1);
+			return 1;
+		}
+		if (i > 0 && inputs[i].name == inputs[i - 1].name) {
+			fprintf(stderr, "ERROR: %s and %s would have the same name\n",
+				inputs[i - 1].path.c_str(), inputs[i].path.c_str());
+			return 1;
+		}
+	}
+	if (inputs.empty()) {
+		fprintf(stderr, "ERROR: nothing to pack\n");
+		return 1;
+	}
+
+	std::vector<asset_entry_t> entries(inputs.size());
+	memset(entries.data(), 0, entries.size() * sizeof(asset_entry_t));
+	std::vector<unsigned char> pack(sizeof(asset_pack_header_t) +
+		entries.size() * sizeof(asset_entry_t), 0);
+	std::vector<unsigned char> contents;
+	std::vector<unsigned char> deflated;
+	unsigned long long total_size = 0;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		if (!read_file(inputs[i].path, contents)) {
+			fprintf(stderr, "ERROR: could not read %s\n", inputs[i].path.c_str());
+			return 1;
+		}
+		asset_entry_t &entry = entries[i];
+		strcpy(entry.name, inputs[i].name.c_str());
+		entry.size = contents.size();
+		entry.hash = asset_hash(contents.data(), contents.size());
+		deflate(contents, deflated);
+		const std::vector<unsigned char> *stored = &contents;
+		if (deflated.size() < contents.size() * (1.0 - ASSET_MIN_SAVING)) {
+			entry.flags |= ASSET_DEFLATE;
+			stored = &deflated;
+		}
+		pad_to(pack, ASSET_PACK_ALIGNMENT);
+		entry.offset = pack.size();
+		entry.stored_size = stored->size();
+		pack.insert(pack.end(), stored->begin(), stored->end());
+		total_size += entry.size;
+		printf("%-40s %10llu -> %10llu %s\n", entry.name, entry.size, entry.stored_size,
+			entry.flags & ASSET_DEFLATE ? "deflate" : "stored");
+	}
+
+	asset_pack_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "APAK", 4);
+	header.version = ASSET_PACK_VERSION;
+	header.entry_count = (unsigned int)entries.size();
+	header.alignment = ASSET_PACK_ALIGNMENT;
+	header.file_size = pack.size();
+	memcpy(pack.data(), &header, sizeof(header));
+	memcpy(pack.data() + sizeof(header), entries.data(), entries.size() * sizeof(asset_entry_t));
+
+	FILE *file = fopen(pack_path, "wb");
+	if (!file || fwrite(pack.data(), 1, pack.size(), file) != pack.size()) {
+		fprintf(stderr, "ERROR: could not write %s\n", pack_path);
+		if (file) {
+			fclose(file);
+		}
+		return 1;
+	}
+	fclose(file);
+
+	asset_pack_t check;
+	if (!asset_pack_open(&check, pack_path)) {
+		return 1;
+	}
+	int failed = 0;
+	for (unsigned int i = 0; i < check.header->entry_count; i++) {
+		if (!asset_pack_verify(&check, &check.entries[i])) {
+			fprintf(stderr, "ERROR: %s doesn't match its hash after packing\n",
+				check.entries[i].name);
+			failed++;
+		}
+	}
+	asset_pack_close(&check);
+	printf("%u entries, %llu bytes packed into %llu\n", header.entry_count, total_size,
+		header.file_size);
+	return failed ? 1 : 0;
+}
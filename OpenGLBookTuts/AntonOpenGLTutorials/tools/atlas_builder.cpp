@@ -0,0 +1,212 @@
+/******************************************************************************\
+| atlas_builder: packs images into one texture (see texture_atlas.h) so they   |
+| draw with one bind: a MaxRects atlas of any sizes, or a 2D array with one    |
+| image per layer. Writes <out>.ktx, block compressed with mips like           |
+| texture_baker's, and <out>.atlas, the manifest the game reads to move each   |
+| mesh's texcoords into its image's rectangle or pick its layer.               |
+|                                                                              |
+| Atlas mips stop once the gutters run out (8 texels of padding gives 4        |
+| levels), deeper ones would mix neighbouring images. Arrays get full chains.  |
+| Prints where each image went and how much of the atlas they fill.            |
+|                                                                              |
+| build, from this directory:                                                  |
+|   g++ -std=c++11 -O2 -pthread -I../AntonOpenGLTutorials atlas_builder.cpp    |
+|       ../AntonOpenGLTutorials/texture_atlas.cpp                              |
+|       ../AntonOpenGLTutorials/texture_codec.cpp                              |
+|       ../AntonOpenGLTutorials/mip_generator.cpp                              |
+|       ../AntonOpenGLTutorials/image_arena.cpp                                |
+|       ../AntonOpenGLTutorials/image_ops.cpp                                  |
+|       ../AntonOpenGLTutorials/thread_pool.cpp                                |
+|       ../AntonOpenGLTutorials/profiler.cpp -o atlas_builder                  |
+|   cl /EHsc /O2 /I..\AntonOpenGLTutorials atlas_builder.cpp                   |
+|       ..\AntonOpenGLTutorials\texture_atlas.cpp                              |
+|       ..\AntonOpenGLTutorials\texture_codec.cpp                              |
+|       ..\AntonOpenGLTutorials\mip_generator.cpp                              |
+|       ..\AntonOpenGLTutorials\image_arena.cpp                                |
+|       ..\AntonOpenGLTutorials\image_ops.cpp                                  |
+|       ..\AntonOpenGLTutorials\thread_pool.cpp                                |
+|       ..\AntonOpenGLTutorials\profiler.cpp                                   |
+| usage:                                                                       |
+|   atlas_builder atlas|array --out=PATH [bc1|bc3|bc7] [--padding=N]           |
+|       [--max-size=N] [--flip] [--linear] [--threads=N] image...              |
+|   the ship's atlas, flipped like the ship's texture is:                      |
+|   atlas_builder atlas --out="../../external resources/skybox/ship" --flip    |
+|       "../../external resources/skybox/spaceship_texture_map.jpg"            |
+|       "../../external resources/skybox/test_ship.png"                        |
+|       "../../external resources/skybox/cockpit_test.png"                     |
+|   bc7 is the default; --padding is the gutter in texels (8, a multiple of    |
+|   4); --max-size caps a side of the atlas (4096)                             |
+| exits with 1 if anything failed                                              |
+\******************************************************************************/
+#define _CRT_SECURE_NO_WARNINGS
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_FAST_PNG
+#define STBI_FAST_JPEG
+#include "stb_image.h"
+#include "image_ops.h"
+#include "mip_generator.h"
+#include "profiler.h"
+#include "texture_atlas.h"
+#include "texture_codec.h"
+#include "thread_pool.h"
+#include "steady_time.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+// the name the game asks for: the file name without its directory
+std::string entry_name_for(const std::string &path) {
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// the levels of one w x h RGBA image, level 0 included, cut to 'count'
+std::vector<mip_level_t> make_levels(const unsigned char *rgba, int w, int h, bool srgb, int count) {
+	std::vector<mip_level_t> levels(1);
+	levels[0].width = w;
+	levels[0].height = h;
+	levels[0].pixels.assign(rgba, rgba + (size_t)w * h * 4);
+	if (count > 1) {
+		std::vector<mip_level_t> below;
+		generate_mips(rgba, w, h, 4, MIP_FILTER_KAISER, srgb, below);
+		levels.insert(levels.end(), below.begin(), below.end());
+	}
+	levels.resize(std::min(levels.size(), (size_t)count));
+	return levels;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	profiler_init();
+	bool have_kind = false, array = false;
+	texture_format_t format = TEXTURE_BC7;
+	std::string out;
+	int padding = 8;
+	int max_size = 4096;
+	bool flip = false;
+	bool srgb = true;
+	unsigned threads = 0;
+	std::vector<const char *> paths;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "atlas") == 0 || strcmp(argv[i], "array") == 0) {
+			array = argv[i][1] == 'r';
+			have_kind = true;
+		} else if (strcmp(argv[i], "bc1") == 0 || strcmp(argv[i], "bc3") == 0 ||
+			strcmp(argv[i], "bc7") == 0) {
+			format = argv[i][2] == '1' ? TEXTURE_BC1 : (argv[i][2] == '3' ? TEXTURE_BC3 : TEXTURE_BC7);
+		} else if (strncmp(argv[i], "--out=", 6) == 0) {
+			out = argv[i] + 6;
+		} else if (strncmp(argv[i], "--padding=", 10) == 0) {
+			padding = std::max(0, atoi(argv[i] + 10));
+		} else if (strncmp(argv[i], "--max-size=", 11) == 0) {
+			max_size = std::max(4, atoi(argv[i] + 11));
+		} else if (strcmp(argv[i], "--flip") == 0) {
+			flip = true;
+		} else if (strcmp(argv[i], "--linear") == 0) {
+			srgb = false;
+		} else if (strncmp(argv[i], "--threads=", 10) == 0) {
+			threads = (unsigned)atoi(argv[i] + 10);
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "ERROR: unknown option %s\n", argv[i]);
+			return 1;
+		} else {
+			paths.push_back(argv[i]);
+		}
+	}
+	if (!have_kind || out.empty() || paths.empty()) {
+		fprintf(stderr, "usage: atlas_builder atlas|array --out=PATH [bc1|bc3|bc7] [--padding=N] "
+			"[--max-size=N] [--flip] [--linear] [--threads=N] image...\n");
+		return 1;
+	}
+
+	atlas_t atlas;
+	atlas.texture = entry_name_for(out) + ".ktx";
+	atlas.bottom_up = flip;
+	std::vector<unsigned char *> images;
+	bool ok = true;
+	for (size_t i = 0; i < paths.size() && ok; i++) {
+		atlas_entry_t entry;
+		int n;
+		unsigned char *pixels = stbi_load(paths[i], &entry.width, &entry.height, &n, 4);
+		if (!pixels) {
+			fprintf(stderr, "ERROR: could not load %s: %s\n", paths[i], stbi_failure_reason());
+			ok = false;
+			break;
+		}
+		entry.name = entry_name_for(paths[i]);
+		if (atlas_find(&atlas, entry.name.c_str())) {
+			fprintf(stderr, "ERROR: two images are called %s\n", entry.name.c_str());
+			ok = false;
+		}
+		atlas.entries.push_back(entry);
+		images.push_back(pixels);
+	}
+	if (ok && !array && !atlas_pack(&atlas, padding, max_size)) {
+		fprintf(stderr, "ERROR: the images don't fit in %ix%i\n", max_size, max_size);
+		ok = false;
+	}
+	if (ok && array && !atlas_make_array(&atlas)) {
+		ok = false;
+	}
+
+	thread_pool_t pool;
+	thread_pool_init(&pool, threads);
+	if (ok) {
+		double start = now_ms();
+		atlas.levels = atlas_level_count(&atlas);
+		std::vector<unsigned char> rgba;
+		atlas_compose(&atlas, std::vector<const unsigned char *>(images.begin(), images.end()), rgba);
+		int layers = std::max(1, atlas.layers);
+		size_t layer_bytes = (size_t)atlas.width * atlas.height * 4;
+		std::vector<std::vector<unsigned char>> levels(atlas.levels);
+		std::vector<unsigned char> blocks;
+		for (int layer = 0; layer < layers; layer++) {
+			unsigned char *pixels = rgba.data() + layer_bytes * layer;
+			if (flip) {
+				image_flip_rows(pixels, atlas.width, atlas.height, 4);
+			}
+			std::vector<mip_level_t> mips = make_levels(pixels, atlas.width, atlas.height, srgb,
+				atlas.levels);
+			for (int level = 0; level < atlas.levels; level++) {
+				compress_image(&pool, format, mips[level].pixels.data(), mips[level].width,
+					mips[level].height, blocks);
+				levels[level].insert(levels[level].end(), blocks.begin(), blocks.end());
+			}
+		}
+		std::string ktx_path = out + ".ktx", manifest_path = out + ".atlas";
+		ok = ktx_write(ktx_path.c_str(), format, atlas.width, atlas.height, atlas.layers, flip, levels) &&
+			atlas_write_manifest(manifest_path.c_str(), &atlas);
+		if (ok) {
+			double used = 0.0;
+			for (size_t i = 0; i < atlas.entries.size(); i++) {
+				const atlas_entry_t &e = atlas.entries[i];
+				used += (double)e.width * e.height;
+				if (array) {
+					printf("  %-28s layer %i\n", e.name.c_str(), e.layer);
+				} else {
+					printf("  %-28s %5ix%-5i at %5i,%-5i uv %.4f,%.4f - %.4f,%.4f\n", e.name.c_str(),
+						e.width, e.height, e.x, e.y, e.u0, e.v0, e.u1, e.v1);
+				}
+			}
+			printf("%s: %s %s %ix%i", ktx_path.c_str(), texture_format_name(format),
+				array ? "array" : "atlas", atlas.width, atlas.height);
+			if (array) {
+				printf(" x %i layers", atlas.layers);
+			}
+			printf(", %i levels, %.1f%% filled, %.0f ms, manifest %s\n", atlas.levels,
+				100.0 * used / ((double)atlas.width * atlas.height * layers), now_ms() - start,
+				manifest_path.c_str());
+		}
+	}
+	thread_pool_shutdown(&pool);
+	for (size_t i = 0; i < images.size(); i++) {
+		stbi_image_free(images[i]);
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,501 @@
+/******************************************************************************\
+| jpeg_benchmark: decodes JPEGs with stb_image's C kernels, its SSE2 ones      |
+| (what it uses without STBI_FAST_JPEG) and STBI_FAST_JPEG's AVX2 ones, then   |
+| again with the restart intervals spread over a thread pool as the game does  |
+| it. Checks every result against the C kernels' to the byte and reports how   |
+| fast each is.                                                                |
+|                                                                              |
+| Every file is read into memory first, so only decoding is timed: each        |
+| decoder runs --runs times per file (5 by default) and the fastest run        |
+| counts. Speeds are megabytes of decoded pixels a second.                     |
+| Few encoders write restart markers unless asked, so --restart=N first        |
+| re-encodes each image (baseline, quality 90, 4:2:0) with one every N rows    |
+| of MCUs; without them the threaded decode is the same as the AVX2 one.       |
+|                                                                              |
+| build, from this directory:                                                  |
+|   g++ -std=c++11 -O2 -pthread -I../AntonOpenGLTutorials jpeg_benchmark.cpp   |
+|       ../AntonOpenGLTutorials/thread_pool.cpp                                |
+|       ../AntonOpenGLTutorials/profiler.cpp -o jpeg_benchmark                 |
+|   cl /EHsc /O2 /I..\AntonOpenGLTutorials jpeg_benchmark.cpp                  |
+|       ..\AntonOpenGLTutorials\thread_pool.cpp                                |
+|       ..\AntonOpenGLTutorials\profiler.cpp                                   |
+| usage:                                                                       |
+|   jpeg_benchmark [--runs=N] [--restart=N] [--threads=N] [--channels=N]       |
+|       "../../external resources/skybox/"*.jpg                                |
+|   --threads is the pool's size, one per hardware thread by default;          |
+|   --channels=4 times RGBA output instead of the file's own channels          |
+| exits with 1 if a file doesn't decode or the decoders disagree               |
+\******************************************************************************/
+#define _CRT_SECURE_NO_WARNINGS
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_JPEG
+#define STBI_FAST_JPEG
+#include "stb_image.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include "steady_time.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+enum decoder_t {
+	DECODER_C,
+	DECODER_SSE2,
+	DECODER_AVX2,
+	DECODER_THREADS,
+	DECODER_COUNT
+};
+
+const char *decoder_names[DECODER_COUNT] = { "C", "SSE2", "AVX2", "AVX2 + threads" };
+
+bool read_file(const char *path, std::vector<unsigned char> &bytes) {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	bytes.resize(size > 0 ? (size_t)size : 0);
+	bool ok = size > 0 && fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	fclose(file);
+	return ok;
+}
+
+double mb_per_s(double bytes, double ms) {
+	return ms > 0.0 ? bytes / (1024.0 * 1024.0) / (ms / 1000.0) : 0.0;
+}
+
+void pool_parallel_for(void *user, int count, void (*task)(void *arg, int index), void *arg) {
+	thread_pool_parallel_for_nested((thread_pool_t *)user, (size_t)count,
+		[&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			task(arg, (int)i);
+		}
+	});
+}
+
+// the restart interval from the DRI marker before the first scan, 0 if none
+int restart_interval_of(const std::vector<unsigned char> &jpeg) {
+	size_t at = 2;
+	while (at + 4 <= jpeg.size() && jpeg[at] == 0xff && jpeg[at + 1] != 0xda) {
+		size_t length = (size_t)jpeg[at + 2] << 8 | jpeg[at + 3];
+		if (jpeg[at + 1] == 0xdd && at + 6 <= jpeg.size()) {
+			return jpeg[at + 4] << 8 | jpeg[at + 5];
+		}
+		at += 2 + length;
+	}
+	return 0;
+}
+
+// a small baseline encoder, only to make test images with restart markers:
+// the example tables from the JPEG spec (annex K) at quality 90, 4:2:0 for
+// colour images, one component for grey ones
+const unsigned char zigzag[64] = {
+	0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,
+	6, 7, 14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45,
+	38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
+const unsigned char luma_quant[64] = {
+	16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55, 14, 13, 16, 24, 40, 57, 69, 56,
+	14, 17, 22, 29, 51, 87, 80, 62, 18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+	49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99 };
+const unsigned char chroma_quant[64] = {
+	17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99, 99, 99,
+	47, 66, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99 };
+const unsigned char dc_luma_bits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+const unsigned char dc_chroma_bits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+const unsigned char dc_values[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+const unsigned char ac_luma_bits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+const unsigned char ac_luma_values[162] = {
+	0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+	0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+	0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+	0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+	0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+	0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+	0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+	0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+	0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+	0xf9, 0xfa };
+const unsigned char ac_chroma_bits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+const unsigned char ac_chroma_values[162] = {
+	0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+	0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+	0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+	0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+	0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+	0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+	0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+	0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+	0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+	0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+	0xf9, 0xfa };
+
+struct huffman_code_t {
+	unsigned short code[256];
+	unsigned char length[256];
+};
+
+// canonical codes, as the decoder rebuilds them from the DHT
+void build_code(const unsigned char *bits, const unsigned char *values, huffman_code_t *h) {
+	unsigned code = 0;
+	int k = 0;
+	for (int length = 1; length <= 16; length++) {
+		for (int i = 0; i < bits[length - 1]; i++, k++) {
+			h->code[values[k]] = (unsigned short)code++;
+			h->length[values[k]] = (unsigned char)length;
+		}
+		code <<= 1;
+	}
+}
+
+struct bit_writer_t {
+	std::vector<unsigned char> *out;
+	unsigned buffer;
+	int count;
+};
+
+void put_bits(bit_writer_t *w, unsigned bits, int length) {
+	w->buffer = (w->buffer << length) | bits;
+	w->count += length;
+	while (w->count >= 8) {
+		unsigned char byte = (unsigned char)(w->buffer >> (w->count - 8));
+		w->out->push_back(byte);
+		if (byte == 0xff) {
+			w->out->push_back(0); // stuffed, so it isn't read as a marker
+		}
+		w->count -= 8;
+	}
+}
+
+// pads the last byte with 1s, as the spec wants before a marker
+void flush_bits(bit_writer_t *w) {
+	if (w->count > 0) {
+		put_bits(w, (1u << (8 - w->count)) - 1, 8 - w->count);
+	}
+}
+
+// 'v' as a size category and that many extra bits, negatives one less
+void put_value(bit_writer_t *w, const huffman_code_t &h, int run, int v) {
+	int magnitude = abs(v), size = 0;
+	while (magnitude >> size) {
+		size++;
+	}
+	int symbol = run << 4 | size;
+	put_bits(w, h.code[symbol], h.length[symbol]);
+	if (size) {
+		put_bits(w, (unsigned)(v < 0 ? v + (1 << size) - 1 : v) & ((1u << size) - 1), size);
+	}
+}
+
+struct block_encoder_t {
+	float basis[8][8]; // basis[u][x], with the 1/2 and 1/sqrt(2) scales
+	unsigned short quant[2][64];
+	huffman_code_t dc[2], ac[2];
+};
+
+void block_encoder_init(block_encoder_t *e) {
+	for (int u = 0; u < 8; u++) {
+		for (int x = 0; x < 8; x++) {
+			e->basis[u][x] = (u == 0 ? sqrtf(0.5f) : 1.0f) * 0.5f *
+				cosf((2 * x + 1) * u * 3.14159265f / 16.0f);
+		}
+	}
+	for (int i = 0; i < 64; i++) {
+		// quality 90 is 20% of the example tables
+		e->quant[0][i] = (unsigned short)std::min(255, std::max(1, (luma_quant[i] * 20 + 50) / 100));
+		e->quant[1][i] = (unsigned short)std::min(255, std::max(1, (chroma_quant[i] * 20 + 50) / 100));
+	}
+	build_code(dc_luma_bits, dc_values, &e->dc[0]);
+	build_code(dc_chroma_bits, dc_values, &e->dc[1]);
+	build_code(ac_luma_bits, ac_luma_values, &e->ac[0]);
+	build_code(ac_chroma_bits, ac_chroma_values, &e->ac[1]);
+}
+
+// 'samples' are 0..255 minus 128, 'table' 0 for luma and 1 for chroma
+void encode_block(const block_encoder_t &e, bit_writer_t *w, const float *samples, int table,
+	int *dc_pred) {
+	float rows[64], coefficients[64];
+	for (int y = 0; y < 8; y++) {
+		for (int u = 0; u < 8; u++) {
+			float sum = 0.0f;
+			for (int x = 0; x < 8; x++) {
+				sum += e.basis[u][x] * samples[y * 8 + x];
+			}
+			rows[y * 8 + u] = sum;
+		}
+	}
+	for (int v = 0; v < 8; v++) {
+		for (int u = 0; u < 8; u++) {
+			float sum = 0.0f;
+			for (int y = 0; y < 8; y++) {
+				sum += e.basis[v][y] * rows[y * 8 + u];
+			}
+			coefficients[v * 8 + u] = sum;
+		}
+	}
+	int q[64];
+	for (int k = 0; k < 64; k++) {
+		int n = zigzag[k];
+		int value = (int)floorf(coefficients[n] / e.quant[table][n] + 0.5f);
+		q[k] = std::max(k ? -1023 : -2047, std::min(k ? 1023 : 2047, value));
+	}
+	put_value(w, e.dc[table], 0, q[0] - *dc_pred);
+	*dc_pred = q[0];
+	int run = 0;
+	for (int k = 1; k < 64; k++) {
+		if (q[k] == 0) {
+			run++;
+			continue;
+		}
+		for (; run > 15; run -= 16) {
+			put_bits(w, e.ac[table].code[0xf0], e.ac[table].length[0xf0]);
+		}
+		put_value(w, e.ac[table], run, q[k]);
+		run = 0;
+	}
+	if (run) {
+		put_bits(w, e.ac[table].code[0x00], e.ac[table].length[0x00]); // end of block
+	}
+}
+
+void put_segment(std::vector<unsigned char> &out, int marker, size_t length) {
+	out.push_back(0xff);
+	out.push_back((unsigned char)marker);
+	out.push_back((unsigned char)((length + 2) >> 8));
+	out.push_back((unsigned char)(length + 2));
+}
+
+void put_huffman_table(std::vector<unsigned char> &out, int id, const unsigned char *bits,
+	const unsigned char *values) {
+	int count = 0;
+	out.push_back((unsigned char)id);
+	for (int i = 0; i < 16; i++) {
+		out.push_back(bits[i]);
+		count += bits[i];
+	}
+	out.insert(out.end(), values, values + count);
+}
+
+// 'n' 1 or 2 for grey, 3 or 4 for colour (alpha is dropped)
+std::vector<unsigned char> encode_jpeg(const unsigned char *pixels, int w, int h, int n,
+	int restart_rows) {
+	block_encoder_t e;
+	block_encoder_init(&e);
+	bool colour = n >= 3;
+	int components = colour ? 3 : 1;
+	int mcu_size = colour ? 16 : 8;
+	int mcus_x = (w + mcu_size - 1) / mcu_size, mcus_y = (h + mcu_size - 1) / mcu_size;
+	int interval = std::min(65535 / mcus_x, std::max(1, restart_rows)) * mcus_x;
+
+	std::vector<unsigned char> out;
+	const unsigned char header[] = { 0xff, 0xd8, 0xff, 0xe0, 0, 16, 'J', 'F', 'I', 'F', 0, 1, 1, 0,
+		0, 1, 0, 1, 0, 0 };
+	out.insert(out.end(), header, header + sizeof(header));
+	put_segment(out, 0xdb, 65 * (colour ? 2 : 1));
+	for (int t = 0; t < (colour ? 2 : 1); t++) {
+		out.push_back((unsigned char)t);
+		for (int k = 0; k < 64; k++) {
+			out.push_back((unsigned char)e.quant[t][zigzag[k]]);
+		}
+	}
+	put_segment(out, 0xc0, 6 + 3 * components);
+	const unsigned char frame[] = { 8, (unsigned char)(h >> 8), (unsigned char)h,
+		(unsigned char)(w >> 8), (unsigned char)w, (unsigned char)components };
+	out.insert(out.end(), frame, frame + sizeof(frame));
+	for (int c = 0; c < components; c++) {
+		out.push_back((unsigned char)(c + 1));
+		out.push_back(colour && c == 0 ? 0x22 : 0x11);
+		out.push_back(c == 0 ? 0 : 1);
+	}
+	put_segment(out, 0xc4, colour ? 4 * 17 + 2 * 12 + 2 * 162 : 2 * 17 + 12 + 162);
+	put_huffman_table(out, 0x00, dc_luma_bits, dc_values);
+	put_huffman_table(out, 0x10, ac_luma_bits, ac_luma_values);
+	if (colour) {
+		put_huffman_table(out, 0x01, dc_chroma_bits, dc_values);
+		put_huffman_table(out, 0x11, ac_chroma_bits, ac_chroma_values);
+	}
+	put_segment(out, 0xdd, 2);
+	out.push_back((unsigned char)(interval >> 8));
+	out.push_back((unsigned char)interval);
+	put_segment(out, 0xda, 4 + 2 * components);
+	out.push_back((unsigned char)components);
+	for (int c = 0; c < components; c++) {
+		out.push_back((unsigned char)(c + 1));
+		out.push_back(c == 0 ? 0x00 : 0x11);
+	}
+	out.push_back(0);
+	out.push_back(63);
+	out.push_back(0);
+
+	bit_writer_t writer = { &out, 0, 0 };
+	int dc_pred[3] = { 0, 0, 0 };
+	int restarts = 0;
+	// Y, Cb and Cr (or grey) of the MCU, edges clamped
+	float planes[3][16 * 16];
+	for (int m = 0; m < mcus_x * mcus_y; m++) {
+		int left = m % mcus_x * mcu_size, top = m / mcus_x * mcu_size;
+		for (int y = 0; y < mcu_size; y++) {
+			for (int x = 0; x < mcu_size; x++) {
+				const unsigned char *p = pixels + ((size_t)std::min(top + y, h - 1) * w +
+					std::min(left + x, w - 1)) * n;
+				if (colour) {
+					planes[0][y * 16 + x] = 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] - 128.0f;
+					planes[1][y * 16 + x] = -0.168736f * p[0] - 0.331264f * p[1] + 0.5f * p[2];
+					planes[2][y * 16 + x] = 0.5f * p[0] - 0.418688f * p[1] - 0.081312f * p[2];
+				} else {
+					planes[0][y * 8 + x] = p[0] - 128.0f;
+				}
+			}
+		}
+		float block[64];
+		if (colour) {
+			for (int b = 0; b < 4; b++) {
+				for (int i = 0; i < 64; i++) {
+					block[i] = planes[0][(b / 2 * 8 + i / 8) * 16 + b % 2 * 8 + i % 8];
+				}
+				encode_block(e, &writer, block, 0, &dc_pred[0]);
+			}
+			for (int c = 1; c < 3; c++) {
+				for (int i = 0; i < 64; i++) {
+					const float *s = planes[c] + (i / 8 * 2) * 16 + i % 8 * 2;
+					block[i] = (s[0] + s[1] + s[16] + s[17]) * 0.25f;
+				}
+				encode_block(e, &writer, block, 1, &dc_pred[c]);
+			}
+		} else {
+			encode_block(e, &writer, planes[0], 0, &dc_pred[0]);
+		}
+		if ((m + 1) % interval == 0 && m + 1 < mcus_x * mcus_y) {
+			flush_bits(&writer);
+			out.push_back(0xff);
+			out.push_back((unsigned char)(0xd0 + (restarts++ & 7)));
+			dc_pred[0] = dc_pred[1] = dc_pred[2] = 0;
+		}
+	}
+	flush_bits(&writer);
+	out.push_back(0xff);
+	out.push_back(0xd9);
+	return out;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	profiler_init();
+	int runs = 5;
+	int restart_rows = 0;
+	int channels = 0;
+	unsigned threads = 0;
+	std::vector<const char *> files;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--runs=", 7) == 0) {
+			runs = std::max(1, atoi(argv[i] + 7));
+		} else if (strncmp(argv[i], "--restart=", 10) == 0) {
+			restart_rows = std::max(1, atoi(argv[i] + 10));
+		} else if (strncmp(argv[i], "--threads=", 10) == 0) {
+			threads = (unsigned)atoi(argv[i] + 10);
+		} else if (strncmp(argv[i], "--channels=", 11) == 0) {
+			channels = std::max(0, std::min(4, atoi(argv[i] + 11)));
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "ERROR: unknown option %s\n", argv[i]);
+			return 1;
+		} else {
+			files.push_back(argv[i]);
+		}
+	}
+	if (files.empty()) {
+		fprintf(stderr, "usage: jpeg_benchmark [--runs=N] [--restart=N] [--threads=N] "
+			"[--channels=N] image.jpg...\n");
+		return 1;
+	}
+
+	thread_pool_t pool;
+	thread_pool_init(&pool, threads);
+	int failed = 0;
+	double total_bytes = 0.0, total_ms[DECODER_COUNT] = { 0.0, 0.0, 0.0, 0.0 };
+	for (size_t f = 0; f < files.size(); f++) {
+		std::vector<unsigned char> data;
+		if (!read_file(files[f], data)) {
+			fprintf(stderr, "ERROR: could not read %s\n", files[f]);
+			failed++;
+			continue;
+		}
+		if (restart_rows) {
+			int x, y, n;
+			unsigned char *pixels = stbi_load_from_memory(data.data(), (int)data.size(), &x, &y, &n, 0);
+			if (!pixels) {
+				fprintf(stderr, "ERROR: could not decode %s: %s\n", files[f], stbi_failure_reason());
+				failed++;
+				continue;
+			}
+			data = encode_jpeg(pixels, x, y, n, restart_rows);
+			stbi_image_free(pixels);
+		}
+
+		double ms[DECODER_COUNT];
+		unsigned char *pixels[DECODER_COUNT];
+		int x = 0, y = 0, n = 0;
+		bool ok = true;
+		for (int d = 0; d < DECODER_COUNT; d++) {
+			stbi_set_jpeg_simd(d == DECODER_C ? 0 : d == DECODER_SSE2 ? 1 : 2);
+			stbi_set_jpeg_parallel_for(d == DECODER_THREADS ? pool_parallel_for : NULL, &pool);
+			ms[d] = 1e30;
+			pixels[d] = NULL;
+			for (int run = 0; run < runs; run++) {
+				stbi_image_free(pixels[d]);
+				double start = now_ms();
+				pixels[d] = stbi_load_from_memory(data.data(), (int)data.size(), &x, &y, &n, channels);
+				ms[d] = std::min(ms[d], now_ms() - start);
+			}
+			if (!pixels[d]) {
+				fprintf(stderr, "ERROR: could not decode %s with %s: %s\n", files[f], decoder_names[d],
+					stbi_failure_reason());
+				ok = false;
+			} else if (d != DECODER_C && pixels[DECODER_C] &&
+				memcmp(pixels[d], pixels[DECODER_C], (size_t)x * y * (channels ? channels : n)) != 0) {
+				fprintf(stderr, "ERROR: %s decodes differently with %s\n", files[f], decoder_names[d]);
+				ok = false;
+			}
+		}
+		if (ok) {
+			double bytes = (double)x * y * (channels ? channels : n);
+			int interval = restart_interval_of(data);
+			total_bytes += bytes;
+			printf("%s: %ix%i, %i channels, ", files[f], x, y, channels ? channels : n);
+			if (interval) {
+				printf("restart every %i MCUs, ", interval);
+			} else {
+				printf("no restart markers, ");
+			}
+			for (int d = 0; d < DECODER_COUNT; d++) {
+				total_ms[d] += ms[d];
+				printf("%s %.1f ms (%.0f MB/s)%s", decoder_names[d], ms[d], mb_per_s(bytes, ms[d]),
+					d + 1 < DECODER_COUNT ? ", " : "\n");
+			}
+		} else {
+			failed++;
+		}
+		for (int d = 0; d < DECODER_COUNT; d++) {
+			stbi_image_free(pixels[d]);
+		}
+	}
+	if (total_bytes > 0.0) {
+		printf("total: %.1f MB", total_bytes / (1024.0 * 1024.0));
+		for (int d = 0; d < DECODER_COUNT; d++) {
+			printf(", %s %.1f ms (%.0f MB/s, %.2fx SSE2)", decoder_names[d], total_ms[d],
+				mb_per_s(total_bytes, total_ms[d]), total_ms[DECODER_SSE2] / total_ms[d]);
+		}
+		printf(", %s\n", failed ? "some files failed" : "identical output");
+	}
+	thread_pool_shutdown(&pool);
+	return failed ? 1 : 0;
+}
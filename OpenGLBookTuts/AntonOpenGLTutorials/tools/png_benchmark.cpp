@@ -0,0 +1,125 @@
+/******************************************************************************\
+| png_benchmark: decodes PNGs with stb_image as it ships and with              |
+| STBI_FAST_PNG (the game's build), checks the two agree to the byte and       |
+| reports how fast each is.                                                    |
+|                                                                              |
+| Every file is read into memory first, so only decoding is timed: each        |
+| decoder runs --runs times per file (5 by default) and the fastest run        |
+| counts. Speeds are megabytes of decoded pixels a second, the totals are      |
+| over all the files, which is what startup pays for the skybox set.           |
+|                                                                              |
+| build, from this directory:                                                  |
+|   g++ -std=c++11 -O2 -I../AntonOpenGLTutorials png_benchmark.cpp             |
+|       png_benchmark_stock.cpp -o png_benchmark                               |
+|   cl /EHsc /O2 /I..\AntonOpenGLTutorials png_benchmark.cpp                   |
+|       png_benchmark_stock.cpp                                                |
+| usage:                                                                       |
+|   png_benchmark [--runs=N] "../../external resources/skybox/"bkg*.png        |
+| (spaceship_texture_hull.png in there isn't a PNG whatever its name says)     |
+| exits with 1 if a file doesn't decode or the decoders disagree               |
+\******************************************************************************/
+#define _CRT_SECURE_NO_WARNINGS
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#define STBI_FAST_PNG
+#include "stb_image.h"
+#include "steady_time.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+unsigned char *stock_png_load(const unsigned char *data, int size, int *x, int *y, int *n);
+void stock_png_free(unsigned char *pixels);
+
+namespace {
+
+bool read_file(const char *path, std::vector<unsigned char> &bytes) {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	bytes.resize(size > 0 ? (size_t)size : 0);
+	bool ok = size > 0 && fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	fclose(file);
+	return ok;
+}
+
+double mb_per_s(double bytes, double ms) {
+	return ms > 0.0 ? bytes / (1024.0 * 1024.0) / (ms / 1000.0) : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	int runs = 5;
+	std::vector<const char *> files;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--runs=", 7) == 0) {
+			runs = std::max(1, atoi(argv[i] + 7));
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "ERROR: unknown option %s\n", argv[i]);
+			return 1;
+		} else {
+			files.push_back(argv[i]);
+		}
+	}
+	if (files.empty()) {
+		fprintf(stderr, "usage: png_benchmark [--runs=N] image.png...\n");
+		return 1;
+	}
+
+	int failed = 0;
+	double total_bytes = 0.0, total_stock_ms = 0.0, total_fast_ms = 0.0;
+	for (size_t f = 0; f < files.size(); f++) {
+		std::vector<unsigned char> data;
+		if (!read_file(files[f], data)) {
+			fprintf(stderr, "ERROR: could not read %s\n", files[f]);
+			failed++;
+			continue;
+		}
+		double stock_ms = 1e30, fast_ms = 1e30;
+		unsigned char *stock = NULL, *fast = NULL;
+		int x = 0, y = 0, n = 0, fx = 0, fy = 0, fn = 0;
+		for (int run = 0; run < runs; run++) {
+			stock_png_free(stock);
+			free(fast);
+			double start = now_ms();
+			stock = stock_png_load(data.data(), (int)data.size(), &x, &y, &n);
+			double middle = now_ms();
+			fast = stbi_load_from_memory(data.data(), (int)data.size(), &fx, &fy, &fn, 0);
+			double end = now_ms();
+			stock_ms = std::min(stock_ms, middle - start);
+			fast_ms = std::min(fast_ms, end - middle);
+		}
+		if (!stock || !fast) {
+			fprintf(stderr, "ERROR: could not decode %s: %s\n", files[f], stbi_failure_reason());
+			failed++;
+		} else if (x != fx || y != fy || n != fn || memcmp(stock, fast, (size_t)x * y * n) != 0) {
+			fprintf(stderr, "ERROR: %s decodes differently with STBI_FAST_PNG\n", files[f]);
+			failed++;
+		} else {
+			double bytes = (double)x * y * n;
+			total_bytes += bytes;
+			total_stock_ms += stock_ms;
+			total_fast_ms += fast_ms;
+			printf("%s: %ix%i, %i channels, stock %.1f ms (%.0f MB/s), fast %.1f ms (%.0f MB/s), "
+				"%.2fx\n", files[f], x, y, n, stock_ms, mb_per_s(bytes, stock_ms), fast_ms,
+				mb_per_s(bytes, fast_ms), stock_ms / fast_ms);
+		}
+		stock_png_free(stock);
+		free(fast);
+	}
+	if (total_bytes > 0.0) {
+		printf("total: %.1f MB, stock %.1f ms (%.0f MB/s), fast %.1f ms (%.0f MB/s), %.2fx, "
+			"identical output\n", total_bytes / (1024.0 * 1024.0), total_stock_ms,
+			mb_per_s(total_bytes, total_stock_ms), total_fast_ms,
+			mb_per_s(total_bytes, total_fast_ms), total_stock_ms / total_fast_ms);
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,17 @@
+// the stock stb_image PNG decoder for png_benchmark, in a translation unit
+// of its own so it can sit next to the STBI_FAST_PNG one (both are static)
+#define _CRT_SECURE_NO_WARNINGS
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include "stb_image.h"
+
+unsigned char *stock_png_load(const unsigned char *data, int size, int *x, int *y, int *n)
+{
+	return stbi_load_from_memory(data, size, x, y, n, 0);
+}
+
+void stock_png_free(unsigned char *pixels)
+{
+	stbi_image_free(pixels);
+}
@@ -0,0 +1,206 @@
+/******************************************************************************\
+| residency_test: drives texture_residency with a fake backend, no OpenGL,     |
+| and checks the eviction policy:                                              |
+|   the least recently used texture goes first, then the next one              |
+|   a texture over by a little gives up its largest levels only, one over by   |
+|   a lot goes all the way to its placeholder                                  |
+|   a backend that refuses leaves that texture alone and the frame over        |
+|   budget, counted, when nothing else can give anything up                    |
+|   an evicted texture that's drawn again is grown back a level a frame and    |
+|   then stays, however tight the budget                                       |
+|                                                                              |
+| build, from this directory:                                                  |
+|   g++ -std=c++11 -O2 -I../AntonOpenGLTutorials residency_test.cpp            |
+|       ../AntonOpenGLTutorials/texture_residency.cpp -o residency_test        |
+|   cl /EHsc /O2 /I..\AntonOpenGLTutorials residency_test.cpp                  |
+|       ..\AntonOpenGLTutorials\texture_residency.cpp                          |
+| usage:                                                                       |
+|   residency_test                                                             |
+| prints each check that failed and exits with 1 if any did                    |
+\******************************************************************************/
+#define _CRT_SECURE_NO_WARNINGS
+#include "texture_residency.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+namespace {
+
+// every texture has the same three levels, 84 bytes in all
+const size_t LEVEL_BYTES[3] = {64, 16, 4};
+const int LEVELS = 3;
+
+// stands in for the streamer: remembers what it was asked and can be told to
+// refuse, keeping whatever base level a texture already has
+struct fake_backend_t {
+	std::vector<int> base_level; // by id
+	std::vector<bool> refuse; // by id
+	std::vector<int> evicted; // ids, in the order evict was called
+};
+
+int fake_evict(void *user, int id, int base_level) {
+	fake_backend_t *fake = (fake_backend_t *)user;
+	fake->evicted.push_back(id);
+	if (!fake->refuse[id]) {
+		fake->base_level[id] = base_level;
+	}
+	return fake->base_level[id];
+}
+
+struct harness_t {
+	fake_backend_t fake;
+	texture_residency_t residency;
+};
+
+void start(harness_t &h, int textures) {
+	h.fake = fake_backend_t();
+	h.fake.base_level.assign(textures, 0);
+	h.fake.refuse.assign(textures, false);
+	residency_backend_t backend;
+	backend.user = &h.fake;
+	backend.evict = fake_evict;
+	residency_init(&h.residency, backend, SIZE_MAX);
+	h.residency.keep_frames = 0; // anything not drawn this frame may go
+	for (int id = 0; id < textures; id++) {
+		residency_add(&h.residency, id, LEVEL_BYTES, LEVELS);
+	}
+}
+
+// what the game does with a texture it draws: touch it, and the streamer
+// brings back one finer level if it had lost any
+void draw(harness_t &h, int id) {
+	residency_touch(&h.residency, id);
+	if (h.fake.base_level[id] > 0) {
+		h.fake.base_level[id]--;
+		residency_set_base_level(&h.residency, id, h.fake.base_level[id]);
+	}
+}
+
+int failures = 0;
+
+void check(bool ok, const char *test, const char *what) {
+	if (!ok) {
+		fprintf(stderr, "FAILED: %s: %s\n", test, what);
+		failures++;
+	}
+}
+
+void test_lru_order() {
+	const char *test = "lru order";
+	harness_t h;
+	start(h, 3);
+	residency_end_frame(&h.residency);
+	// drawn in the order 2, 0, 1, so 2 is the least recently used
+	draw(h, 2);
+	residency_end_frame(&h.residency);
+	draw(h, 0);
+	residency_end_frame(&h.residency);
+	draw(h, 1);
+	residency_end_frame(&h.residency);
+	// 252 bytes down to 100: all of 2 isn't enough, 0 then gives up its two largest
+	residency_set_budget(&h.residency, 100);
+	residency_end_frame(&h.residency);
+	check(h.fake.evicted.size() == 2, test, "two evictions");
+	check(h.fake.evicted.size() == 2 && h.fake.evicted[0] == 2 && h.fake.evicted[1] == 0, test,
+		"2 evicted before 0");
+	check(residency_base_level(&h.residency, 2) == LEVELS, test, "2 down to its placeholder");
+	check(residency_base_level(&h.residency, 0) == 2, test, "0 keeps its smallest level");
+	check(residency_base_level(&h.residency, 1) == 0, test, "1 untouched");
+	residency_stats_t stats = residency_stats(&h.residency);
+	check(stats.resident_bytes == 88, test, "88 bytes resident");
+	check(stats.placeholder_textures == 1 && stats.evicted_textures == 2, test, "stats");
+	check(stats.over_budget_frames == 0, test, "never over budget");
+}
+
+void test_partial_drop() {
+	const char *test = "partial drop";
+	harness_t h;
+	start(h, 1);
+	residency_end_frame(&h.residency);
+	// 84 bytes into 30: dropping the 64 byte level is enough
+	residency_set_budget(&h.residency, 30);
+	residency_end_frame(&h.residency);
+	check(residency_base_level(&h.residency, 0) == 1, test, "largest level only");
+	residency_stats_t stats = residency_stats(&h.residency);
+	check(stats.evicted_bytes == 64 && stats.resident_bytes == 20, test, "64 bytes freed");
+	check(stats.placeholder_textures == 0, test, "not the placeholder");
+	// then into 3: even the 4 byte level is too much
+	residency_set_budget(&h.residency, 3);
+	residency_end_frame(&h.residency);
+	check(residency_base_level(&h.residency, 0) == LEVELS, test, "then the placeholder");
+	stats = residency_stats(&h.residency);
+	check(stats.evicted_bytes == 84 && stats.resident_bytes == 0, test, "84 bytes freed");
+	check(stats.evictions == 2, test, "one eviction a frame");
+}
+
+void test_refusal() {
+	const char *test = "refusal";
+	harness_t h;
+	start(h, 2);
+	residency_end_frame(&h.residency);
+	draw(h, 0);
+	residency_end_frame(&h.residency);
+	draw(h, 1);
+	residency_end_frame(&h.residency);
+	// 0 is next in line but refuses, so 1 has to give up its levels instead
+	h.fake.refuse[0] = true;
+	residency_set_budget(&h.residency, 110);
+	residency_end_frame(&h.residency);
+	check(residency_base_level(&h.residency, 0) == 0, test, "0 kept everything");
+	check(residency_base_level(&h.residency, 1) == 1, test, "1 gave up its largest level");
+	residency_stats_t stats = residency_stats(&h.residency);
+	check(stats.over_budget_frames == 0, test, "1 was enough");
+	// with both refusing, nothing can be done and the frame stays over budget
+	h.fake.refuse[1] = true;
+	residency_set_budget(&h.residency, 10);
+	residency_end_frame(&h.residency);
+	stats = residency_stats(&h.residency);
+	check(stats.resident_bytes == 104 && stats.resident_bytes > stats.budget, test,
+		"still over budget");
+	check(stats.over_budget_frames == 1, test, "over budget frame counted");
+	check(residency_base_level(&h.residency, 0) == 0 && residency_base_level(&h.residency, 1) == 1,
+		test, "nothing changed");
+}
+
+void test_restore_on_touch() {
+	const char *test = "restore on touch";
+	harness_t h;
+	start(h, 1);
+	residency_end_frame(&h.residency);
+	residency_set_budget(&h.residency, 0);
+	residency_end_frame(&h.residency);
+	check(residency_base_level(&h.residency, 0) == LEVELS, test, "evicted to its placeholder");
+	// drawn every frame from now on: a level back a frame, never evicted again
+	for (int frame = 0; frame < LEVELS; frame++) {
+		draw(h, 0);
+		residency_end_frame(&h.residency);
+		check(residency_base_level(&h.residency, 0) == LEVELS - 1 - frame, test,
+			"one finer level a frame");
+	}
+	draw(h, 0);
+	residency_end_frame(&h.residency);
+	residency_stats_t stats = residency_stats(&h.residency);
+	check(residency_base_level(&h.residency, 0) == 0, test, "all levels back");
+	check(stats.restores == (unsigned long long)LEVELS, test, "a restore a level");
+	check(stats.evictions == 1, test, "in use, so not evicted again");
+	check(stats.over_budget_frames == (unsigned long long)LEVELS + 1, test,
+		"over budget while in use");
+	// once it isn't drawn any more it goes again
+	residency_end_frame(&h.residency);
+	check(residency_base_level(&h.residency, 0) == LEVELS, test, "evicted once unused");
+}
+
+} // namespace
+
+int main() {
+	test_lru_order();
+	test_partial_drop();
+	test_refusal();
+	test_restore_on_touch();
+	if (failures) {
+		fprintf(stderr, "%i checks failed\n", failures);
+		return 1;
+	}
+	printf("residency_test: all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,404 @@
+/******************************************************************************\
+| shader_permutations: expands and validates every shader permutation listed   |
+| in shaders.manifest, offline, so a broken permutation shows up here and not  |
+| when the game happens to draw with it.                                       |
+|                                                                              |
+| For each manifest line both stages are run through the same preprocessor     |
+| the game uses (shader_preprocessor.cpp) and checked:                         |
+|   - every #include resolves and there is a #version                          |
+|   - #if/#ifdef/#ifndef and #endif balance                                    |
+|   - each define in the key is actually tested by one of the stages, which    |
+|     catches typos like TEXTRUED that would silently pick the default path    |
+| The expanded sources are written to the output directory. If                 |
+| glslangValidator (the Khronos reference compiler) is on the PATH each stage  |
+| is compiled and the pair linked with it as well, --require-glslang turns it  |
+| being missing into an error.                                                 |
+| With --embed=file, and only when every permutation passed, the stages are    |
+| written as constexpr strings with their hashes into a header the game        |
+| compiles in (embedded_shaders.h), so it doesn't read shader files at all.    |
+| --check-embed=file writes nothing and fails if the header isn't what --embed |
+| would write, so a shader edited without regenerating it is caught.           |
+|                                                                              |
+| build, from this directory:                                                  |
+|   g++ -std=c++11 -O2 -I../AntonOpenGLTutorials shader_permutations.cpp       |
+|       ../AntonOpenGLTutorials/shader_preprocessor.cpp                        |
+|       ../AntonOpenGLTutorials/file_system.cpp -o shader_permutations         |
+|   cl /EHsc /O2 /I..\AntonOpenGLTutorials shader_permutations.cpp             |
+|       ..\AntonOpenGLTutorials\shader_preprocessor.cpp                        |
+|       ..\AntonOpenGLTutorials\file_system.cpp                                |
+| usage:                                                                       |
+|   shader_permutations ../AntonOpenGLTutorials/shaders.manifest [out_dir]     |
+|       [--embed=../AntonOpenGLTutorials/embedded_shaders.h]                   |
+|       [--check-embed=../AntonOpenGLTutorials/embedded_shaders.h]             |
+|       [--require-glslang]                                                    |
+| exits with 1 if anything failed                                              |
+|                                                                              |
+| The game's vcxproj builds this and runs it with --check-embed before         |
+| compiling, whenever a shader or the manifest changed (the                    |
+| CheckShaderPermutations target), so a broken permutation or a stale          |
+| embedded_shaders.h fails the build; the checked-in header is never           |
+| rewritten by it. glslang is optional there, /p:RequireGlslang=true makes it  |
+| required (glslangValidator from the Vulkan SDK on the PATH).                 |
+\******************************************************************************/
+#define _CRT_SECURE_NO_WARNINGS
+#include "shader_preprocessor.h"
+#include "file_system.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#define NULL_DEVICE "NUL"
+#define chdir _chdir
+#define getcwd _getcwd
+#else
+#include <unistd.h>
+#define NULL_DEVICE "/dev/null"
+#endif
+
+struct permutation_t {
+	std::string name;
+	std::string vertex_file;
+	std::string fragment_file;
+	std::string key;
+	int line;
+};
+
+static bool read_manifest(const char *file_name, std::vector<permutation_t> &permutations) {
+	std::ifstream stream(file_name);
+	if (!stream) {
+		fprintf(stderr, "ERROR: could not open manifest %s\n", file_name);
+		return false;
+	}
+	std::string line;
+	int line_number = 0;
+	bool ok = true;
+	while (std::getline(stream, line)) {
+		line_number++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) {
+			line.erase(comment);
+		}
+		std::istringstream fields(line);
+		permutation_t permutation;
+		if (!(fields >> permutation.name)) {
+			continue; // blank or comment
+		}
+		if (!(fields >> permutation.vertex_file >> permutation.fragment_file)) {
+			fprintf(stderr, "ERROR: %s(%i): expected <name> <vertex> <fragment> [defines]\n",
+				file_name, line_number);
+			ok = false;
+			continue;
+		}
+		std::string define;
+		while (fields >> define) {
+			permutation.key += " " + define;
+		}
+		permutation.key = normalise_permutation_key(permutation.key);
+		permutation.line = line_number;
+		permutations.push_back(permutation);
+	}
+	return ok;
+}
+
+static bool write_file(const std::string &file_name, const std::string &text) {
+	FILE *file = fopen(file_name.c_str(), "wb");
+	if (!file) {
+		fprintf(stderr, "ERROR: could not write %s\n", file_name.c_str());
+		return false;
+	}
+	fwrite(text.data(), 1, text.size(), file);
+	fclose(file);
+	return true;
+}
+
+// the first word after '#' on each line, for the checks below
+static std::string directive_word(const std::string &line) {
+	size_t i = line.find_first_not_of(" \t");
+	if (i == std::string::npos || line[i] != '#') {
+		return std::string();
+	}
+	i = line.find_first_not_of(" \t", i + 1);
+	if (i == std::string::npos) {
+		return std::string();
+	}
+	size_t end = line.find_first_of(" \t(", i);
+	return line.substr(i, end == std::string::npos ? std::string::npos : end - i);
+}
+
+static bool check_conditionals(const std::string &source, const std::string &stage_name) {
+	std::istringstream stream(source);
+	std::string line;
+	int depth = 0;
+	while (std::getline(stream, line)) {
+		std::string word = directive_word(line);
+		if (word == "if" || word == "ifdef" || word == "ifndef") {
+			depth++;
+		} else if (word == "endif") {
+			if (--depth < 0) {
+				break;
+			}
+		}
+	}
+	if (depth != 0) {
+		fprintf(stderr, "  ERROR: %s: unbalanced #if/#endif\n", stage_name.c_str());
+		return false;
+	}
+	return true;
+}
+
+// true if 'name' appears as a whole word in 'source' outside the generated #defines
+static bool uses_define(const std::string &source, const std::string &name) {
+	size_t body = source.find("\n#line ");
+	for (size_t at = source.find(name, body); at != std::string::npos;
+		at = source.find(name, at + 1)) {
+		bool start_ok = at == 0 || !(isalnum((unsigned char)source[at - 1]) || source[at - 1] == '_');
+		size_t end = at + name.size();
+		bool end_ok = end >= source.size() ||
+			!(isalnum((unsigned char)source[end]) || source[end] == '_');
+		if (start_ok && end_ok) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// relative paths are turned absolute before main() changes directory
+static std::string absolute_path(const std::string &path) {
+	if (path.empty() || path[0] == '/' || path[0] == '\\' ||
+		(path.size() > 1 && path[1] == ':')) {
+		return path;
+	}
+	char cwd[4096];
+	if (!getcwd(cwd, sizeof(cwd))) {
+		return path;
+	}
+	return std::string(cwd) + "/" + path;
+}
+
+// one embedded stage, the same file and key used by two programs is stored once
+struct embedded_stage_t {
+	std::string file;
+	std::string key;
+	std::string source;
+};
+
+static void add_stage(std::vector<embedded_stage_t> &stages, const std::string &file,
+	const std::string &key, const std::string &source) {
+	for (size_t i = 0; i < stages.size(); i++) {
+		if (stages[i].file == file && stages[i].key == key) {
+			return;
+		}
+	}
+	embedded_stage_t stage;
+	stage.file = file;
+	stage.key = key;
+	stage.source = source;
+	stages.push_back(stage);
+}
+
+static std::string c_string_literal(const std::string &text) {
+	std::string result = "\"";
+	for (size_t i = 0; i < text.size(); i++) {
+		char c = text[i];
+		if (c == '"' || c == '\\') {
+			result += '\\';
+			result += c;
+		} else if (c == '\t') {
+			result += "\\t";
+		} else if (c == '\n') {
+			result += "\\n";
+		} else {
+			result += c;
+		}
+	}
+	return result + "\"";
+}
+
+// every stage as a constexpr string with its hash_string(), one literal per
+// source line so no single literal runs into MSVC's length limit
+static std::string embedded_header(const std::string &manifest,
+	const std::vector<embedded_stage_t> &stages) {
+	std::ostringstream out;
+	out << "// generated by tools/shader_permutations from " << manifest << ", do not edit.\n"
+		"// regenerate after changing a shader, include or the manifest:\n"
+		"//   shader_permutations shaders.manifest --embed=embedded_shaders.h\n"
+		"// (run from this directory)\n"
+		"#pragma once\n"
+		"#ifndef _EMBEDDED_SHADERS_H_\n"
+		"#define _EMBEDDED_SHADERS_H_\n\n"
+		"struct embedded_shader_t {\n"
+		"\tconst char *file;\n"
+		"\tconst char *permutation; // normalised key, see shader_preprocessor.h\n"
+		"\tunsigned long long hash; // hash_string(source)\n"
+		"\tconst char *source; // preprocessed\n"
+		"};\n\n"
+		"static constexpr int embedded_shader_count = " << stages.size() << ";\n\n"
+		"static constexpr embedded_shader_t embedded_shaders[] = {\n";
+	for (size_t i = 0; i < stages.size(); i++) {
+		char hash[32];
+		snprintf(hash, sizeof(hash), "0x%016llxull", hash_string(stages[i].source));
+		out << "\t{ " << c_string_literal(stages[i].file) << ", "
+			<< c_string_literal(stages[i].key) << ", " << hash << ",\n";
+		std::istringstream lines(stages[i].source);
+		std::string line;
+		while (std::getline(lines, line)) {
+			out << "\t\t" << c_string_literal(line + "\n") << "\n";
+		}
+		out << "\t},\n";
+	}
+	out << "};\n\n#endif\n";
+	return out.str();
+}
+
+// whether 'file_name' holds 'text', carriage returns aside (git may have
+// checked it out with CRLF line ends)
+static bool file_matches(const std::string &file_name, const std::string &text) {
+	std::ifstream stream(file_name.c_str(), std::ios::binary);
+	if (!stream) {
+		return false;
+	}
+	std::ostringstream contents;
+	contents << stream.rdbuf();
+	std::string existing = contents.str();
+	existing.erase(std::remove(existing.begin(), existing.end(), '\r'), existing.end());
+	return existing == text;
+}
+
+int main(int argc, char **argv) {
+	const char *manifest_arg = NULL;
+	std::string out_dir = "shader_permutations_out";
+	std::string embed_file;
+	bool check_embed = false;
+	bool require_glslang = false;
+	int positional = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--embed=", 8) == 0) {
+			embed_file = argv[i] + 8;
+			check_embed = false;
+		} else if (strncmp(argv[i], "--check-embed=", 14) == 0) {
+			embed_file = argv[i] + 14;
+			check_embed = true;
+		} else if (strcmp(argv[i], "--require-glslang") == 0) {
+			require_glslang = true;
+		} else if (positional == 0) {
+			manifest_arg = argv[i];
+			positional++;
+		} else {
+			out_dir = argv[i];
+		}
+	}
+	if (!manifest_arg) {
+		fprintf(stderr, "usage: %s <shaders.manifest> [out_dir] [--embed=header | "
+			"--check-embed=header] [--require-glslang]\n", argv[0]);
+		return 1;
+	}
+	out_dir = absolute_path(out_dir);
+	make_directory(out_dir.c_str());
+	if (!embed_file.empty()) {
+		embed_file = absolute_path(embed_file);
+	}
+
+	std::vector<permutation_t> permutations;
+	bool ok = read_manifest(manifest_arg, permutations);
+
+	// shader paths in the manifest are relative to it. working from its directory
+	// makes the file names in the expanded sources match what the game sees
+	std::string manifest = manifest_arg;
+	size_t slash = manifest.find_last_of("/\\");
+	if (slash != std::string::npos) {
+		std::string directory = manifest.substr(0, slash);
+		manifest = manifest.substr(slash + 1);
+		if (chdir(directory.c_str()) != 0) {
+			fprintf(stderr, "ERROR: could not change to %s\n", directory.c_str());
+			return 1;
+		}
+	}
+
+	bool have_glslang = system("glslangValidator --version > " NULL_DEVICE " 2>&1") == 0;
+	if (!have_glslang) {
+		if (require_glslang) {
+			fprintf(stderr, "ERROR: glslangValidator not found and --require-glslang given\n");
+			return 1;
+		}
+		printf("glslangValidator not found, doing preprocessor checks only\n");
+	}
+
+	std::vector<embedded_stage_t> stages;
+	int failed = 0;
+	for (size_t i = 0; i < permutations.size(); i++) {
+		const permutation_t &p = permutations[i];
+		printf("%s [%s]\n", p.name.c_str(), p.key.c_str());
+		bool permutation_ok = true;
+
+		std::string vertex_source, fragment_source;
+		std::vector<std::string> files;
+		if (!preprocess_shader(p.vertex_file.c_str(), p.key, vertex_source, files) ||
+			!preprocess_shader(p.fragment_file.c_str(), p.key, fragment_source, files)) {
+			failed++;
+			continue;
+		}
+		permutation_ok &= check_conditionals(vertex_source, p.vertex_file);
+		permutation_ok &= check_conditionals(fragment_source, p.fragment_file);
+
+		std::vector<std::string> defines;
+		split_permutation_key(p.key, defines);
+		for (size_t d = 0; d < defines.size(); d++) {
+			std::string name = defines[d].substr(0, defines[d].find('='));
+			if (!uses_define(vertex_source, name) && !uses_define(fragment_source, name)) {
+				fprintf(stderr, "  ERROR: %s isn't used by %s or %s\n", name.c_str(),
+					p.vertex_file.c_str(), p.fragment_file.c_str());
+				permutation_ok = false;
+			}
+		}
+
+		// glslangValidator picks the stage from the extension
+		std::string vertex_out = out_dir + "/" + p.name + ".vert";
+		std::string fragment_out = out_dir + "/" + p.name + ".frag";
+		permutation_ok &= write_file(vertex_out, vertex_source);
+		permutation_ok &= write_file(fragment_out, fragment_source);
+
+		if (have_glslang && permutation_ok) {
+			std::string command = "glslangValidator -l \"" + vertex_out + "\" \"" + fragment_out + "\"";
+			if (system(command.c_str()) != 0) {
+				fprintf(stderr, "  ERROR: glslangValidator rejected %s\n", p.name.c_str());
+				permutation_ok = false;
+			}
+		}
+		if (!permutation_ok) {
+			failed++;
+			continue;
+		}
+		add_stage(stages, p.vertex_file, p.key, vertex_source);
+		add_stage(stages, p.fragment_file, p.key, fragment_source);
+	}
+
+	printf("%i permutations, %i failed\n", (int)permutations.size(), failed);
+	if (!ok || failed > 0) {
+		return 1;
+	}
+	// only written when everything passed, so the game never embeds a broken shader
+	if (!embed_file.empty()) {
+		std::string header = embedded_header(manifest, stages);
+		if (check_embed) {
+			if (!file_matches(embed_file, header)) {
+				fprintf(stderr, "ERROR: %s is out of date, regenerate it with --embed\n",
+					embed_file.c_str());
+				return 1;
+			}
+			printf("%s is up to date\n", embed_file.c_str());
+		} else {
+			if (!write_file(embed_file, header)) {
+				return 1;
+			}
+			printf("embedded %i stages in %s\n", (int)stages.size(), embed_file.c_str());
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,270 @@
+/******************************************************************************\
+| texture_baker: compresses images to BC1, BC3 or BC7 with a full mip chain    |
+| and writes each as a .ktx next to it (bkg1_back6.png -> bkg1_back6.ktx).     |
+| The game's texture streamer picks up the .ktx in place of the image when the |
+| driver supports the format and uploads it with glCompressedTexImage2D,       |
+| otherwise it keeps using the image.                                          |
+|                                                                              |
+| Runs on the CPU only: every level is decoded again after encoding and        |
+| compared against its source, so quality (PSNR, RGB for BC1 and RGBA          |
+| otherwise) and speed (megapixels a second over all levels) can be checked    |
+| on a machine without a GPU. Blocks are encoded on one worker per hardware    |
+| thread unless --threads says otherwise.                                      |
+|                                                                              |
+| build, from this directory:                                                  |
+|   g++ -std=c++11 -O2 -pthread -I../AntonOpenGLTutorials texture_baker.cpp    |
+|       ../AntonOpenGLTutorials/texture_codec.cpp                              |
+|       ../AntonOpenGLTutorials/mip_generator.cpp                              |
+|       ../AntonOpenGLTutorials/image_arena.cpp                                |
+|       ../AntonOpenGLTutorials/image_ops.cpp                                  |
+|       ../AntonOpenGLTutorials/thread_pool.cpp                                |
+|       ../AntonOpenGLTutorials/profiler.cpp -o texture_baker                  |
+|   cl /EHsc /O2 /I..\AntonOpenGLTutorials texture_baker.cpp                   |
+|       ..\AntonOpenGLTutorials\texture_codec.cpp                              |
+|       ..\AntonOpenGLTutorials\mip_generator.cpp                              |
+|       ..\AntonOpenGLTutorials\image_arena.cpp                                |
+|       ..\AntonOpenGLTutorials\image_ops.cpp                                  |
+|       ..\AntonOpenGLTutorials\thread_pool.cpp                                |
+|       ..\AntonOpenGLTutorials\profiler.cpp                                   |
+|                                                                              |
+| Mips are made with mip_generator.cpp, kaiser filtered in linear light        |
+| unless --filter or --linear (for data that isn't colour) say otherwise.      |
+|                                                                              |
+| usage:                                                                       |
+|   texture_baker bc1|bc3|bc7 [--no-mips] [--filter=box|kaiser|lanczos]        |
+|       [--linear] [--premultiply] [--flip] [--threads=N] [--levels]           |
+|       [--tiers[=N,...]] image...                                             |
+|   --flip stores the rows bottom-up, for textures the game loads flipped      |
+|   (the ship's); --premultiply multiplies colour by alpha before the mips are |
+|   made, for textures blended with GL_ONE, GL_ONE_MINUS_SRC_ALPHA; --levels   |
+|   prints the PSNR of every level, not just the first                         |
+|   --tiers also writes bkg1_back6_512.ktx, bkg1_back6_1024.ktx and so on: the |
+|   chain from the level that size down, for every listed size (512, 1024,     |
+|   2048 and 4096 by default) the image has a level of. The game loads the     |
+|   smallest tier of a skybox that covers its window. Sizes bigger than the    |
+|   image are skipped, nothing is upscaled                                     |
+| exits with 1 if anything failed                                              |
+\******************************************************************************/
+#define _CRT_SECURE_NO_WARNINGS
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_FAST_PNG
+#define STBI_FAST_JPEG
+#include "stb_image.h"
+#include "image_ops.h"
+#include "mip_generator.h"
+#include "profiler.h"
+#include "texture_codec.h"
+#include "thread_pool.h"
+#include "steady_time.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string stem_of(const std::string &path) {
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+		return path;
+	}
+	return path.substr(0, dot);
+}
+
+std::string ktx_path_for(const std::string &path) {
+	return stem_of(path) + ".ktx";
+}
+
+// bkg1_back6.png, 1024 -> bkg1_back6_1024.ktx, the name main.cpp looks for
+std::string tier_path_for(const std::string &path, int tier) {
+	return stem_of(path) + "_" + std::to_string(tier) + ".ktx";
+}
+
+bool parse_tiers(const char *list, std::vector<int> &tiers) {
+	tiers.clear();
+	for (const char *p = list; *p;) {
+		char *end = NULL;
+		long tier = strtol(p, &end, 10);
+		if (end == p || tier <= 0 || (tier & (tier - 1)) != 0) {
+			return false;
+		}
+		tiers.push_back((int)tier);
+		if (*end && *end != ',') {
+			return false;
+		}
+		p = *end ? end + 1 : end;
+	}
+	return !tiers.empty();
+}
+
+// one .ktx per tier, each the mip chain from the level whose larger side is
+// the tier down. the levels are the ones already encoded for the full image
+bool write_tiers(texture_format_t format, const char *path, bool flip,
+	const std::vector<mip_level_t> &mips, const std::vector<std::vector<unsigned char>> &levels,
+	const std::vector<int> &tiers) {
+	for (size_t t = 0; t < tiers.size(); t++) {
+		size_t first = 0;
+		while (first < mips.size() && std::max(mips[first].width, mips[first].height) > tiers[t]) {
+			first++;
+		}
+		if (first == mips.size() || std::max(mips[first].width, mips[first].height) != tiers[t]) {
+			printf("  tier %i: skipped, no level of %s is that size\n", tiers[t], path);
+			continue;
+		}
+		std::vector<std::vector<unsigned char>> tier_levels(levels.begin() + first, levels.end());
+		std::string out_path = tier_path_for(path, tiers[t]);
+		if (!ktx_write(out_path.c_str(), format, mips[first].width, mips[first].height, 0, flip,
+			tier_levels)) {
+			return false;
+		}
+		size_t bytes = 0;
+		for (size_t i = 0; i < tier_levels.size(); i++) {
+			bytes += tier_levels[i].size();
+		}
+		printf("  tier %i: %s, %i levels, %.2f MB\n", tiers[t], out_path.c_str(),
+			(int)tier_levels.size(), bytes / (1024.0 * 1024.0));
+	}
+	return true;
+}
+
+bool bake(thread_pool_t *pool, texture_format_t format, const char *path, mip_filter_t filter,
+	bool srgb, bool premultiply, bool flip, bool print_levels, const std::vector<int> &tiers) {
+	int w, h, n;
+	unsigned char *pixels = stbi_load(path, &w, &h, &n, 0);
+	if (!pixels) {
+		fprintf(stderr, "ERROR: could not load %s: %s\n", path, stbi_failure_reason());
+		return false;
+	}
+	pixels = image_convert_channels(pixels, (size_t)w * h, n, 4);
+	if (!pixels) {
+		fprintf(stderr, "ERROR: out of memory for %s\n", path);
+		return false;
+	}
+	if (flip) {
+		image_flip_rows(pixels, w, h, 4);
+	}
+	if (premultiply) {
+		image_premultiply_alpha(pixels, (size_t)w * h);
+	}
+	std::vector<mip_level_t> mips(1);
+	mips[0].width = w;
+	mips[0].height = h;
+	mips[0].pixels.assign(pixels, pixels + (size_t)w * h * 4);
+	stbi_image_free(pixels);
+	std::vector<mip_level_t> below;
+	generate_mips(mips[0].pixels.data(), w, h, 4, filter, srgb, below);
+	mips.insert(mips.end(), below.begin(), below.end());
+
+	int channels = format == TEXTURE_BC1 ? 3 : 4;
+	std::vector<std::vector<unsigned char>> levels;
+	std::vector<unsigned char> decoded;
+	double encode_ms = 0.0;
+	double pixel_count = 0.0;
+	double first_psnr = 0.0, worst_psnr = 99.0;
+	for (size_t index = 0; index < mips.size(); index++) {
+		const mip_level_t &level = mips[index];
+		levels.push_back(std::vector<unsigned char>());
+		double start = now_ms();
+		compress_image(pool, format, level.pixels.data(), level.width, level.height, levels.back());
+		encode_ms += now_ms() - start;
+		pixel_count += (double)level.width * level.height;
+
+		decompress_image(format, levels.back().data(), level.width, level.height, decoded);
+		double psnr = image_psnr(level.pixels.data(), decoded.data(), level.width, level.height,
+			channels);
+		if (index == 0) {
+			first_psnr = psnr;
+		}
+		worst_psnr = std::min(worst_psnr, psnr);
+		if (print_levels) {
+			printf("  level %2i %5ix%-5i %6.2f dB\n", (int)index, level.width, level.height, psnr);
+		}
+	}
+
+	std::string out_path = ktx_path_for(path);
+	if (!ktx_write(out_path.c_str(), format, w, h, 0, flip, levels)) {
+		return false;
+	}
+	size_t bytes = 0;
+	for (size_t i = 0; i < levels.size(); i++) {
+		bytes += levels[i].size();
+	}
+	printf("%s: %s %ix%i, %i levels (%s), %.2f MB (RGBA8 would be %.2f MB), %.0f ms, "
+		"%.1f Mpixel/s, PSNR %.2f dB (worst level %.2f dB)\n",
+		out_path.c_str(), texture_format_name(format), w, h, (int)levels.size(),
+		mip_filter_name(filter),
+		bytes / (1024.0 * 1024.0), pixel_count * 4.0 / (1024.0 * 1024.0), encode_ms,
+		pixel_count / (encode_ms * 1000.0), first_psnr, worst_psnr);
+	return write_tiers(format, path, flip, mips, levels, tiers);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	profiler_init();
+	texture_format_t format = TEXTURE_BC1;
+	bool have_format = false;
+	mip_filter_t filter = MIP_FILTER_KAISER;
+	bool srgb = true;
+	bool premultiply = false;
+	bool flip = false;
+	bool print_levels = false;
+	unsigned threads = 0;
+	std::vector<int> tiers;
+	std::vector<const char *> images;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "bc1") == 0 || strcmp(argv[i], "bc3") == 0 ||
+			strcmp(argv[i], "bc7") == 0) {
+			format = argv[i][2] == '1' ? TEXTURE_BC1 : (argv[i][2] == '3' ? TEXTURE_BC3 : TEXTURE_BC7);
+			have_format = true;
+		} else if (strcmp(argv[i], "--no-mips") == 0) {
+			filter = MIP_FILTER_NONE;
+		} else if (strncmp(argv[i], "--filter=", 9) == 0) {
+			if (!mip_filter_from_name(argv[i] + 9, &filter)) {
+				fprintf(stderr, "ERROR: unknown filter %s\n", argv[i] + 9);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--linear") == 0) {
+			srgb = false;
+		} else if (strcmp(argv[i], "--premultiply") == 0) {
+			premultiply = true;
+		} else if (strcmp(argv[i], "--flip") == 0) {
+			flip = true;
+		} else if (strcmp(argv[i], "--levels") == 0) {
+			print_levels = true;
+		} else if (strcmp(argv[i], "--tiers") == 0) {
+			parse_tiers("512,1024,2048,4096", tiers);
+		} else if (strncmp(argv[i], "--tiers=", 8) == 0) {
+			if (!parse_tiers(argv[i] + 8, tiers)) {
+				fprintf(stderr, "ERROR: --tiers wants powers of two, like --tiers=512,1024\n");
+				return 1;
+			}
+		} else if (strncmp(argv[i], "--threads=", 10) == 0) {
+			threads = (unsigned)atoi(argv[i] + 10);
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "ERROR: unknown option %s\n", argv[i]);
+			return 1;
+		} else {
+			images.push_back(argv[i]);
+		}
+	}
+	if (!have_format || images.empty()) {
+		fprintf(stderr, "usage: texture_baker bc1|bc3|bc7 [--no-mips] [--filter=box|kaiser|lanczos] "
+			"[--linear] [--premultiply] [--flip] [--threads=N] [--levels] [--tiers[=N,...]] image...\n");
+		return 1;
+	}
+
+	thread_pool_t pool;
+	thread_pool_init(&pool, threads);
+	int failed = 0;
+	for (size_t i = 0; i < images.size(); i++) {
+		if (!bake(&pool, format, images[i], filter, srgb, premultiply, flip, print_levels, tiers)) {
+			failed++;
+		}
+	}
+	thread_pool_shutdown(&pool);
+	return failed ? 1 : 0;
+}